@@ -0,0 +1,155 @@
+/**
+ * @file SDAggregator.cpp
+ */
+#include "SDAggregator.hpp"
+#include "SDJson.hpp"
+#include "SDTime.hpp"
+
+#include <cstdio>
+
+/**
+ * @param[in] bucket_seconds Width of a bucket, `0` is treated as one second.
+ * @param[in] fields Names of the numeric message fields to aggregate, at most `SDREADER_AGG_MAX_FIELDS`.
+ * @param[in] separator Field separator of the log lines.
+ */
+SDAggregator::SDAggregator(uint32_t bucket_seconds, const std::vector<std::string>& fields, const std::string& separator)
+    : width(bucket_seconds > 0 ? bucket_seconds : 1), separator(separator)
+{
+    for(const std::string& f : fields){
+        if(this->fields.size() == SDREADER_AGG_MAX_FIELDS) break;
+        this->fields.push_back(f);
+    }
+    for(const std::string& f : this->fields) this->keys.emplace_back(f);
+}
+
+uint32_t SDAggregator::topic_id(std::string_view topic){
+    auto it = this->topic_ids.find(topic);
+    if(it != this->topic_ids.end()) return it->second;
+
+    uint32_t id = this->topics.size();
+    this->topics.emplace_back(topic);
+    this->topic_ids.emplace(this->topics.back(), id);
+    return id;
+}
+
+/**
+ * Splits a log line into topic and message, see `add()`.
+ *
+ * @param[in] line A `TIME;TOPIC;MESSAGE;` line.
+ * @param[in] epoch The line's time stamp.
+ */
+void SDAggregator::add_line(std::string_view line, int64_t epoch){
+    size_t first_sc = line.find(this->separator);
+    if(first_sc == std::string_view::npos) return;
+    size_t second_sc = line.find(this->separator, first_sc + 1);
+    if(second_sc == std::string_view::npos) return;
+
+    size_t msg_start = second_sc + this->separator.size();
+    this->add(line.substr(first_sc + 1, second_sc - first_sc - 1), line.substr(msg_start), epoch);
+}
+
+/**
+ * Looks the fields up in `message` in one pass and adds every numeric value to its
+ * bucket's statistics. Missing and non-numeric fields are ignored, a message with no
+ * usable field allocates nothing.
+ *
+ * @param[in] topic The line's topic.
+ * @param[in] message The line's JSON message.
+ * @param[in] epoch The line's time stamp.
+ */
+void SDAggregator::add(std::string_view topic, std::string_view message, int64_t epoch){
+    std::string_view values[SDREADER_AGG_MAX_FIELDS];
+    double numbers[SDREADER_AGG_MAX_FIELDS];
+    const size_t n = this->fields.size();
+
+    if(sd_json_fields(message, this->keys.data(), n, values) == 0) return;
+
+    bool any = false;
+    bool usable[SDREADER_AGG_MAX_FIELDS];
+    for(size_t f = 0; f < n; f++){
+        usable[f] = sd_json_number(values[f], numbers[f]);
+        any |= usable[f];
+    }
+    if(!any) return;
+
+    // floor division so buckets before 1970 stay aligned
+    int64_t start = epoch / this->width * this->width;
+    if(epoch < 0 && start != epoch) start -= this->width;
+
+    size_t base = this->topic_id(topic) * n;
+    std::vector<SDFieldStats>& cells = this->buckets[start];
+    if(cells.size() < base + n) cells.resize(base + n);
+
+    for(size_t f = 0; f < n; f++){
+        if(usable[f]) cells[base + f].add(numbers[f]);
+    }
+}
+
+static void append_number(std::string& out, double value){
+    char num[SDJSON_NUMBER_CHARS];
+    out.append(num, snprintf(num, sizeof(num), "%.7g", value));
+}
+
+/**
+ * Formats every bucket ending at or before `before` as one row per topic and releases
+ * it. A row is a log line whose message holds the statistics of each field with values,
+ *
+ * ```
+ * 5-24-2023T17:00:00;kkm_k6p/bc:57:29:00:f6:d3;{"TEMP":{"count":60,"min":20.5,"max":21.2,"mean":20.8}};
+ * ```
+ *
+ * @param[in] before Buckets ending after this epoch stay open.
+ * @param[in] row Called with each row's bucket start and text, in time order.
+ */
+void SDAggregator::emit(int64_t before, const std::function<void(int64_t, std::string_view)>& row){
+    const size_t n = this->fields.size();
+    char ts[SD_TIME_CHARS];
+
+    auto it = this->buckets.begin();
+    while(it != this->buckets.end() && it->first + this->width <= before){
+        const std::vector<SDFieldStats>& cells = it->second;
+
+        for(size_t t = 0; t * n < cells.size(); t++){
+            std::string& r = this->row;
+            r.assign(ts, sd_format_time(it->first, ts));
+            r += this->separator;
+            r += this->topics[t];
+            r += this->separator;
+            r += '{';
+
+            bool first = true;
+            for(size_t f = 0; f < n; f++){
+                const SDFieldStats& s = cells[t * n + f];
+                if(s.count == 0) continue;
+
+                if(!first) r += ',';
+                first = false;
+
+                r += '"';
+                r += this->fields[f];
+                r += "\":{\"count\":";
+                r += std::to_string(s.count);
+                r += ",\"min\":";
+                append_number(r, s.min);
+                r += ",\"max\":";
+                append_number(r, s.max);
+                r += ",\"mean\":";
+                append_number(r, s.sum / s.count);
+                r += '}';
+            }
+
+            if(first) continue;     // the topic had no values in this bucket
+            r += '}';
+            r += this->separator;
+            row(it->first, r);
+        }
+
+        it = this->buckets.erase(it);
+    }
+}
+
+size_t SDAggregator::cells() const {
+    size_t total = 0;
+    for(const auto& b : this->buckets) total += b.second.size();
+    return total;
+}
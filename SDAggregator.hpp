@@ -0,0 +1,94 @@
+/**
+ * @file SDAggregator.hpp
+ * @brief Per time bucket, per topic statistics of numeric message fields, used by
+ *  `SDReader::aggregate_entry_range_from_files()`.
+ */
+#ifndef SDAGGREGATOR_HPP
+#define SDAGGREGATOR_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define SDREADER_AGG_MAX_FIELDS 8       // numeric fields one query can aggregate
+
+/**
+ * @brief Running statistics of one field.
+ */
+struct SDFieldStats {
+    double min = 0;
+    double max = 0;
+    double sum = 0;
+    uint32_t count = 0;
+
+    void add(double value){
+        if(this->count == 0 || value < this->min) this->min = value;
+        if(this->count == 0 || value > this->max) this->max = value;
+        this->sum += value;
+        this->count++;
+    }
+};
+
+/**
+ * @brief Accumulates min/max/mean/count of numeric JSON fields per bucket and topic.
+ *
+ * Buckets are `bucket_seconds` wide and aligned to the Unix epoch, so hourly buckets
+ * start on the hour. Only buckets and topics that received a value hold memory, and
+ * finished buckets are released by `emit()`, so memory is bounded by the open buckets
+ * times the topics seen, not by the number of lines.
+ */
+class SDAggregator {
+
+    private:
+
+        int64_t width;
+        std::string separator;
+        std::vector<std::string> fields;
+        std::vector<std::string_view> keys;             // views of `fields` for the scanner
+
+        std::vector<std::string> topics;
+        std::map<std::string, uint32_t, std::less<>> topic_ids;
+        std::map<int64_t, std::vector<SDFieldStats>> buckets;   // bucket start -> topic * field
+
+        std::string row;        // reused to format rows
+
+        uint32_t topic_id(std::string_view topic);
+
+    public:
+
+        /**
+         * @brief Aggregate `fields` in buckets of `bucket_seconds`, lines split on `separator`.
+         */
+        SDAggregator(uint32_t bucket_seconds, const std::vector<std::string>& fields, const std::string& separator = ";");
+
+        /**
+         * @brief Add the fields of a `TIME;TOPIC;MESSAGE;` line with time stamp `epoch`.
+         */
+        void add_line(std::string_view line, int64_t epoch);
+
+        /**
+         * @brief Add the fields of `message`, logged on `topic` at `epoch`.
+         */
+        void add(std::string_view topic, std::string_view message, int64_t epoch);
+
+        /**
+         * @brief Pass every bucket ending at or before `before` to `row(bucket start, line)` and release it.
+         */
+        void emit(int64_t before, const std::function<void(int64_t, std::string_view)>& row);
+
+        /**
+         * @brief Buckets held in memory.
+         */
+        size_t open_buckets() const {return this->buckets.size();}
+
+        /**
+         * @brief Field statistics held in memory.
+         */
+        size_t cells() const;
+
+};
+
+#endif
@@ -0,0 +1,599 @@
+/**
+ * @file SDArchiveReader.cpp
+ */
+#include "SDArchiveReader.hpp"
+
+#if !defined(ESP_PLATFORM)
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <queue>
+
+#include "SDReader.hpp"
+#include "SDLineReader.hpp"
+#include "SDScan.hpp"
+#include "SDLogIndex.hpp"
+#include "SDBinaryFormat.hpp"
+#include "SDCompress.hpp"
+#include "SDRecovery.hpp"
+#include "SDMetrics.hpp"
+
+static uint64_t elapsed_us(std::chrono::steady_clock::time_point since){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+/**
+ * CPU time of the calling thread, which unlike the wall clock leaves out the time the
+ * workers take from it when there are fewer cores than threads.
+ */
+static uint64_t thread_cpu_us(){
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Plans the files overlapping the range into tasks, starts the workers on them and
+ * merges and publishes the results of each file in date order while the workers scan
+ * the files after it.
+ *
+ * @param[in] epoch The beginning of the time range to collect data from.
+ * @param[in] terminus The end of the time range to collect data from.
+ * @param[in] topic_filter The topic patterns to collect, compiled once into an `SDTopicFilter`.
+ * @param[in] page_length The maximum number of entries in a page, `0` to fill pages up to the MQTT buffer size.
+ * @param[in] prefix Only collect data from files whose prefix matches, for example only collect from `log` files.
+ * @param[in] filetype Match file type, this defaults to `csv`.
+ */
+void SDArchiveReader::read_entry_range_from_files(TimeStamp epoch,
+        TimeStamp terminus,
+        std::vector<std::string> topic_filter,
+        int page_length,
+        std::string prefix,
+        std::string filetype)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    SDTopicFilter filter(topic_filter);
+    this->q_epoch = epoch.get_epoch();
+    this->q_terminus = terminus.get_epoch();
+    this->filter = &filter;
+    this->stats = SDArchiveStats();
+
+    this->plan(prefix, filetype);
+
+    size_t threads = (this->threads > 0) ? this->threads : SDWorkPool::default_threads();
+    size_t ahead = threads * SDARCHIVE_TASKS_AHEAD;
+    this->stats.threads = threads;
+    this->stats.files = this->sources.size();
+    this->stats.tasks = this->task_count;
+
+    this->page_topic = SDREADER_RANGE_TOPIC + this->device;
+    this->next_seq = 0;
+
+    // workers may run ahead of the merge by `ahead` tasks past the file being merged
+    this->admitted = this->sources.empty() ? 0 : this->sources[0].task_count + ahead;
+    this->pool.start(this->task_count, threads, [this](size_t t){this->scan_task(t);}, &this->admitted);
+
+    for(size_t s = 0; s < this->sources.size(); s++){
+        const Source& source = this->sources[s];
+        this->admitted = source.first_task + source.task_count + ahead;
+
+        auto wait = std::chrono::steady_clock::now();
+        for(size_t t = source.first_task; t < source.first_task + source.task_count; t++){
+            while(!this->tasks[t].done.load()) sd_task_sleep(SDWORKPOOL_POLL_MS);
+        }
+        this->stats.merge_wait_us += elapsed_us(wait);
+
+        uint64_t merge = thread_cpu_us();
+        this->merge_source(s, page_length);
+        this->stats.merge_us += thread_cpu_us() - merge;
+    }
+
+    this->pool.wait();
+    this->stats.steals = this->pool.stolen();
+    this->stats.total_us = elapsed_us(start);
+
+    this->filter = NULL;
+    this->sources.clear();
+    this->tasks.reset();
+    this->task_count = 0;
+}
+
+/**
+ * Lists the archive and turns each file overlapping the time range into a source and its
+ * tasks.
+ *
+ * @param[in] prefix The prefix of the files to query.
+ * @param[in] filetype The extension of the files to query.
+ */
+void SDArchiveReader::plan(const std::string& prefix, const std::string& filetype){
+    if(this->catalog.stale("/", prefix, filetype))
+        this->catalog.refresh(*this->sd, "/", prefix, filetype);
+
+    this->sources.clear();
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    std::vector<std::pair<size_t, std::pair<uint32_t, uint32_t>>> planned;
+
+    for(const SDCatalogEntry& file : this->catalog.files()){
+        if(file.day_start + SD_SECS_PER_DAY <= this->q_epoch) continue;
+        if(file.day_start > this->q_terminus) break;
+
+        Source source;
+        source.path = file.path;
+        ranges.clear();
+        this->plan_source(source, ranges);
+
+        source.first_task = planned.size();
+        source.task_count = ranges.size();
+        for(const auto& r : ranges) planned.push_back({this->sources.size(), r});
+        this->sources.push_back(std::move(source));
+    }
+
+    this->task_count = planned.size();
+    this->tasks.reset(new Task[this->task_count]);
+    for(size_t t = 0; t < this->task_count; t++){
+        this->tasks[t].source = planned[t].first;
+        this->tasks[t].start = planned[t].second.first;
+        this->tasks[t].stop = planned[t].second.second;
+    }
+}
+
+/**
+ * Finds the format of a source, where its data ends and its wanted topic IDs, and cuts
+ * the bytes which can hold matches into ranges. Like SDReader, a text file whose
+ * dictionary has no wanted topic is only scanned outside the span where encoding was on,
+ * and a binary file without wanted topics is not scanned at all.
+ *
+ * @param[in,out] source The source, with its path set.
+ * @param[out] ranges The byte ranges to scan, in file order.
+ */
+void SDArchiveReader::plan_source(Source& source, std::vector<std::pair<uint32_t, uint32_t>>& ranges){
+    File f = this->sd->open(source.path.c_str(), "r");
+    if(!f){
+        Serial.println("[ERROR] failed to open archive file");
+        return;
+    }
+
+    source.data_size = sd_data_end(f);
+
+    uint8_t head[SDLOGGER_FRAME_HEADER > SDLOGGER_BLOCK_HEADER ? SDLOGGER_FRAME_HEADER : SDLOGGER_BLOCK_HEADER];
+    f.seek(0);
+    size_t n = f.read(head, sizeof(head));
+    f.close();
+
+    SDFrameHeader frame;
+    SDBlockHeader block;
+    if(sd_parse_frame_header(head, n, frame)) source.kind = SOURCE_COMPRESSED;
+    else if(SDBlockDecoder::parse_header(head, n, block)) source.kind = SOURCE_BINARY;
+
+    int wanted = -1;
+    if(source.dictionary.load(*this->sd, sd_uncompressed_name(source.path))){
+        wanted = 0;
+        source.wanted_ids.resize(source.dictionary.size());
+        for(size_t id = 0; id < source.dictionary.size(); id++){
+            source.wanted_ids[id] = this->filter->match(source.dictionary.topic(id));
+            if(source.wanted_ids[id]) wanted++;
+        }
+    }
+
+    uint32_t start = 0;
+    uint32_t stop = source.data_size;
+
+    if(source.kind == SOURCE_COMPRESSED){
+        ranges.push_back({0, stop});
+        return;
+    }
+
+    if(source.kind == SOURCE_BINARY && wanted <= 0) return;
+
+    if(source.kind == SOURCE_TEXT && wanted == 0){
+        // only the lines with topics written as is are left to scan, before encoding
+        // started and after it ended
+        uint32_t encoded_end = source.dictionary.end_offset();
+        if(encoded_end < stop){
+            if(source.dictionary.start_offset() > 0) ranges.push_back({0, source.dictionary.start_offset()});
+            start = encoded_end;
+        }else{
+            stop = std::min(stop, source.dictionary.start_offset());
+        }
+
+    }else if(this->use_index){
+        std::vector<SDIndexEntry> index;
+        // same rule as SDReader, an index out of order by more than the slack is not used
+        if(sd_load_index(*this->sd, source.path, source.data_size, index) &&
+                sd_index_ordered(index, SDLOGGER_INDEX_SLACK)){
+            for(const SDIndexEntry& e : index){
+                if((int64_t)e.epoch < this->q_epoch - SDLOGGER_INDEX_SLACK){
+                    start = e.offset;
+
+                }else if((int64_t)e.epoch > this->q_terminus + SDLOGGER_INDEX_SLACK){
+                    stop = e.offset;
+                    break;
+                }
+            }
+        }
+    }
+
+    if(start >= stop) return;
+
+    // binary blocks cannot be found from an arbitrary offset cheaply, they are scanned whole
+    uint32_t pieces = 1;
+    if(source.kind == SOURCE_TEXT && this->split_bytes > 0)
+        pieces = (stop - start + this->split_bytes - 1) / this->split_bytes;
+
+    for(uint32_t i = 0; i < pieces; i++){
+        uint32_t from = start + (uint64_t)(stop - start) * i / pieces;
+        uint32_t to = start + (uint64_t)(stop - start) * (i + 1) / pieces;
+        ranges.push_back({from, to});
+    }
+}
+
+/**
+ * Runs on a worker: scans task `t` and sorts its entries by time stamp.
+ *
+ * @param[in] t The task's number.
+ */
+void SDArchiveReader::scan_task(size_t t){
+    Task& task = this->tasks[t];
+    const Source& source = this->sources[task.source];
+
+    File f = this->sd->open(source.path.c_str(), "r");
+    if(!f){
+        Serial.println("[ERROR] failed to open archive file");
+
+    }else if(source.kind == SOURCE_COMPRESSED){
+        this->scan_frames(task, source, f);
+
+    }else if(source.kind == SOURCE_BINARY){
+        this->scan_blocks(task, source, f);
+
+    }else{
+        this->scan_text(task, source, f);
+    }
+    f.close();
+
+    // lines are logged close to time order, so this is usually a single pass
+    auto earlier = [](const Hit& a, const Hit& b){return a.epoch < b.epoch;};
+    if(!std::is_sorted(task.hits.begin(), task.hits.end(), earlier))
+        std::stable_sort(task.hits.begin(), task.hits.end(), earlier);
+
+    task.done = true;
+}
+
+/**
+ * Scans the lines of a text file which start in `[task.start, task.stop)`. A range after
+ * the first starts reading one byte early and drops the line holding that byte, which
+ * belongs to the range before, so every line is scanned by exactly one range. The file
+ * is scanned through its own memory map when the storage can map it, ranges of the same
+ * file share the mapped pages through the page cache.
+ *
+ * @param[in,out] task The range and its entries.
+ * @param[in] source The file.
+ * @param[in] f The open file.
+ */
+void SDArchiveReader::scan_text(Task& task, const Source& source, File& f){
+    SDLineReader lines(SDARCHIVE_BLOCK_SIZE);
+    SDTimeParser parser;
+    std::string_view line;
+
+    SDMapping mapping;
+    if(this->mapped && this->sd->map(source.path.c_str(), mapping) && mapping.size() >= source.data_size)
+        lines.attach(mapping.data(), source.data_size);
+    else
+        lines.attach(&f, source.data_size);
+
+    if(task.start > 0){
+        lines.seek(task.start - 1);
+        lines.next(line);
+    }
+
+    while(lines.next(line)){
+        if(lines.line_offset() >= task.stop) break;
+        this->collect_line(task, source, parser, line);
+    }
+
+    task.bytes_read += lines.bytes_read();
+}
+
+/**
+ * Checks one text line against the query like `SDReader::collect_line()` and keeps it if
+ * it matches, with its topic expanded if the line refers to the dictionary. Entries are
+ * kept JSON escaped, so the merge only copies them into pages.
+ *
+ * @param[in,out] task The task the line belongs to.
+ * @param[in] source The file holding the line.
+ * @param[in,out] parser Parses the line time stamps of the file.
+ * @param[in] line The line, without its newline.
+ */
+void SDArchiveReader::collect_line(Task& task, const Source& source, SDTimeParser& parser, std::string_view line){
+    task.scanned++;
+
+    // skip lines torn by a power loss, strips the checksum of whole ones
+    if(!sd_check_line(line, this->separator)){
+        task.rejected++;
+        return;
+    }
+
+    size_t first_sc, second_sc;
+    if(!sd_scan_separators(line, this->separator[0], first_sc, second_sc)) return;
+
+    std::string_view l_topic = line.substr(first_sc + 1, second_sc - first_sc - 1);
+
+    int64_t ts;
+    if(!parser.parse(line.substr(0, first_sc), ts)) return;
+    if(ts < this->q_epoch || ts > this->q_terminus) return;
+
+    size_t offset = task.text.size();
+    uint16_t id;
+    if(SDTopicDictionary::parse_ref(l_topic, id)){
+        if(id >= source.wanted_ids.size() || !source.wanted_ids[id]) return;
+
+        SDPageBuilder::append_escaped(task.text, line.substr(0, first_sc + 1));
+        SDPageBuilder::append_escaped(task.text, source.dictionary.topic(id));
+        SDPageBuilder::append_escaped(task.text, line.substr(second_sc));
+
+    }else if(SDTopicDictionary::escaped(l_topic)){
+        if(!this->filter->match(l_topic.substr(1))) return;
+
+        SDPageBuilder::append_escaped(task.text, line.substr(0, first_sc + 1));
+        SDPageBuilder::append_escaped(task.text, line.substr(first_sc + 2));
+
+    }else if(this->filter->match(l_topic)){
+        SDPageBuilder::append_escaped(task.text, line);
+
+    }else{
+        return;
+    }
+
+    keep(task, ts, offset);
+}
+
+/**
+ * Records the entry appended to `task.text` at `offset`.
+ *
+ * @param[in,out] task The task holding the entry.
+ * @param[in] epoch The entry's time stamp.
+ * @param[in] offset Where the entry starts in `task.text`.
+ */
+void SDArchiveReader::keep(Task& task, int64_t epoch, size_t offset){
+    task.hits.push_back({epoch, (uint32_t)offset, (uint32_t)(task.text.size() - offset)});
+}
+
+/**
+ * Scans the binary blocks in `[task.start, task.stop)` like `SDReader::scan_blocks()`,
+ * writing the wanted records out as escaped lines.
+ *
+ * @param[in,out] task The range and its entries.
+ * @param[in] source The file.
+ * @param[in] f The open file.
+ */
+void SDArchiveReader::scan_blocks(Task& task, const Source& source, File& f){
+    uint32_t pos = task.start;
+    uint8_t head[SDLOGGER_BLOCK_HEADER];
+    char ts[SD_TIME_CHARS];
+    std::vector<uint8_t> payload;
+    SDBlockHeader header;
+    SDBlockDecoder decoder;
+
+    while(pos < task.stop){
+        f.seek(pos);
+        size_t n = f.read(head, SDLOGGER_BLOCK_HEADER);
+        task.bytes_read += n;
+
+        if(!SDBlockDecoder::parse_header(head, n, header)){
+            if(n < SDLOGGER_BLOCK_HEADER) break;
+            pos++;      // resynchronize on the next block header
+            continue;
+        }
+
+        payload.resize(header.payload_len);
+        n = f.read(payload.data(), header.payload_len);
+        task.bytes_read += n;
+
+        if(n != header.payload_len || !decoder.begin(header, payload.data())){
+            Serial.println("[ERROR] corrupt block in binary log, skipping");
+            pos++;
+            continue;
+        }
+        pos += SDLOGGER_BLOCK_HEADER + header.payload_len;
+
+        int64_t epoch;
+        uint16_t id;
+        std::string_view message;
+        while(decoder.next(epoch, id, message)){
+            task.scanned++;
+            if(epoch < this->q_epoch || epoch > this->q_terminus) continue;
+            if(id >= source.wanted_ids.size() || !source.wanted_ids[id]) continue;
+
+            size_t offset = task.text.size();
+            task.text.append(ts, sd_format_time(epoch, ts));
+            SDPageBuilder::append_escaped(task.text, this->separator);
+            SDPageBuilder::append_escaped(task.text, source.dictionary.topic(id));
+            SDPageBuilder::append_escaped(task.text, this->separator);
+            SDPageBuilder::append_escaped(task.text, message);
+            SDPageBuilder::append_escaped(task.text, this->separator);
+            keep(task, epoch, offset);
+        }
+    }
+}
+
+/**
+ * Scans the frames of a compressed file like `SDReader::scan_frames()`, skipping frames
+ * outside the time range without reading them.
+ *
+ * @param[in,out] task The range and its entries.
+ * @param[in] source The file.
+ * @param[in] f The open file.
+ */
+void SDArchiveReader::scan_frames(Task& task, const Source& source, File& f){
+    uint32_t size = f.size();
+    uint32_t pos = task.start;
+    uint8_t head[SDLOGGER_FRAME_HEADER];
+    std::vector<uint8_t> stored, raw_buffer;
+    SDTimeParser parser;
+    SDFrameHeader header;
+
+    while(pos < size){
+        f.seek(pos);
+        size_t n = f.read(head, SDLOGGER_FRAME_HEADER);
+        task.bytes_read += n;
+
+        if(!sd_parse_frame_header(head, n, header)){
+            if(n < SDLOGGER_FRAME_HEADER) break;
+            pos++;      // resynchronize on the next frame header
+            continue;
+        }
+
+        // skip frames entirely outside the range, frames without time stamps have min > max
+        if((int64_t)header.max_epoch < this->q_epoch || (int64_t)header.min_epoch > this->q_terminus){
+            pos += SDLOGGER_FRAME_HEADER + header.stored_len;
+            continue;
+        }
+
+        stored.resize(header.stored_len);
+        bool ok = f.read(stored.data(), header.stored_len) == header.stored_len;
+        task.bytes_read += header.stored_len;
+
+        const uint8_t* raw = stored.data();
+        if(ok && header.stored_len < header.raw_len){
+            raw_buffer.resize(header.raw_len);
+            ok = SDLzCodec::decompress(stored.data(), header.stored_len, raw_buffer.data(), header.raw_len) == header.raw_len;
+            raw = raw_buffer.data();
+        }
+
+        if(!ok || sd_crc32(raw, header.raw_len) != header.crc){
+            Serial.println("[ERROR] corrupt frame in compressed log, skipping");
+            pos++;
+            continue;
+        }
+        pos += SDLOGGER_FRAME_HEADER + header.stored_len;
+
+        std::string_view text((const char*)raw, header.raw_len);
+        size_t line_start = 0;
+        while(line_start < text.size()){
+            size_t line_end = text.find('\n', line_start);
+            if(line_end == std::string_view::npos) line_end = text.size();
+
+            std::string_view line = text.substr(line_start, line_end - line_start);
+            line_start = line_end + 1;
+
+            if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            this->collect_line(task, source, parser, line);
+        }
+    }
+}
+
+/**
+ * Publishes the entries of source `s` in time stamp order, merging its ranges' sorted
+ * entries and breaking ties by range so entries with equal time stamps keep their file
+ * order. The ranges of a file logged in time order follow each other and are published
+ * one after another without the merge. The ranges' memory is released afterwards.
+ *
+ * @param[in] s The source, all of whose tasks are done.
+ * @param[in] page_length The maximum number of entries in a page, `0` or less for no limit.
+ */
+void SDArchiveReader::merge_source(size_t s, int page_length){
+    const Source& source = this->sources[s];
+    size_t first = source.first_task;
+    this->merging = s;
+    size_t last = first + source.task_count;
+
+    size_t overhead = SDREADER_MQTT_OVERHEAD + this->page_topic.size();
+    this->page.set_budget(this->mqtt_buffer > overhead ? this->mqtt_buffer - overhead : 0);
+    this->page.begin(source.path, this->next_seq);
+
+    // ranges which do not overlap in time are already in order
+    bool ordered = true;
+    int64_t newest = INT64_MIN;
+    for(size_t t = first; t < last && ordered; t++){
+        const std::vector<Hit>& hits = this->tasks[t].hits;
+        if(hits.empty()) continue;
+
+        ordered = hits.front().epoch >= newest;
+        newest = hits.back().epoch;
+    }
+
+    if(ordered){
+        for(size_t t = first; t < last; t++){
+            const Task& task = this->tasks[t];
+            for(const Hit& hit : task.hits)
+                this->page_entry(std::string_view(task.text).substr(hit.offset, hit.length), hit.epoch, page_length);
+        }
+    }
+
+    // heap of (time stamp, task), the earliest entry on top
+    std::vector<size_t> next(source.task_count, 0);
+    auto later = [](const std::pair<int64_t, size_t>& a, const std::pair<int64_t, size_t>& b){
+        return (a.first != b.first) ? a.first > b.first : a.second > b.second;
+    };
+    std::priority_queue<std::pair<int64_t, size_t>, std::vector<std::pair<int64_t, size_t>>, decltype(later)> heads(later);
+
+    for(size_t t = first; t < last && !ordered; t++){
+        if(!this->tasks[t].hits.empty()) heads.push({this->tasks[t].hits[0].epoch, t});
+    }
+
+    while(!heads.empty()){
+        size_t t = heads.top().second;
+        heads.pop();
+
+        Task& task = this->tasks[t];
+        size_t& i = next[t - first];
+        const Hit& hit = task.hits[i];
+        this->page_entry(std::string_view(task.text).substr(hit.offset, hit.length), hit.epoch, page_length);
+
+        if(++i < task.hits.size()) heads.push({task.hits[i].epoch, t});
+    }
+
+    if(!this->page.empty()) this->publish_page();
+
+    for(size_t t = first; t < last; t++){
+        Task& task = this->tasks[t];
+
+        this->stats.bytes_read += task.bytes_read;
+        this->stats.lines_scanned += task.scanned;
+        this->stats.lines_matched += task.hits.size();
+        SD_METRIC_ADD(SD_FILE_OPENS, 1);
+        SD_METRIC_ADD(SD_FILE_CLOSES, 1);
+        SD_METRIC_ADD(SD_LINES_SCANNED, task.scanned);
+        SD_METRIC_ADD(SD_LINES_MATCHED, task.hits.size());
+        SD_METRIC_ADD(SD_LINES_REJECTED, task.rejected);
+
+        std::string().swap(task.text);
+        std::vector<Hit>().swap(task.hits);
+    }
+}
+
+/**
+ * Adds an entry to the page like `SDReader::page_entry()`, publishing the page first if
+ * the entry would take it over its byte budget and afterwards if it holds `page_length`
+ * entries. The entry was escaped by the worker which found it.
+ *
+ * @param[in] entry The escaped text to publish.
+ * @param[in] epoch The entry's time stamp.
+ * @param[in] page_length The maximum number of entries in a page, `0` or less for no limit.
+ */
+void SDArchiveReader::page_entry(std::string_view entry, int64_t epoch, int page_length){
+    if(!this->page.add_escaped(entry, epoch)){
+        if(!this->page.empty()) this->publish_page();
+
+        if(!this->page.add_escaped(entry, epoch)){
+            Serial.println("[WARNING] entry larger than the MQTT buffer was not published");
+            return;
+        }
+    }
+
+    if(page_length > 0 && this->page.count() >= (size_t)page_length){
+        this->publish_page();
+    }
+}
+
+/**
+ * Publishes the page to the page sink and starts the next, empty page of the same file.
+ */
+void SDArchiveReader::publish_page(){
+    this->next_seq = this->page.sequence() + 1;
+    if(sd_publish_page(*this->sink, this->page_topic, this->page.finish())) this->stats.pages++;
+
+    this->page.begin(this->sources[this->merging].path, this->next_seq);
+}
+#endif
@@ -0,0 +1,224 @@
+/**
+ * @file SDArchiveReader.hpp
+ * @brief Host side range queries over an archive of daily log files pulled from SD cards,
+ *  scanned in parallel.
+ */
+#ifndef SDARCHIVEREADER_HPP
+#define SDARCHIVEREADER_HPP
+
+#if !defined(ESP_PLATFORM)
+#include <SD.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "TimeStamp.hpp"
+#include "SDStorage.hpp"
+#include "SDFileCatalog.hpp"
+#include "SDTime.hpp"
+#include "SDTopicFilter.hpp"
+#include "SDTopicDictionary.hpp"
+#include "SDPageBuilder.hpp"
+#include "SDPageSink.hpp"
+#include "SDWorkPool.hpp"
+
+#define SDARCHIVE_SPLIT_BYTES 4194304   // text files are scanned in ranges of about this many bytes
+#define SDARCHIVE_TASKS_AHEAD 4         // tasks per thread scanned ahead of the merge
+#define SDARCHIVE_BLOCK_SIZE 65536      // bytes requested per read while scanning
+#define SDARCHIVE_DEVICE "archive"      // appended to the page topic unless `set_device()` is called
+
+/**
+ * @brief Counts and timings of the last archive query.
+ */
+struct SDArchiveStats {
+    uint32_t threads = 0;       // worker threads scanning
+    uint32_t files = 0;         // files overlapping the time range
+    uint32_t tasks = 0;         // files and ranges of files scanned
+    uint32_t steals = 0;        // tasks a worker took from another worker's deque
+    uint32_t pages = 0;         // pages published
+    uint64_t bytes_read = 0;    // bytes read from the files
+    uint64_t lines_scanned = 0; // lines and binary records checked against the query
+    uint64_t lines_matched = 0; // entries published
+    uint64_t merge_wait_us = 0; // time the merge waited for the workers
+    uint64_t merge_us = 0;      // CPU time the calling thread spent merging and publishing
+    uint64_t total_us = 0;      // time of the whole query
+};
+
+/**
+ * @brief Runs SDReader's range queries over a directory of daily log files on the host,
+ *  scanning files on a pool of worker threads.
+ *
+ * Every file overlapping the time range becomes one or more tasks: text files are cut
+ * into byte ranges of about `set_split_bytes()` bytes, each range owning the lines which
+ * start inside it, and binary and compressed files are scanned whole. Existing `.idx`
+ * sidecars narrow a file to the part holding the range first, they are never built or
+ * extended. The tasks run on an `SDWorkPool`, each keeping its matching entries JSON
+ * escaped back to back in one buffer, so escaping runs on the workers too.
+ *
+ * The calling thread merges the results of each file as soon as its tasks are done, by
+ * time stamp with ties kept in file order, and publishes them in the pages SDReader
+ * publishes, in file date order. Files written by a rotating logger hold one day each,
+ * so such an export is in time stamp order as a whole. Workers stay at most
+ * `SDARCHIVE_TASKS_AHEAD` tasks per thread ahead of the merge, bounding the results held
+ * in memory when the sink is slower than the scan.
+ *
+ * The storage must allow files to be opened and read from several threads at once, as
+ * `SDPosixStorage` does.
+ */
+class SDArchiveReader {
+
+    private:
+
+        enum SourceKind {
+            SOURCE_TEXT,
+            SOURCE_BINARY,
+            SOURCE_COMPRESSED,
+        };
+
+        /**
+         * @brief A file overlapping the query, read only once the workers start.
+         */
+        struct Source {
+            std::string path;
+            SourceKind kind = SOURCE_TEXT;
+            uint32_t data_size = 0;         // where the data ends, before any preallocated zeros
+            SDTopicDictionary dictionary;
+            std::vector<bool> wanted_ids;   // topic IDs which match the query's filter
+            size_t first_task = 0;
+            size_t task_count = 0;
+        };
+
+        /**
+         * @brief A matching entry, `length` bytes at `offset` in its task's `text`.
+         */
+        struct Hit {
+            int64_t epoch;
+            uint32_t offset;
+            uint32_t length;
+        };
+
+        /**
+         * @brief Bytes `[start, stop)` of a source, and the entries found there.
+         */
+        struct Task {
+            size_t source = 0;
+            uint32_t start = 0;
+            uint32_t stop = 0;
+
+            std::string text;               // matching entries back to back, JSON escaped
+            std::vector<Hit> hits;          // sorted by time stamp once the task is done
+            uint64_t bytes_read = 0;
+            uint64_t scanned = 0;
+            uint64_t rejected = 0;
+            std::atomic<bool> done{false};
+        };
+
+        SDStorage* sd;
+        size_t threads = 0;
+        uint32_t split_bytes = SDARCHIVE_SPLIT_BYTES;
+        bool use_index = false;
+        bool mapped = true;             // scan text files through memory maps
+        std::string separator = ";";
+
+        SDMqttSink mqtt_sink;
+        SDPageSink* sink = &mqtt_sink;
+        std::string device = SDARCHIVE_DEVICE;
+        std::string page_topic;
+        size_t mqtt_buffer = SDREADER_MQTT_BUFFER;
+        SDPageBuilder page;
+        uint32_t next_seq = 0;
+        size_t merging = 0;             // source whose entries are being published
+
+        SDFileCatalog catalog;
+        std::vector<Source> sources;
+        std::unique_ptr<Task[]> tasks;
+        size_t task_count = 0;
+        std::atomic<size_t> admitted{0};    // workers may take tasks below this
+
+        SDWorkPool pool;
+        SDArchiveStats stats;
+
+        int64_t q_epoch = 0;
+        int64_t q_terminus = 0;
+        const SDTopicFilter* filter = NULL;
+
+        void plan(const std::string& prefix, const std::string& filetype);
+        void plan_source(Source& source, std::vector<std::pair<uint32_t, uint32_t>>& ranges);
+
+        void scan_task(size_t t);
+        void scan_text(Task& task, const Source& source, File& f);
+        void scan_blocks(Task& task, const Source& source, File& f);
+        void scan_frames(Task& task, const Source& source, File& f);
+        void collect_line(Task& task, const Source& source, SDTimeParser& parser, std::string_view line);
+        static void keep(Task& task, int64_t epoch, size_t offset);
+
+        void merge_source(size_t s, int page_length);
+        void page_entry(std::string_view entry, int64_t epoch, int page_length);
+        void publish_page();
+
+    public:
+
+        /**
+         * @brief A reader of the log files in `storage`, usually an `SDPosixStorage`.
+         */
+        SDArchiveReader(SDStorage& storage){this->sd = &storage;}
+
+        /**
+         * @brief Scan with `threads` worker threads, `0` for one per hardware thread.
+         */
+        void set_threads(size_t threads){this->threads = threads;}
+
+        /**
+         * @brief Cut text files into ranges of about `bytes`, `0` scans every file whole.
+         */
+        void set_split_bytes(uint32_t bytes){this->split_bytes = bytes;}
+
+        /**
+         * @brief Narrow files to the time range, widened by `SDLOGGER_INDEX_SLACK`, with
+         *  their existing `.idx` sidecars, files whose index is out of order are scanned whole.
+         */
+        void set_use_index(bool use){this->use_index = use;}
+
+        /**
+         * @brief Scan text files through memory maps when the storage can map them, the
+         *  default, or read them in blocks of `SDARCHIVE_BLOCK_SIZE` bytes.
+         */
+        void set_mapped(bool mapped){this->mapped = mapped;}
+
+        /**
+         * @brief Publish pages to `sink` instead of the MQTT broker, `NULL` restores MQTT.
+         */
+        void set_page_sink(SDPageSink* sink){this->sink = (sink != NULL) ? sink : &this->mqtt_sink;}
+
+        /**
+         * @brief Name appended to the page topic in place of a device's MAC address.
+         */
+        void set_device(std::string device){this->device = device;}
+
+        /**
+         * @brief Size of the MQTT client's buffer, pages are kept small enough to fit it.
+         */
+        void set_mqtt_buffer_size(size_t bytes){this->mqtt_buffer = bytes;}
+
+        /**
+         * @brief Publish every entry in `[epoch, terminus]` whose topic matches
+         *  `topic_filter`, like `SDReader::read_entry_range_from_files()`.
+         */
+        void read_entry_range_from_files(TimeStamp epoch,
+                TimeStamp terminus,
+                std::vector<std::string> topic_filter,
+                int page_length=0,
+                std::string prefix="log",
+                std::string filetype="csv");
+
+        /**
+         * @brief Counts and timings of the last query.
+         */
+        const SDArchiveStats& get_stats() const {return this->stats;}
+
+};
+#endif
+
+#endif
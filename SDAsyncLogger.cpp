@@ -0,0 +1,286 @@
+/**
+ * @file SDAsyncLogger.cpp
+ */
+#include "SDAsyncLogger.hpp"
+
+/**
+ * Creates an asynchronous logger in front of `logger`. The writer is not started until
+ * `start()` is called, lines logged before then stay in the queue.
+ *
+ * @param[in] logger The logger used by the writer task, must outlive this object.
+ * @param[in] queue_length Number of lines which can wait to be written, rounded up to a power of two.
+ * @param[in] policy What to do when a line is logged while the queue is full.
+ */
+SDAsyncLogger::SDAsyncLogger(SDLogger* logger, size_t queue_length, SDOverflowPolicy policy)
+    : logger(logger), queue(queue_length), policy(policy),
+      running(false), writer_done(true), dropped(0), oversize(0), max_enqueue(0), written(0)
+{
+}
+
+SDAsyncLogger::~SDAsyncLogger(){
+    this->stop();
+}
+
+/**
+ * Starts the writer task. The wrapped logger is switched to buffered writes if it is not
+ * already, so a batch of lines reaches the card as whole sectors.
+ *
+ * @returns `true` if the writer is running.
+ */
+bool SDAsyncLogger::start(){
+    if(this->running) return true;
+
+    if(!this->logger->is_buffered())
+        this->logger->enable_buffered_writes();
+
+    this->writer_done = false;
+    this->running = true;
+
+#if defined(ESP_PLATFORM)
+    BaseType_t ok = xTaskCreate(SDAsyncLogger::writer_entry, "sdlog_writer",
+            SDLOGGER_ASYNC_STACK_SIZE, this, SDLOGGER_ASYNC_PRIORITY, &this->writer_task);
+
+    if(ok != pdPASS){
+        Serial.println("[ERROR] failed to create sd log writer task");
+        this->running = false;
+        this->writer_done = true;
+        return false;
+    }
+#else
+    this->writer_thread = std::thread(&SDAsyncLogger::writer_loop, this);
+#endif
+
+    return true;
+}
+
+/**
+ * Signals the writer to stop and waits for it to write every queued line and flush the
+ * logger.
+ */
+void SDAsyncLogger::stop(){
+    if(!this->running) return;
+
+    this->running = false;
+
+#if defined(ESP_PLATFORM)
+    while(!this->writer_done) sd_task_sleep(SDLOGGER_ASYNC_POLL_MS);
+    this->writer_task = NULL;
+#else
+    if(this->writer_thread.joinable()) this->writer_thread.join();
+#endif
+}
+
+#if defined(ESP_PLATFORM)
+/**
+ * FreeRTOS task entry point, runs the writer loop and deletes the task once stopped.
+ */
+void SDAsyncLogger::writer_entry(void* arg){
+    ((SDAsyncLogger*)arg)->writer_loop();
+    vTaskDelete(NULL);
+}
+#endif
+
+/**
+ * Body of the writer task. Lines are drained in batches of at most
+ * `SDLOGGER_ASYNC_BATCH_SIZE`. While the queue is empty the logger's durability mode
+ * decides when buffered lines are committed, so `SD_DURABLE_INTERVAL` and
+ * `SD_DURABLE_BYTES` group lines across batches as they do without the writer.
+ */
+void SDAsyncLogger::writer_loop(){
+    while(this->running){
+        if(this->write_batch() == 0){
+            this->logger_lock.lock();
+            this->logger->flush_if_stale();
+            this->logger_lock.unlock();
+            sd_task_sleep(SDLOGGER_ASYNC_POLL_MS);
+        }
+    }
+
+    // drain whatever was queued before stop()
+    while(this->write_batch() > 0);
+    this->logger_lock.lock();
+    this->logger->flush();
+    this->logger_lock.unlock();
+
+    this->writer_done = true;
+}
+
+/**
+ * Pops up to `SDLOGGER_ASYNC_BATCH_SIZE` lines and appends them to the logger as one
+ * group, so the logger's durability policy commits the batch at most once.
+ *
+ * @returns The number of lines written.
+ */
+size_t SDAsyncLogger::write_batch(){
+    size_t n = 0;
+
+    this->logger_lock.lock();
+    this->logger->begin_group();
+    while(n < SDLOGGER_ASYNC_BATCH_SIZE && this->queue.try_pop([this](SDLogRecord& r){
+                this->logger->log_line(std::string_view(r.line, r.length));
+            })){
+        n++;
+    }
+    this->logger->end_group();
+    this->logger_lock.unlock();
+
+    this->written.fetch_add(n, std::memory_order_relaxed);
+    return n;
+}
+
+/**
+ * Compresses closed files of the wrapped logger one at a time, holding the logger while 
+ * each file is compressed. Call it from a task of lower priority than the writer, or
+ * from `loop()`, never from the writer. Producers keep queueing while a file is 
+ * compressed and the writer catches up afterwards, so the queue should hold the lines 
+ * logged while one day file is compressed or the overflow policy applies.
+ *
+ * @param[in] max_files Most files compressed by this call.
+ *
+ * @returns The number of files compressed.
+ */
+size_t SDAsyncLogger::compress_closed_files(size_t max_files){
+    size_t done = 0;
+
+    while(done < max_files){
+        this->logger_lock.lock();
+        size_t queued = this->logger->pending_compression();
+        size_t n = this->logger->compress_closed_files(1);
+        bool progress = (n > 0 || this->logger->pending_compression() < queued);
+        this->logger_lock.unlock();
+
+        if(!progress) break;
+        done += n;
+    }
+
+    return done;
+}
+
+/**
+ * Preallocates the daily file of `epoch` while holding the logger, like
+ * `compress_closed_files()` call it from a task of lower priority than the writer, some
+ * time before the day begins, so that the writer does not wait on the zeros at midnight.
+ */
+bool SDAsyncLogger::prepare_day(int64_t epoch){
+    this->logger_lock.lock();
+    bool ok = this->logger->prepare_day(epoch);
+    this->logger_lock.unlock();
+    return ok;
+}
+
+/**
+ * Formats a line into a queue slot, applying the overflow policy if the queue is full.
+ * The line has the same layout as the one written by `SDLogger::log_absolute_mqtt()`,
+ * including the doubled `@` of a topic beginning with one.
+ *
+ * @param[in] time Time stamp string.
+ * @param[in] offset Relative offset appended to the time stamp as `+<offset>`, or `NULL`.
+ * @param[in] mqtt_topic The topic string.
+ * @param[in] mqtt_message The message string.
+ *
+ * @returns `true` if the line was queued.
+ */
+bool SDAsyncLogger::enqueue(std::string_view time, const int* offset,
+        std::string_view mqtt_topic, std::string_view mqtt_message)
+{
+    uint32_t t0 = micros();
+    const std::string& sep = this->logger->get_separator();
+
+    char num[SDLOGGER_INT_CHARS];
+    size_t num_len = (offset != NULL) ? SDLogger::format_int(num, *offset) : 0;
+
+    bool escape = SDTopicDictionary::needs_escape(mqtt_topic);
+    size_t length = time.size() + mqtt_topic.size() + mqtt_message.size() + 3 * sep.size();
+    if(offset != NULL) length += 1 + num_len;
+    if(escape) length++;
+
+    if(length > SDLOGGER_ASYNC_RECORD_SIZE){
+        this->oversize.fetch_add(1, std::memory_order_relaxed);
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    auto fill = [&](SDLogRecord& r){
+        char* p = r.line;
+        memcpy(p, time.data(), time.size()); p += time.size();
+        if(offset != NULL){
+            *p++ = '+';
+            memcpy(p, num, num_len); p += num_len;
+        }
+        memcpy(p, sep.data(), sep.size()); p += sep.size();
+        if(escape) *p++ = '@';
+        memcpy(p, mqtt_topic.data(), mqtt_topic.size()); p += mqtt_topic.size();
+        memcpy(p, sep.data(), sep.size()); p += sep.size();
+        memcpy(p, mqtt_message.data(), mqtt_message.size()); p += mqtt_message.size();
+        memcpy(p, sep.data(), sep.size()); p += sep.size();
+        r.length = p - r.line;
+    };
+
+    bool queued = false;
+    for(;;){
+        if(this->queue.try_push(fill)){
+            queued = true;
+            break;
+        }
+
+        if(this->policy == SD_DROP_NEWEST){
+            this->dropped.fetch_add(1, std::memory_order_relaxed);
+            break;
+
+        }else if(this->policy == SD_DROP_OLDEST){
+            if(this->queue.try_pop([](SDLogRecord&){}))
+                this->dropped.fetch_add(1, std::memory_order_relaxed);
+
+        }else{
+            // SD_BLOCK, nothing will free a slot if the writer is not running
+            if(!this->running){
+                this->dropped.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            sd_task_sleep(0);
+        }
+    }
+
+    uint32_t elapsed = micros() - t0;
+    uint32_t prev = this->max_enqueue.load(std::memory_order_relaxed);
+    while(elapsed > prev && !this->max_enqueue.compare_exchange_weak(prev, elapsed, std::memory_order_relaxed));
+
+    return queued;
+}
+
+/**
+ * Queues a line with an absolute time stamp. Never touches the card, the line is written
+ * later by the writer task.
+ *
+ * @param[in] time The timestamp as a string formatted `<date_string>T<time_string>`.
+ * @param[in] mqtt_topic The topic string as a `<base>/<subtopic>/...` formatted string.
+ * @param[in] mqtt_message A string, often JSON object string but not always.
+ *
+ * @returns `true` if queued, `false` if dropped.
+ */
+bool SDAsyncLogger::log_absolute_mqtt(std::string_view time, std::string_view mqtt_topic, std::string_view mqtt_message){
+    return this->enqueue(time, NULL, mqtt_topic, mqtt_message);
+}
+
+/**
+ * Queues a line with a relative time stamp, `<time>+<offset>`.
+ *
+ * @param[in] time The timestamp as a string formatted `<date_string>T<time_string>`.
+ * @param[in] offset The relative offset in minutes.
+ * @param[in] mqtt_topic The topic string as a `<base>/<subtopic>/...` formatted string.
+ * @param[in] mqtt_message A string, often JSON object string but not always.
+ *
+ * @returns `true` if queued, `false` if dropped.
+ */
+bool SDAsyncLogger::log_relative_mqtt(std::string_view time, int offset, std::string_view mqtt_topic, std::string_view mqtt_message){
+    return this->enqueue(time, &offset, mqtt_topic, mqtt_message);
+}
+
+/**
+ * Resets the dropped, oversize and enqueue latency statistics.
+ */
+void SDAsyncLogger::reset_stats(){
+    this->dropped = 0;
+    this->oversize = 0;
+    this->max_enqueue = 0;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file SDAsyncLogger.hpp
+ * @brief Asynchronous front end for SDLogger, records are queued by the caller and written
+ *  to the card by a background writer task.
+ */
+#ifndef SDASYNCLOGGER_HPP
+#define SDASYNCLOGGER_HPP
+
+#include <atomic>
+#include <string>
+#include <string_view>
+
+#include "SDLogger.hpp"
+#include "SDRecordQueue.hpp"
+#include "SDTask.hpp"
+
+#define SDLOGGER_ASYNC_RECORD_SIZE 512      // maximum bytes in one queued line
+#define SDLOGGER_ASYNC_QUEUE_LENGTH 32      // default number of queued lines
+#define SDLOGGER_ASYNC_BATCH_SIZE 16        // maximum lines written per batch
+#define SDLOGGER_ASYNC_POLL_MS 10           // writer sleep when the queue is empty
+#define SDLOGGER_ASYNC_STACK_SIZE 4096      // writer task stack (FreeRTOS only)
+#define SDLOGGER_ASYNC_PRIORITY 1           // writer task priority (FreeRTOS only)
+
+/**
+ * @brief What a producer does when the queue is full.
+ */
+enum SDOverflowPolicy {
+    SD_DROP_NEWEST,     // discard the record being logged
+    SD_DROP_OLDEST,     // discard the oldest queued record to make room
+    SD_BLOCK            // wait for the writer to free a slot
+};
+
+/**
+ * @brief A formatted line waiting to be written.
+ */
+struct SDLogRecord {
+    uint16_t length = 0;
+    char line[SDLOGGER_ASYNC_RECORD_SIZE];
+};
+
+/**
+ * @brief Queues log lines from any task and writes them with an SDLogger from a dedicated
+ *  writer task (FreeRTOS task on target, `std::thread` on host).
+ *
+ * While the writer is running the wrapped SDLogger must only be used through this object.
+ * Producers format their line directly into a queue slot and never touch the card, so the
+ * cost of logging is bounded by the line length rather than the SPI transaction.
+ */
+class SDAsyncLogger {
+
+    private:
+
+        SDLogger* logger;
+        SDRecordQueue<SDLogRecord> queue;
+        SDOverflowPolicy policy;
+        SDMutex logger_lock;        // held by the writer while it uses the logger
+
+        std::atomic<bool> running;
+        std::atomic<bool> writer_done;
+        std::atomic<uint32_t> dropped;
+        std::atomic<uint32_t> oversize;
+        std::atomic<uint32_t> max_enqueue;  // worst enqueue latency, microseconds
+        std::atomic<uint32_t> written;
+
+#if defined(ESP_PLATFORM)
+        TaskHandle_t writer_task = NULL;
+        static void writer_entry(void* arg);
+#else
+        std::thread writer_thread;
+#endif
+
+        void writer_loop();
+        size_t write_batch();
+
+        bool enqueue(std::string_view time, const int* offset,
+                std::string_view mqtt_topic, std::string_view mqtt_message);
+
+    public:
+
+        /**
+         * @brief Wrap `logger`, the queue holds `queue_length` lines.
+         */
+        SDAsyncLogger(SDLogger* logger,
+                size_t queue_length = SDLOGGER_ASYNC_QUEUE_LENGTH,
+                SDOverflowPolicy policy = SD_DROP_NEWEST);
+
+        /**
+         * @brief Stops the writer, writing out any queued lines.
+         */
+        ~SDAsyncLogger();
+
+        /**
+         * @brief Start the background writer.
+         */
+        bool start();
+
+        /**
+         * @brief Stop the background writer after draining the queue.
+         */
+        void stop();
+
+        /**
+         * @brief Queue a line with an absolute time stamp, see `SDLogger::log_absolute_mqtt()`.
+         */
+        bool log_absolute_mqtt(std::string_view time, std::string_view mqtt_topic, std::string_view mqtt_message);
+
+        /**
+         * @brief Queue a line with a relative time stamp, see `SDLogger::log_relative_mqtt()`.
+         */
+        bool log_relative_mqtt(std::string_view time, int offset, std::string_view mqtt_topic, std::string_view mqtt_message);
+
+        /**
+         * @brief Compress up to `max_files` closed files from the calling task, see 
+         *  `SDLogger::compress_closed_files()`.
+         */
+        size_t compress_closed_files(size_t max_files = SIZE_MAX);
+
+        /**
+         * @brief Prepare the daily file of `epoch` from the calling task, see
+         *  `SDLogger::prepare_day()`.
+         */
+        bool prepare_day(int64_t epoch);
+
+        /**
+         * @brief Change the overflow policy.
+         */
+        void set_overflow_policy(SDOverflowPolicy policy){this->policy = policy;}
+
+        /**
+         * @brief Number of lines currently waiting in the queue.
+         */
+        size_t queue_depth() const {return this->queue.size();}
+
+        /**
+         * @brief Number of lines discarded because the queue was full or the line too long.
+         */
+        uint32_t dropped_count() const {return this->dropped.load(std::memory_order_relaxed);}
+
+        /**
+         * @brief Number of lines discarded because they did not fit in `SDLOGGER_ASYNC_RECORD_SIZE`.
+         */
+        uint32_t oversize_count() const {return this->oversize.load(std::memory_order_relaxed);}
+
+        /**
+         * @brief Number of lines handed to the SDLogger by the writer.
+         */
+        uint32_t written_count() const {return this->written.load(std::memory_order_relaxed);}
+
+        /**
+         * @brief Longest time, in microseconds, a producer spent queueing one line.
+         */
+        uint32_t max_enqueue_micros() const {return this->max_enqueue.load(std::memory_order_relaxed);}
+
+        /**
+         * @brief Clear the dropped/latency statistics.
+         */
+        void reset_stats();
+
+};
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * @file SDBinaryFormat.cpp
+ */
+#include "SDBinaryFormat.hpp"
+
+#include <cstring>
+
+namespace {
+
+/**
+ * Byte-wise CRC-32 lookup table, built once on first use.
+ */
+struct CrcTable {
+    uint32_t entries[256];
+
+    CrcTable(){
+        for(uint32_t i = 0; i < 256; i++){
+            uint32_t c = i;
+            for(int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            this->entries[i] = c;
+        }
+    }
+};
+
+}
+
+/**
+ * Table driven CRC-32, one lookup per byte.
+ */
+uint32_t sd_crc32(const uint8_t* data, size_t len, uint32_t crc){
+    static const CrcTable table;
+
+    crc = ~crc;
+    for(size_t i = 0; i < len; i++){
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void put_varint(std::vector<uint8_t>& out, uint64_t v){
+    while(v >= 0x80){
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+static size_t varint_size(uint64_t v){
+    size_t n = 1;
+    while(v >= 0x80){
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static bool get_varint(const uint8_t* data, size_t len, size_t& pos, uint64_t& v){
+    v = 0;
+    for(unsigned shift = 0; shift < 64 && pos < len; shift += 7){
+        uint8_t b = data[pos++];
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if(!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+static void put_u16(uint8_t* p, uint16_t v){
+    p[0] = v; p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t* p, uint32_t v){
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint16_t get_u16(const uint8_t* p){
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t* p){
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void SDBlockEncoder::reset(){
+    this->block.resize(SDLOGGER_BLOCK_HEADER);
+    this->count = 0;
+    this->base_epoch = 0;
+    this->prev_epoch = 0;
+}
+
+/**
+ * Appends a record to the block. The first record of a block is always accepted so that
+ * messages larger than a block are still written, in a block of their own.
+ *
+ * @param[in] epoch The record's time stamp.
+ * @param[in] topic_id The record's topic ID.
+ * @param[in] message The message bytes.
+ *
+ * @returns `false` if the record did not fit and the block should be finished first.
+ */
+bool SDBlockEncoder::add(int64_t epoch, uint16_t topic_id, std::string_view message){
+    if(this->count == 0){
+        this->base_epoch = (uint32_t)epoch;
+        this->prev_epoch = epoch;
+    }
+
+    int64_t delta = epoch - this->prev_epoch;
+    uint64_t zz = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+
+    size_t body = varint_size(zz) + varint_size(topic_id) + message.size();
+    size_t total = varint_size(body) + body;
+
+    if(this->count > 0 && this->block.size() + total > SDLOGGER_BLOCK_TARGET) return false;
+    if(this->count == UINT16_MAX || this->block.size() - SDLOGGER_BLOCK_HEADER + total > UINT16_MAX) return false;
+
+    put_varint(this->block, body);
+    put_varint(this->block, zz);
+    put_varint(this->block, topic_id);
+    this->block.insert(this->block.end(), message.begin(), message.end());
+
+    this->prev_epoch = epoch;
+    this->count++;
+    return true;
+}
+
+/**
+ * Fills in the header of the current block.
+ *
+ * @returns The encoded block, empty if the block holds no records.
+ */
+std::string_view SDBlockEncoder::finish(){
+    if(this->count == 0) return std::string_view();
+
+    uint8_t* h = this->block.data();
+    size_t payload = this->block.size() - SDLOGGER_BLOCK_HEADER;
+
+    memcpy(h, SDLOGGER_BLOCK_MAGIC, 4);
+    put_u16(h + 4, payload);
+    put_u16(h + 6, this->count);
+    put_u32(h + 8, this->base_epoch);
+    put_u32(h + 12, sd_crc32(h + SDLOGGER_BLOCK_HEADER, payload));
+
+    return std::string_view((const char*)h, this->block.size());
+}
+
+/**
+ * @param[in] data Bytes which should start with a block header.
+ * @param[in] len Number of bytes available at `data`.
+ * @param[out] header The parsed header.
+ *
+ * @returns `true` if `data` holds a block header.
+ */
+bool SDBlockDecoder::parse_header(const uint8_t* data, size_t len, SDBlockHeader& header){
+    if(len < SDLOGGER_BLOCK_HEADER || memcmp(data, SDLOGGER_BLOCK_MAGIC, 4) != 0) return false;
+
+    header.payload_len = get_u16(data + 4);
+    header.record_count = get_u16(data + 6);
+    header.base_epoch = get_u32(data + 8);
+    header.crc = get_u32(data + 12);
+    return true;
+}
+
+/**
+ * Checks the payload against the header's CRC and prepares to iterate its records.
+ *
+ * @param[in] header The block's header.
+ * @param[in] payload `header.payload_len` bytes following the header.
+ *
+ * @returns `false` if the payload is corrupt.
+ */
+bool SDBlockDecoder::begin(const SDBlockHeader& header, const uint8_t* payload){
+    this->payload = payload;
+    this->len = header.payload_len;
+    this->pos = 0;
+    this->epoch = header.base_epoch;
+
+    if(sd_crc32(payload, header.payload_len) != header.crc){
+        this->len = 0;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @param[out] epoch The record's time stamp.
+ * @param[out] topic_id The record's topic ID.
+ * @param[out] message The message, a view into the payload.
+ *
+ * @returns `false` once all records have been returned.
+ */
+bool SDBlockDecoder::next(int64_t& epoch, uint16_t& topic_id, std::string_view& message){
+    uint64_t body, zz, id;
+    if(this->pos >= this->len || !get_varint(this->payload, this->len, this->pos, body)) return false;
+
+    if(body > this->len - this->pos) return false;
+    size_t end = this->pos + body;
+
+    if(!get_varint(this->payload, end, this->pos, zz) || !get_varint(this->payload, end, this->pos, id)) return false;
+
+    this->epoch += (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+
+    epoch = this->epoch;
+    topic_id = (uint16_t)id;
+    message = std::string_view((const char*)this->payload + this->pos, end - this->pos);
+
+    this->pos = end;
+    return true;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file SDBinaryFormat.hpp
+ * @brief Compact binary record format for log files, an alternative to `TIME;TOPIC;MESSAGE;`
+ *  lines.
+ *
+ * A binary log file is a sequence of blocks. Each block starts with a 16 byte header
+ *
+ * | bytes | field |
+ * |---|---|
+ * | 4 | magic `SDLB` |
+ * | 2 | payload length |
+ * | 2 | record count |
+ * | 4 | epoch of the first record |
+ * | 4 | CRC-32 of the payload |
+ *
+ * followed by the payload, a sequence of records
+ *
+ * | field | encoding |
+ * |---|---|
+ * | record length | varint, bytes after this field |
+ * | time delta | zigzag varint, seconds since the previous record of the block |
+ * | topic ID | varint, resolved through the file's topic dictionary (SDTopicDictionary.hpp) |
+ * | message | raw bytes |
+ *
+ * All integers are little endian. The codec has no dependency on the SD card so it can be
+ * used by host tools.
+ */
+#ifndef SDBINARYFORMAT_HPP
+#define SDBINARYFORMAT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#define SDLOGGER_BLOCK_MAGIC "SDLB"
+#define SDLOGGER_BLOCK_HEADER 16        // bytes in a block header
+#define SDLOGGER_BLOCK_TARGET 512       // blocks are closed before they grow past this size
+
+/**
+ * @brief Fields of a block header.
+ */
+struct SDBlockHeader {
+    uint16_t payload_len;
+    uint16_t record_count;
+    uint32_t base_epoch;
+    uint32_t crc;
+};
+
+/**
+ * @brief CRC-32 (IEEE) of `len` bytes, continuing from `crc`.
+ */
+uint32_t sd_crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+/**
+ * @brief Collects records into a block and produces the encoded block.
+ */
+class SDBlockEncoder {
+
+    private:
+
+        std::vector<uint8_t> block;     // header space followed by the payload
+        uint16_t count = 0;
+        uint32_t base_epoch = 0;
+        int64_t prev_epoch = 0;
+
+    public:
+
+        SDBlockEncoder(){this->reset();}
+
+        /**
+         * @brief Append a record, `false` if it would push a non-empty block past `SDLOGGER_BLOCK_TARGET`.
+         */
+        bool add(int64_t epoch, uint16_t topic_id, std::string_view message);
+
+        /**
+         * @brief Write the header and return the whole block, valid until the next `reset()`.
+         */
+        std::string_view finish();
+
+        /**
+         * @brief Start a new, empty block.
+         */
+        void reset();
+
+        /**
+         * @brief Records in the current block.
+         */
+        uint16_t records() const {return this->count;}
+
+        /**
+         * @brief Epoch of the first record in the current block.
+         */
+        uint32_t first_epoch() const {return this->base_epoch;}
+
+};
+
+/**
+ * @brief Iterates over the records of one block.
+ */
+class SDBlockDecoder {
+
+    private:
+
+        const uint8_t* payload = NULL;
+        size_t len = 0;
+        size_t pos = 0;
+        int64_t epoch = 0;
+
+    public:
+
+        /**
+         * @brief Parse a header, `false` if `data` does not start with a block header.
+         */
+        static bool parse_header(const uint8_t* data, size_t len, SDBlockHeader& header);
+
+        /**
+         * @brief Decode the payload of a block whose header is `header`, `false` if the CRC does not match.
+         */
+        bool begin(const SDBlockHeader& header, const uint8_t* payload);
+
+        /**
+         * @brief Next record of the block, `false` at the end or on a malformed record.
+         */
+        bool next(int64_t& epoch, uint16_t& topic_id, std::string_view& message);
+
+};
+
+#endif
@@ -0,0 +1,231 @@
+/**
+ * @file SDCompress.cpp
+ */
+#include "SDCompress.hpp"
+
+#include <cstring>
+
+#define SDLZ_MIN_MATCH 4
+#define SDLZ_LAST_LITERALS 5    // the block format ends with at least this many literals
+#define SDLZ_MATCH_LIMIT 12     // no match may start within this many bytes of the end
+
+static inline uint32_t read32(const uint8_t* p){
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hash4(uint32_t seq){
+    return (seq * 2654435761U) >> (32 - SDLZ_HASH_BITS);
+}
+
+/**
+ * Writes a length continuation, `255` bytes followed by the remainder.
+ */
+static inline bool put_length(uint8_t* dst, size_t cap, size_t& op, size_t len){
+    while(len >= 255){
+        if(op >= cap) return false;
+        dst[op++] = 255;
+        len -= 255;
+    }
+    if(op >= cap) return false;
+    dst[op++] = (uint8_t)len;
+    return true;
+}
+
+/**
+ * Writes one sequence: a token, the literals `src[anchor, ip)` and, if `match_len` is
+ * non-zero, the match.
+ */
+static bool put_sequence(const uint8_t* src, size_t anchor, size_t ip, size_t offset, size_t match_len,
+        uint8_t* dst, size_t cap, size_t& op){
+
+    size_t lit = ip - anchor;
+    size_t ml = match_len ? match_len - SDLZ_MIN_MATCH : 0;
+
+    if(op >= cap) return false;
+    size_t token = op++;
+    dst[token] = (uint8_t)(((lit < 15) ? lit : 15) << 4);
+
+    if(lit >= 15 && !put_length(dst, cap, op, lit - 15)) return false;
+    if(op + lit > cap) return false;
+    memcpy(dst + op, src + anchor, lit);
+    op += lit;
+
+    if(match_len == 0) return true;
+
+    if(op + 2 > cap) return false;
+    dst[op++] = (uint8_t)offset;
+    dst[op++] = (uint8_t)(offset >> 8);
+
+    dst[token] |= (uint8_t)((ml < 15) ? ml : 15);
+    if(ml >= 15 && !put_length(dst, cap, op, ml - 15)) return false;
+
+    return true;
+}
+
+/**
+ * Greedy LZ4 block compression. Each position's 4 byte sequence is hashed, a hit in the
+ * table is checked and extended in both directions, and positions without a match are
+ * skipped faster the longer the run of literals grows.
+ *
+ * @param[in] src Data to compress, at most `SDLOGGER_FRAME_MAX` bytes.
+ * @param[in] len Bytes in `src`.
+ * @param[out] dst Destination.
+ * @param[in] cap Bytes available at `dst`.
+ *
+ * @returns The compressed length, or `0` if it would exceed `cap`.
+ */
+size_t SDLzCodec::compress(const uint8_t* src, size_t len, uint8_t* dst, size_t cap){
+    if(len > SDLOGGER_FRAME_MAX) return 0;
+
+    this->table.assign((size_t)1 << SDLZ_HASH_BITS, 0);
+
+    size_t op = 0;
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    if(len > SDLZ_MATCH_LIMIT){
+        const size_t limit = len - SDLZ_MATCH_LIMIT;
+        const size_t match_end = len - SDLZ_LAST_LITERALS;
+
+        while(ip < limit){
+            uint32_t seq = read32(src + ip);
+            uint32_t h = hash4(seq);
+            size_t ref = this->table[h];
+            this->table[h] = (uint16_t)ip;
+
+            if(ref >= ip || read32(src + ref) != seq){
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            while(ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]){
+                ip--;
+                ref--;
+            }
+
+            size_t match_len = SDLZ_MIN_MATCH;
+            while(ip + match_len < match_end && src[ip + match_len] == src[ref + match_len]) match_len++;
+
+            if(!put_sequence(src, anchor, ip, ip - ref, match_len, dst, cap, op)) return 0;
+
+            ip += match_len;
+            anchor = ip;
+            if(ip - 2 < limit) this->table[hash4(read32(src + ip - 2))] = (uint16_t)(ip - 2);
+        }
+    }
+
+    if(!put_sequence(src, anchor, len, 0, 0, dst, cap, op)) return 0;
+    return op;
+}
+
+/**
+ * Decodes an LZ4 block, checking every length against both buffers so corrupt input
+ * cannot read or write out of bounds.
+ *
+ * @param[in] src Compressed data.
+ * @param[in] len Bytes in `src`.
+ * @param[out] dst Destination.
+ * @param[in] cap Bytes available at `dst`.
+ *
+ * @returns The decompressed length, or `-1` if the input is malformed.
+ */
+long SDLzCodec::decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t cap){
+    size_t ip = 0;
+    size_t op = 0;
+
+    while(ip < len){
+        uint8_t token = src[ip++];
+
+        size_t lit = token >> 4;
+        if(lit == 15){
+            uint8_t b;
+            do{
+                if(ip >= len) return -1;
+                b = src[ip++];
+                lit += b;
+            }while(b == 255);
+        }
+
+        if(ip + lit > len || op + lit > cap) return -1;
+        memcpy(dst + op, src + ip, lit);
+        ip += lit;
+        op += lit;
+
+        if(ip == len) break;    // the last sequence has no match
+
+        if(ip + 2 > len) return -1;
+        size_t offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if(offset == 0 || offset > op) return -1;
+
+        size_t match_len = token & 15;
+        if(match_len == 15){
+            uint8_t b;
+            do{
+                if(ip >= len) return -1;
+                b = src[ip++];
+                match_len += b;
+            }while(b == 255);
+        }
+        match_len += SDLZ_MIN_MATCH;
+
+        if(op + match_len > cap) return -1;
+
+        // matches may overlap their own output
+        const uint8_t* ref = dst + op - offset;
+        if(offset >= match_len){
+            memcpy(dst + op, ref, match_len);
+        }else{
+            for(size_t i = 0; i < match_len; i++) dst[op + i] = ref[i];
+        }
+        op += match_len;
+    }
+
+    return (long)op;
+}
+
+static void put_u16(uint8_t* p, uint16_t v){
+    p[0] = v; p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t* p, uint32_t v){
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint16_t get_u16(const uint8_t* p){
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t* p){
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void sd_write_frame_header(const SDFrameHeader& header, uint8_t* out){
+    memcpy(out, SDLOGGER_FRAME_MAGIC, 4);
+    put_u32(out + 4, header.min_epoch);
+    put_u32(out + 8, header.max_epoch);
+    put_u16(out + 12, header.raw_len);
+    put_u16(out + 14, header.stored_len);
+    put_u32(out + 16, header.crc);
+}
+
+/**
+ * @param[in] data Bytes which should start with a frame header.
+ * @param[in] len Number of bytes available at `data`.
+ * @param[out] header The parsed header.
+ *
+ * @returns `true` if `data` holds a plausible frame header.
+ */
+bool sd_parse_frame_header(const uint8_t* data, size_t len, SDFrameHeader& header){
+    if(len < SDLOGGER_FRAME_HEADER || memcmp(data, SDLOGGER_FRAME_MAGIC, 4) != 0) return false;
+
+    header.min_epoch = get_u32(data + 4);
+    header.max_epoch = get_u32(data + 8);
+    header.raw_len = get_u16(data + 12);
+    header.stored_len = get_u16(data + 14);
+    header.crc = get_u32(data + 16);
+
+    return header.stored_len <= header.raw_len;
+}
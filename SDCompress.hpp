@@ -0,0 +1,108 @@
+/**
+ * @file SDCompress.hpp
+ * @brief Block compression of closed daily log files.
+ *
+ * A compressed file is named `<log file>.sdz` and holds a sequence of independently
+ * decodable frames. Each frame starts with a 20 byte header
+ *
+ * | bytes | field |
+ * |---|---|
+ * | 4 | magic `SDLZ` |
+ * | 4 | smallest time stamp of the lines in the frame |
+ * | 4 | largest time stamp of the lines in the frame |
+ * | 2 | uncompressed length |
+ * | 2 | stored length, equal to the uncompressed length if stored uncompressed |
+ * | 4 | CRC-32 of the uncompressed data |
+ *
+ * followed by the stored data. Frames hold whole `\n<line>` runs of about
+ * `SDLOGGER_COMPRESS_BLOCK` bytes, compressed with an LZ4 block format codec, so a reader
+ * can skip frames outside its time range and decode the rest with two frame sized buffers.
+ * All integers are little endian.
+ */
+#ifndef SDCOMPRESS_HPP
+#define SDCOMPRESS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define SDLOGGER_COMPRESSED_EXT ".sdz"  // appended to the log file name
+#define SDLOGGER_FRAME_MAGIC "SDLZ"
+#define SDLOGGER_FRAME_HEADER 20        // bytes in a frame header
+#define SDLOGGER_COMPRESS_BLOCK 4096    // target uncompressed bytes per frame
+#define SDLOGGER_FRAME_MAX 65535        // largest uncompressed frame
+#define SDLZ_HASH_BITS 12               // compressor hash table of 2^12 positions
+
+/**
+ * @brief Fields of a frame header.
+ */
+struct SDFrameHeader {
+    uint32_t min_epoch;
+    uint32_t max_epoch;
+    uint16_t raw_len;
+    uint16_t stored_len;
+    uint32_t crc;
+};
+
+/**
+ * @brief Name of the compressed file for log file `fn`.
+ */
+inline std::string sd_compressed_name(const std::string& fn){
+    return fn + SDLOGGER_COMPRESSED_EXT;
+}
+
+/**
+ * @brief Log file name of `fn` without the compressed extension, if it has one.
+ */
+inline std::string sd_uncompressed_name(const std::string& fn){
+    const size_t ext = sizeof(SDLOGGER_COMPRESSED_EXT) - 1;
+
+    if(fn.size() > ext && fn.compare(fn.size() - ext, ext, SDLOGGER_COMPRESSED_EXT) == 0)
+        return fn.substr(0, fn.size() - ext);
+    return fn;
+}
+
+/**
+ * @brief LZ4 block format compressor and bounds checked decompressor.
+ *
+ * The compressor is a greedy single pass matcher over a 4096 entry hash table (8 KB) and
+ * handles inputs up to `SDLOGGER_FRAME_MAX` bytes. Decompression needs no memory beyond
+ * the output buffer.
+ */
+class SDLzCodec {
+
+    private:
+
+        std::vector<uint16_t> table;    // last position of each hashed 4 byte sequence
+
+    public:
+
+        /**
+         * @brief Compress `len` bytes into `dst`, returns `0` if the result would not fit in `cap`.
+         */
+        size_t compress(const uint8_t* src, size_t len, uint8_t* dst, size_t cap);
+
+        /**
+         * @brief Decompress into `dst`, returns the decompressed length or `-1` on malformed input.
+         */
+        static long decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t cap);
+
+        /**
+         * @brief Largest compressed size of `len` bytes.
+         */
+        static size_t bound(size_t len){return len + len / 255 + 16;}
+
+};
+
+/**
+ * @brief Write a frame header to `out`, which must hold `SDLOGGER_FRAME_HEADER` bytes.
+ */
+void sd_write_frame_header(const SDFrameHeader& header, uint8_t* out);
+
+/**
+ * @brief Parse a frame header, `false` if `data` does not start with one.
+ */
+bool sd_parse_frame_header(const uint8_t* data, size_t len, SDFrameHeader& header);
+
+#endif
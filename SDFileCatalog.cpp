@@ -0,0 +1,138 @@
+/**
+ * @file SDFileCatalog.cpp
+ */
+#include "SDFileCatalog.hpp"
+
+#include <algorithm>
+
+std::atomic<uint32_t> SDFileCatalog::generation(0);
+
+/**
+ * Parses an unsigned decimal number from the front of `s`, removing the digits.
+ *
+ * @returns `false` if `s` does not start with a digit.
+ */
+static bool take_number(std::string_view& s, unsigned& value){
+    size_t n = 0;
+    value = 0;
+
+    while(n < s.size() && s[n] >= '0' && s[n] <= '9' && n < 9){
+        value = value * 10 + (s[n] - '0');
+        n++;
+    }
+
+    s.remove_prefix(n);
+    return n > 0;
+}
+
+/**
+ * Checks that `name` has the layout SDLogger uses for daily files and converts its date
+ * to the epoch of midnight (UTC) on that day. Directory prefixes in `name` are ignored.
+ *
+ * @param[in] name File name or path, ex `/log_5-24-2023.csv`.
+ * @param[in] prefix Expected prefix, ex `log`.
+ * @param[in] filetype Expected extension without the dot, ex `csv`.
+ * @param[out] day_start Epoch of the file's date.
+ * @param[out] compressed If not `NULL`, names ending in `.sdz` are accepted and flagged here.
+ *
+ * @returns `true` if the name matched.
+ */
+bool SDFileCatalog::parse_name(std::string_view name, std::string_view prefix, std::string_view filetype, int64_t& day_start,
+        bool* compressed){
+
+    size_t slash = name.rfind('/');
+    if(slash != std::string_view::npos) name.remove_prefix(slash + 1);
+
+    std::string_view ext = SDLOGGER_COMPRESSED_EXT;
+    bool is_compressed = name.size() > ext.size() && name.substr(name.size() - ext.size()) == ext;
+    if(is_compressed){
+        if(compressed == NULL) return false;
+        name.remove_suffix(ext.size());
+    }
+    if(compressed != NULL) *compressed = is_compressed;
+
+    if(name.size() < prefix.size() + filetype.size() + 2) return false;
+    if(name.substr(0, prefix.size()) != prefix || name[prefix.size()] != '_') return false;
+    name.remove_prefix(prefix.size() + 1);
+
+    if(name.substr(name.size() - filetype.size()) != filetype || name[name.size() - filetype.size() - 1] != '.') return false;
+    name.remove_suffix(filetype.size() + 1);
+
+    unsigned month, day, year;
+    if(!take_number(name, month) || name.empty() || name[0] != '-') return false;
+    name.remove_prefix(1);
+    if(!take_number(name, day) || name.empty() || name[0] != '-') return false;
+    name.remove_prefix(1);
+    if(!take_number(name, year) || !name.empty()) return false;
+
+    if(month < 1 || month > 12 || day < 1 || day > 31) return false;
+
+    day_start = sd_days_from_civil(year, month, day) * SD_SECS_PER_DAY;
+    return true;
+}
+
+/**
+ * @param[in] dir Directory the catalog should describe.
+ * @param[in] prefix File name prefix the catalog should contain.
+ * @param[in] filetype File extension the catalog should contain.
+ *
+ * @returns `true` if the catalog was never listed, was listed for other files, or a log
+ * file has been created since it was listed.
+ */
+bool SDFileCatalog::stale(const std::string& dir, const std::string& prefix, const std::string& filetype){
+    return !this->listed ||
+        this->listed_generation != generation.load(std::memory_order_relaxed) ||
+        this->dir != dir || this->prefix != prefix || this->filetype != filetype;
+}
+
+/**
+ * Lists `dir` in a single pass, keeping the files whose names match
+ * `<prefix>_M-D-YYYY.<filetype>` or `<prefix>_M-D-YYYY.<filetype>.sdz`, and sorts them by
+ * date. A day may have both files, when lines arrived after it was compressed, the 
+ * compressed file holding the older lines is listed first.
+ *
+ * @param[in] sd The card to list.
+ * @param[in] dir Directory to list, ex `/`.
+ * @param[in] prefix File name prefix, ex `log`.
+ * @param[in] filetype File extension without the dot, ex `csv`.
+ */
+void SDFileCatalog::refresh(SDStorage& sd, const std::string& dir, const std::string& prefix, const std::string& filetype){
+    // read the generation first so a file created while listing leaves the catalog stale
+    this->listed_generation = generation.load(std::memory_order_relaxed);
+    this->entries.clear();
+    this->dir = dir;
+    this->prefix = prefix;
+    this->filetype = filetype;
+    this->listed = true;
+
+    File root = sd.open(dir.c_str(), "r");
+    if(!root){
+        Serial.println("[ERROR] failed to open directory for file catalog");
+        return;
+    }
+
+    std::string base = (dir.size() > 0 && dir.back() == '/') ? dir : dir + "/";
+
+    File entry = root.openNextFile();
+    while(entry){
+        int64_t day_start;
+        bool compressed;
+        std::string_view name = entry.name();
+
+        if(!entry.isDirectory() && parse_name(name, prefix, filetype, day_start, &compressed)){
+            size_t slash = name.rfind('/');
+            if(slash != std::string_view::npos) name.remove_prefix(slash + 1);
+
+            this->entries.push_back({day_start, base + std::string(name), compressed});
+        }
+
+        entry.close();
+        entry = root.openNextFile();
+    }
+    root.close();
+
+    std::sort(this->entries.begin(), this->entries.end(),
+            [](const SDCatalogEntry& a, const SDCatalogEntry& b){
+                return (a.day_start != b.day_start) ? a.day_start < b.day_start : a.compressed > b.compressed;
+            });
+}
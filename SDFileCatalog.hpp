@@ -0,0 +1,77 @@
+/**
+ * @file SDFileCatalog.hpp
+ * @brief Cached, date sorted listing of the daily log files on the SD card.
+ */
+#ifndef SDFILECATALOG_HPP
+#define SDFILECATALOG_HPP
+
+#include <SD.h>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SDStorage.hpp"
+#include "SDTime.hpp"
+#include "SDCompress.hpp"
+
+/**
+ * @brief A daily log file found on the card.
+ */
+struct SDCatalogEntry {
+    int64_t day_start;      // epoch of midnight on the file's date
+    std::string path;       // path of the file, ex `/log_5-24-2023.csv`
+    bool compressed;        // the file is block compressed, see SDCompress.hpp
+};
+
+/**
+ * @brief Lists a directory once and keeps the files named `<prefix>_M-D-YYYY.<filetype>`,
+ *  or their compressed `.sdz` versions, sorted by date.
+ *
+ * The catalog is reused between queries until a logger creates a new file, which bumps a
+ * global generation counter through `invalidate()`.
+ */
+class SDFileCatalog {
+
+    private:
+
+        static std::atomic<uint32_t> generation;
+
+        std::vector<SDCatalogEntry> entries;
+        std::string dir;
+        std::string prefix;
+        std::string filetype;
+        uint32_t listed_generation = 0;
+        bool listed = false;
+
+    public:
+
+        /**
+         * @brief Mark every catalog stale, called when a log file is created.
+         */
+        static void invalidate(){generation.fetch_add(1, std::memory_order_relaxed);}
+
+        /**
+         * @brief Parse a file name of the form `<prefix>_M-D-YYYY.<filetype>` into the epoch of its date.
+         */
+        static bool parse_name(std::string_view name, std::string_view prefix, std::string_view filetype, int64_t& day_start,
+                bool* compressed = NULL);
+
+        /**
+         * @brief The catalog must be listed again before it describes `dir` with this prefix and type.
+         */
+        bool stale(const std::string& dir, const std::string& prefix, const std::string& filetype);
+
+        /**
+         * @brief List `dir` and keep the matching files sorted by date.
+         */
+        void refresh(SDStorage& sd, const std::string& dir, const std::string& prefix, const std::string& filetype);
+
+        /**
+         * @brief Catalogued files, sorted by date.
+         */
+        const std::vector<SDCatalogEntry>& files() const {return this->entries;}
+
+};
+
+#endif
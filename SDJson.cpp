@@ -0,0 +1,135 @@
+/**
+ * @file SDJson.cpp
+ */
+#include "SDJson.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static inline size_t skip_space(std::string_view s, size_t i){
+    while(i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\n' || s[i] == '\r')) i++;
+    return i;
+}
+
+/**
+ * Skips the string starting at the quote `s[i]`, including escaped quotes.
+ *
+ * @returns The index after the closing quote, or `npos` if the string is not closed.
+ */
+static size_t skip_string(std::string_view s, size_t i){
+    for(i++; i < s.size(); i++){
+        if(s[i] == '\\') i++;
+        else if(s[i] == '"') return i + 1;
+    }
+    return std::string_view::npos;
+}
+
+/**
+ * Skips the value starting at `s[i]`. Objects and arrays are skipped by counting brackets
+ * outside of strings, scalars end at the next `,` or closing bracket, which must exist.
+ *
+ * @returns The index after the value, or `npos` if it is not terminated.
+ */
+static size_t skip_value(std::string_view s, size_t i){
+    if(i >= s.size()) return std::string_view::npos;
+    if(s[i] == '"') return skip_string(s, i);
+
+    if(s[i] == '{' || s[i] == '['){
+        int depth = 0;
+        while(i < s.size()){
+            char c = s[i];
+            if(c == '"'){
+                i = skip_string(s, i);
+                if(i == std::string_view::npos) return i;
+                continue;
+            }
+            if(c == '{' || c == '[') depth++;
+            else if(c == '}' || c == ']'){
+                if(--depth == 0) return i + 1;
+            }
+            i++;
+        }
+        return std::string_view::npos;
+    }
+
+    // a scalar cut off by the end of the message may be truncated itself
+    while(i < s.size() && s[i] != ',' && s[i] != '}' && s[i] != ']') i++;
+    return (i < s.size()) ? i : std::string_view::npos;
+}
+
+/**
+ * Walks the members of the object once. Each key is compared, still escaped, against the
+ * wanted keys, so keys are matched byte for byte.
+ *
+ * @param[in] json The logged message.
+ * @param[in] keys Names of the fields to find.
+ * @param[in] key_count Number of keys.
+ * @param[out] values Raw value of each key, empty if the key is missing.
+ *
+ * @returns The number of keys found.
+ */
+size_t sd_json_fields(std::string_view json, const std::string_view* keys, size_t key_count, std::string_view* values){
+    for(size_t k = 0; k < key_count; k++) values[k] = std::string_view();
+
+    size_t found = 0;
+    size_t i = skip_space(json, 0);
+    if(i >= json.size() || json[i] != '{') return 0;
+    i++;
+
+    while(found < key_count){
+        i = skip_space(json, i);
+        if(i >= json.size() || json[i] != '"') break;
+
+        size_t key_end = skip_string(json, i);
+        if(key_end == std::string_view::npos) break;
+        std::string_view key = json.substr(i + 1, key_end - i - 2);
+
+        i = skip_space(json, key_end);
+        if(i >= json.size() || json[i] != ':') break;
+        i = skip_space(json, i + 1);
+
+        size_t value_end = skip_value(json, i);
+        if(value_end == std::string_view::npos) break;
+
+        std::string_view value = json.substr(i, value_end - i);
+        while(!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+
+        for(size_t k = 0; k < key_count; k++){
+            if(values[k].empty() && keys[k] == key){
+                values[k] = value;
+                found++;
+                break;
+            }
+        }
+
+        i = skip_space(json, value_end);
+        if(i >= json.size() || json[i] != ',') break;
+        i++;
+    }
+
+    return found;
+}
+
+/**
+ * @param[in] value A raw value from `sd_json_fields()`.
+ * @param[out] number The parsed number.
+ *
+ * @returns `true` if `value` is a finite JSON number.
+ */
+bool sd_json_number(std::string_view value, double& number){
+    if(value.empty() || value.size() > SDJSON_NUMBER_CHARS) return false;
+    if(value[0] != '-' && (value[0] < '0' || value[0] > '9')) return false;
+
+    for(char c : value){
+        if((c < '0' || c > '9') && c != '-' && c != '+' && c != '.' && c != 'e' && c != 'E') return false;
+    }
+
+    char buf[SDJSON_NUMBER_CHARS + 1];
+    memcpy(buf, value.data(), value.size());
+    buf[value.size()] = '\0';
+
+    char* end;
+    number = strtod(buf, &end);
+    return end == buf + value.size() && std::isfinite(number);
+}
@@ -0,0 +1,32 @@
+/**
+ * @file SDJson.hpp
+ * @brief Single pass lookup of top level fields in the flat JSON objects logged as MQTT
+ *  messages, without building a DOM or allocating.
+ */
+#ifndef SDJSON_HPP
+#define SDJSON_HPP
+
+#include <cstddef>
+#include <string_view>
+
+#define SDJSON_NUMBER_CHARS 32      // longest number `sd_json_number()` parses
+
+/**
+ * @brief Find the values of `keys` among the top level members of the JSON object `json`.
+ *
+ * `values[i]` is set to the raw text of the value of `keys[i]`, strings including their
+ * quotes, or left empty if the key is missing. Nested objects and arrays, and quotes or
+ * braces inside strings, are skipped over. Scanning stops once every key is found or at
+ * the first malformed character, keeping the values found until then.
+ *
+ * @returns The number of keys found.
+ */
+size_t sd_json_fields(std::string_view json, const std::string_view* keys, size_t key_count, std::string_view* values);
+
+/**
+ * @brief Parse a raw JSON value as a finite number, `false` for strings, literals and
+ *  malformed numbers.
+ */
+bool sd_json_number(std::string_view value, double& number);
+
+#endif
@@ -0,0 +1,149 @@
+/**
+ * @file SDLineReader.cpp
+ */
+#include "SDLineReader.hpp"
+
+/**
+ * Attaches the reader to an open file. Reading starts from the file's current position
+ * and all buffered data from a previous file is discarded. Bytes from `limit` on are 
+ * treated as past the end of the file, which keeps the preallocated zeros of a log file
+ * out of its last line (see `sd_data_end()`).
+ *
+ * @param[in] f The open file to read lines from.
+ * @param[in] limit Offset the file ends at for the reader.
+ */
+void SDLineReader::attach(File* f, uint32_t limit){
+    this->f = f;
+    this->memory = NULL;
+    this->limit = limit;
+    this->begin = 0;
+    this->end = 0;
+    this->base = (f != NULL) ? f->position() : 0;
+    this->line_start = this->base;
+    this->eof = (f == NULL);
+    this->terminated = false;
+    this->total_read = 0;
+}
+
+/**
+ * Attaches the reader to memory holding a whole file, lines are returned as views into
+ * it. `size` plays the part of `limit`, bytes past it are never looked at.
+ *
+ * @param[in] data The file's first byte.
+ * @param[in] size Offset the file ends at for the reader.
+ */
+void SDLineReader::attach(const char* data, uint32_t size){
+    this->f = NULL;
+    this->memory = data;
+    this->limit = (data != NULL) ? size : 0;
+    this->begin = 0;
+    this->end = this->limit;
+    this->base = 0;
+    this->line_start = 0;
+    this->eof = true;
+    this->terminated = false;
+    this->total_read = 0;
+}
+
+/**
+ * Seeks the attached file and discards the buffer, the next line returned starts at
+ * `offset`.
+ *
+ * @param[in] offset Byte offset in the file.
+ *
+ * @returns `true` if the seek succeeded.
+ */
+bool SDLineReader::seek(uint32_t offset){
+    if(this->memory != NULL){
+        this->begin = (offset < this->end) ? offset : this->end;
+        this->line_start = this->begin;
+        return offset <= this->end;
+    }
+
+    if(this->f == NULL) return false;
+
+    bool ok = this->f->seek(offset);
+    this->begin = 0;
+    this->end = 0;
+    this->base = this->f->position();
+    this->line_start = this->base;
+    this->eof = !ok;
+    return ok;
+}
+
+/**
+ * Moves any partial line to the front of the buffer and reads the next block behind it.
+ * The buffer is doubled if the partial line already fills it.
+ *
+ * @returns `false` if nothing more could be read.
+ */
+bool SDLineReader::fill(){
+    if(this->eof) return false;
+
+    if(this->begin > 0){
+        memmove(this->buf.data(), this->buf.data() + this->begin, this->end - this->begin);
+        this->end -= this->begin;
+        this->base += this->begin;
+        this->begin = 0;
+    }
+
+    if(this->end == this->buf.size())
+        this->buf.resize(this->buf.size() * 2);
+
+    size_t want = this->buf.size() - this->end;
+    uint32_t at = this->base + this->end;
+    if(at >= this->limit) want = 0;
+    else if(this->limit - at < want) want = this->limit - at;
+
+    size_t n = (want > 0) ? this->f->read((uint8_t*)this->buf.data() + this->end, want) : 0;
+    if(n == 0){
+        this->eof = true;
+        return false;
+    }
+
+    this->end += n;
+    this->total_read += n;
+    return true;
+}
+
+/**
+ * Finds the next newline in the buffered block and returns the text before it. Blocks
+ * are read from the file as needed, memory is searched in place and never refilled. The
+ * final line of a file is returned even if it is not followed by a newline.
+ *
+ * @param[out] line View of the line, valid until the next call.
+ *
+ * @returns `true` if a line was returned, `false` at the end of the file.
+ */
+bool SDLineReader::next(std::string_view& line){
+    for(;;){
+        const char* data = (this->memory != NULL) ? this->memory : this->buf.data();
+        const char* start = data + this->begin;
+        const char* nl = (const char*)memchr(start, '\n', this->end - this->begin);
+
+        if(nl != NULL){
+            size_t len = nl - start;
+            this->line_start = this->base + this->begin;
+            this->begin += len + 1;
+            this->terminated = true;
+            if(this->memory != NULL) this->total_read += len + 1;
+
+            if(len > 0 && start[len - 1] == '\r') len--;
+            line = std::string_view(start, len);
+            return true;
+        }
+
+        if(!this->fill()){
+            if(this->begin == this->end) return false;
+
+            // unterminated last line
+            start = ((this->memory != NULL) ? this->memory : this->buf.data()) + this->begin;
+            line = std::string_view(start, this->end - this->begin);
+            this->line_start = this->base + this->begin;
+            if(this->memory != NULL) this->total_read += this->end - this->begin;
+            this->begin = this->end;
+            this->terminated = false;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ * @file SDLineReader.hpp
+ * @brief Block buffered line reader for files on the SD card.
+ */
+#ifndef SDLINEREADER_HPP
+#define SDLINEREADER_HPP
+
+#include <SD.h>
+#include <string_view>
+#include <vector>
+#include <cstring>
+
+#define SDREADER_BLOCK_SIZE 2048    // bytes requested from the card per read
+
+/**
+ * @brief Reads a file in blocks of `SDREADER_BLOCK_SIZE` bytes and splits the blocks into
+ *  lines with `memchr`.
+ *
+ * Lines are returned as views into the block buffer without the trailing newline (or
+ * carriage return) and stay valid until the next call to `next()`. A line which crosses
+ * a block boundary is moved to the front of the buffer before the next block is read,
+ * and the buffer grows if a single line is longer than a block.
+ *
+ * A reader attached to memory instead, ex a file mapped by `SDStorage::map()`, returns
+ * views into that memory without copying, valid for as long as the memory is.
+ */
+class SDLineReader {
+
+    private:
+
+        File* f = NULL;
+        const char* memory = NULL;  // data of a reader attached to memory, read in place of `buf`
+        std::vector<char> buf;
+        size_t begin = 0;           // first unconsumed byte in `buf`
+        size_t end = 0;             // one past the last valid byte in `buf`
+        uint32_t base = 0;          // file offset of `buf[0]`
+        uint32_t line_start = 0;    // file offset of the last line returned
+        uint32_t limit = UINT32_MAX;    // file offset reading stops at
+        bool eof = false;
+        bool terminated = false;    // last line returned ended with a newline
+        uint64_t total_read = 0;    // bytes read from the card, or consumed from memory, since `attach()`
+
+        bool fill();
+
+    public:
+
+        /**
+         * @brief Create a reader which requests `block_size` bytes per read.
+         */
+        SDLineReader(size_t block_size = SDREADER_BLOCK_SIZE){this->buf.resize(block_size);}
+
+        /**
+         * @brief Read lines from `f` starting at its current position, up to offset `limit`.
+         */
+        void attach(File* f, uint32_t limit = UINT32_MAX);
+
+        /**
+         * @brief Read lines from the `size` bytes at `data`, starting at offset `0`.
+         */
+        void attach(const char* data, uint32_t size);
+
+        /**
+         * @brief Stop reading from the attached file or memory.
+         */
+        void detach(){this->f = NULL; this->memory = NULL;}
+
+        /**
+         * @brief Get the next line, `false` once the end of the file is reached.
+         */
+        bool next(std::string_view& line);
+
+        /**
+         * @brief Move the file to `offset` and discard buffered data, or move to `offset` in memory.
+         */
+        bool seek(uint32_t offset);
+
+        /**
+         * @brief File offset of the first byte of the last line returned by `next()`.
+         */
+        uint32_t line_offset() const {return this->line_start;}
+
+        /**
+         * @brief File offset of the next byte `next()` will consume.
+         */
+        uint32_t position() const {return this->base + this->begin;}
+
+        /**
+         * @brief The last line returned by `next()` was followed by a newline.
+         */
+        bool last_terminated() const {return this->terminated;}
+
+        /**
+         * @brief Bytes read from the card, or consumed from memory, since the reader was attached.
+         */
+        uint64_t bytes_read() const {return this->total_read;}
+
+};
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * @file SDLogIndex.hpp
+ * @brief Layout of the sparse time index kept next to each log file.
+ *
+ * The index is a sidecar file named `<log file>.idx` holding fixed size binary entries,
+ * each mapping the time stamp of a logged line to the byte offset the line was written
+ * at. Entries are appended in file order every `SDLOGGER_INDEX_STRIDE` lines (or every
+ * N seconds) so the index stays a small fraction of the log.
+ *
+ * An index can only be used to seek if no line is older than the newest line before it
+ * by more than a slack. A writer which logs a later line out of order appends an entry
+ * with epoch `SDLOGGER_INDEX_UNORDERED` at that line, and readers scan such files whole.
+ */
+#ifndef SDLOGINDEX_HPP
+#define SDLOGINDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SDStorage.hpp"
+
+#define SDLOGGER_INDEX_EXT ".idx"       // appended to the log file name
+#define SDLOGGER_INDEX_STRIDE 64        // default number of lines between entries
+#define SDLOGGER_INDEX_SLACK 600        // seconds a line may be older than the newest line before it
+#define SDLOGGER_INDEX_UNORDERED 0      // epoch of the entry marking a file as out of time order
+
+/**
+ * @brief One index entry, the line written at `offset` has time stamp `epoch`.
+ *
+ * `offset` points at the newline which precedes the line, matching the way SDLogger
+ * writes `\n<line>`. In binary files (SDBinaryFormat.hpp) it points at the header of a
+ * block and `epoch` is the block's first time stamp.
+ */
+struct SDIndexEntry {
+    uint32_t epoch;
+    uint32_t offset;
+};
+
+/**
+ * @brief Name of the index file belonging to log file `fn`.
+ */
+inline std::string sd_index_filename(const std::string& fn){
+    return fn + SDLOGGER_INDEX_EXT;
+}
+
+/**
+ * @brief Read the index of log file `fn` into `index`, `false` unless it exists and
+ *  describes a file of `file_size` bytes: offsets must be increasing and inside the file.
+ */
+inline bool sd_load_index(SDStorage& sd, const std::string& fn, uint32_t file_size, std::vector<SDIndexEntry>& index){
+    index.clear();
+
+    std::string idx_fn = sd_index_filename(fn);
+    if(!sd.exists(idx_fn.c_str())) return false;
+
+    File idx = sd.open(idx_fn.c_str(), "r");
+    if(!idx) return false;
+
+    size_t count = idx.size() / sizeof(SDIndexEntry);
+    index.resize(count);
+    size_t n = idx.read((uint8_t*)index.data(), count * sizeof(SDIndexEntry));
+    idx.close();
+
+    if(n != count * sizeof(SDIndexEntry) || count == 0){
+        index.clear();
+        return false;
+    }
+
+    for(size_t i = 0; i < count; i++){
+        if(index[i].offset >= file_size) return false;
+        if(i > 0 && index[i].offset <= index[i - 1].offset) return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief `true` if an index can be used to seek by time stamp, allowing entries to be
+ *  `slack` seconds older than the newest entry before them. `false` if the writer marked
+ *  the file as out of order with a `SDLOGGER_INDEX_UNORDERED` entry.
+ */
+inline bool sd_index_ordered(const std::vector<SDIndexEntry>& index, uint32_t slack){
+    int64_t newest = 0;
+
+    for(const SDIndexEntry& e : index){
+        if(e.epoch == SDLOGGER_INDEX_UNORDERED) return false;
+        if((int64_t)e.epoch + slack < newest) return false;
+        if(e.epoch > newest) newest = e.epoch;
+    }
+
+    return !index.empty();
+}
+
+#endif
@@ -1,7 +1,10 @@
 #include "SDLogger.hpp"
 
+#include <algorithm>
+
 SDLogger::SDLogger(std::string filename){
     this->filename = filename + filetype;
+    this->line_buffer.reserve(SDLOGGER_LINE_RESERVE);
     
     this->initialize_sd_card();
 }
@@ -27,6 +30,17 @@ SDLogger::SDLogger(std::string prefix, int month, int day, int year, std::string
         "-" + std::to_string(day) +
         "-" + std::to_string(year) + 
         filetype;
+    this->line_buffer.reserve(SDLOGGER_LINE_RESERVE);
+}
+
+/**
+ * Writes the lines still held by the buffered writer, including an unwritten binary
+ * block, and closes the open files, so a logger going out of scope loses no records.
+ * Unlike `close_card()` the card is left initialized for other users.
+ */
+SDLogger::~SDLogger(){
+    this->close_write_handle();
+    this->close_parked();
 }
 
 /**
@@ -36,7 +50,7 @@ SDLogger::SDLogger(std::string prefix, int month, int day, int year, std::string
  */
 bool SDLogger::initialize_sd_card(){
 
-    const auto ok = this->sd.begin(TT_CLK, TT_MISO, TT_MOSI, TT_SS, &SPI);
+    const auto ok = this->sd->begin();
 
     if(!ok){
         Serial.println("[ERROR] failed to initialize sd card");
@@ -50,6 +64,26 @@ bool SDLogger::initialize_sd_card(){
     return true;
 }
 
+/**
+ * Moves the logger to another storage backend, for example an `SDMemoryStorage` on host.
+ * Pending lines are written to the old storage and its file is closed before the new
+ * storage is initialized.
+ *
+ * @param[in] storage The storage to log to, must outlive the logger.
+ *
+ * @returns `true` if the storage initialized.
+ */
+bool SDLogger::set_storage(SDStorage& storage){
+    this->close_write_handle();
+    this->close_parked();
+    this->dictionary_ready = false;
+    this->file_known = false;
+    this->reset_index_state();
+
+    this->sd = &storage;
+    return this->initialize_sd_card();
+}
+
 /**
  * Stores a file name in this object for repeated access. Use if planning
  * to use this object for operating on one file only.
@@ -57,7 +91,7 @@ bool SDLogger::initialize_sd_card(){
  * @param[in] fn The file name to open/close. 
  */
 void SDLogger::set_filename(std::string fn){
-    this->filename = fn;
+    this->switch_file(fn);
 }
 
 /**
@@ -75,11 +109,261 @@ void SDLogger::set_filename(std::string fn){
  * @param[in] filetype The filetype/extension of the file, ex `.csv` or `.txt`
  */
 void SDLogger::set_filename(std::string prefix, int month, int day, int year, std::string filetype){
-    this->filename = prefix + 
+    this->switch_file(prefix + 
         "_" + std::to_string(month) + 
         "-" + std::to_string(day) +
         "-" + std::to_string(year) + 
-        filetype;
+        filetype);
+}
+
+/**
+ * Closes the current file and makes `fn` the file to log to. With compression enabled
+ * the file being left is queued for `compress_closed_files()`. A rotating logger also 
+ * closes its other daily files and picks the file of its next record again.
+ *
+ * @param[in] fn The new file name.
+ */
+void SDLogger::switch_file(const std::string& fn){
+    this->close_write_handle();
+    this->close_parked();
+    this->current_day = INT64_MIN;
+    this->day_prefix_len = 0;
+    this->dictionary_ready = false;
+    this->file_known = false;
+    this->reset_index_state();
+
+    if(this->compress_closed && this->format == SD_FORMAT_TEXT && 
+            !this->filename.empty() && this->filename != fn && this->exists()){
+        this->queue_compression(this->filename);
+    }
+
+    this->filename = fn;
+}
+
+/**
+ * Switches the logger into rotating mode. Each record is written to the daily file of its
+ * own time stamp, `<prefix>_M-D-YYYY<filetype>`, so late or backfilled records land in
+ * the file SDReader looks for them in and the logger does not have to be rebuilt at 
+ * midnight. Records without a valid time stamp go to the current file.
+ *
+ * Up to `handles` daily files are kept open, the current one and the most recently used
+ * others, so records interleaving two days do not reopen their files. A file is closed
+ * when a newer file needs its handle, and queued for compression then if compression is 
+ * enabled and its day is over. Records for the current day cost a compare of the date characters.
+ *
+ * Open files are needed for this, so if buffered writes are off they are enabled with
+ * `SD_DURABLE_RECORD`, committing every record as before but without closing the file.
+ *
+ * @param[in] prefix The first part of the file names, ex `/log`.
+ * @param[in] filetype The file extension, ex `.csv`.
+ * @param[in] header Fields of the header line written when a text file is created, empty for none.
+ * @param[in] handles Number of daily files kept open, at least `1`.
+ */
+void SDLogger::enable_rotation(std::string prefix, std::string filetype, std::vector<std::string> header, size_t handles){
+    this->close_write_handle();
+    this->close_parked();
+
+    this->rotate_prefix = prefix;
+    this->rotate_filetype = filetype;
+    this->rotate_handles = (handles > 0) ? handles : 1;
+
+    this->rotate_header.clear();
+    for(const std::string& field : header) this->rotate_header += field + this->separator;
+
+    this->current_day = INT64_MIN;
+    this->day_prefix_len = 0;
+    this->rotating = true;
+
+    if(!this->buffered) this->set_durability(SD_DURABLE_RECORD);
+}
+
+/**
+ * Closes every daily file but the current one, which the logger keeps writing to.
+ */
+void SDLogger::disable_rotation(){
+    this->close_parked();
+    this->rotating = false;
+}
+
+/**
+ * Makes the daily file of a record's time stamp the current file. The date characters
+ * of the time stamp are compared with the current day first, only a record with another
+ * date or a relative offset has its time stamp parsed.
+ *
+ * @param[in] time The record's time stamp field.
+ * @param[in] offset Relative offset in minutes added to the time stamp.
+ *
+ * @returns `false` if there is no file to write the record to.
+ */
+bool SDLogger::route(std::string_view time, int offset){
+    size_t len = this->day_prefix_len;
+    if(offset == 0 && len > 0 && time.size() > len && time[len] == 'T' && 
+            memcmp(time.data(), this->day_prefix, len) == 0 && time.find('+', len) == std::string_view::npos){
+        return true;
+    }
+
+    int64_t epoch;
+    if(!this->time_parser.parse(time, epoch)){
+        if(!this->filename.empty()) return true;
+
+        Serial.println("[ERROR] record without a valid time stamp has no daily file");
+        return false;
+    }
+
+    int64_t day = sd_day_start(epoch + (int64_t)offset * SD_OFFSET_UNIT);
+    if(day != this->current_day) this->rotate_to(day);
+    return true;
+}
+
+/**
+ * Moves the logger to the daily file of `day`, reusing its handle if it is still open.
+ * The current file is kept open unless all handles are in use.
+ *
+ * @param[in] day Epoch of the day's midnight.
+ */
+void SDLogger::rotate_to(int64_t day){
+    char date[sizeof(this->day_prefix)];
+    int date_len = this->format_day(day, date, sizeof(date));
+    std::string fn = this->rotate_prefix + "_" + date + this->rotate_filetype;
+
+    if(day > this->newest_day) this->newest_day = day;
+    this->park();
+
+    size_t slot = 0;
+    while(slot < this->parked.size() && this->parked[slot].filename != fn) slot++;
+
+    if(slot < this->parked.size()){
+        this->unpark(slot);
+
+    }else{
+        while(!this->parked.empty() && this->parked.size() >= this->rotate_handles) this->evict(this->parked.size() - 1);
+
+        this->filename = fn;
+        this->file_known = false;
+        this->dictionary_ready = false;
+        this->reset_index_state();
+
+        if(this->format == SD_FORMAT_TEXT && !this->rotate_header.empty() && !this->exists())
+            this->append_bytes(this->rotate_header);
+    }
+
+    memcpy(this->day_prefix, date, date_len);
+    this->day_prefix_len = date_len;
+    this->current_day = day;
+}
+
+/**
+ * Writes the `M-D-YYYY` date of the daily file of `day` to `date`.
+ *
+ * @param[in] day Epoch of the day's midnight.
+ *
+ * @returns The length of the date.
+ */
+int SDLogger::format_day(int64_t day, char* date, size_t size){
+    int64_t year;
+    unsigned month, d;
+    sd_civil_from_days(day / SD_SECS_PER_DAY, year, month, d);
+    return snprintf(date, size, "%u-%u-%lld", month, d, (long long)year);
+}
+
+/**
+ * Moves the current file into the most recently used slot of `parked`, its buffered lines
+ * are written to it first but not committed.
+ */
+void SDLogger::park(){
+    this->flush_block();
+    if(!this->wfp_open) return;
+
+    if(this->buffered_bytes > 0 && !this->write_buffered()) this->drop_buffered();
+
+    SDOpenLog slot;
+    slot.filename = this->filename;
+    slot.day = this->current_day;
+    slot.wfp = this->wfp;
+    slot.wfp_size = this->wfp_size;
+    slot.committed_size = this->committed_size;
+    slot.allocated = this->wfp_allocated;
+    slot.oldest_write = this->oldest_write;
+    slot.lines_since_index = this->lines_since_index;
+    slot.last_index_epoch = this->last_index_epoch;
+    slot.index_pending = this->index_pending;
+    slot.index_known = this->index_known;
+    slot.index_unordered = this->index_unordered;
+    slot.newest_epoch = this->newest_epoch;
+    slot.dictionary_ready = this->dictionary_ready;
+    std::swap(slot.dictionary, this->dictionary);
+
+    this->wfp = File();
+    this->wfp_open = false;
+    this->wfp_size = 0;
+    this->committed_size = 0;
+    this->parked.insert(this->parked.begin(), std::move(slot));
+}
+
+/**
+ * Makes a parked file the current file again.
+ *
+ * @param[in] slot Index of the file in `parked`.
+ */
+void SDLogger::unpark(size_t slot){
+    SDOpenLog& open = this->parked[slot];
+
+    this->filename = open.filename;
+    this->file_known = true;
+    this->wfp = open.wfp;
+    this->wfp_open = true;
+    this->wfp_size = open.wfp_size;
+    this->committed_size = open.committed_size;
+    this->wfp_allocated = open.allocated;
+    this->oldest_write = open.oldest_write;
+    this->lines_since_index = open.lines_since_index;
+    this->last_index_epoch = open.last_index_epoch;
+    this->index_pending = open.index_pending;
+    this->index_known = open.index_known;
+    this->index_unordered = open.index_unordered;
+    this->newest_epoch = open.newest_epoch;
+    this->dictionary_ready = open.dictionary_ready;
+    std::swap(this->dictionary, open.dictionary);
+
+    this->parked.erase(this->parked.begin() + slot);
+}
+
+/**
+ * Commits and closes a parked file, cutting off its preallocated zeros, and queues it for
+ * compression if compression is enabled and a later day has been logged to.
+ *
+ * @param[in] slot Index of the file in `parked`.
+ */
+void SDLogger::evict(size_t slot){
+    SDOpenLog open = std::move(this->parked[slot]);
+    this->parked.erase(this->parked.begin() + slot);
+
+    this->commit_parked(open);
+    open.wfp.close();
+    SD_METRIC_ADD(SD_FILE_CLOSES, 1);
+    this->trim_file(open.filename, open.wfp_size, open.allocated);
+
+    if(this->compress_closed && this->format == SD_FORMAT_TEXT && open.day < this->newest_day)
+        this->queue_compression(open.filename);
+}
+
+/**
+ * Commits and closes every parked file.
+ */
+void SDLogger::close_parked(){
+    while(!this->parked.empty()) this->evict(this->parked.size() - 1);
+}
+
+/**
+ * Flushes a parked file if it has uncommitted bytes.
+ */
+void SDLogger::commit_parked(SDOpenLog& slot){
+    if(slot.wfp_size == slot.committed_size) return;
+
+    SD_METRIC_START(t_flush);
+    slot.wfp.flush();
+    SD_METRIC_TIME(SD_FLUSH_LATENCY, t_flush);
+    slot.committed_size = slot.wfp_size;
 }
 
 /**
@@ -92,7 +376,7 @@ void SDLogger::set_filename(std::string prefix, int month, int day, int year, st
 File SDLogger::open_file(const char* mode){
     try{
         Serial.printf("\t-> trying to open file \'%s\' in mode -> %s\n", this->filename.c_str(), mode);
-        return this->sd.open(this->filename.c_str(), mode);
+        return this->sd->open(this->filename.c_str(), mode);
 
     }catch(const std::exception& e){
         Serial.println("print error in open");
@@ -105,96 +389,1524 @@ File SDLogger::open_file(const char* mode){
 }
 
 
+/**
+ * Opens the file for writing. The first time a file name is opened the card is checked
+ * for the file, and if the open creates it, file catalogs used by SDReader are marked 
+ * stale so that the new file is found by the next range query.
+ *
+ * @param[in] mode `FILE_WRITE` or `FILE_APPEND`.
+ *
+ * @returns The open file.
+ */
+File SDLogger::open_for_write(const char* mode){
+    bool created = !this->file_known && !this->exists();
+
+    File f = this->open_file(mode);
+    if(f) SD_METRIC_ADD(SD_FILE_OPENS, 1);
+
+    if(created && f) SDFileCatalog::invalidate();
+    this->file_known = true;
+    return f;
+}
+
 /**
  * Closes the connection to the SD card. This is effectively shutting down 
- * the connection through the SPI interface.
+ * the connection through the SPI interface. Any lines still held by the
+ * buffered writer are written first.
  */
 void SDLogger::close_card(){
-    this->sd.end();
+    this->close_write_handle();
+    this->close_parked();
+    this->sd->end();
 }
 
 /**
- * Write a line to a file, this replaces whatever is currently in the file so use
- * with caution. File is closed at end of operation.
+ * Switches the logger into buffered mode. Instead of opening and closing the file 
+ * for every line, the file is kept open and appended lines are collected in a buffer
+ * of `buffer_size` bytes. The buffer is written to the card when it is full, when the
+ * oldest buffered line is older than `max_age_ms`, or when `flush()`/`close_card()` is
+ * called.
  *
- * Note that a newline character is appended to the end of the input parameter.
+ * Full buffers are written so that they end on a sector boundary of the file, which 
+ * lets the filesystem write whole sectors without a read-modify-write.
  *
- * @param[in] line The string data which is written as a "line". 
+ * @param[in] buffer_size Size of the write buffer in bytes, rounded up to a multiple of `SDLOGGER_SECTOR_SIZE`.
+ * @param[in] max_age_ms Maximum time in milliseconds a line may wait in the buffer.
  */
-void SDLogger::write_line(std::string line){
-    File f = this->open_file(FILE_WRITE);
+void SDLogger::enable_buffered_writes(size_t buffer_size, unsigned long max_age_ms){
+    this->flush();
 
-    f.write('\n');
+    if(buffer_size < SDLOGGER_SECTOR_SIZE) buffer_size = SDLOGGER_SECTOR_SIZE;
+    buffer_size = ((buffer_size + SDLOGGER_SECTOR_SIZE - 1) / SDLOGGER_SECTOR_SIZE) * SDLOGGER_SECTOR_SIZE;
 
-    const char* buf = line.c_str();
-    f.write((uint8_t*)buf, line.length());
-    f.close();
+    this->write_buffer.resize(buffer_size);
+    this->write_buffer.shrink_to_fit();
+    this->flush_age = max_age_ms;
+    this->buffered = true;
 }
 
 /**
- * Appends a line of text to the end of a file's contents. Note that 
- * a newline character is appended to the end of the input string to 
- * create a "line" and that the file is closed after the operation.
+ * Writes any buffered data, closes the file, and releases the write buffer. Following
+ * appends open and close the file per line again.
+ */
+void SDLogger::disable_buffered_writes(){
+    this->close_write_handle();
+    this->close_parked();
+    this->buffered = false;
+
+    this->write_buffer.clear();
+    this->write_buffer.shrink_to_fit();
+}
+
+/**
+ * Writes all buffered data to the file and flushes the file so that the directory 
+ * entry on the card reflects the new size. In binary format the block being collected
+ * is closed and written first.
  *
- * @param[in] line The text to append to the end of the file.
+ * @returns `true` if all buffered data was written.
  */
-void SDLogger::append_line(std::string line){
-    File f = this->open_file(FILE_APPEND);
+bool SDLogger::flush(){
+    this->flush_block();
+    for(SDOpenLog& slot : this->parked) this->commit_parked(slot);
 
-    f.write('\n');
+    if(this->buffered_bytes == 0){
+        if(this->wfp_open){
+            SD_METRIC_START(t_flush);
+            this->wfp.flush();
+            SD_METRIC_TIME(SD_FLUSH_LATENCY, t_flush);
+            this->committed_size = this->wfp_size;
+        }
+        return true;
+    }
 
-    const char* buf = line.c_str();
-    f.write((uint8_t*)buf, line.length());
-    f.close();
+    if(!this->open_write_handle()) return false;
+    bool ok = this->write_buffered();
+
+    SD_METRIC_START(t_flush);
+    this->wfp.flush();
+    SD_METRIC_TIME(SD_FLUSH_LATENCY, t_flush);
+    this->committed_size = this->wfp_size;
+
+    return ok;
+}
+
+/**
+ * Writes the buffered bytes to the open file without flushing it. After a short write the
+ * bytes which did not reach the file stay in the buffer, so the next write or flush
+ * retries them in order, and the short write is counted in the metrics.
+ *
+ * @returns `true` if all buffered bytes were written.
+ */
+bool SDLogger::write_buffered(){
+    SD_METRIC_START(t_write);
+    size_t written = this->wfp.write(this->write_buffer.data(), this->buffered_bytes);
+    SD_METRIC_TIME(SD_WRITE_LATENCY, t_write);
+    SD_METRIC_ADD(SD_BYTES_WRITTEN, written);
+
+    if(written > this->buffered_bytes) written = 0;
+    this->wfp_size += written;
+    this->buffered_bytes -= written;
+
+    if(this->buffered_bytes == 0) return true;
+
+    // keep the tail for the next write, it follows the bytes which reached the file
+    memmove(this->write_buffer.data(), this->write_buffer.data() + written, this->buffered_bytes);
+    SD_METRIC_ADD(SD_SHORT_WRITES, 1);
+    Serial.println("[ERROR] short write while flushing log buffer, keeping the unwritten bytes");
+    return false;
 }
 
+/**
+ * Gives up on the bytes short writes left in the buffer, before the buffer is reused for
+ * another file or the file is closed. They are reported and counted as dropped.
+ */
+void SDLogger::drop_buffered(){
+    if(this->buffered_bytes == 0) return;
+
+    Serial.println("[ERROR] dropping log bytes the card did not accept");
+    SD_METRIC_ADD(SD_BYTES_DROPPED, this->buffered_bytes);
+    this->buffered_bytes = 0;
+}
 
 /**
- * Logs an mqtt topic message to a file. This means that the logged data is 
- * timestamped, has a topic, and a message. The line is appended to the file
- * using `append_line(string)` from this class.
+ * Commits buffered records when the durability policy requires it, see `set_durability()`.
+ * In every mode the buffer is flushed once its oldest uncommitted line, or the oldest
+ * record of an unwritten binary block, has been waiting longer than the configured maximum
+ * age. Lines are only checked as they are appended, so this should be called periodically
+ * by applications which log infrequently. Does nothing between `begin_group()` and 
+ * `end_group()`.
+ */
+void SDLogger::flush_if_stale(){
+    if(this->grouping) return;
+
+    unsigned long now = millis();
+    uint32_t pending = this->uncommitted_bytes();
+
+    bool due = (pending > 0 && now - this->oldest_write >= this->flush_age) ||
+            (this->encoder.records() > 0 && now - this->block_started >= this->flush_age);
+
+    if(this->durability == SD_DURABLE_RECORD) due = due || pending > 0 || this->encoder.records() > 0;
+    else if(this->durability == SD_DURABLE_BYTES) due = due || pending >= this->commit_bytes;
+
+    if(due){
+        this->flush();
+        return;
+    }
+
+    // daily files left open by rotation are held to the same maximum age
+    for(SDOpenLog& slot : this->parked){
+        if(slot.wfp_size != slot.committed_size && now - slot.oldest_write >= this->flush_age)
+            this->commit_parked(slot);
+    }
+}
+
+/**
+ * Selects when buffered records are committed, trading throughput for the records a
+ * power loss can take. Each commit is a flush, which on FAT writes the file's directory
+ * entry and costs a few ms on an SD card.
  *
- * @param[in] time The timestamp as a string formatted `<date_string>T<time_string>`.
- * @param[in] mqtt_topic The topic string as a `<base>/<subtopic>/...` formatted string.
- * @param[in] mqtt_message A string, often JSON object string but not always.
+ * - `SD_DURABLE_RECORD` commits every record before the log call returns, like the
+ *   unbuffered open and close per line but without reopening the file.
+ * - `SD_DURABLE_INTERVAL` commits once the oldest uncommitted record is `every` ms old,
+ *   a power loss takes at most the last `every` ms of records. This is the mode of
+ *   `enable_buffered_writes()`, `every` replaces its maximum age.
+ * - `SD_DURABLE_BYTES` commits once `every` bytes are uncommitted, by default the buffer
+ *   size. The maximum age of `enable_buffered_writes()` still bounds how long an idle
+ *   logger holds records.
+ *
+ * Buffered writes are enabled with the default buffer if they are not already.
+ * SDAsyncLogger commits once per batch of lines, see `begin_group()`.
+ *
+ * @param[in] mode The durability mode.
+ * @param[in] every The interval in ms or the bytes per commit, `0` keeps the current one.
  */
-void SDLogger::log_absolute_mqtt(std::string time, std::string mqtt_topic, std::string mqtt_message){
-    std::string line = time + separator + 
-        mqtt_topic + separator + 
-        mqtt_message + separator;
+void SDLogger::set_durability(SDDurability mode, uint32_t every){
+    if(!this->buffered) this->enable_buffered_writes();
 
-    this->append_line(line);
+    this->durability = mode;
+    if(mode == SD_DURABLE_INTERVAL && every > 0) this->flush_age = every;
+    if(mode == SD_DURABLE_BYTES) this->commit_bytes = (every > 0) ? every : this->write_buffer.size();
+
+    this->flush_if_stale();
 }
 
 /**
- * Logs an mqtt topic message to a file. This means that the logged data is 
- * timestamped, has a topic, and a message. The line is appended to the file
- * using `log_absolute_mqtt(string)` from this class. Essentially a wrapper 
- * which adds the `offset` parameter to provide a relative time estimate in
- * minutes from the previous known time. 
+ * Ends a group of records started with `begin_group()` and commits them together if the
+ * durability policy requires it, in `SD_DURABLE_RECORD` the whole group is committed by
+ * one flush.
+ */
+void SDLogger::end_group(){
+    this->grouping = false;
+    this->flush_if_stale();
+}
+
+/**
+ * Bytes written or buffered since the last flush.
+ */
+uint32_t SDLogger::uncommitted_bytes(){
+    return this->wfp_size + this->buffered_bytes - this->committed_size;
+}
+
+/**
+ * Reserves space for each log file the logger creates, by growing the file to `bytes` of
+ * zeros (see `SDStorage::preallocate()`) before its first record. Records then overwrite
+ * the zeros in place, so appends inside the reservation neither allocate clusters nor
+ * write the FAT, and the file's clusters are contiguous. The logger tracks where the data
+ * ends and cuts the zeros off when the file is closed cleanly, on a move to the next file,
+ * the eviction of a rotating logger's daily file or `close_card()`.
  *
- * @param[in] time The timestamp as a string formatted `<date_string>T<time_string>`.
- * @param[in] offset The relative offset in minutes, probably calculated from the WDT module reset frequency.
- * @param[in] mqtt_topic The topic string as a `<base>/<subtopic>/...` formatted string.
- * @param[in] mqtt_message A string, often JSON object string but not always.
+ * After a power loss the zeros remain. SDReader stops where the data ends, the logger
+ * continues writing there when it opens the file again, and `recover_file()` reports the
+ * zeros without treating them as a torn record. Existing files are not grown, and a file
+ * which outgrows its reservation is appended to as usual, so `bytes` should cover a day
+ * of logging.
+ *
+ * The SD card cannot reserve clusters without writing them, growing a file there writes
+ * the zeros a sector at a time (`SDStorage::preallocation_writes()`), seconds for a day of
+ * logging. On such storage a file is only written in place if it was created ahead of
+ * time by `prepare_file()` or `prepare_day()`, files first created by a log call are
+ * appended to.
+ *
+ * Writing in place needs an open file, so if buffered writes are off they are enabled
+ * with `SD_DURABLE_RECORD`, as for rotation. Files are not preallocated while buffered
+ * writes are disabled again.
+ *
+ * @param[in] bytes Bytes reserved for each new file, `0` disables preallocation.
+ */
+void SDLogger::enable_preallocation(uint32_t bytes){
+    this->preallocation = bytes;
+    if(bytes > 0 && !this->buffered) this->set_durability(SD_DURABLE_RECORD);
+}
+
+/**
+ * Opens the file in append mode and keeps the handle for buffered writes. With 
+ * preallocation enabled the file is written in place instead, see `open_preallocated()`.
+ *
+ * @returns `true` if the handle is open.
  */
-void SDLogger::log_relative_mqtt(std::string time, int offset, std::string mqtt_topic, std::string mqtt_message){
-    time = time + "+" + std::to_string(offset);
+bool SDLogger::open_write_handle(){
+    if(this->wfp_open) return true;
+    if(this->preallocation > 0 && this->open_preallocated()) return true;
 
-    this->log_absolute_mqtt(time, mqtt_topic, mqtt_message);
+    this->wfp = this->open_for_write(FILE_APPEND);
+    if(!this->wfp){
+        Serial.println("[ERROR] failed to open log file for buffered writes");
+        return false;
+    }
+
+    this->wfp_size = this->wfp.size();
+    this->committed_size = this->wfp_size;
+    this->wfp_allocated = this->wfp_size;
+    this->wfp_open = true;
+    return true;
 }
 
 /**
- * Used to initialize a CSV file by writing the list of comma 
- * separated fields to the first line of the file. In this case
- * the fields are provided as a vector and are written using
- * `write_line(string)` so the values overwrite all other data
- * in the file.
+ * Opens the file for writing in place at the end of its data. A new file is preallocated
+ * first. An existing file may still hold the zeros of a reservation if it was not closed
+ * cleanly, its data is found to end at the last non-zero byte (`sd_data_end()`), or in
+ * binary format after the last whole block.
  *
- * @param[in] fields A vector list of strings which represent data columns/fields in the CSV
- * file.
+ * @returns `false` if the file could not be preallocated or opened, it is then appended to.
  */
-void SDLogger::write_header(std::vector<std::string> fields){
+bool SDLogger::open_preallocated(){
+    const char* fn = this->filename.c_str();
+    bool created = !this->exists();
+
+    if(created && this->sd->preallocation_writes()) return false;
+    if(created && !this->sd->preallocate(fn, this->preallocation)){
+        Serial.println("[WARNING] failed to preallocate log file, appending instead");
+        this->sd->remove(fn);
+        return false;
+    }
+
+    File f = this->sd->open(fn, SDSTORAGE_MODE_UPDATE);
+    if(!f){
+        Serial.println("[WARNING] failed to open log file in place, appending instead");
+        if(created) this->sd->remove(fn);
+        return false;
+    }
+    SD_METRIC_ADD(SD_FILE_OPENS, 1);
+
+    uint32_t allocated = f.size();
+    uint32_t end = created ? 0 : sd_data_end(f);
+    if(!created && end < allocated && this->format == SD_FORMAT_BINARY) end = this->binary_end(f, this->filename, allocated);
+    f.seek(end);
+
+    if(created) SDFileCatalog::invalidate();
+    this->file_known = true;
+
+    this->wfp = f;
+    this->wfp_size = end;
+    this->committed_size = end;
+    this->wfp_allocated = allocated;
+    this->wfp_open = true;
+    return true;
+}
+
+/**
+ * Flushes pending data and closes the buffered write handle if it is open, cutting off
+ * the preallocated zeros after its data.
+ */
+void SDLogger::close_write_handle(){
+    this->flush();
+    this->drop_buffered();
+
+    if(this->wfp_open){
+        this->wfp.close();
+        this->wfp_open = false;
+        SD_METRIC_ADD(SD_FILE_CLOSES, 1);
+        this->trim_file(this->filename, this->wfp_size, this->wfp_allocated);
+    }
+}
+
+/**
+ * Creates log file `fn` with `header` and grows it to the logger's preallocation, so that
+ * the log call which first writes to it does not wait while the zeros are written. Call it
+ * from `loop()` or a task of low priority, for example for tomorrow's file some time
+ * before midnight. Existing files are left as they are.
+ *
+ * @param[in] fn Path of the log file.
+ * @param[in] header Line written before the zeros, empty for none.
+ *
+ * @returns `true` if the file exists afterwards, `false` if preallocation is disabled or
+ *  the file could not be created.
+ */
+bool SDLogger::prepare_file(const std::string& fn, std::string_view header){
+    if(this->preallocation == 0) return false;
+    if(this->sd->exists(fn.c_str())) return true;
+
+    if(!header.empty()){
+        File f = this->sd->open(fn.c_str(), FILE_APPEND);
+        bool ok = f && f.write((uint8_t)'\n') == 1 && f.write((const uint8_t*)header.data(), header.length()) == header.length();
+        if(f) f.close();
+
+        if(!ok){
+            Serial.println("[WARNING] failed to write header of prepared log file");
+            this->sd->remove(fn.c_str());
+            return false;
+        }
+    }
+
+    if(!this->sd->preallocate(fn.c_str(), this->preallocation)){
+        Serial.println("[WARNING] failed to preallocate prepared log file");
+        this->sd->remove(fn.c_str());
+        return false;
+    }
+
+    SDFileCatalog::invalidate();
+    return true;
+}
+
+/**
+ * Prepares the daily file of `epoch` of a rotating logger, see `prepare_file()`. A text
+ * file starts with the rotation header, as if a record had created it.
+ *
+ * @returns `false` if the logger is not rotating or the file could not be prepared.
+ */
+bool SDLogger::prepare_day(int64_t epoch){
+    if(!this->rotating) return false;
+
+    char date[sizeof(this->day_prefix)];
+    this->format_day(sd_day_start(epoch), date, sizeof(date));
+    std::string fn = this->rotate_prefix + "_" + date + this->rotate_filetype;
+
+    return this->prepare_file(fn, (this->format == SD_FORMAT_TEXT) ? std::string_view(this->rotate_header) : std::string_view());
+}
+
+/**
+ * Cuts a closed file whose data ends before its preallocated zeros to `size`.
+ *
+ * @param[in] fn Name of the file.
+ * @param[in] size Where the data ends.
+ * @param[in] allocated Size of the file on the card.
+ */
+void SDLogger::trim_file(const std::string& fn, uint32_t size, uint32_t allocated){
+    if(allocated <= size) return;
+
+    if(!this->sd->truncate(fn.c_str(), size))
+        Serial.println("[WARNING] failed to release preallocated space of log file");
+}
+
+/**
+ * Number of bytes the buffer may hold before it is written. This is the buffer size
+ * reduced by the fill of the file's last partial sector, so that a full buffer always
+ * ends on a sector boundary.
+ */
+size_t SDLogger::buffer_limit(){
+    return this->write_buffer.size() - (this->wfp_size % SDLOGGER_SECTOR_SIZE);
+}
+
+/**
+ * Copies bytes into the write buffer, writing the buffer out to the card each time it
+ * fills. Full buffer writes are not followed by a flush of the file's metadata, that is
+ * left to `flush()`. If the file cannot be opened, or a full buffer cannot be written at
+ * all, the bytes are dropped.
+ *
+ * @param[in] data Bytes to append.
+ * @param[in] len Number of bytes in `data`.
+ */
+void SDLogger::buffer_bytes(const uint8_t* data, size_t len){
+    // open before buffering so the buffer limit accounts for the file's current size
+    if(!this->open_write_handle()) return;
+
+    while(len > 0){
+        if(this->uncommitted_bytes() == 0) this->oldest_write = millis();
+
+        size_t space = this->buffer_limit() - this->buffered_bytes;
+        size_t n = (len < space) ? len : space;
+
+        memcpy(this->write_buffer.data() + this->buffered_bytes, data, n);
+        this->buffered_bytes += n;
+        data += n;
+        len -= n;
+
+        // a write which made no room leaves nowhere to put the rest
+        if(this->buffered_bytes == this->buffer_limit() && !this->write_buffered() && 
+                this->buffered_bytes == this->buffer_limit() && len > 0){
+            Serial.println("[ERROR] log buffer full after a failed write, dropping data");
+            SD_METRIC_ADD(SD_BYTES_DROPPED, len);
+            return;
+        }
+    }
+}
+
+/**
+ * Write a line to a file, this replaces whatever is currently in the file so use
+ * with caution. File is closed at end of operation.
+ *
+ * Note that a newline character is appended to the end of the input parameter.
+ *
+ * @param[in] line The string data which is written as a "line". 
+ */
+void SDLogger::write_line(std::string_view line){
+    File f = this->replace_file();
+
+    f.write('\n');
+
+    f.write((const uint8_t*)line.data(), line.length());
+    f.close();
+}
+
+/**
+ * Opens the file truncated to be written from the start. Pending data is written to the
+ * old contents first, and the file's index and topic dictionary are removed with them.
+ *
+ * @returns The open, empty file.
+ */
+File SDLogger::replace_file(){
+    this->close_write_handle();
+
+    // the file is replaced, so are its index and topic dictionary
+    if(this->indexing) this->sd->remove(sd_index_filename(this->filename).c_str());
+    this->reset_index_state();
+
+    if(this->encode_topics || this->format == SD_FORMAT_BINARY)
+        this->sd->remove(SDTopicDictionary::filename(this->filename).c_str());
+    this->dictionary_ready = false;
+
+    return this->open_for_write(FILE_WRITE);
+}
+
+/**
+ * Appends a line of text to the end of a file's contents. Note that 
+ * a newline character is appended to the end of the input string to 
+ * create a "line" and that the file is closed after the operation.
+ *
+ * In buffered mode the line is copied into the write buffer instead and 
+ * the file stays open, see `enable_buffered_writes()`.
+ *
+ * @param[in] line The text to append to the end of the file.
+ */
+void SDLogger::append_line(std::string_view line){
+    this->append_bytes(line);
+    this->flush_if_stale();
+}
+
+/**
+ * Appends `\n<data>` to the file, or to the write buffer in buffered mode.
+ *
+ * @param[in] data The text, or binary block, to append.
+ * @param[in] newline `false` to append `data` without the preceding newline.
+ *
+ * @returns The file offset the data, including its newline, was written at.
+ */
+uint32_t SDLogger::append_bytes(std::string_view data, bool newline){
+    const uint8_t nl = '\n';
+
+    if(newline) SD_METRIC_ADD(SD_LINES_WRITTEN, 1);
+
+    if(this->buffered){
+        if(!this->open_write_handle()) return 0;
+        uint32_t offset = this->wfp_size + this->buffered_bytes;
+
+        if(newline) this->buffer_bytes(&nl, 1);
+        this->buffer_bytes((const uint8_t*)data.data(), data.length());
+        return offset;
+    }
+
+    File f = this->open_for_write(FILE_APPEND);
+    uint32_t offset = f.size();
+
+    SD_METRIC_START(t_write);
+    size_t written = newline ? f.write(nl) : 0;
+    written += f.write((const uint8_t*)data.data(), data.length());
+    SD_METRIC_TIME(SD_WRITE_LATENCY, t_write);
+    SD_METRIC_ADD(SD_BYTES_WRITTEN, written);
+
+    size_t expected = data.length() + (newline ? 1 : 0);
+    if(written < expected){
+        Serial.println("[ERROR] short write while appending to log file");
+        SD_METRIC_ADD(SD_SHORT_WRITES, 1);
+        SD_METRIC_ADD(SD_BYTES_DROPPED, expected - written);
+    }
+
+    // closing commits the data and directory entry, the unbuffered flush
+    SD_METRIC_START(t_close);
+    f.close();
+    SD_METRIC_TIME(SD_FLUSH_LATENCY, t_close);
+    SD_METRIC_ADD(SD_FILE_CLOSES, 1);
+
+    return offset;
+}
+
+/**
+ * Enables the sparse time index. An entry mapping a line's time stamp to its byte offset
+ * is appended to `<filename>.idx` for the first line logged to a file, then every 
+ * `every_lines` lines and, if `every_seconds` is non-zero, whenever that many seconds have
+ * passed since the last entry. SDReader uses the index to seek to the start of a query 
+ * window instead of scanning from the beginning of the file.
+ *
+ * A record more than `SDLOGGER_INDEX_SLACK` older than the newest record of its file, ex
+ * one routed late to its daily file by a rotating logger, marks the index out of order
+ * and readers scan that file whole.
+ *
+ * @param[in] every_lines Number of lines between index entries.
+ * @param[in] every_seconds Maximum seconds between index entries, `0` to index by line count only.
+ */
+void SDLogger::enable_index(uint32_t every_lines, uint32_t every_seconds){
+    this->index_stride = (every_lines > 0) ? every_lines : 1;
+    this->index_seconds = every_seconds;
+    this->indexing = true;
+    this->reset_index_state();
+}
+
+/**
+ * Forget the index position so that the next line logged starts a new entry, called 
+ * when the logger moves to another file.
+ */
+void SDLogger::reset_index_state(){
+    this->lines_since_index = 0;
+    this->last_index_epoch = 0;
+    this->index_pending = true;
+    this->index_known = false;
+    this->index_unordered = false;
+    this->newest_epoch = 0;
+}
+
+/**
+ * Adds an index entry for the line just written at `offset` if one is due. Parsing
+ * the time stamp is cheap (see `SDTimeParser`) so every line is parsed, lines without
+ * a valid time stamp are not counted.
+ *
+ * @param[in] offset Offset of the newline preceding the line.
+ * @param[in] time The line's time stamp field.
+ */
+void SDLogger::index_line(uint32_t offset, std::string_view time){
+    if(!this->indexing) return;
+
+    int64_t epoch;
+    if(!this->time_parser.parse(time, epoch)) return;
+
+    this->index_entry(offset, epoch, 1, this->late_record(epoch));
+}
+
+/**
+ * Tracks the newest time stamp logged to the file. Readers seek with the index assuming
+ * no line is older than the newest line before it by more than `SDLOGGER_INDEX_SLACK`,
+ * see `sd_index_ordered()`, a late record breaking that must be indexed as out of order.
+ *
+ * @param[in] epoch Time stamp of the record being logged.
+ *
+ * @returns `true` if the record is older than the newest one by more than the slack.
+ */
+bool SDLogger::late_record(int64_t epoch){
+    if(!this->index_known) this->load_index_state();
+
+    bool late = epoch + SDLOGGER_INDEX_SLACK < this->newest_epoch;
+    if(epoch > this->newest_epoch) this->newest_epoch = epoch;
+    return late;
+}
+
+/**
+ * Reads the newest time stamp and the out of order marker from the index the file already
+ * has, so records appended to a file logged before keep its index consistent. Only the
+ * indexed lines are known, not the newest line itself.
+ */
+void SDLogger::load_index_state(){
+    this->index_known = true;
+
+    std::string idx_fn = sd_index_filename(this->filename);
+    if(!this->sd->exists(idx_fn.c_str())) return;
+
+    File idx = this->sd->open(idx_fn.c_str(), "r");
+    if(!idx) return;
+
+    SDIndexEntry entry;
+    while(idx.read((uint8_t*)&entry, sizeof(entry)) == sizeof(entry)){
+        if(entry.epoch == SDLOGGER_INDEX_UNORDERED) this->index_unordered = true;
+        if((int64_t)entry.epoch > this->newest_epoch) this->newest_epoch = entry.epoch;
+    }
+    idx.close();
+}
+
+/**
+ * Counts `lines` records written at `offset` and appends an index entry for them if one
+ * is due. Binary blocks are indexed as a whole, by their first time stamp. A late record
+ * is marked with a `SDLOGGER_INDEX_UNORDERED` entry, after which the file's index is 
+ * complete since readers scan the file whole.
+ *
+ * @param[in] offset Offset of the newline preceding the line, or of the block.
+ * @param[in] epoch Time stamp of the first record at `offset`.
+ * @param[in] lines Number of records written at `offset`.
+ * @param[in] late `true` if a record at `offset` is out of order, see `late_record()`.
+ */
+void SDLogger::index_entry(uint32_t offset, int64_t epoch, uint32_t lines, bool late){
+    if(this->index_unordered) return;
+
+    this->lines_since_index += lines;
+    bool due = late || this->index_pending || this->lines_since_index >= this->index_stride;
+
+    if(!due && this->index_seconds > 0)
+        due = (epoch - (int64_t)this->last_index_epoch) >= (int64_t)this->index_seconds;
+
+    if(!due) return;
+
+    SDIndexEntry entry = {late ? SDLOGGER_INDEX_UNORDERED : (uint32_t)epoch, offset};
+
+    File idx = this->sd->open(sd_index_filename(this->filename).c_str(), FILE_APPEND);
+    if(!idx){
+        Serial.println("[ERROR] failed to open log index");
+        return;
+    }
+    idx.write((const uint8_t*)&entry, sizeof(entry));
+    idx.close();
+
+    this->last_index_epoch = entry.epoch;
+    this->lines_since_index = 0;
+    this->index_pending = false;
+    this->index_unordered = late;
+}
+
+/**
+ * Writes the decimal representation of `value` to `buf` without allocating.
+ *
+ * @param[out] buf Destination, must hold at least `SDLOGGER_INT_CHARS` characters.
+ * @param[in] value The integer to format.
+ *
+ * @returns The number of characters written, no terminator is added.
+ */
+size_t SDLogger::format_int(char* buf, long value){
+    char tmp[SDLOGGER_INT_CHARS];
+    size_t n = 0;
+    unsigned long v = (value < 0) ? 0UL - (unsigned long)value : (unsigned long)value;
+
+    do{
+        tmp[n++] = '0' + (v % 10);
+        v /= 10;
+    }while(v > 0);
+
+    size_t len = 0;
+    if(value < 0) buf[len++] = '-';
+    while(n > 0) buf[len++] = tmp[--n];
+
+    return len;
+}
+
+/**
+ * Builds `<time>[+<offset>];<topic>;<message>;` in the logger's line buffer. The buffer 
+ * keeps its capacity between lines so once it has grown to the longest line logged,
+ * formatting does not allocate. With topic encoding enabled the topic is written as 
+ * `@<id>`, a topic written as is gets its leading `@` doubled (see SDTopicDictionary.hpp).
+ *
+ * @param[in] time The timestamp string.
+ * @param[in] offset Relative offset appended as `+<offset>`, or `NULL` for none.
+ * @param[in] mqtt_topic The topic string.
+ * @param[in] mqtt_message The message string.
+ */
+void SDLogger::format_line(std::string_view time, const int* offset, std::string_view mqtt_topic, std::string_view mqtt_message){
+    std::string& line = this->line_buffer;
+    line.clear();
+
+    line.append(time.data(), time.size());
+    if(offset != NULL){
+        char num[SDLOGGER_INT_CHARS];
+        line.push_back('+');
+        line.append(num, format_int(num, *offset));
+    }
+    line.append(this->separator);
+
+    int id = this->encode_topics ? this->topic_id(mqtt_topic) : -1;
+    if(id >= 0){
+        char num[SDLOGGER_INT_CHARS];
+        line.push_back('@');
+        line.append(num, format_int(num, id));
+    }else{
+        this->literal_topic();
+        if(SDTopicDictionary::needs_escape(mqtt_topic)) line.push_back('@');
+        line.append(mqtt_topic.data(), mqtt_topic.size());
+    }
+
+    line.append(this->separator);
+    line.append(mqtt_message.data(), mqtt_message.size());
+    line.append(this->separator);
+}
+
+/**
+ * Logs an mqtt topic message to a file. This means that the logged data is 
+ * timestamped, has a topic, and a message. The line is formatted in the logger's
+ * reusable line buffer and appended to the file using `append_line(string_view)` 
+ * from this class.
+ *
+ * @param[in] time The timestamp as a string formatted `<date_string>T<time_string>`.
+ * @param[in] mqtt_topic The topic string as a `<base>/<subtopic>/...` formatted string.
+ * @param[in] mqtt_message A string, often JSON object string but not always.
+ */
+void SDLogger::log_absolute_mqtt(std::string_view time, std::string_view mqtt_topic, std::string_view mqtt_message){
+    if(this->rotating && !this->route(time, 0)) return;
+
+    if(this->format == SD_FORMAT_BINARY){
+        this->log_binary(time, 0, mqtt_topic, mqtt_message);
+        return;
+    }
+
+    this->format_line(time, NULL, mqtt_topic, mqtt_message);
+    this->write_record(this->line_buffer);
+}
+
+/**
+ * Logs an mqtt topic message to a file. This means that the logged data is 
+ * timestamped, has a topic, and a message. Behaves like `log_absolute_mqtt()` 
+ * but adds the `offset` parameter to provide a relative time estimate in
+ * minutes from the previous known time. The offset is formatted directly into
+ * the line buffer.
+ *
+ * @param[in] time The timestamp as a string formatted `<date_string>T<time_string>`.
+ * @param[in] offset The relative offset in minutes, probably calculated from the WDT module reset frequency.
+ * @param[in] mqtt_topic The topic string as a `<base>/<subtopic>/...` formatted string.
+ * @param[in] mqtt_message A string, often JSON object string but not always.
+ */
+void SDLogger::log_relative_mqtt(std::string_view time, int offset, std::string_view mqtt_topic, std::string_view mqtt_message){
+    if(this->rotating && !this->route(time, offset)) return;
+
+    if(this->format == SD_FORMAT_BINARY){
+        this->log_binary(time, offset, mqtt_topic, mqtt_message);
+        return;
+    }
+
+    this->format_line(time, &offset, mqtt_topic, mqtt_message);
+    this->write_record(this->line_buffer);
+}
+
+/**
+ * Appends an already formatted `TIME;TOPIC;MESSAGE;` line. Used by writers which format
+ * lines themselves, such as SDAsyncLogger, which must double the leading `@` of a topic
+ * like the logger does. If topic encoding is enabled the line is formatted again with 
+ * the topic's ID, in binary format it is split into its fields and encoded as a record.
+ *
+ * @param[in] line The formatted line, beginning with its time stamp field.
+ */
+void SDLogger::log_line(std::string_view line){
+    if(this->rotating && !this->route(line.substr(0, line.find(this->separator)), 0)) return;
+
+    if(this->encode_topics || this->format == SD_FORMAT_BINARY){
+        size_t first_sc = line.find(this->separator);
+        size_t second_sc = (first_sc == std::string_view::npos) ? first_sc : line.find(this->separator, first_sc + 1);
+        uint16_t id;
+
+        std::string_view topic = (second_sc == std::string_view::npos) ? std::string_view() : 
+                line.substr(first_sc + 1, second_sc - first_sc - 1);
+
+        if(second_sc != std::string_view::npos && !SDTopicDictionary::parse_ref(topic, id)){
+            if(SDTopicDictionary::escaped(topic)) topic.remove_prefix(1);
+
+            std::string_view message = line.substr(second_sc + this->separator.size());
+            if(message.size() >= this->separator.size() && 
+                    message.substr(message.size() - this->separator.size()) == this->separator){
+                message.remove_suffix(this->separator.size());
+            }
+
+            if(this->format == SD_FORMAT_BINARY){
+                this->log_binary(line.substr(0, first_sc), 0, topic, message);
+                return;
+            }
+
+            this->format_line(line.substr(0, first_sc), NULL, topic, message);
+            this->write_record(this->line_buffer);
+            return;
+        }
+
+        if(this->format == SD_FORMAT_BINARY){
+            Serial.println("[ERROR] cannot encode line as a binary record");
+            return;
+        }
+
+    }else{
+        this->literal_topic();
+    }
+
+    this->write_record(line);
+}
+
+/**
+ * Appends a formatted line, with its checksum if enabled, and updates the time index.
+ *
+ * @param[in] line The formatted line, beginning with its time stamp field.
+ */
+void SDLogger::write_record(std::string_view line){
+    if(this->checksums){
+        if(line.data() != this->line_buffer.data()) this->line_buffer.assign(line.data(), line.size());
+        sd_append_checksum(this->line_buffer);
+        line = this->line_buffer;
+    }
+
+    uint32_t offset = this->append_bytes(line);
+    this->index_line(offset, line.substr(0, line.find(this->separator)));
+    this->flush_if_stale();
+}
+
+/**
+ * Selects the on-card format. In `SD_FORMAT_BINARY` each record is stored as a time
+ * delta, a topic ID from the file's topic dictionary and the raw message, collected into
+ * CRC checked blocks of up to `SDLOGGER_BLOCK_TARGET` bytes (see SDBinaryFormat.hpp). A
+ * block is written when it is full, when its first record is older than the flush age,
+ * or on `flush()`/`close_card()`, so in binary format unflushed records are lost on power
+ * failure even without buffered writes.
+ *
+ * A file should be written in one format only, binary files are given a different 
+ * extension by convention, ex `.sdl`. SDReader detects the format of each file.
+ *
+ * @param[in] format The format for records logged from now on.
+ */
+void SDLogger::set_format(SDLogFormat format){
+    this->flush();
+    this->format = format;
+    this->dictionary_ready = false;
+}
+
+/**
+ * Adds a record to the binary block being collected, writing the block out first if the
+ * record does not fit.
+ *
+ * @param[in] time The time stamp field.
+ * @param[in] offset Relative offset in minutes added to the time stamp.
+ * @param[in] mqtt_topic The topic, stored as its dictionary ID.
+ * @param[in] mqtt_message The message, stored as is.
+ */
+void SDLogger::log_binary(std::string_view time, int offset, std::string_view mqtt_topic, std::string_view mqtt_message){
+    int64_t epoch;
+    if(!this->time_parser.parse(time, epoch)){
+        Serial.println("[ERROR] binary record has no valid time stamp");
+        return;
+    }
+    epoch += (int64_t)offset * SD_OFFSET_UNIT;
+
+    int id = this->topic_id(mqtt_topic);
+    if(id < 0){
+        Serial.println("[ERROR] binary record topic could not be added to the dictionary");
+        return;
+    }
+
+    if(!this->encoder.add(epoch, id, mqtt_message)){
+        this->flush_block();
+
+        if(!this->encoder.add(epoch, id, mqtt_message)){
+            Serial.println("[ERROR] binary record is larger than a block, not logged");
+            return;
+        }
+    }
+    if(this->indexing && this->late_record(epoch)) this->block_late = true;
+
+    SD_METRIC_ADD(SD_LINES_WRITTEN, 1);
+    if(this->encoder.records() == 1) this->block_started = millis();
+    this->flush_if_stale();
+}
+
+/**
+ * Writes the binary block being collected, if any, and indexes it by its first time
+ * stamp.
+ */
+void SDLogger::flush_block(){
+    if(this->encoder.records() == 0) return;
+
+    std::string_view block = this->encoder.finish();
+    uint32_t offset = this->append_bytes(block, false);
+
+    if(this->indexing) this->index_entry(offset, this->encoder.first_epoch(), this->encoder.records(), this->block_late);
+    this->block_late = false;
+    this->encoder.reset();
+}
+
+/**
+ * Enables topic encoding. Each file gets a topic dictionary sidecar `<filename>.tdx` 
+ * (see SDTopicDictionary.hpp) and lines logged from now on write `@<id>` in place of the
+ * topic. SDReader resolves its topic filter against the dictionary once per file.
+ */
+void SDLogger::enable_topic_dictionary(){
+    this->encode_topics = true;
+    this->dictionary_ready = false;
+    for(SDOpenLog& open : this->parked) open.dictionary_ready = false;
+}
+
+/**
+ * Disables topic encoding. The next line of each file whose dictionary was in use records
+ * the offset where topics are written as is again, so readers looking for topics which
+ * are not in the dictionary still scan it, see `SDTopicDictionary::set_end()`.
+ */
+void SDLogger::disable_topic_dictionary(){
+    this->encode_topics = false;
+}
+
+/**
+ * Logical size of the log file, including lines still in the write buffer.
+ */
+uint32_t SDLogger::data_end(){
+    if(this->buffered){
+        if(!this->open_write_handle()) return 0;
+        return this->wfp_size + this->buffered_bytes;
+    }
+
+    File f = this->sd->open(this->filename.c_str(), "r");
+    if(!f) return 0;
+
+    uint32_t size = f.size();
+    f.close();
+    return size;
+}
+
+/**
+ * Looks up the ID of `topic`, loading or creating the file's dictionary on first use and
+ * adding topics the dictionary has not seen.
+ *
+ * @param[in] topic The topic to encode.
+ *
+ * @returns The ID, or `-1` if the topic cannot be encoded and should be written as is.
+ */
+int SDLogger::topic_id(std::string_view topic){
+    if(!this->dictionary_ready){
+        if(!this->dictionary.load(*this->sd, this->filename))
+            this->dictionary.create(*this->sd, this->filename, this->data_end());
+        this->dictionary_ready = true;
+    }
+
+    if(!this->dictionary.exists() || topic.find('\n') != std::string_view::npos) return -1;
+
+    int id = this->dictionary.find(topic);
+    if(id < 0) id = this->dictionary.add(*this->sd, this->filename, topic);
+
+    return id;
+}
+
+/**
+ * Called before a text line with its topic written as is. If the file has a topic 
+ * dictionary, loaded once per file, the line's offset is recorded as where encoding 
+ * ended unless an earlier offset already is.
+ */
+void SDLogger::literal_topic(){
+    if(!this->dictionary_ready){
+        this->dictionary.load(*this->sd, this->filename);
+        this->dictionary_ready = true;
+    }
+
+    if(this->dictionary.exists() && this->dictionary.end_offset() == UINT32_MAX)
+        this->dictionary.set_end(*this->sd, this->filename, this->data_end());
+}
+
+/**
+ * Adds closed file `fn` to the files waiting for `compress_closed_files()`, once.
+ *
+ * @param[in] fn The log file name.
+ */
+void SDLogger::queue_compression(const std::string& fn){
+    if(std::find(this->compress_queue.begin(), this->compress_queue.end(), fn) == this->compress_queue.end())
+        this->compress_queue.push_back(fn);
+}
+
+/**
+ * @param[in] fn The log file name.
+ *
+ * @returns `true` if `fn` is the current file or one of the parked daily files.
+ */
+bool SDLogger::file_open(const std::string& fn) const {
+    if(fn == this->filename) return true;
+
+    for(const SDOpenLog& open : this->parked){
+        if(open.filename == fn) return true;
+    }
+    return false;
+}
+
+/**
+ * Compresses files queued when the logger closed them with compression enabled, oldest
+ * first. Compressing a day of logging takes a noticeable time, so the logger never does
+ * it while logging. Call this when the application has time, ex from `loop()` after
+ * sending its readings, passing `1` to compress a single file per call. A queued file
+ * which is open again, because a late record was routed to it, is kept queued until the
+ * logger closes it again. A file which failed to compress, ex because the card is full,
+ * stays queued and is tried again by the next call. Files queued when the logger is 
+ * destroyed stay uncompressed.
+ *
+ * With an SDAsyncLogger running, call `SDAsyncLogger::compress_closed_files()` instead.
+ *
+ * @param[in] max_files Most files compressed by this call.
+ *
+ * @returns The number of files compressed.
+ */
+size_t SDLogger::compress_closed_files(size_t max_files){
+    size_t done = 0;
+
+    for(size_t i = 0; i < this->compress_queue.size() && done < max_files;){
+        std::string fn = this->compress_queue[i];
+        if(this->file_open(fn)){
+            i++;
+            continue;
+        }
+
+        if(!this->sd->exists(fn.c_str())){
+            this->compress_queue.erase(this->compress_queue.begin() + i);
+            continue;
+        }
+        if(this->compress_file(fn)){
+            this->compress_queue.erase(this->compress_queue.begin() + i);
+            done++;
+        }
+        else i++;
+    }
+
+    return done;
+}
+
+/**
+ * Appends the contents of file `from` to file `to`, cutting `to` back to its former size
+ * if not all of it could be written.
+ *
+ * @returns `true` if all of `from` was appended.
+ */
+static bool append_file(SDStorage& sd, const std::string& from, const std::string& to){
+    File in = sd.open(from.c_str(), "r");
+    File out = sd.open(to.c_str(), FILE_APPEND);
+    bool opened = out;
+    bool ok = in && opened;
+    uint32_t size = opened ? out.size() : 0;
+
+    uint8_t buf[SDLOGGER_SECTOR_SIZE];
+    size_t n;
+    while(ok && (n = in.read(buf, sizeof(buf))) > 0) ok = out.write(buf, n) == n;
+
+    if(in) in.close();
+    if(out) out.close();
+
+    if(!ok && opened) sd.truncate(to.c_str(), size);
+    return ok;
+}
+
+/**
+ * Compresses a closed text log file into `<fn>.sdz` (see SDCompress.hpp). The file is 
+ * read in sector sized pieces and cut into frames of about `SDLOGGER_COMPRESS_BLOCK` bytes
+ * ending on line boundaries, each frame recording the time range of its lines so SDReader
+ * can skip it without decompressing. The frames are written to `<fn>.sdz.tmp`, which is
+ * started over by every attempt, and only once all of them are written is it renamed to
+ * `<fn>.sdz`. If `<fn>.sdz` already exists, because lines were logged to the day after
+ * it was compressed, the new frames are appended to it instead, and cut off again if
+ * that append comes up short. A failed attempt thus leaves `<fn>.sdz` as it was, and
+ * retrying it does not compress any line twice.
+ *
+ * Once all frames are written `fn` and its time index are removed, the topic dictionary
+ * is kept for the compressed file. Lines of a compressed file are resolved against the 
+ * dictionary one by one, so its start offset, which pointed into `fn`, is reset to `0`
+ * for the plain file the day's later lines go to. Frames are written before `fn` is 
+ * removed, so a power loss can at worst leave lines in both files. The file should not be
+ * written while it is being compressed, which for a full day of logging takes a 
+ * noticeable time, see `compress_closed_files()`.
+ *
+ * @param[in] fn Name of the log file to compress.
+ *
+ * @returns `true` if the file was compressed and removed.
+ */
+bool SDLogger::compress_file(const std::string& fn){
+    if(fn == this->filename) this->close_write_handle();
+
+    File in = this->sd->open(fn.c_str(), "r");
+    if(!in){
+        Serial.println("[ERROR] failed to open log file for compression");
+        return false;
+    }
+
+    // a file left preallocated by a power loss is compressed up to the end of its data
+    uint32_t left = sd_data_end(in);
+    in.seek(0);
+
+    std::string out_fn = sd_compressed_name(fn);
+    std::string tmp_fn = out_fn + SDSTORAGE_TMP_EXT;
+    File out = this->sd->open(tmp_fn.c_str(), FILE_WRITE);
+    if(!out){
+        Serial.println("[ERROR] failed to create compressed log file");
+        in.close();
+        return false;
+    }
+
+    SDLzCodec codec;
+    SDTimeParser parser;
+    std::vector<uint8_t> raw;       // lines read but not yet compressed
+    std::vector<uint8_t> frame;     // header and stored data of one frame
+    bool eof = false;
+    bool ok = true;
+
+    raw.reserve(SDLOGGER_COMPRESS_BLOCK + SDLOGGER_SECTOR_SIZE);
+
+    auto read_more = [&](){
+        size_t want = SDLOGGER_FRAME_MAX - raw.size();
+        if(want > SDLOGGER_SECTOR_SIZE) want = SDLOGGER_SECTOR_SIZE;
+        if(want > left) want = left;
+
+        size_t old = raw.size();
+        raw.resize(old + want);
+        size_t n = (want > 0) ? in.read(raw.data() + old, want) : 0;
+        raw.resize(old + n);
+        left -= n;
+        if(n == 0) eof = true;
+    };
+
+    // offset of the last newline in `raw` after the first byte, 0 if there is none
+    auto last_newline = [&](){
+        for(size_t i = raw.size(); i > 1; i--){
+            if(raw[i - 1] == '\n') return i - 1;
+        }
+        return (size_t)0;
+    };
+
+    while(ok){
+        while(!eof && raw.size() < SDLOGGER_COMPRESS_BLOCK) read_more();
+        if(raw.empty()) break;
+
+        // cut after the last whole line, reading on if a single line fills the block
+        size_t cut = raw.size();
+        if(!eof){
+            cut = last_newline();
+            while(cut == 0 && !eof && raw.size() < SDLOGGER_FRAME_MAX){
+                read_more();
+                cut = last_newline();
+            }
+            if(cut == 0) cut = raw.size();
+        }
+
+        SDFrameHeader header = {UINT32_MAX, 0, (uint16_t)cut, 0, sd_crc32(raw.data(), cut)};
+
+        // time range of the lines in the frame
+        size_t line_start = 0;
+        while(line_start < cut){
+            const uint8_t* nl = (const uint8_t*)memchr(raw.data() + line_start, '\n', cut - line_start);
+            size_t line_end = nl ? nl - raw.data() : cut;
+
+            std::string_view line((const char*)raw.data() + line_start, line_end - line_start);
+            int64_t epoch;
+            if(parser.parse(line.substr(0, line.find(this->separator)), epoch)){
+                if(epoch < header.min_epoch) header.min_epoch = epoch;
+                if(epoch > header.max_epoch) header.max_epoch = epoch;
+            }
+            line_start = line_end + 1;
+        }
+
+        frame.resize(SDLOGGER_FRAME_HEADER + SDLzCodec::bound(cut));
+        size_t stored = codec.compress(raw.data(), cut, frame.data() + SDLOGGER_FRAME_HEADER, frame.size() - SDLOGGER_FRAME_HEADER);
+        if(stored == 0 || stored >= cut){
+            memcpy(frame.data() + SDLOGGER_FRAME_HEADER, raw.data(), cut);
+            stored = cut;
+        }
+        header.stored_len = stored;
+        sd_write_frame_header(header, frame.data());
+
+        ok = out.write(frame.data(), SDLOGGER_FRAME_HEADER + stored) == SDLOGGER_FRAME_HEADER + stored;
+        raw.erase(raw.begin(), raw.begin() + cut);
+    }
+
+    in.close();
+    out.close();
+
+    if(ok){
+        if(this->sd->exists(out_fn.c_str())) ok = append_file(*this->sd, tmp_fn, out_fn);
+        else ok = this->sd->rename(tmp_fn.c_str(), out_fn.c_str());
+    }
+    this->sd->remove(tmp_fn.c_str());
+
+    if(!ok){
+        Serial.println("[ERROR] short write while compressing log file");
+        return false;
+    }
+
+    this->sd->remove(fn.c_str());
+    this->sd->remove(sd_index_filename(fn).c_str());
+    if(fn == this->filename){
+        this->file_known = false;
+        this->dictionary_ready = false;
+    }
+
+    SDTopicDictionary dict;
+    if(dict.load(*this->sd, fn) && dict.start_offset() != 0) dict.set_start(*this->sd, fn, 0);
+
+    SDFileCatalog::invalidate();
+    return true;
+}
+
+/**
+ * Recovers log file `fn` after a power loss, call at startup before the file is logged to
+ * again. A record torn by a power loss mid-write can only be the last one in the file,
+ * so only the end of the file is examined:
+ *
+ * - in a text file the last line must be terminated and pass its checksum, see 
+ *   SDRecovery.hpp,
+ * - in a binary file the blocks following the last indexed one must be whole and pass
+ *   their CRC,
+ * - compressed files are written whole and are left alone.
+ *
+ * A topic dictionary rewrite cut off by the power loss, see `compress_file()`, is finished
+ * for plain and compressed files alike.
+ *
+ * A torn record is appended to `<fn>.torn` for inspection, then the file is cut where
+ * the last whole record ends and index entries past the cut are dropped. A corrupt 
+ * binary block followed by whole ones is not torn, it is left for SDReader to skip.
+ *
+ * A file preallocated by the logger (`enable_preallocation()`) and not closed cleanly 
+ * ends in zeros, the end of its data is found first by `sd_data_end()` and the zeros are
+ * not a torn record. They are kept while this logger preallocates, as it continues 
+ * writing into them, and cut off otherwise.
+ *
+ * @param[in] fn Name of the log file.
+ * @param[out] report Receives what was found, may be `NULL`.
+ *
+ * @returns `true` if the file is whole, or was cut after its last whole record.
+ */
+bool SDLogger::recover_file(const std::string& fn, SDRecoveryReport* report){
+    if(fn == this->filename) this->close_write_handle();
+
+    SDRecoveryReport result;
+    if(report != NULL) *report = result;
+    SDTopicDictionary::recover(*this->sd, sd_uncompressed_name(fn));
+    if(!this->sd->exists(fn.c_str())) return true;
+
+    File f = this->sd->open(fn.c_str(), "r");
+    if(!f){
+        Serial.println("[ERROR] failed to open log file for recovery");
+        return false;
+    }
+
+    result.file_size = f.size();
+    uint32_t end = sd_data_end(f);
+    result.valid_size = end;
+
+    uint8_t head[SDLOGGER_FRAME_HEADER];
+    f.seek(0);
+    size_t n = f.read(head, sizeof(head));
+    SDFrameHeader frame;
+    SDBlockHeader block;
+
+    if(sd_parse_frame_header(head, n, frame)){
+        result.torn = false;
+        result.valid_size = result.file_size;
+    }else if(SDBlockDecoder::parse_header(head, n, block)){
+        result.torn = this->torn_binary_tail(f, fn, result.file_size, end, result.valid_size);
+    }else{
+        result.torn = this->torn_text_tail(f, end, result.valid_size);
+    }
+
+    // the last block may end in zeros, a torn record ends at the last non-zero byte
+    if(end < result.valid_size) end = result.valid_size;
+    result.reserved = result.file_size - end;
+
+    bool ok = !result.torn || this->quarantine(f, fn, result.valid_size, end);
+    f.close();
+
+    if(result.torn && ok){
+        Serial.println("[WARNING] torn record at the end of log file, moved to .torn file");
+        ok = this->sd->truncate(fn.c_str(), result.valid_size);
+
+        // drop index entries pointing past the cut, entries are in file order
+        std::string idx_fn = sd_index_filename(fn);
+        File idx = this->sd->exists(idx_fn.c_str()) ? this->sd->open(idx_fn.c_str(), "r") : File();
+        if(idx){
+            size_t keep = idx.size() / sizeof(SDIndexEntry);
+            SDIndexEntry entry;
+
+            while(keep > 0){
+                idx.seek((keep - 1) * sizeof(SDIndexEntry));
+                if(idx.read((uint8_t*)&entry, sizeof(entry)) != sizeof(entry) || entry.offset < result.valid_size) break;
+                keep--;
+            }
+            size_t size = idx.size();
+            idx.close();
+
+            if(keep * sizeof(SDIndexEntry) < size) this->sd->truncate(idx_fn.c_str(), keep * sizeof(SDIndexEntry));
+        }
+
+        if(fn == this->filename) this->reset_index_state();
+        SDFileCatalog::invalidate();
+
+    }else if(ok && result.reserved > 0 && this->preallocation == 0){
+        ok = this->sd->truncate(fn.c_str(), result.valid_size);
+    }
+
+    if(!ok) Serial.println("[ERROR] failed to remove torn record from log file");
+    if(report != NULL) *report = result;
+    return ok;
+}
+
+/**
+ * Checks the last line of a text log file. Lines are written as `\n<line>`, so the last 
+ * line starts after the last newline and the file is cut at that newline. Lines longer
+ * than `SDLOGGER_RECOVERY_MAX_LINE` are only checked for their terminator.
+ *
+ * @param[in] f The open file.
+ * @param[in] size Where the data of the file ends.
+ * @param[out] valid Where the file should be cut, only set if the line is torn.
+ *
+ * @returns `true` if the last line is torn.
+ */
+bool SDLogger::torn_text_tail(File& f, uint32_t size, uint32_t& valid){
+    uint8_t buf[SDLOGGER_RECOVERY_CHUNK];
+    uint32_t end = size;
+    uint32_t cut = 0;
+    bool found = false;
+
+    while(end > 0 && !found){
+        uint32_t begin = (end > sizeof(buf)) ? end - sizeof(buf) : 0;
+
+        f.seek(begin);
+        if(f.read(buf, end - begin) != end - begin) return false;
+
+        for(uint32_t i = end - begin; i > 0 && !found; i--){
+            if(buf[i - 1] == '\n'){
+                cut = begin + i - 1;
+                found = true;
+            }
+        }
+        end = begin;
+    }
+
+    uint32_t first = found ? cut + 1 : 0;
+    if(first == size) return false;
+
+    uint32_t from = (size - first > SDLOGGER_RECOVERY_MAX_LINE) ? size - SDLOGGER_RECOVERY_CHUNK : first;
+    std::string tail(size - from, '\0');
+
+    f.seek(from);
+    if(f.read((uint8_t*)&tail[0], tail.size()) != tail.size()) return false;
+
+    bool torn;
+    std::string_view line(tail);
+    if(tail.find('\0') != std::string::npos){
+        torn = true;
+
+    }else if(from == first){
+        torn = !sd_check_line(line, this->separator);
+
+    }else{
+        // too long to hold, only the terminator is checked
+        if(line.size() > SDLOGGER_CHECKSUM_CHARS && line[line.size() - SDLOGGER_CHECKSUM_CHARS] == SDLOGGER_CHECKSUM_MARK)
+            line.remove_suffix(SDLOGGER_CHECKSUM_CHARS);
+        torn = line.substr(line.size() - this->separator.size()) != this->separator;
+    }
+
+    if(torn) valid = cut;
+    return torn;
+}
+
+/**
+ * `true` if a whole block of a binary log file starts at `at`.
+ *
+ * @param[in] f The open file.
+ * @param[in] at Offset of the block.
+ * @param[in] size Size of the file.
+ * @param[in] payload Buffer reused for the payload.
+ * @param[out] next Offset where the block ends.
+ */
+static bool whole_block(File& f, uint32_t at, uint32_t size, std::vector<uint8_t>& payload, uint32_t& next){
+    uint8_t head[SDLOGGER_BLOCK_HEADER];
+    SDBlockHeader header;
+    SDBlockDecoder decoder;
+
+    f.seek(at);
+    size_t n = f.read(head, SDLOGGER_BLOCK_HEADER);
+    if(!SDBlockDecoder::parse_header(head, n, header)) return false;
+    if(at + SDLOGGER_BLOCK_HEADER + header.payload_len > size) return false;
+
+    payload.resize(header.payload_len);
+    if(f.read(payload.data(), header.payload_len) != header.payload_len) return false;
+    if(!decoder.begin(header, payload.data())) return false;
+
+    next = at + SDLOGGER_BLOCK_HEADER + header.payload_len;
+    return true;
+}
+
+/**
+ * Walks the blocks of a binary log file from its last indexed block, or the start, to
+ * the first block which is incomplete or fails its CRC.
+ *
+ * @param[in] f The open file.
+ * @param[in] fn Name of the file, to find its index.
+ * @param[in] size Size of the file.
+ *
+ * @returns Offset where the last whole block of the walk ends.
+ */
+uint32_t SDLogger::binary_end(File& f, const std::string& fn, uint32_t size){
+    uint32_t pos = 0;
+
+    File idx = this->sd->exists(sd_index_filename(fn).c_str()) ? this->sd->open(sd_index_filename(fn).c_str(), "r") : File();
+    if(idx){
+        SDIndexEntry entry;
+        size_t count = idx.size() / sizeof(SDIndexEntry);
+
+        if(count > 0 && idx.seek((count - 1) * sizeof(SDIndexEntry)) && 
+                idx.read((uint8_t*)&entry, sizeof(entry)) == sizeof(entry) && entry.offset < size){
+            pos = entry.offset;
+        }
+        idx.close();
+    }
+
+    std::vector<uint8_t> payload;
+    uint32_t next;
+    while(pos < size && whole_block(f, pos, size, payload, next)) pos = next;
+    return pos;
+}
+
+/**
+ * Finds the end of the whole blocks of a binary log file with `binary_end()`. A block
+ * which is incomplete or fails its CRC there is torn if no whole block follows it before
+ * the data ends, the preallocated zeros after it are not searched.
+ *
+ * @param[in] f The open file.
+ * @param[in] fn Name of the file, to find its index.
+ * @param[in] size Size of the file.
+ * @param[in] end Where the data of the file ends, see `sd_data_end()`.
+ * @param[out] valid Where the whole blocks end, and the file should be cut if the last block is torn.
+ *
+ * @returns `true` if the last block is torn.
+ */
+bool SDLogger::torn_binary_tail(File& f, const std::string& fn, uint32_t size, uint32_t end, uint32_t& valid){
+    uint32_t pos = this->binary_end(f, fn, size);
+    valid = pos;
+    if(pos >= end) return false;
+
+    std::vector<uint8_t> payload;
+    uint32_t next;
+    for(uint32_t at = pos + 1; at < end && at + SDLOGGER_BLOCK_HEADER <= size; at++){
+        if(whole_block(f, at, size, payload, next)) return false;
+    }
+    return true;
+}
+
+/**
+ * Appends bytes `[from, to)` of `f` to the `.torn` file of `fn`.
+ *
+ * @returns `true` if all bytes were copied.
+ */
+bool SDLogger::quarantine(File& f, const std::string& fn, uint32_t from, uint32_t to){
+    File out = this->sd->open(sd_torn_filename(fn).c_str(), FILE_APPEND);
+    if(!out){
+        Serial.println("[ERROR] failed to open .torn file");
+        return false;
+    }
+
+    uint8_t buf[SDLOGGER_RECOVERY_CHUNK];
+    bool ok = f.seek(from);
+
+    while(ok && from < to){
+        size_t want = (to - from < sizeof(buf)) ? to - from : sizeof(buf);
+        size_t n = f.read(buf, want);
+        ok = (n == want) && out.write(buf, n) == n;
+        from += n;
+    }
+
+    out.close();
+    return ok;
+}
+
+/**
+ * Used to initialize a CSV file by writing the list of comma 
+ * separated fields to the first line of the file. In this case
+ * the fields are provided as a vector and are written using
+ * `write_line(string)` so the values overwrite all other data
+ * in the file.
+ *
+ * @param[in] fields A vector list of strings which represent data columns/fields in the CSV
+ * file.
+ */
+void SDLogger::write_header(std::vector<std::string> fields){
+    if(this->format == SD_FORMAT_BINARY){
+        // binary files carry no header, only start the file over
+        this->replace_file().close();
+        return;
+    }
+
     std::string header = "";
     for(std::string i : fields){
         header += i + separator;
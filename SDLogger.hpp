@@ -9,15 +9,68 @@
 #define SDLOGGER_H
 
 #include <SD.h>
-#include "../../include/SDCard.hpp"
+#include "SDStorage.hpp"
+#include "SDLogIndex.hpp"
+#include "SDFileCatalog.hpp"
+#include "SDTime.hpp"
+#include "SDTopicDictionary.hpp"
+#include "SDBinaryFormat.hpp"
+#include "SDCompress.hpp"
+#include "SDMetrics.hpp"
+#include "SDRecovery.hpp"
 
 #include <vector>
+#include <string>
+#include <string_view>
+#include <cstring>
 
-#define TT_CLK 18
-#define TT_MISO 19
-#define TT_MOSI 23
-#define TT_SS 13
+#define SDLOGGER_SECTOR_SIZE 512            // bytes per SD card sector
+#define SDLOGGER_DEFAULT_BUFFER_SIZE 4096   // default size of the buffered writer, multiple of SDLOGGER_SECTOR_SIZE
+#define SDLOGGER_DEFAULT_FLUSH_AGE 5000     // default maximum age(ms) of unflushed data in buffered mode
+#define SDLOGGER_LINE_RESERVE 256           // initial capacity of the reusable line buffer
+#define SDLOGGER_INT_CHARS 24               // characters needed to format any long
+#define SDLOGGER_ROTATION_HANDLES 3         // daily files a rotating logger keeps open, including the current one
+#define SDLOGGER_DEFAULT_PREALLOCATION 1048576  // default bytes reserved for each new log file
 
+/**
+ * @brief On-card format of the records written by SDLogger.
+ */
+enum SDLogFormat {
+    SD_FORMAT_TEXT,     // `TIME;TOPIC;MESSAGE;` lines
+    SD_FORMAT_BINARY    // CRC checked blocks of binary records, see SDBinaryFormat.hpp
+};
+
+/**
+ * @brief When buffered records are committed to the card, each commit is a flush which
+ *  updates the file's directory entry so a power loss cannot lose the records.
+ */
+enum SDDurability {
+    SD_DURABLE_RECORD,      // commit every record before the log call returns
+    SD_DURABLE_INTERVAL,    // commit once the oldest uncommitted record is N ms old
+    SD_DURABLE_BYTES        // commit once N bytes are uncommitted
+};
+
+/**
+ * @brief A daily file a rotating SDLogger keeps open while it writes to another, see
+ *  `SDLogger::enable_rotation()`.
+ */
+struct SDOpenLog {
+    std::string filename;
+    int64_t day = 0;                // epoch of the file's midnight
+    File wfp;
+    uint32_t wfp_size = 0;          // bytes written to the file
+    uint32_t committed_size = 0;    // bytes in the file as of its last flush
+    uint32_t allocated = 0;         // size of the file on the card, including preallocated zeros
+    unsigned long oldest_write = 0; // millis() when the oldest uncommitted byte was written
+    uint32_t lines_since_index = 0;
+    uint32_t last_index_epoch = 0;
+    bool index_pending = true;
+    bool index_known = false;
+    bool index_unordered = false;
+    int64_t newest_epoch = 0;
+    bool dictionary_ready = false;
+    SDTopicDictionary dictionary;
+};
 
 /**
  * @brief Creates an interface for writing data to a log file
@@ -35,7 +88,109 @@ class SDLogger {
         std::string filetype = ".csv";  // file extension assumed for the file
         std::string separator = ";";    // separator between CSV fields
 
-        SDCard sd;
+        SDStorage* sd = &sd_default_storage();   // where the log files are kept
+
+        bool file_known = false;        // `filename` has been checked for existence since it was set
+        File open_for_write(const char* mode);
+
+        bool buffered = false;          // keep the file open and collect lines in `write_buffer`
+        File wfp;                       // write handle held open while in buffered mode
+        bool wfp_open = false;
+        uint32_t wfp_size = 0;          // bytes in the file on the card, excluding buffered data
+        std::vector<uint8_t> write_buffer;
+        size_t buffered_bytes = 0;      // bytes waiting in `write_buffer`
+        unsigned long flush_age = SDLOGGER_DEFAULT_FLUSH_AGE;
+        unsigned long oldest_write = 0; // millis() when the oldest uncommitted byte was buffered
+        uint32_t committed_size = 0;    // bytes in the file as of the last flush
+        uint32_t wfp_allocated = 0;     // size of the file on the card, past `wfp_size` while preallocated zeros remain
+        uint32_t preallocation = 0;     // bytes reserved for each new file, 0 disables
+
+        SDDurability durability = SD_DURABLE_INTERVAL;
+        uint32_t commit_bytes = SDLOGGER_DEFAULT_BUFFER_SIZE;  // uncommitted bytes allowed in SD_DURABLE_BYTES
+        bool grouping = false;          // commits deferred until `end_group()`
+
+        uint32_t uncommitted_bytes();
+
+        bool open_write_handle();
+        bool open_preallocated();
+        bool prepare_file(const std::string& fn, std::string_view header);
+        void close_write_handle();
+        void trim_file(const std::string& fn, uint32_t size, uint32_t allocated);
+        void buffer_bytes(const uint8_t* data, size_t len);
+        size_t buffer_limit();
+
+        std::string line_buffer;        // reused to format each logged line
+        bool checksums = false;         // append a checksum to each text line, see SDRecovery.hpp
+        void format_line(std::string_view time, const int* offset, std::string_view mqtt_topic, std::string_view mqtt_message);
+
+        bool indexing = false;          // maintain a `.idx` sidecar, see SDLogIndex.hpp
+        uint32_t index_stride = SDLOGGER_INDEX_STRIDE;
+        uint32_t index_seconds = 0;     // also index when this many seconds passed, 0 disables
+        uint32_t lines_since_index = 0;
+        uint32_t last_index_epoch = 0;
+        bool index_pending = true;      // next line starts a new index entry
+        bool index_known = false;       // `newest_epoch` and `index_unordered` describe `filename`
+        bool index_unordered = false;   // the index is marked out of order, no more entries are written
+        int64_t newest_epoch = 0;       // newest time stamp logged to the file
+        bool block_late = false;        // the waiting binary block holds an out of order record
+        SDTimeParser time_parser;       // parses time stamps for index entries
+
+        uint32_t append_bytes(std::string_view data, bool newline = true);
+        void index_line(uint32_t offset, std::string_view time);
+        void index_entry(uint32_t offset, int64_t epoch, uint32_t lines, bool late = false);
+        bool late_record(int64_t epoch);
+        void load_index_state();
+        void reset_index_state();
+
+        bool encode_topics = false;     // write `@<id>` in place of topics, see SDTopicDictionary.hpp
+        bool dictionary_ready = false;  // `dictionary` describes `filename`
+        SDTopicDictionary dictionary;
+
+        int topic_id(std::string_view topic);
+        void literal_topic();
+        uint32_t data_end();
+        void write_record(std::string_view line);
+        File replace_file();
+
+        SDLogFormat format = SD_FORMAT_TEXT;
+        SDBlockEncoder encoder;         // binary records waiting to be written as a block
+        unsigned long block_started = 0;    // millis() when the first waiting record was added
+
+        void log_binary(std::string_view time, int offset, std::string_view mqtt_topic, std::string_view mqtt_message);
+        void flush_block();
+
+        bool compress_closed = false;   // queue a text file for compression once the logger moves to another file
+        std::vector<std::string> compress_queue;    // closed files waiting for compress_closed_files()
+        void queue_compression(const std::string& fn);
+        bool file_open(const std::string& fn) const;
+        void switch_file(const std::string& fn);
+        bool write_buffered();
+        void drop_buffered();
+
+        bool rotating = false;          // pick the daily file of each record from its time stamp
+        std::string rotate_prefix;
+        std::string rotate_filetype;
+        std::string rotate_header;      // header line written to new daily files, empty for none
+        size_t rotate_handles = SDLOGGER_ROTATION_HANDLES;
+        int64_t current_day = INT64_MIN;    // midnight of the current daily file
+        int64_t newest_day = INT64_MIN;     // latest day logged to
+        char day_prefix[16];            // `M-D-YYYY` of the current day
+        size_t day_prefix_len = 0;
+        std::vector<SDOpenLog> parked;  // other open daily files, most recently used first
+
+        bool route(std::string_view time, int offset);
+        void rotate_to(int64_t day);
+        int format_day(int64_t day, char* date, size_t size);
+        void park();
+        void unpark(size_t slot);
+        void evict(size_t slot);
+        void close_parked();
+        void commit_parked(SDOpenLog& slot);
+
+        bool torn_text_tail(File& f, uint32_t size, uint32_t& valid);
+        bool torn_binary_tail(File& f, const std::string& fn, uint32_t size, uint32_t end, uint32_t& valid);
+        uint32_t binary_end(File& f, const std::string& fn, uint32_t size);
+        bool quarantine(File& f, const std::string& fn, uint32_t from, uint32_t to);
 
 
     public:
@@ -43,7 +198,7 @@ class SDLogger {
         /**
          * @brief Default constructor that performs no initialization.
          */
-        SDLogger(){};
+        SDLogger(){this->line_buffer.reserve(SDLOGGER_LINE_RESERVE);};
 
         /**
          * @brief Constructor to set the file name
@@ -55,9 +210,27 @@ class SDLogger {
          */
         SDLogger(std::string prefix, int month, int day, int year, std::string filetype);
 
+        /**
+         * @brief Writes buffered lines and closes the open log files, the card stays initialized.
+         */
+        ~SDLogger();
+
+        SDLogger(const SDLogger&) = delete;
+        SDLogger& operator=(const SDLogger&) = delete;
+
         // must be called before logging
         bool initialize_sd_card();
 
+        /**
+         * @brief Log to `storage` instead of the SD card and initialize it.
+         */
+        bool set_storage(SDStorage& storage);
+
+        /**
+         * @brief Storage the log files are kept on.
+         */
+        SDStorage& get_storage(){return *this->sd;}
+
         /**
          * @brief Set the filename to write to the easiest way possible
          */
@@ -79,25 +252,185 @@ class SDLogger {
          * @brief Append a line to the target csv file containing 
          *  an absolute time stamp, mqtt topic, and an mqtt message
          */
-        void log_absolute_mqtt(std::string time, std::string mqtt_topic, std::string mqtt_message);
+        void log_absolute_mqtt(std::string_view time, std::string_view mqtt_topic, std::string_view mqtt_message);
 
         /**
          * @brief Append a line with a relative time stamp to the 
          *  target file
          */
-        void log_relative_mqtt(std::string time, int offset, std::string mqtt_topic, std::string mqtt_message);
+        void log_relative_mqtt(std::string_view time, int offset, std::string_view mqtt_topic, std::string_view mqtt_message);
+
+        /**
+         * @brief Append a line already formatted as `TIME;TOPIC;MESSAGE;` and index it
+         */
+        void log_line(std::string_view line);
 
         /**
          * @brief Write a line to the file, will overwrite the 
          *  contents of the file
          */
-        void write_line(std::string line);
+        void write_line(std::string_view line);
 
         /**
          * @brief Open file and append a line, add newline
          *  if needed
          */
-        void append_line(std::string line);
+        void append_line(std::string_view line);
+
+        /**
+         * @brief Format an integer into `buf` without allocating.
+         */
+        static size_t format_int(char* buf, long value);
+
+        /**
+         * @brief Separator written between CSV fields.
+         */
+        const std::string& get_separator(){return this->separator;}
+
+        /**
+         * @brief Keep the file open and collect appended lines in a sector aligned
+         *  buffer which is written when full, too old, or flushed.
+         */
+        void enable_buffered_writes(size_t buffer_size = SDLOGGER_DEFAULT_BUFFER_SIZE, 
+                unsigned long max_age_ms = SDLOGGER_DEFAULT_FLUSH_AGE);
+
+        /**
+         * @brief Flush buffered data, close the file and return to open/close per line.
+         */
+        void disable_buffered_writes();
+
+        /**
+         * @brief Buffered writes are enabled.
+         */
+        bool is_buffered(){return this->buffered;}
+
+        /**
+         * @brief Write any buffered lines to the card.
+         */
+        bool flush();
+
+        /**
+         * @brief Commit buffered lines if the durability policy requires it, call
+         *  periodically when logging infrequently.
+         */
+        void flush_if_stale();
+
+        /**
+         * @brief Select when buffered records are committed, enabling buffered writes.
+         */
+        void set_durability(SDDurability mode, uint32_t every = 0);
+
+        /**
+         * @brief When buffered records are committed.
+         */
+        SDDurability get_durability(){return this->durability;}
+
+        /**
+         * @brief Defer commits until `end_group()`, so a batch of records shares one.
+         */
+        void begin_group(){this->grouping = true;}
+
+        /**
+         * @brief Commit the records logged since `begin_group()` if the policy requires it.
+         */
+        void end_group();
+
+        /**
+         * @brief Append a checksum to each text line so torn lines are detected exactly.
+         */
+        void enable_line_checksums(){this->checksums = true;}
+
+        /**
+         * @brief Write lines without checksums.
+         */
+        void disable_line_checksums(){this->checksums = false;}
+
+        /**
+         * @brief Move a torn record at the end of log file `fn` to `<fn>.torn` and cut the file after the last whole record.
+         */
+        bool recover_file(const std::string& fn, SDRecoveryReport* report = NULL);
+
+        /**
+         * @brief Recover the logger's current file, call at startup before logging.
+         */
+        bool recover(SDRecoveryReport* report = NULL){return this->recover_file(this->filename, report);}
+
+        /**
+         * @brief Reserve `bytes` for each new log file so appends inside it do not allocate clusters.
+         */
+        void enable_preallocation(uint32_t bytes = SDLOGGER_DEFAULT_PREALLOCATION);
+
+        /**
+         * @brief Create new log files empty.
+         */
+        void disable_preallocation(){this->preallocation = 0;}
+
+        /**
+         * @brief Create and preallocate log file `fn` ahead of its first record, off the log path.
+         */
+        bool prepare_file(const std::string& fn){return this->prepare_file(fn, "");}
+
+        /**
+         * @brief Create and preallocate the daily file of `epoch` of a rotating logger,
+         *  with its header, ahead of its first record.
+         */
+        bool prepare_day(int64_t epoch);
+
+        /**
+         * @brief Maintain a sparse time index next to the log file for fast range queries.
+         */
+        void enable_index(uint32_t every_lines = SDLOGGER_INDEX_STRIDE, uint32_t every_seconds = 0);
+
+        /**
+         * @brief Stop adding entries to the time index.
+         */
+        void disable_index(){this->indexing = false;}
+
+        /**
+         * @brief Replace topics with IDs from a per-file topic dictionary to shrink files.
+         */
+        void enable_topic_dictionary();
+
+        /**
+         * @brief Write topics in full again.
+         */
+        void disable_topic_dictionary();
+
+        /**
+         * @brief Select the format records are written in, files must not mix formats.
+         */
+        void set_format(SDLogFormat format);
+
+        /**
+         * @brief Format records are written in.
+         */
+        SDLogFormat get_format(){return this->format;}
+
+        /**
+         * @brief Queue each text log file for compression into a `.sdz` file when the logger 
+         *  moves to the next file, see `compress_closed_files()`.
+         */
+        void enable_compression(){this->compress_closed = true;}
+
+        /**
+         * @brief Stop queueing closed files for compression, files already queued stay queued.
+         */
+        void disable_compression(){this->compress_closed = false;}
+
+        /**
+         * @brief Compress up to `max_files` queued closed files, returns the number compressed.
+         */
+        size_t compress_closed_files(size_t max_files = SIZE_MAX);
+
+        /**
+         * @brief Number of closed files waiting for `compress_closed_files()`.
+         */
+        size_t pending_compression() const {return this->compress_queue.size();}
+
+        /**
+         * @brief Compress closed log file `fn` into `<fn>.sdz` and remove it.
+         */
+        bool compress_file(const std::string& fn);
 
         /**
          * @brief _Not implemented_
@@ -113,15 +446,37 @@ class SDLogger {
         /**
          * @brief File with name `fn` exists in SD card's filesystem.
          */
-        bool exists(std::string fn){return this->sd.exists(fn.c_str());}
+        bool exists(std::string fn){return this->sd->exists(fn.c_str());}
 
         /**
          * @brief File with name stored in `this->filename` exists in SD card's filesystem.
          */
-        bool exists(){return this->sd.exists(this->filename.c_str());}
+        bool exists(){return this->sd->exists(this->filename.c_str());}
+
+        /**
+         * @brief Route each record to `<prefix>_M-D-YYYY<filetype>` by its own time stamp,
+         *  writing `header` to new files and keeping up to `handles` files open.
+         */
+        void enable_rotation(std::string prefix, std::string filetype = ".csv",
+                std::vector<std::string> header = {}, size_t handles = SDLOGGER_ROTATION_HANDLES);
+
+        /**
+         * @brief Close the other daily files and log to the current file only.
+         */
+        void disable_rotation();
+
+        /**
+         * @brief Records are routed to daily files by their time stamps.
+         */
+        bool is_rotating(){return this->rotating;}
+
+        /**
+         * @brief Name of the file records are currently written to.
+         */
+        const std::string& get_filename(){return this->filename;}
 
         /**
-         * @brief Close card connection.
+         * @brief Flush buffered data and close card connection.
          */
         void close_card();
 
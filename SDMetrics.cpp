@@ -0,0 +1,134 @@
+/**
+ * @file SDMetrics.cpp
+ */
+#include "SDMetrics.hpp"
+
+#include <cstdio>
+
+#if SDLOGGER_METRICS
+SDMetrics sd_metrics;
+#endif
+
+static const char* COUNTER_NAMES[SD_COUNTER_COUNT] = {
+    "bytes_written",
+    "lines_written",
+    "short_writes",
+    "bytes_dropped",
+    "file_opens",
+    "file_closes",
+    "lines_scanned",
+    "lines_matched",
+    "lines_rejected",
+    "pages_published",
+    "pages_failed",
+    "page_bytes",
+};
+
+static const char* HISTOGRAM_NAMES[SD_HISTOGRAM_COUNT] = {
+    "write_us",
+    "flush_us",
+    "publish_us",
+};
+
+#if SDLOGGER_METRICS
+/**
+ * Reads a metric, zeroing it if `reset`.
+ */
+static uint32_t take(std::atomic<uint32_t>& value, bool reset){
+    return reset ? value.exchange(0, std::memory_order_relaxed) : value.load(std::memory_order_relaxed);
+}
+#endif
+
+/**
+ * Copies every counter and histogram. Each value is read atomically, but the snapshot as
+ * a whole is not, an operation recorded while it is taken may be counted in some of its
+ * metrics and not yet in others. With metrics compiled out only the heap and uptime are
+ * filled in.
+ *
+ * @param[out] snapshot The copy.
+ * @param[in] reset `true` to zero each metric as it is read.
+ */
+void sd_metrics_snapshot(SDMetricsSnapshot& snapshot, bool reset){
+    snapshot = SDMetricsSnapshot();
+    snapshot.uptime_ms = millis();
+    snapshot.heap_free = ESP.getFreeHeap();
+    snapshot.heap_min_free = ESP.getMinFreeHeap();
+
+#if SDLOGGER_METRICS
+    for(int c = 0; c < SD_COUNTER_COUNT; c++)
+        snapshot.counters[c] = take(sd_metrics.counters[c], reset);
+
+    for(int h = 0; h < SD_HISTOGRAM_COUNT; h++){
+        auto& hist = sd_metrics.histograms[h];
+        SDHistogramData& data = snapshot.histograms[h];
+
+        data.count = take(hist.count, reset);
+        data.sum_us = take(hist.sum_us, reset);
+        data.max_us = take(hist.max_us, reset);
+        for(int b = 0; b < SDMETRICS_BUCKETS; b++) data.buckets[b] = take(hist.buckets[b], reset);
+    }
+#endif
+}
+
+void sd_metrics_reset(){
+    SDMetricsSnapshot discard;
+    sd_metrics_snapshot(discard, true);
+}
+
+/**
+ * Formats the snapshot as one JSON object, counters by name followed by one object per
+ * histogram:
+ *
+ * ```
+ * {"uptime_ms":81234,"heap_free":151040,"heap_min_free":120332,"bytes_written":52480,...,
+ *  "write_us":{"count":353,"sum":41230,"max":2210,"buckets":[0,12,301,...]},...}
+ * ```
+ *
+ * Bucket `i > 0` counts operations of `[2^(i+3), 2^(i+4))` us, see `sd_metrics_bucket()`.
+ *
+ * @param[in] snapshot The metrics to format.
+ * @param[out] out Receives the JSON, replacing its contents.
+ */
+void sd_metrics_json(const SDMetricsSnapshot& snapshot, std::string& out){
+    char num[16];
+
+    out.assign("{\"uptime_ms\":");
+    out.append(num, snprintf(num, sizeof(num), "%lu", (unsigned long)snapshot.uptime_ms));
+    out.append(",\"heap_free\":");
+    out.append(num, snprintf(num, sizeof(num), "%lu", (unsigned long)snapshot.heap_free));
+    out.append(",\"heap_min_free\":");
+    out.append(num, snprintf(num, sizeof(num), "%lu", (unsigned long)snapshot.heap_min_free));
+
+    for(int c = 0; c < SD_COUNTER_COUNT; c++){
+        out.append(",\"").append(COUNTER_NAMES[c]).append("\":");
+        out.append(num, snprintf(num, sizeof(num), "%lu", (unsigned long)snapshot.counters[c]));
+    }
+
+    for(int h = 0; h < SD_HISTOGRAM_COUNT; h++){
+        const SDHistogramData& data = snapshot.histograms[h];
+
+        out.append(",\"").append(HISTOGRAM_NAMES[h]).append("\":{\"count\":");
+        out.append(num, snprintf(num, sizeof(num), "%lu", (unsigned long)data.count));
+        out.append(",\"sum\":");
+        out.append(num, snprintf(num, sizeof(num), "%lu", (unsigned long)data.sum_us));
+        out.append(",\"max\":");
+        out.append(num, snprintf(num, sizeof(num), "%lu", (unsigned long)data.max_us));
+        out.append(",\"buckets\":[");
+        for(int b = 0; b < SDMETRICS_BUCKETS; b++){
+            if(b > 0) out.push_back(',');
+            out.append(num, snprintf(num, sizeof(num), "%lu", (unsigned long)data.buckets[b]));
+        }
+        out.append("]}");
+    }
+
+    out.push_back('}');
+}
+
+void sd_metrics_print(){
+    SDMetricsSnapshot snapshot;
+    std::string json;
+
+    sd_metrics_snapshot(snapshot);
+    sd_metrics_json(snapshot, json);
+    Serial.println(json.c_str());
+}
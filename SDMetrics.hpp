@@ -0,0 +1,151 @@
+/**
+ * @file SDMetrics.hpp
+ * @brief Process wide counters and latency histograms of the logger and reader, recorded
+ *  with relaxed atomic adds and read through snapshots.
+ *
+ * Build with `SDLOGGER_METRICS=0` to compile the recording out, the `SD_METRIC_*` macros
+ * then expand to nothing and their arguments are not evaluated.
+ */
+#ifndef SDMETRICS_HPP
+#define SDMETRICS_HPP
+
+#include <Arduino.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#ifndef SDLOGGER_METRICS
+#define SDLOGGER_METRICS 1
+#endif
+
+#define SDMETRICS_BUCKETS 16        // latency buckets, see `sd_metrics_bucket()`
+#define SDMETRICS_FIRST_BUCKET_US 16    // upper bound of the first bucket
+
+/**
+ * @brief Counted events, each a 32 bit count which wraps.
+ */
+enum SDCounter {
+    SD_BYTES_WRITTEN,       // bytes written to log files
+    SD_LINES_WRITTEN,       // lines and binary records logged
+    SD_SHORT_WRITES,        // writes to log files which wrote fewer bytes than asked
+    SD_BYTES_DROPPED,       // bytes given up after short writes
+    SD_FILE_OPENS,          // log files opened by loggers and readers
+    SD_FILE_CLOSES,         // log files closed by loggers and readers
+    SD_LINES_SCANNED,       // lines and binary records examined by queries
+    SD_LINES_MATCHED,       // of those, the ones in the query's range and topics
+    SD_LINES_REJECTED,      // of those, torn or corrupt text lines which were skipped
+    SD_PAGES_PUBLISHED,     // pages delivered to a page sink
+    SD_PAGES_FAILED,        // pages a sink failed to deliver
+    SD_PAGE_BYTES,          // bytes of the delivered pages
+    SD_COUNTER_COUNT
+};
+
+/**
+ * @brief Timed operations, each a histogram of microseconds.
+ */
+enum SDHistogram {
+    SD_WRITE_LATENCY,       // one write call to a log file
+    SD_FLUSH_LATENCY,       // a flush, or the close ending an unbuffered append
+    SD_PUBLISH_LATENCY,     // one page handed to a page sink
+    SD_HISTOGRAM_COUNT
+};
+
+/**
+ * @brief Histogram of one timed operation in a snapshot.
+ */
+struct SDHistogramData {
+    uint32_t count;
+    uint32_t sum_us;
+    uint32_t max_us;
+    uint32_t buckets[SDMETRICS_BUCKETS];
+};
+
+/**
+ * @brief Copy of all metrics, plus the heap state when it was taken.
+ */
+struct SDMetricsSnapshot {
+    uint32_t uptime_ms;
+    uint32_t heap_free;         // free heap bytes, `0` on host
+    uint32_t heap_min_free;     // lowest free heap since boot, `0` on host
+    uint32_t counters[SD_COUNTER_COUNT];
+    SDHistogramData histograms[SD_HISTOGRAM_COUNT];
+};
+
+/**
+ * @brief The live metrics, use the `SD_METRIC_*` macros to record.
+ */
+struct SDMetrics {
+    std::atomic<uint32_t> counters[SD_COUNTER_COUNT];
+    struct {
+        std::atomic<uint32_t> count;
+        std::atomic<uint32_t> sum_us;
+        std::atomic<uint32_t> max_us;
+        std::atomic<uint32_t> buckets[SDMETRICS_BUCKETS];
+    } histograms[SD_HISTOGRAM_COUNT];
+};
+
+extern SDMetrics sd_metrics;
+
+/**
+ * @brief Bucket of a latency, bucket `i > 0` holds `[2^(i+3), 2^(i+4))` us and the last
+ *  bucket everything above.
+ */
+inline unsigned sd_metrics_bucket(uint32_t us){
+    if(us < SDMETRICS_FIRST_BUCKET_US) return 0;
+    unsigned b = 31 - __builtin_clz(us) - 3;
+    return (b < SDMETRICS_BUCKETS) ? b : SDMETRICS_BUCKETS - 1;
+}
+
+/**
+ * @brief Add `n` to counter `c`.
+ */
+inline void sd_metrics_add(SDCounter c, uint32_t n){
+    sd_metrics.counters[c].fetch_add(n, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Record one operation of `us` microseconds in histogram `h`.
+ */
+inline void sd_metrics_time(SDHistogram h, uint32_t us){
+    auto& hist = sd_metrics.histograms[h];
+
+    hist.count.fetch_add(1, std::memory_order_relaxed);
+    hist.sum_us.fetch_add(us, std::memory_order_relaxed);
+    hist.buckets[sd_metrics_bucket(us)].fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t max = hist.max_us.load(std::memory_order_relaxed);
+    while(us > max && !hist.max_us.compare_exchange_weak(max, us, std::memory_order_relaxed)){}
+}
+
+/**
+ * @brief Copy the metrics into `snapshot`, zeroing them if `reset` so the next snapshot
+ *  covers only the interval since this one.
+ */
+void sd_metrics_snapshot(SDMetricsSnapshot& snapshot, bool reset = false);
+
+/**
+ * @brief Zero all metrics.
+ */
+void sd_metrics_reset();
+
+/**
+ * @brief Write `snapshot` as a JSON object to `out`.
+ */
+void sd_metrics_json(const SDMetricsSnapshot& snapshot, std::string& out);
+
+/**
+ * @brief Print a snapshot of the metrics as JSON to the serial console.
+ */
+void sd_metrics_print();
+
+#if SDLOGGER_METRICS
+#define SD_METRIC_ADD(counter, n) sd_metrics_add(counter, n)
+#define SD_METRIC_START(name) const uint32_t name = micros()
+#define SD_METRIC_TIME(histogram, start) sd_metrics_time(histogram, (uint32_t)micros() - start)
+#else
+#define SD_METRIC_ADD(counter, n) ((void)0)
+#define SD_METRIC_START(name) ((void)0)
+#define SD_METRIC_TIME(histogram, start) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,176 @@
+/**
+ * @file SDPageBuilder.cpp
+ */
+#include "SDPageBuilder.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#define PAGE_NUMBER_CHARS 20    // characters of the longest int64_t
+
+static const char PAGE_HEAD[] = "{\"file name\":\"";
+static const char PAGE_DATA[] = "\",\"data\":[";
+static const char PAGE_EPOCH[] = "],\"epoch\":";
+static const char PAGE_TERMINUS[] = ",\"terminus\":";
+static const char PAGE_SEQ[] = ",\"seq\":";
+
+/**
+ * Characters of `value` in decimal.
+ */
+static size_t number_chars(int64_t value){
+    size_t n = (value < 0) ? 2 : 1;
+    uint64_t v = (value < 0) ? 0 - (uint64_t)value : (uint64_t)value;
+
+    while(v >= 10){
+        v /= 10;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Bytes `finish()` appends after the last entry for page `seq` spanning `first` to `last`.
+ */
+static size_t close_size(int64_t first, int64_t last, uint32_t seq){
+    return sizeof(PAGE_EPOCH) - 1 + number_chars(first) + sizeof(PAGE_TERMINUS) - 1 + number_chars(last) +
+        sizeof(PAGE_SEQ) - 1 + number_chars(seq) + 1;
+}
+
+/**
+ * Counts the bytes of `text` after escaping, see `append_escaped()`.
+ */
+size_t SDPageBuilder::escaped_size(std::string_view text){
+    size_t size = text.size();
+
+    for(unsigned char c : text){
+        if(c == '"' || c == '\\' || c == '\n' || c == '\r' || c == '\t') size += 1;
+        else if(c < 0x20) size += 5;
+    }
+
+    return size;
+}
+
+/**
+ * Appends `text` as the contents of a JSON string. Quotes, backslashes and control
+ * characters are escaped, other bytes, including UTF-8 sequences, are copied as is.
+ */
+void SDPageBuilder::append_escaped(std::string& out, std::string_view text){
+    size_t run = 0;     // start of the pending run of bytes which need no escaping
+
+    for(size_t i = 0; i < text.size(); i++){
+        unsigned char c = text[i];
+        if(c >= 0x20 && c != '"' && c != '\\') continue;
+
+        out.append(text.data() + run, i - run);
+        run = i + 1;
+
+        switch(c){
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            default:{
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                out.append(esc, 6);
+            }
+        }
+    }
+
+    out.append(text.data() + run, text.size() - run);
+}
+
+/**
+ * Starts a new page, keeping the buffer's capacity.
+ *
+ * @param[in] filename The file the page's entries are read from.
+ * @param[in] seq The page's sequence number.
+ */
+void SDPageBuilder::begin(std::string_view filename, uint32_t seq){
+    if(this->filename != filename) this->filename.assign(filename.data(), filename.size());
+
+    this->buffer.clear();
+    this->buffer.reserve(this->budget);
+    this->seq = seq;
+    this->entries = 0;
+    this->first_epoch = 0;
+    this->last_epoch = 0;
+    this->finished = false;
+
+    this->buffer.append(PAGE_HEAD);
+    append_escaped(this->buffer, this->filename);
+    this->buffer.append(PAGE_DATA);
+}
+
+/**
+ * Escapes `entry` into the page if the page, once closed, stays within the budget.
+ *
+ * @param[in] entry The log line to add.
+ * @param[in] epoch The entry's time stamp.
+ *
+ * @returns `false` if the entry does not fit, the page is unchanged.
+ */
+bool SDPageBuilder::add(std::string_view entry, int64_t epoch){
+    return this->place(entry, escaped_size(entry), epoch, false);
+}
+
+/**
+ * Copies an entry escaped beforehand with `append_escaped()` into the page if the page,
+ * once closed, stays within the budget. Lets the escaping run on other threads than the
+ * one building the pages.
+ *
+ * @param[in] entry The escaped log line to add.
+ * @param[in] epoch The entry's time stamp.
+ *
+ * @returns `false` if the entry does not fit, the page is unchanged.
+ */
+bool SDPageBuilder::add_escaped(std::string_view entry, int64_t epoch){
+    return this->place(entry, entry.size(), epoch, true);
+}
+
+/**
+ * Adds an entry taking `size` bytes once escaped, copied as is if it is `escaped`.
+ */
+bool SDPageBuilder::place(std::string_view entry, size_t size, int64_t epoch, bool escaped){
+    if(this->buffer.empty() || this->finished) this->begin(this->filename, this->seq);
+
+    size_t need = (this->entries > 0 ? 1 : 0) + 2 + size;
+    size_t close = close_size(this->entries > 0 ? this->first_epoch : epoch, epoch, this->seq);
+    if(this->buffer.size() + need + close > this->budget) return false;
+
+    if(this->entries > 0) this->buffer.push_back(',');
+    this->buffer.push_back('"');
+    if(escaped) this->buffer.append(entry);
+    else append_escaped(this->buffer, entry);
+    this->buffer.push_back('"');
+
+    if(this->entries == 0) this->first_epoch = epoch;
+    this->last_epoch = epoch;
+    this->entries++;
+    return true;
+}
+
+/**
+ * Closes the data array and writes the page's time range and sequence number.
+ *
+ * @returns The page, valid until the next `begin()` or `add()`.
+ */
+const std::string& SDPageBuilder::finish(){
+    if(this->buffer.empty()) this->begin(this->filename, this->seq);
+
+    if(!this->finished){
+        char num[PAGE_NUMBER_CHARS + 1];
+
+        this->buffer.append(PAGE_EPOCH);
+        this->buffer.append(num, snprintf(num, sizeof(num), "%lld", (long long)this->first_epoch));
+        this->buffer.append(PAGE_TERMINUS);
+        this->buffer.append(num, snprintf(num, sizeof(num), "%lld", (long long)this->last_epoch));
+        this->buffer.append(PAGE_SEQ);
+        this->buffer.append(num, snprintf(num, sizeof(num), "%lu", (unsigned long)this->seq));
+        this->buffer.push_back('}');
+        this->finished = true;
+    }
+
+    return this->buffer;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file SDPageBuilder.hpp
+ * @brief Builds the JSON pages published by SDReader directly into one reusable buffer.
+ */
+#ifndef SDPAGEBUILDER_HPP
+#define SDPAGEBUILDER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#define SDREADER_MQTT_BUFFER 34464      // MQTT client buffer, holds the packet header, topic and page
+#define SDREADER_MQTT_OVERHEAD 7        // fixed header and topic length bytes of a publish packet
+
+/**
+ * @brief Serializes log entries into a JSON page of at most `budget` bytes.
+ *
+ * A page has the form
+ *
+ * ```
+ * {"file name":"/log_5-24-2023.csv","data":["<entry>","<entry>"],"epoch":1684948257,"terminus":1684948317,"seq":12}
+ * ```
+ *
+ * where `epoch` and `terminus` are the time stamps of the first and last entry and `seq`
+ * numbers the pages of an export, so a receiver can drop pages repeated by a resumed
+ * export. Entries
+ * are JSON escaped as they are copied in, and `add()` refuses an entry once it would push
+ * the finished page past the budget, so a page is closed as full as possible and never
+ * over the limit. The buffer is the page's only storage: `begin()` empties it in constant
+ * time and reserves the budget, so once the first page is built the following pages are
+ * built without allocating.
+ */
+class SDPageBuilder {
+
+    private:
+
+        std::string buffer;
+        std::string filename;
+        size_t budget;
+        uint32_t seq = 0;
+        size_t entries = 0;
+        int64_t first_epoch = 0;
+        int64_t last_epoch = 0;
+        bool finished = false;
+
+        bool place(std::string_view entry, size_t size, int64_t epoch, bool escaped);
+
+    public:
+
+        /**
+         * @brief A builder for pages of at most `budget` bytes.
+         */
+        SDPageBuilder(size_t budget = SDREADER_MQTT_BUFFER - SDREADER_MQTT_OVERHEAD){this->budget = budget;}
+
+        /**
+         * @brief Set the largest page size in bytes, takes effect at the next `begin()`.
+         */
+        void set_budget(size_t budget){this->budget = budget;}
+
+        /**
+         * @brief Largest page size in bytes.
+         */
+        size_t get_budget() const {return this->budget;}
+
+        /**
+         * @brief Discard the page and start empty page `seq` for entries from `filename`.
+         */
+        void begin(std::string_view filename, uint32_t seq = 0);
+
+        /**
+         * @brief Add an entry with time stamp `epoch`, `false` if it does not fit in the page.
+         */
+        bool add(std::string_view entry, int64_t epoch);
+
+        /**
+         * @brief Add an entry already escaped by `append_escaped()`, `false` if it does not fit.
+         */
+        bool add_escaped(std::string_view entry, int64_t epoch);
+
+        /**
+         * @brief Close the page and return its JSON, valid until the next `begin()`.
+         */
+        const std::string& finish();
+
+        /**
+         * @brief Entries in the page.
+         */
+        size_t count() const {return this->entries;}
+
+        /**
+         * @brief Sequence number of the page.
+         */
+        uint32_t sequence() const {return this->seq;}
+
+        /**
+         * @brief The page holds no entries.
+         */
+        bool empty() const {return this->entries == 0;}
+
+        /**
+         * @brief Bytes `text` takes once JSON escaped.
+         */
+        static size_t escaped_size(std::string_view text);
+
+        /**
+         * @brief Append `text` to `out` JSON escaped, as `add()` copies entries into the page.
+         */
+        static void append_escaped(std::string& out, std::string_view text);
+
+};
+
+#endif
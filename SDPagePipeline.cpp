@@ -0,0 +1,221 @@
+/**
+ * @file SDPagePipeline.cpp
+ */
+#include "SDPagePipeline.hpp"
+
+#include <Arduino.h>
+
+#define PAGE_EMPTY 0        // the buffer holds no submitted page
+#define PAGE_QUEUED 1       // submitted, not yet published
+#define PAGE_DELIVERED 2    // published and accepted by the sink
+#define PAGE_FAILED 3       // the sink failed to publish it
+
+/**
+ * Allocates the page buffers and their queues, the buffers reserve memory when first
+ * used. The sender is not started until `start()` is called.
+ *
+ * @param[in] depth Number of page buffers, raised to two if smaller.
+ */
+SDPagePipeline::SDPagePipeline(size_t depth)
+    : depth(depth < 2 ? 2 : depth),
+      pages(new SDPageBuilder[this->depth]),
+      marks(new SDQueryCursor[this->depth]),
+      states(new uint8_t[this->depth]()),
+      free_pages(this->depth), full_pages(this->depth),
+      running(false), sender_done(true), sent(0), failed(0), send_micros(0)
+{
+}
+
+SDPagePipeline::~SDPagePipeline(){
+    this->stop();
+}
+
+/**
+ * Starts the sender task. Every buffer is returned to the free queue, including any a
+ * reader still held when the pipeline was last stopped.
+ *
+ * @param[in] sink Where the sender publishes pages, must outlive the export.
+ * @param[in] topic Topic passed to the sink with every page.
+ *
+ * @returns `true` if the sender is running.
+ */
+bool SDPagePipeline::start(SDPageSink* sink, const std::string& topic){
+    if(this->running) return true;
+    if(sink == NULL) return false;
+
+    this->sink = sink;
+    this->topic = topic;
+
+    while(this->free_pages.try_pop([](SDPageBuilder*&){}));
+    while(this->full_pages.try_pop([](SDPageBuilder*&){}));
+    for(size_t i = 0; i < this->depth; i++){
+        SDPageBuilder* page = &this->pages[i];
+        this->states[i] = PAGE_EMPTY;
+        this->free_pages.try_push([page](SDPageBuilder*& slot){slot = page;});
+    }
+
+    this->sent = 0;
+    this->failed = 0;
+    this->send_micros = 0;
+    this->wait_micros = 0;
+
+    this->sender_done = false;
+    this->running = true;
+
+#if defined(ESP_PLATFORM)
+    BaseType_t ok = xTaskCreate(SDPagePipeline::sender_entry, "sdread_sender",
+            SDREADER_SENDER_STACK_SIZE, this, SDREADER_SENDER_PRIORITY, &this->sender_task);
+
+    if(ok != pdPASS){
+        Serial.println("[ERROR] failed to create sd page sender task");
+        this->running = false;
+        this->sender_done = true;
+        return false;
+    }
+#else
+    this->sender_thread = std::thread(&SDPagePipeline::sender_loop, this);
+#endif
+
+    return true;
+}
+
+/**
+ * Signals the sender to stop and waits for it to publish every submitted page. A buffer
+ * still held by the reader is not published.
+ */
+void SDPagePipeline::stop(){
+    if(!this->running) return;
+
+    this->running = false;
+
+#if defined(ESP_PLATFORM)
+    while(!this->sender_done) sd_task_sleep(SDREADER_PIPELINE_POLL_MS);
+    this->sender_task = NULL;
+#else
+    if(this->sender_thread.joinable()) this->sender_thread.join();
+#endif
+}
+
+#if defined(ESP_PLATFORM)
+/**
+ * FreeRTOS task entry point, runs the sender loop and deletes the task once stopped.
+ */
+void SDPagePipeline::sender_entry(void* arg){
+    ((SDPagePipeline*)arg)->sender_loop();
+    vTaskDelete(NULL);
+}
+#endif
+
+/**
+ * Body of the sender task. Submitted pages are published in order and their buffers
+ * handed back to the reader. Once stopped, pages already submitted are still published.
+ */
+void SDPagePipeline::sender_loop(){
+    for(;;){
+        SDPageBuilder* page = NULL;
+
+        if(!this->full_pages.try_pop([&page](SDPageBuilder*& slot){page = slot;})){
+            if(!this->running) break;
+            sd_task_sleep(SDREADER_PIPELINE_POLL_MS);
+            continue;
+        }
+
+        uint32_t t0 = micros();
+        bool ok = sd_publish_page(*this->sink, this->topic, page->finish());
+        this->send_micros.fetch_add(micros() - t0, std::memory_order_relaxed);
+
+        if(ok) this->sent.fetch_add(1, std::memory_order_relaxed);
+        else this->failed.fetch_add(1, std::memory_order_relaxed);
+
+        // published by the release of the slot, read by the reader after taking it
+        this->states[page - this->pages.get()] = ok ? PAGE_DELIVERED : PAGE_FAILED;
+        this->free_pages.try_push([page](SDPageBuilder*& slot){slot = page;});
+    }
+
+    this->sender_done = true;
+}
+
+/**
+ * Pops a free buffer and reports the publish result of the page it last carried.
+ *
+ * @returns `false` if no buffer is free.
+ */
+bool SDPagePipeline::take(SDPageBuilder*& page, SDQueryCursor* delivered, bool* failed){
+    if(!this->free_pages.try_pop([&page](SDPageBuilder*& slot){page = slot;})) return false;
+
+    size_t i = page - this->pages.get();
+    if(this->states[i] == PAGE_DELIVERED && delivered != NULL) *delivered = this->marks[i];
+    if(this->states[i] == PAGE_FAILED && failed != NULL) *failed = true;
+    this->states[i] = PAGE_EMPTY;
+
+    return true;
+}
+
+/**
+ * Takes an empty page buffer for the reader to fill. Blocks while every buffer is queued
+ * for or being published by the sender. Buffers are returned in publish order, so the
+ * cursors reported through `delivered` only move forward.
+ *
+ * @param[out] delivered Set to the cursor of the buffer's last page if it was delivered, else unchanged.
+ * @param[out] failed Set to `true` if the buffer's last page failed, else unchanged.
+ *
+ * @returns A page buffer, or `NULL` if the pipeline is not running.
+ */
+SDPageBuilder* SDPagePipeline::acquire(SDQueryCursor* delivered, bool* failed){
+    SDPageBuilder* page = NULL;
+    uint32_t t0 = micros();
+
+    while(!this->take(page, delivered, failed)){
+        if(!this->running) return NULL;
+        sd_task_sleep(0);
+    }
+
+    this->wait_micros += micros() - t0;
+    return page;
+}
+
+/**
+ * Queues a filled page for the sender. The page must have come from `acquire()` and is
+ * not touched by the reader until it is acquired again. Never blocks, there is a slot for
+ * every buffer.
+ *
+ * @param[in] page The page to publish.
+ * @param[in] mark The export's cursor once the page is published.
+ */
+void SDPagePipeline::submit(SDPageBuilder* page, const SDQueryCursor& mark){
+    size_t i = page - this->pages.get();
+    this->marks[i] = mark;
+    this->states[i] = PAGE_QUEUED;
+
+    page->finish();
+    this->full_pages.try_push([page](SDPageBuilder*& slot){slot = page;});
+}
+
+/**
+ * Collects the buffers the reader did not take back before the pipeline stopped, in the
+ * order their pages were published.
+ *
+ * @param[out] delivered Set to the cursor of the last page delivered before any failure.
+ * @param[out] failed Set to `true` if one of the pages failed, else unchanged.
+ *
+ * @returns `true` if `delivered` was set.
+ */
+bool SDPagePipeline::drain(SDQueryCursor& delivered, bool& failed){
+    if(this->running) return false;
+
+    SDPageBuilder* page;
+    bool found = false;
+    bool page_failed = false;
+    SDQueryCursor mark;
+
+    while(this->take(page, &mark, &page_failed)){
+        if(!page_failed && !mark.file.empty()){
+            delivered = mark;
+            found = true;
+        }
+        mark.file.clear();
+    }
+
+    if(page_failed) failed = true;
+    return found;
+}
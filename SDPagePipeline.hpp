@@ -0,0 +1,140 @@
+/**
+ * @file SDPagePipeline.hpp
+ * @brief Double buffered page export, pages are published by a sender task while the
+ *  reader fills the next one.
+ */
+#ifndef SDPAGEPIPELINE_HPP
+#define SDPAGEPIPELINE_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "SDPageBuilder.hpp"
+#include "SDPageSink.hpp"
+#include "SDQueryCursor.hpp"
+#include "SDRecordQueue.hpp"
+#include "SDTask.hpp"
+
+#define SDREADER_PIPELINE_DEPTH 2           // page buffers shared by the reader and sender
+#define SDREADER_PIPELINE_POLL_MS 1         // sleep of a task waiting on the other
+#define SDREADER_SENDER_STACK_SIZE 8192     // sender task stack (FreeRTOS only)
+#define SDREADER_SENDER_PRIORITY 1          // sender task priority (FreeRTOS only)
+
+/**
+ * @brief Hands finished pages from the reading task to a sender task through two bounded
+ *  queues.
+ *
+ * The pipeline owns `depth` page buffers. The reader `acquire()`s an empty buffer, fills
+ * it and `submit()`s it, the sender publishes submitted pages to the sink in order and
+ * returns their buffers. With the default depth of two the SD card is read into one page
+ * while the other is on the network, and the reader only waits when it fills a page
+ * before the previous one is sent. Buffers keep their capacity between pages.
+ *
+ * Each page is submitted with the cursor of its last entry. Buffers come back to the
+ * reader in the order their pages were published, and `acquire()` reports whether the
+ * sink accepted a buffer's page along with its cursor, so the reader alone tracks and
+ * saves the export's position.
+ */
+class SDPagePipeline {
+
+    private:
+
+        SDPageSink* sink = NULL;
+        std::string topic;
+
+        size_t depth;
+        std::unique_ptr<SDPageBuilder[]> pages;
+        std::unique_ptr<SDQueryCursor[]> marks;     // cursor after each buffer's page, reader only
+        std::unique_ptr<uint8_t[]> states;          // publish result of each buffer's page
+        SDRecordQueue<SDPageBuilder*> free_pages;   // empty buffers for the reader
+        SDRecordQueue<SDPageBuilder*> full_pages;   // finished pages for the sender
+
+        std::atomic<bool> running;
+        std::atomic<bool> sender_done;
+        std::atomic<uint32_t> sent;
+        std::atomic<uint32_t> failed;
+        std::atomic<uint32_t> send_micros;  // time the sender spent publishing
+        uint32_t wait_micros = 0;           // time the reader spent waiting for a buffer
+
+#if defined(ESP_PLATFORM)
+        TaskHandle_t sender_task = NULL;
+        static void sender_entry(void* arg);
+#else
+        std::thread sender_thread;
+#endif
+
+        void sender_loop();
+        bool take(SDPageBuilder*& page, SDQueryCursor* delivered, bool* failed);
+
+    public:
+
+        /**
+         * @brief A pipeline of `depth` page buffers, at least two.
+         */
+        explicit SDPagePipeline(size_t depth = SDREADER_PIPELINE_DEPTH);
+
+        /**
+         * @brief Stops the sender, publishing any submitted pages.
+         */
+        ~SDPagePipeline();
+
+        SDPagePipeline(const SDPagePipeline&) = delete;
+        SDPagePipeline& operator=(const SDPagePipeline&) = delete;
+
+        /**
+         * @brief Start a sender publishing pages to `sink` on `topic`, all buffers become free.
+         */
+        bool start(SDPageSink* sink, const std::string& topic);
+
+        /**
+         * @brief Wait until every submitted page is published and stop the sender.
+         */
+        void stop();
+
+        /**
+         * @brief The sender is running.
+         */
+        bool is_running() const {return this->running.load();}
+
+        /**
+         * @brief Take an empty buffer, waiting for the sender if none is free. If the buffer's
+         *  last page was delivered its cursor is copied to `delivered`, if it failed `failed` is set.
+         */
+        SDPageBuilder* acquire(SDQueryCursor* delivered = NULL, bool* failed = NULL);
+
+        /**
+         * @brief Queue a finished page from `acquire()` for the sender, `mark` is the
+         *  cursor after its last entry.
+         */
+        void submit(SDPageBuilder* page, const SDQueryCursor& mark);
+
+        /**
+         * @brief After `stop()`, report the pages not yet reported by `acquire()`: the cursor
+         *  of the last one delivered before any failure, and whether one failed.
+         */
+        bool drain(SDQueryCursor& delivered, bool& failed);
+
+        /**
+         * @brief Pages published since the last `start()`.
+         */
+        uint32_t pages_sent() const {return this->sent.load(std::memory_order_relaxed);}
+
+        /**
+         * @brief Pages the sink failed to deliver since the last `start()`.
+         */
+        uint32_t pages_failed() const {return this->failed.load(std::memory_order_relaxed);}
+
+        /**
+         * @brief Microseconds the sender spent publishing since the last `start()`.
+         */
+        uint32_t sender_busy_micros() const {return this->send_micros.load(std::memory_order_relaxed);}
+
+        /**
+         * @brief Microseconds the reader waited for a free buffer since the last `start()`.
+         */
+        uint32_t reader_wait_micros() const {return this->wait_micros;}
+
+};
+
+#endif
@@ -0,0 +1,77 @@
+/**
+ * @file SDPageSink.cpp
+ */
+#include "SDPageSink.hpp"
+#include "SDMetrics.hpp"
+
+#include "MQTTMailer.hpp"
+
+#if !defined(ESP_PLATFORM)
+#include <chrono>
+#include <thread>
+#endif
+
+extern PubSubClient mqtt_client;
+
+/**
+ * @param[in] sink Destination of the page.
+ * @param[in] topic MQTT topic of the page.
+ * @param[in] page The page's JSON.
+ *
+ * @returns The result of `sink.publish()`.
+ */
+bool sd_publish_page(SDPageSink& sink, const std::string& topic, const std::string& page){
+    SD_METRIC_START(t_publish);
+    bool ok = sink.publish(topic, page);
+    SD_METRIC_TIME(SD_PUBLISH_LATENCY, t_publish);
+
+    if(ok){
+        SD_METRIC_ADD(SD_PAGES_PUBLISHED, 1);
+        SD_METRIC_ADD(SD_PAGE_BYTES, page.size());
+    }else{
+        SD_METRIC_ADD(SD_PAGES_FAILED, 1);
+    }
+    return ok;
+}
+
+/**
+ * Publishes the page on the global `mqtt_client`, not retained. The client is used
+ * directly rather than through the MQTT mailer so that a dropped connection or a page
+ * the client refuses is reported, which keeps the query cursor on the failed page.
+ *
+ * @param[in] topic MQTT topic of the page.
+ * @param[in] page The page's JSON.
+ *
+ * @returns `true` if the client was connected and accepted the page.
+ */
+bool SDMqttSink::publish(const std::string& topic, const std::string& page){
+    if(this->client_lock != NULL) this->client_lock->lock();
+
+    bool ok = mqtt_client.connected() &&
+            mqtt_client.publish(topic.c_str(), (const uint8_t*)page.data(), page.size(), false);
+
+    if(this->client_lock != NULL) this->client_lock->unlock();
+    return ok;
+}
+
+#if !defined(ESP_PLATFORM)
+/**
+ * Blocks the calling thread for the simulated transmission time of the page and counts it.
+ *
+ * @param[in] topic MQTT topic of the page, ignored.
+ * @param[in] page The page's JSON.
+ *
+ * @returns `true`.
+ */
+bool SDLocalSink::publish(const std::string& topic, const std::string& page){
+    (void)topic;
+    uint64_t delay = this->latency_us + (uint64_t)this->us_per_kb * page.size() / 1024;
+    if(delay > 0) std::this_thread::sleep_for(std::chrono::microseconds(delay));
+
+    this->page_count++;
+    this->byte_count += page.size();
+    if(this->keep) this->kept.push_back(page);
+
+    return true;
+}
+#endif
@@ -0,0 +1,122 @@
+/**
+ * @file SDPageSink.hpp
+ * @brief Destinations for the JSON pages SDReader exports.
+ */
+#ifndef SDPAGESINK_HPP
+#define SDPAGESINK_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SDTask.hpp"
+
+/**
+ * @brief Receives finished pages, see `SDReader::set_page_sink()`.
+ *
+ * `publish()` is called from the task exporting the pages, which is the sender task when
+ * the reader is pipelined, one page at a time.
+ */
+class SDPageSink {
+
+    public:
+
+        virtual ~SDPageSink(){}
+
+        /**
+         * @brief Deliver `page` on `topic`, `false` if it could not be delivered.
+         */
+        virtual bool publish(const std::string& topic, const std::string& page) = 0;
+
+};
+
+/**
+ * @brief Publish `page` through `sink`, counting and timing it in the metrics.
+ */
+bool sd_publish_page(SDPageSink& sink, const std::string& topic, const std::string& page);
+
+/**
+ * @brief Publishes pages to the MQTT broker through the global `mqtt_client`, a page
+ *  fails if the client is not connected or does not accept it.
+ *
+ * `PubSubClient` is not thread safe. A sink publishing from the sender task of a pipelined
+ * reader needs a lock which the application also holds around its own use of the client,
+ * ex `mqtt_client.loop()`, see `set_lock()`.
+ */
+class SDMqttSink : public SDPageSink {
+
+    private:
+
+        SDMutex* client_lock = NULL;
+
+    public:
+
+        bool publish(const std::string& topic, const std::string& page) override;
+
+        /**
+         * @brief Hold `lock` while publishing, `NULL` publishes without locking.
+         */
+        void set_lock(SDMutex* lock){this->client_lock = lock;}
+
+        /**
+         * @brief `true` if publishing is guarded by a lock.
+         */
+        bool has_lock() const {return this->client_lock != NULL;}
+
+};
+
+#if !defined(ESP_PLATFORM)
+/**
+ * @brief Host stand in for the broker which takes `latency_us` plus `us_per_kb` for every
+ *  KB of a page to "send" it, so export time can be measured without a network.
+ */
+class SDLocalSink : public SDPageSink {
+
+    private:
+
+        uint32_t latency_us;
+        uint32_t us_per_kb;
+        bool keep;
+
+        uint32_t page_count = 0;
+        uint64_t byte_count = 0;
+        std::vector<std::string> kept;
+
+    public:
+
+        /**
+         * @brief A sink taking `latency_us + us_per_kb * KB` per page, keeping the pages if `keep_pages`.
+         */
+        SDLocalSink(uint32_t latency_us = 0, uint32_t us_per_kb = 0, bool keep_pages = false)
+            : latency_us(latency_us), us_per_kb(us_per_kb), keep(keep_pages) {}
+
+        bool publish(const std::string& topic, const std::string& page) override;
+
+        /**
+         * @brief Pages received.
+         */
+        uint32_t pages() const {return this->page_count;}
+
+        /**
+         * @brief Bytes received.
+         */
+        uint64_t bytes() const {return this->byte_count;}
+
+        /**
+         * @brief Pages received, in order, if the sink keeps them.
+         */
+        const std::vector<std::string>& received() const {return this->kept;}
+
+        /**
+         * @brief Forget the received pages and counts.
+         */
+        void clear(){
+            this->page_count = 0;
+            this->byte_count = 0;
+            this->kept.clear();
+        }
+
+};
+#endif
+
+#endif
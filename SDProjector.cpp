@@ -0,0 +1,102 @@
+/**
+ * @file SDProjector.cpp
+ */
+#include "SDProjector.hpp"
+#include "SDJson.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+void SDProjector::set_fields(const std::vector<std::string>& fields){
+    this->fields.clear();
+    this->keys.clear();
+
+    for(const std::string& f : fields){
+        if(this->fields.size() == SDREADER_PROJECT_MAX_FIELDS) break;
+        this->fields.push_back(f);
+    }
+    for(const std::string& f : this->fields) this->keys.emplace_back(f);
+}
+
+/**
+ * @param[in] topic The message's topic.
+ * @param[in] message The logged JSON message.
+ * @param[in] epoch The message's time stamp.
+ * @param[out] out Replaced by the row.
+ *
+ * @returns `false` if the message holds none of the fields, `out` is then unspecified.
+ */
+bool SDProjector::project(std::string_view topic, std::string_view message, int64_t epoch, std::string& out) const {
+    std::string_view values[SDREADER_PROJECT_MAX_FIELDS];
+    if(sd_json_fields(message, this->keys.data(), this->keys.size(), values) == 0) return false;
+
+    char num[24];
+    out.clear();
+    out.append(num, snprintf(num, sizeof(num), "%lld", (long long)epoch));
+    out += ',';
+    out.append(topic);
+
+    for(size_t f = 0; f < this->keys.size(); f++){
+        if(values[f].empty()) continue;
+        out += ',';
+        out.append(this->keys[f]);
+        out += '=';
+        out.append(values[f]);
+    }
+
+    return true;
+}
+
+/**
+ * Splits a log line into topic and message, see `project()`.
+ *
+ * @param[in] line A `TIME;TOPIC;MESSAGE;` line.
+ * @param[in] epoch The line's time stamp.
+ * @param[out] out Replaced by the row.
+ *
+ * @returns `false` if the line is malformed or holds none of the fields.
+ */
+bool SDProjector::project_line(std::string_view line, int64_t epoch, std::string& out) const {
+    size_t first_sc = line.find(this->separator);
+    if(first_sc == std::string_view::npos) return false;
+    size_t second_sc = line.find(this->separator, first_sc + 1);
+    if(second_sc == std::string_view::npos) return false;
+
+    std::string_view topic = line.substr(first_sc + 1, second_sc - first_sc - 1);
+    return this->project(topic, line.substr(second_sc + this->separator.size()), epoch, out);
+}
+
+/**
+ * @param[in] topic_id ID of the message's topic, for example from its file's topic dictionary.
+ * @param[in] message The logged JSON message.
+ * @param[in] epoch The message's time stamp.
+ * @param[out] out At least `SDREADER_TUPLE_MAX` bytes.
+ *
+ * @returns The tuple's size, or `0` if no field is present and numeric.
+ */
+size_t SDProjector::project_binary(uint16_t topic_id, std::string_view message, int64_t epoch, uint8_t* out) const {
+    std::string_view values[SDREADER_PROJECT_MAX_FIELDS];
+    if(sd_json_fields(message, this->keys.data(), this->keys.size(), values) == 0) return 0;
+
+    uint32_t ts = (uint32_t)epoch;
+    out[0] = ts; out[1] = ts >> 8; out[2] = ts >> 16; out[3] = ts >> 24;
+    out[4] = topic_id; out[5] = topic_id >> 8;
+
+    uint8_t mask = 0;
+    size_t n = 7;
+    for(size_t f = 0; f < this->keys.size(); f++){
+        double number;
+        if(!sd_json_number(values[f], number)) continue;
+
+        float value = (float)number;
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        out[n] = bits; out[n + 1] = bits >> 8; out[n + 2] = bits >> 16; out[n + 3] = bits >> 24;
+
+        mask |= 1 << f;
+        n += 4;
+    }
+    out[6] = mask;
+
+    return (mask != 0) ? n : 0;
+}
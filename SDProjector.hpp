@@ -0,0 +1,82 @@
+/**
+ * @file SDProjector.hpp
+ * @brief Projects logged messages onto a few named JSON fields, as compact text rows or
+ *  binary tuples.
+ */
+#ifndef SDPROJECTOR_HPP
+#define SDPROJECTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define SDREADER_PROJECT_MAX_FIELDS 8   // fields one projection can extract
+#define SDREADER_TUPLE_MAX (4 + 2 + 1 + 4 * SDREADER_PROJECT_MAX_FIELDS)   // largest binary tuple
+
+/**
+ * @brief Extracts named top level fields from a message's flat JSON in a single pass.
+ *
+ * A text row is
+ *
+ * ```
+ * 1684948257,kkm_k6p/bc:57:29:00:f6:d3,HUMIDITY=40.167999,TEMP=21.136999
+ * ```
+ *
+ * holding the epoch, the topic and every field present in the message with its raw JSON
+ * value, in the order the fields were given. A binary tuple is
+ *
+ * | bytes | field |
+ * |---|---|
+ * | 4 | epoch |
+ * | 2 | topic ID |
+ * | 1 | bit `i` set if field `i` is present and numeric |
+ * | 4 each | the present fields as 32 bit floats |
+ *
+ * in little endian. Missing fields are left out of both, a message holding none of the
+ * fields gives no row. Projecting never allocates beyond the output string's capacity.
+ */
+class SDProjector {
+
+    private:
+
+        std::vector<std::string> fields;
+        std::vector<std::string_view> keys;     // views of `fields` for the scanner
+        std::string separator = ";";
+
+    public:
+
+        /**
+         * @brief Project onto `fields`, at most `SDREADER_PROJECT_MAX_FIELDS`, an empty list disables projection.
+         */
+        void set_fields(const std::vector<std::string>& fields);
+
+        /**
+         * @brief Set the separator of the log lines given to `project_line()`.
+         */
+        void set_separator(const std::string& separator){this->separator = separator;}
+
+        /**
+         * @brief Fields are set.
+         */
+        bool active() const {return !this->fields.empty();}
+
+        /**
+         * @brief Write the text row of `message` to `out`, `false` if it has none of the fields.
+         */
+        bool project(std::string_view topic, std::string_view message, int64_t epoch, std::string& out) const;
+
+        /**
+         * @brief Write the text row of a `TIME;TOPIC;MESSAGE;` line with time stamp `epoch` to `out`.
+         */
+        bool project_line(std::string_view line, int64_t epoch, std::string& out) const;
+
+        /**
+         * @brief Write the binary tuple of `message` to `out`, returns its size or `0` if it has no numeric field.
+         */
+        size_t project_binary(uint16_t topic_id, std::string_view message, int64_t epoch, uint8_t* out) const;
+
+};
+
+#endif
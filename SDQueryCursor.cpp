@@ -0,0 +1,149 @@
+/**
+ * @file SDQueryCursor.cpp
+ */
+#include "SDQueryCursor.hpp"
+#include "SDBinaryFormat.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+#define CURSOR_TMP_EXT ".tmp"
+#define CURSOR_FIELDS 9
+
+static uint32_t crc_of(const std::string& s, uint32_t crc = 0){
+    return sd_crc32((const uint8_t*)s.data(), s.size(), crc);
+}
+
+/**
+ * @param[in] epoch The beginning of the query's time range.
+ * @param[in] terminus The end of the query's time range.
+ * @param[in] topic_filter The query's topic patterns.
+ * @param[in] prefix The prefix of the files queried.
+ * @param[in] filetype The extension of the files queried.
+ *
+ * @returns A CRC-32 over the query's parameters.
+ */
+uint32_t SDQueryCursor::query_id(int64_t epoch, int64_t terminus, const std::vector<std::string>& topic_filter,
+        const std::string& prefix, const std::string& filetype){
+
+    uint32_t crc = crc_of(std::to_string(epoch) + ";" + std::to_string(terminus) + ";" + prefix + ";" + filetype);
+    for(const std::string& pattern : topic_filter) crc = crc_of(";" + pattern, crc);
+
+    return crc;
+}
+
+void SDQueryCursor::reset(uint32_t query){
+    this->query = query;
+    this->file.clear();
+    this->offset = 0;
+    this->skip = 0;
+    this->last_epoch = 0;
+    this->at_epoch = 0;
+    this->seq = 0;
+}
+
+/**
+ * Reads and checks one cursor line.
+ *
+ * @returns `true` if `fn` holds a cursor whose CRC matches.
+ */
+static bool read_cursor(SDStorage& sd, const std::string& fn, SDQueryCursor& cursor){
+    if(!sd.exists(fn.c_str())) return false;
+
+    File f = sd.open(fn.c_str(), "r");
+    if(!f) return false;
+
+    std::string line(f.size(), '\0');
+    line.resize(f.read((uint8_t*)&line[0], line.size()));
+    f.close();
+
+    while(!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+
+    // the crc follows the last separator, the file name may contain separators itself
+    size_t crc_sep = line.rfind(';');
+    if(crc_sep == std::string::npos) return false;
+    if(strtoul(line.c_str() + crc_sep + 1, NULL, 16) != crc_of(line.substr(0, crc_sep))) return false;
+
+    std::vector<std::string> fields;
+    size_t pos = 0;
+    while(fields.size() < CURSOR_FIELDS - 2){
+        size_t sep = line.find(';', pos);
+        if(sep == std::string::npos || sep > crc_sep) return false;
+        fields.push_back(line.substr(pos, sep - pos));
+        pos = sep + 1;
+    }
+    if(fields[0] != SDREADER_CURSOR_MAGIC) return false;
+
+    cursor.query = strtoul(fields[1].c_str(), NULL, 10);
+    cursor.seq = strtoul(fields[2].c_str(), NULL, 10);
+    cursor.offset = strtoul(fields[3].c_str(), NULL, 10);
+    cursor.skip = strtoul(fields[4].c_str(), NULL, 10);
+    cursor.last_epoch = strtoll(fields[5].c_str(), NULL, 10);
+    cursor.at_epoch = strtoul(fields[6].c_str(), NULL, 10);
+    cursor.file = line.substr(pos, crc_sep - pos);
+    return true;
+}
+
+/**
+ * Loads the cursor saved in `fn`, or in its temporary file if a save was interrupted
+ * between removing the old cursor and renaming the new one.
+ *
+ * @param[in] sd The card holding the cursor.
+ * @param[in] fn The cursor file.
+ *
+ * @returns `true` if a valid cursor was loaded, the cursor is unchanged otherwise.
+ */
+bool SDQueryCursor::load(SDStorage& sd, const std::string& fn){
+    SDQueryCursor loaded;
+
+    if(!read_cursor(sd, fn, loaded) && !read_cursor(sd, fn + CURSOR_TMP_EXT, loaded)) return false;
+
+    *this = loaded;
+    return true;
+}
+
+/**
+ * Writes the cursor to a temporary file and renames it over `fn`, so a reset while
+ * saving leaves either the old or the new cursor readable.
+ *
+ * @param[in] sd The card holding the cursor.
+ * @param[in] fn The cursor file.
+ *
+ * @returns `true` if the cursor was saved.
+ */
+bool SDQueryCursor::save(SDStorage& sd, const std::string& fn) const {
+    std::string tmp_fn = fn + CURSOR_TMP_EXT;
+
+    std::string line = std::string(SDREADER_CURSOR_MAGIC) + ";" +
+        std::to_string(this->query) + ";" +
+        std::to_string(this->seq) + ";" +
+        std::to_string(this->offset) + ";" +
+        std::to_string(this->skip) + ";" +
+        std::to_string(this->last_epoch) + ";" +
+        std::to_string(this->at_epoch) + ";" +
+        this->file;
+
+    char crc[12];
+    line.append(crc, snprintf(crc, sizeof(crc), ";%08lx\n", (unsigned long)crc_of(line)));
+
+    File f = sd.open(tmp_fn.c_str(), FILE_WRITE);
+    if(!f){
+        Serial.println("[ERROR] failed to save export cursor");
+        return false;
+    }
+
+    bool ok = f.write((const uint8_t*)line.data(), line.size()) == line.size();
+    f.close();
+    if(!ok){
+        Serial.println("[ERROR] failed to save export cursor");
+        return false;
+    }
+
+    sd.remove(fn.c_str());
+    return sd.rename(tmp_fn.c_str(), fn.c_str());
+}
+
+void SDQueryCursor::remove(SDStorage& sd, const std::string& fn){
+    sd.remove(fn.c_str());
+    sd.remove((fn + CURSOR_TMP_EXT).c_str());
+}
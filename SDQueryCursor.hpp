@@ -0,0 +1,75 @@
+/**
+ * @file SDQueryCursor.hpp
+ * @brief Position of a range export, persisted to the card so an interrupted export can
+ *  resume after its last published page.
+ *
+ * The cursor file holds one line
+ *
+ * ```
+ * SDQC;<query>;<seq>;<offset>;<skip>;<last epoch>;<at epoch>;<file>;<crc>
+ * ```
+ *
+ * where `crc` is the CRC-32, in hex, of everything before it. It is written to
+ * `<cursor file>.tmp` first and renamed over the old cursor, a reader falls back to the
+ * `.tmp` file if the rename was interrupted.
+ */
+#ifndef SDQUERYCURSOR_HPP
+#define SDQUERYCURSOR_HPP
+
+#include <SD.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SDStorage.hpp"
+
+#define SDREADER_CURSOR_FILE "/export.cur"  // default cursor file
+#define SDREADER_CURSOR_MAGIC "SDQC"
+
+/**
+ * @brief Where an export stands after its last published page.
+ *
+ * An export resumes by reading `file` from `offset`, which is the start of a line, binary
+ * block or compressed frame, and skipping the first `skip` entries there that match the
+ * query, as they were published already. The next page is numbered `seq`. If `file` was
+ * replaced, ex compressed, the export resumes at `last_epoch` instead and skips the first
+ * `at_epoch` entries with that time stamp.
+ */
+struct SDQueryCursor {
+    uint32_t query = 0;         // identifies the query, see `query_id()`
+    std::string file;           // file of the last published entry, empty if none was published
+    uint32_t offset = 0;        // line, block or frame holding the last published entry
+    uint32_t skip = 0;          // matching entries at `offset` up to and including it
+    int64_t last_epoch = 0;     // time stamp of the last published entry
+    uint32_t at_epoch = 0;      // entries published in a row with time stamp `last_epoch`
+    uint32_t seq = 0;           // sequence number of the next page
+
+    /**
+     * @brief Identify a query by its time range, topic patterns and file names.
+     */
+    static uint32_t query_id(int64_t epoch, int64_t terminus, const std::vector<std::string>& topic_filter,
+            const std::string& prefix, const std::string& filetype);
+
+    /**
+     * @brief Start `query` from the beginning.
+     */
+    void reset(uint32_t query);
+
+    /**
+     * @brief Load the cursor saved in `fn`, `false` if there is none or it is corrupt.
+     */
+    bool load(SDStorage& sd, const std::string& fn);
+
+    /**
+     * @brief Save the cursor to `fn`, replacing the previous one.
+     */
+    bool save(SDStorage& sd, const std::string& fn) const;
+
+    /**
+     * @brief Delete the cursor saved in `fn`.
+     */
+    static void remove(SDStorage& sd, const std::string& fn);
+
+};
+
+#endif
@@ -2,6 +2,7 @@
  * @file SDReader.cpp
  */
 #include "SDReader.hpp"
+#include "SDScan.hpp"
 
 /**
  * Debug helper function not scoped to SDReader class, prints the current amount of free memory on the heap
@@ -16,151 +17,270 @@ void print_heap_debug(){
 }
 
 /**
- * @brief Check if any of the filters match the target string
- *  return true if one of them does or filter is "", else return false.
- *
- * @param[in] filter
- * @param[in] target
+ * @brief Initialize connection to SD card and return false if no connection established.
  *
- * @returns `true` if match found, `false` otherwise.
+ * @returns A boolean value: `true` if initialization successful, `false` otherwise.
  */
-bool SDReader::topic_filter_match(vector<string> filter, string target){
-    bool check_default = (filter.size() == 1);
-    string def = "";
+bool SDReader::initialize_sd_card(){
 
-    for(string f : filter){
-        if(check_default && f == def){
-            return true;
+    const auto ok = this->sd->begin();
 
-        }else if(f != def && target.find(f) != string::npos){
-            return true;
-        }
+    if(!ok){
+        Serial.println("[ERROR] failed to initialize sd card");
+        return false;
     }
     
-    return false;
+    Serial.println("[DEBUG] success initializing sd card reader");
+    Serial.print("[DEBUG] bytes free =  ");
+    double perc = ESP.getFreeHeap();
+    Serial.println(perc);
+    return true;
 }
 
 /**
- * @brief Compile collected data into a JSON "page"
- *  which can then be published via the MQTT interface.
+ * Moves the reader to another storage backend, for example an `SDMemoryStorage` on host.
+ * The open file is closed and file catalogs are marked stale so the next range query
+ * lists the new storage.
  *
- * @param[in] filename The name of the file this page came from.
- * @param[in] epoch The beginning timestamp of the range this data was collected from.
- * @param[in] terminus The end timestamp of the range this data was collected from.
- * @param[in] data The vector of data entries collected in this page.
+ * @param[in] storage The storage to read from, must outlive the reader.
  *
- * @returns A single JSON object string which contains fields: `file name`, `epoch`, `terminus`, and `data`.
+ * @returns `true` if the storage initialized.
  */
-string SDReader::build_json_page(
-        string filename,
-        long int epoch,
-        long int terminus,
-        vector<string> &data
-        ){
+bool SDReader::set_storage(SDStorage& storage){
+    if(this->file_open) this->close_file();
 
-    string json_data_arr = "[";
-    for(string n : data){
-        json_data_arr += "\"" + n + "\",";
-    }
+    this->sd = &storage;
+    SDFileCatalog::invalidate();
+    return this->initialize_sd_card();
+}
 
-    json_data_arr += "]";
-    
-    return "{ \"file name\":"  + filename + 
-            ", \"epoch\": " + to_string(epoch) + 
-            ", \"terminus\": " + to_string(terminus) +
-            ", \"data\": " + json_data_arr + "}";
+/**
+ * Publishes a snapshot of the logger and reader metrics as one JSON object, see
+ * `sd_metrics_json()`, to `SDREADER_METRICS_TOPIC` followed by the device's MAC address.
+ * Call periodically with `reset` to publish the activity of each interval, the counters
+ * then also cannot wrap between snapshots.
+ *
+ * @param[in] reset `true` to zero the metrics once read.
+ *
+ * @returns `false` if the page sink failed to deliver the snapshot.
+ */
+bool SDReader::publish_metrics(bool reset){
+    SDMetricsSnapshot snapshot;
+    sd_metrics_snapshot(snapshot, reset);
+
+    string json;
+    sd_metrics_json(snapshot, json);
+
+    if(this->device_mac.empty()) this->device_mac = WiFi.macAddress().c_str();
+    return this->sink->publish(SDREADER_METRICS_TOPIC + this->device_mac, json);
 }
 
+/**
+ * Reads the next line through the block buffered line reader. Prefer iterating 
+ * `SDLineReader` directly when the line does not need to outlive the next read,
+ * as this copies the line into a new string.
+ *
+ * @returns The next line from the file as a string, including the newline if one was present.
+ */
+string SDReader::read_line(){
+    if(!this->file_open) return "";
 
+    std::string_view line;
+    if(!this->lines.next(line)) return "";
+
+    string buf(line);
+    if(this->lines.last_terminated()) buf += '\n';
+
+    return buf;
+}
 
 /**
- * @brief Calculate the size, in bytes, of the current page.
+ * Parses the time stamp field at the start of a logged line with the reader's 
+ * `SDTimeParser`.
  *
- * If debugging is enabled over serial port, then the page size is printed to the 
- * serial port.
+ * @param[in] line A line from a log file.
+ * @param[out] epoch The line's epoch.
  *
- * @param[in] page Reference to the "page" of collected results.
+ * @returns `false` if the line has no time stamp (e.g. the header).
+ */
+bool SDReader::line_epoch(std::string_view line, int64_t& epoch){
+    size_t first_sc = line.find(this->separator);
+    if(first_sc == std::string_view::npos) return false;
+
+    return this->time_parser.parse(line.substr(0, first_sc), epoch);
+}
+
+/**
+ * Finds where the data of the newly opened file ends and attaches the line reader to the
+ * file from its start. With `set_mapped()` on the host the file is mapped and lines are
+ * scanned in place, falling back to block reads if the storage cannot map it. The map is
+ * taken after `sd_data_end()`, so it covers all of the data, and lines past
+ * `data_size` are never looked at, the file must not be shortened below that while open.
  *
- * @returns An integer (bytes) representing the size of the page.
+ * @param[in] path Path of the file opened in `fp`.
  */
-int SDReader::calculate_page_size(vector<string> &page){
-    int size = 0;
-    for(string n : page)
-        size += n.size();
+void SDReader::attach_lines(const string& path){
+    this->data_size = this->fp ? sd_data_end(this->fp) : 0;
+    this->fp.seek(0);
 
-    if(USB_DEBUG){
-        Serial.print("[DEBUG] memory usage is ");
-        double perc = ESP.getFreeHeap();
-        Serial.print(perc);
-        Serial.println(" bytes");
-        Serial.print("[DEBUG] page size is ");
-        Serial.print(size);
-        Serial.print(" bytes, and capacity is ");
-        Serial.println(page.capacity());
+#if !defined(ESP_PLATFORM)
+    if(this->mapped && this->fp && this->sd->map(path.c_str(), this->mapping) && this->mapping.size() >= this->data_size){
+        this->lines.attach(this->mapping.data(), this->data_size);
+        return;
     }
+    this->mapping.reset();
+#endif
 
-    if(USB_DEBUG && size > 34464){
-        Serial.println("[WARNING] page size is above MQTT buffer limit of 34464");
+    this->lines.attach(&(this->fp), this->data_size);
+}
+
+/**
+ * Reads the index of the current file into `this->index`, see `sd_load_index()`.
+ *
+ * @param[in] file_size Size of the log file in bytes.
+ *
+ * @returns `true` if a usable index was loaded.
+ */
+bool SDReader::load_index(uint32_t file_size){
+    return sd_load_index(*this->sd, this->filename, file_size, this->index);
+}
+
+/**
+ * Scans the open file from `from` and writes an index entry every `SDLOGGER_INDEX_STRIDE`
+ * lines, using the same layout as SDLogger. Used to build an index for files logged 
+ * without one, or to extend an index whose logger stopped adding entries. A line older
+ * than the newest line before it by more than `SDLOGGER_INDEX_SLACK` ends the index with
+ * a `SDLOGGER_INDEX_UNORDERED` entry, as SDLogger does.
+ *
+ * @param[in] from Offset to start scanning at, the line there is not indexed when appending.
+ * @param[in] append `true` to extend the existing index, `false` to replace it.
+ */
+void SDReader::index_lines(uint32_t from, bool append){
+    string idx_fn = sd_index_filename(this->filename);
+    File idx = this->sd->open(idx_fn.c_str(), append ? FILE_APPEND : FILE_WRITE);
+    if(!idx){
+        Serial.println("[ERROR] failed to write log index");
+        return;
     }
 
-    return size;
+    int64_t newest = 0;
+    for(const SDIndexEntry& e : this->index) if(e.epoch > newest) newest = e.epoch;
+
+    this->lines.seek(from);
+
+    uint32_t count = append ? 0 : SDLOGGER_INDEX_STRIDE - 1;
+    std::string_view line;
+    while(this->lines.next(line)){
+        if(append && this->lines.line_offset() <= from + 1) continue;
+
+        int64_t ts;
+        if(!this->line_epoch(line, ts)) continue;
+
+        bool late = ts + SDLOGGER_INDEX_SLACK < newest;
+        if(ts > newest) newest = ts;
+
+        if(!late && ++count < SDLOGGER_INDEX_STRIDE) continue;
+        count = 0;
+
+        uint32_t offset = this->lines.line_offset();
+        SDIndexEntry entry = {late ? SDLOGGER_INDEX_UNORDERED : (uint32_t)ts, (offset > 0) ? offset - 1 : 0};
+
+        idx.write((const uint8_t*)&entry, sizeof(entry));
+        this->index.push_back(entry);
+        if(late) break;
+    }
+
+    idx.close();
 }
 
 /**
- * @brief Initialize connection to SD card and return false if no connection established.
+ * Makes `this->index` describe the open file. With `set_use_index(true, true)` a missing
+ * or stale index is rebuilt and an index whose last entry lags far behind the end of the
+ * file is extended, otherwise the reader never writes to the card.
  *
- * @returns A boolean value: `true` if initialization successful, `false` otherwise.
+ * @returns `true` if the index can be used to seek in the open file, see `sd_index_ordered()`.
  */
-bool SDReader::initialize_sd_card(){
+bool SDReader::prepare_index(){
+    uint32_t size = this->data_size;
 
-    const auto ok = this->sd.begin(TT_CLK, TT_MISO, TT_MOSI, TT_SS, &SPI);
+    if(!this->load_index(size)){
+        this->index.clear();
+        if(this->build_index) this->index_lines(0, false);
 
-    if(!ok){
-        Serial.println("[ERROR] failed to initialize sd card");
-        return false;
+    }else if(this->build_index && sd_index_ordered(this->index, this->index_slack()) &&
+            size - this->index.back().offset > SDREADER_INDEX_EXTEND_BYTES){
+        this->index_lines(this->index.back().offset, true);
     }
-    
-    Serial.println("[DEBUG] success initializing sd card reader");
-    Serial.print("[DEBUG] bytes free =  ");
-    double perc = ESP.getFreeHeap();
-    Serial.println(perc);
-    return true;
+
+    return sd_index_ordered(this->index, this->index_slack());
 }
 
 /**
- * @returns The next line from the file as a string.
+ * Seconds by which index bounds are widened, the larger of the time ordered slack and the
+ * slack SDLogger allows before it marks an index out of order.
+ *
+ * @returns The slack in seconds.
  */
-string SDReader::read_line(){
-    if(!this->file_open) return "";
-    
-    string buf = "";
+uint32_t SDReader::index_slack(){
+    return (this->order_slack > SDLOGGER_INDEX_SLACK) ? this->order_slack : SDLOGGER_INDEX_SLACK;
+}
+
+/**
+ * Binary searches the open file for the start of the first line with a time stamp at or
+ * after `target`, assuming the file is ordered by time. Each probe seeks to the middle of
+ * the remaining range, discards the partial line it lands in, and reads forward to the 
+ * next time stamped line. The search stops once the range is smaller than a read block.
+ *
+ * @param[in] target The epoch to search for.
+ *
+ * @returns An offset at or before the first line at or after `target`, which is the start of a line.
+ */
+uint32_t SDReader::seek_epoch(int64_t target){
+    uint32_t lo = 0;
+    uint32_t hi = this->data_size;
+    std::string_view line;
+
+    while(hi - lo > SDREADER_BLOCK_SIZE){
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        this->lines.seek(mid);
+        this->lines.next(line);   // resynchronize to the next line start
 
-    while(this->fp.available()){
-        char c = this->fp.read();
-        buf += c;
+        int64_t ts;
+        bool found = false;
+        while(!found && this->lines.next(line))
+            found = this->line_epoch(line, ts);
 
-        if(c == '\n'){
-            break;
+        if(found && ts < target){
+            // out of order data could put the line past hi, never let the range invert
+            lo = (this->lines.line_offset() < hi) ? this->lines.line_offset() : hi;
+        }else{
+            hi = mid;
         }
     }
 
-    return buf;
+    return lo;
 }
 
 /**
- * Collect all log entries within date range included by the topic filter. This 
- * search is conducted on all files in the SD card file system. Once a file is found
- * which meets the criteria of time range, prefix, and filetype, `read_entry_range()`
- * is used to parse the file's entries for ones that match time range and topic filter
- * untill the end of the file has been reached. Entries are uploaded to MQTT broker in pages
- * which are limited in length by `page_length`.
+ * Collect all log entries within date range included by the topic filter. The root 
+ * directory is listed once into a file catalog of `<prefix>_M-D-YYYY.<filetype>` files 
+ * sorted by date, the catalog is reused by later queries until a logger creates a new
+ * file. Only files whose date overlaps the time range are opened, and 
+ * `read_entry_range()` is used to parse each file's entries for ones that match time 
+ * range and topic filter. Entries are uploaded to MQTT broker in pages which are limited
+ * in length by `page_length` and in size by the MQTT buffer, see `read_entry_range()`.
+ * The last page of each file is published even if it is not full.
  *
- * This process is repeated until all files in the file system have been checked.
+ * With `enable_cursor()` the export's position is saved after delivered pages. If the
+ * cursor file holds the position of an interrupted export of the same query, the files
+ * before its file are skipped and reading resumes after the last published entry, with
+ * page numbering continuing from the last delivered page.
  *
  * @param[in] epoch The beginning of the time range to collect data from. 
  * @param[in] terminus The end of the time range to collect data from.
- * @param[in] topic_filter The vector of topics to collect in a page.
- * @param[in] page_length The maximum length of the page to construct.
+ * @param[in] topic_filter The vector of topic patterns to collect in a page, compiled once into an `SDTopicFilter`.
+ * @param[in] page_length The maximum number of entries in a page, `0` to fill pages up to the MQTT buffer size.
  * @param[in] prefix Only collect data from files whose prefix matches, for example only collect from `log` files.
  * @param[in] filetype Match file type, this defaults to `csv`.
  */
@@ -172,32 +292,85 @@ void SDReader::read_entry_range_from_files(TimeStamp epoch,
             string filetype)
 {
 
-    vector<string> data;
-
     if(this->file_open)
         this->close_file();
 
-    int secs_p_day = 86400;
+    int64_t q_epoch = epoch.get_epoch();
+    int64_t q_terminus = terminus.get_epoch();
 
-    long int counter = epoch.get_epoch(); 
-    //ESP_ERROR_CHECK( heap_trace_start(HEAP_TRACE_LEAKS) );
-    for(int i = epoch.get_epoch(); i < terminus.get_epoch(); i += secs_p_day){
-        string mdy = TimeStamp(i).get_mdy(); 
-        string test_fn = "/" + prefix + "_" + mdy + "." + filetype;
+    SDTopicFilter filter(topic_filter);
+    uint32_t query = SDQueryCursor::query_id(q_epoch, q_terminus, topic_filter, prefix, filetype);
 
+    this->begin_export(query, !this->cursor_path.empty(), SDREADER_RANGE_TOPIC);
+    this->scan_files(q_epoch, q_terminus, filter, page_length, prefix, filetype);
+    this->end_export(true);
+}
 
-        this->filename = test_fn;
+/**
+ * Scans the catalog's files overlapping `[q_epoch, q_terminus]` in date order, resuming
+ * at the export cursor's file if it has one, and publishes each file's last page. An
+ * aggregating query emits the buckets which ended before each new day's file.
+ *
+ * @param[in] q_epoch The beginning of the time range.
+ * @param[in] q_terminus The end of the time range.
+ * @param[in] filter The compiled topic filter.
+ * @param[in] page_length The maximum number of results to include in a page.
+ * @param[in] prefix The prefix of the files to scan.
+ * @param[in] filetype The extension of the files to scan.
+ */
+void SDReader::scan_files(int64_t q_epoch, int64_t q_terminus, const SDTopicFilter& filter, int page_length,
+        const string& prefix, const string& filetype){
 
-        if(this->sd.exists(test_fn.c_str())){
-            // open and pull data from file
-            this->open_file(test_fn);
-            //print_heap_debug();
-            this->read_entry_range(this->fp, epoch, terminus, topic_filter, page_length);
-            this->close_file();
+    if(this->catalog.stale("/", prefix, filetype))
+        this->catalog.refresh(*this->sd, "/", prefix, filetype);
 
-        }else{
-            //Serial.println("\tfile doesn't exist");
+    // a resumed export skips the files before the one holding its last published entry
+    bool resuming = !this->cursor.file.empty();
+    if(resuming){
+        bool found = false;
+        for(const SDCatalogEntry& file : this->catalog.files()) found |= (file.path == this->cursor.file);
+
+        if(!found){
+            // the file was replaced, likely compressed, so its offsets are meaningless
+            Serial.println("[WARNING] export cursor file is gone, resuming from its last time stamp");
+            if(this->cursor.last_epoch > q_epoch) q_epoch = this->cursor.last_epoch;
+
+            // q_epoch is inclusive, skip the entries published at the last time stamp
+            this->resume_epoch = this->cursor.last_epoch;
+            this->resume_epoch_skip = this->cursor.at_epoch;
+            resuming = false;
+        }
+    }
+
+    //ESP_ERROR_CHECK( heap_trace_start(HEAP_TRACE_LEAKS) );
+    for(const SDCatalogEntry& file : this->catalog.files()){
+        if(file.day_start + SD_SECS_PER_DAY <= q_epoch) continue;
+        if(file.day_start > q_terminus) break;
+
+        if(resuming){
+            if(file.path != this->cursor.file) continue;
+
+            resuming = false;
+            this->resume_offset = this->cursor.offset;
+            this->resume_skip = this->cursor.skip;
+        }
+
+        if(this->aggregator != NULL){
+            this->emit_buckets(file.day_start, page_length);
+            this->flush_page();
         }
+
+        this->filename = file.path;
+
+        // open and pull data from file
+        this->open_file(file.path);
+        //print_heap_debug();
+        this->scan_range(q_epoch, q_terminus, filter, page_length);
+        this->flush_page();
+        this->close_file();
+
+        this->resume_offset = 0;
+        this->resume_skip = 0;
     }
 
     /*
@@ -206,20 +379,119 @@ void SDReader::read_entry_range_from_files(TimeStamp epoch,
     */
 }
 
+/**
+ * Streams the files overlapping the time range once, like `read_entry_range_from_files()`,
+ * but instead of the matching lines publishes the count, min, max and mean of numeric
+ * message fields per topic and per `bucket_seconds` wide bucket. Each row is published as
+ * a line of the form
+ *
+ * ```
+ * 5-24-2023T17:00:00;meter_teros10/0_shallow/08:3A:F2:31:9B:D0;{"VWC":{"count":60,"min":-2.15,"max":-2.1,"mean":-2.13}};
+ * ```
+ *
+ * where the time is the start of the bucket, in pages on the `datagator/data/aggregate/`
+ * topic. Buckets are aligned to the epoch, so the first and last bucket only cover the
+ * part inside the range. Missing and non-numeric fields are skipped. Finished buckets
+ * are published as soon as the scan reaches the next day's file, so memory is bounded by
+ * the buckets of one day times the topics seen.
+ *
+ * @param[in] epoch The beginning of the time range to aggregate.
+ * @param[in] terminus The end of the time range to aggregate.
+ * @param[in] topic_filter Topic patterns of the lines to aggregate, see `SDTopicFilter`.
+ * @param[in] bucket_seconds Width of a bucket, ex `3600` for hourly statistics.
+ * @param[in] fields Names of the top level numeric JSON fields to aggregate, at most `SDREADER_AGG_MAX_FIELDS`.
+ * @param[in] prefix Only aggregate files whose prefix matches.
+ * @param[in] filetype Match file type, this defaults to `csv`.
+ */
+void SDReader::aggregate_entry_range_from_files(TimeStamp epoch, 
+        TimeStamp terminus, 
+        vector<string> topic_filter, 
+        uint32_t bucket_seconds, 
+        vector<string> fields, 
+        string prefix, 
+        string filetype)
+{
+    if(bucket_seconds == 0 || fields.empty()){
+        Serial.println("[ERROR] aggregation needs a bucket width and at least one field");
+        return;
+    }
+
+    if(this->file_open)
+        this->close_file();
+
+    int64_t q_epoch = epoch.get_epoch();
+    int64_t q_terminus = terminus.get_epoch();
+
+    SDTopicFilter filter(topic_filter);
+    SDAggregator aggregator(bucket_seconds, fields, this->separator);
+    this->aggregator = &aggregator;
+
+    uint32_t query = SDQueryCursor::query_id(q_epoch, q_terminus, topic_filter, prefix, filetype);
+    this->begin_export(query, false, SDREADER_AGGREGATE_TOPIC);
+    this->scan_files(q_epoch, q_terminus, filter, 0, prefix, filetype);
+
+    this->emit_buckets(INT64_MAX, 0);
+    this->flush_page();
+    this->end_export(true);
+
+    this->aggregator = NULL;
+}
+
+/**
+ * Publishes the aggregation buckets ending at or before `before`.
+ *
+ * @param[in] before Buckets ending after this epoch stay open.
+ * @param[in] page_length The maximum number of rows in a page.
+ */
+void SDReader::emit_buckets(int64_t before, int page_length){
+    this->aggregator->emit(before, [this, page_length](int64_t bucket, std::string_view row){
+        this->page_entry(row, bucket, page_length);
+    });
+}
+
 /**
  * Collect all log entries in a file that fall within the time range and match 
- * a topic in topic filter. Collected entries are counted as entries in a "page". Entries are added
- * to the "page" until `page_length` is reached. At this point the entries are uploaded 
- * via MQTT to the broker.
+ * a topic in topic filter. Collected entries are serialized into a JSON "page" (see
+ * `SDPageBuilder`) until `page_length` is reached or the next entry would make the page
+ * larger than the MQTT buffer (`set_mqtt_buffer_size()`). At this point the page is 
+ * uploaded via MQTT to the broker.
  *
  * This process is repeated until the end of the file is reached or the entries no longer
- * fall within the time range.
+ * fall within the time range. Lines are read in blocks through `SDLineReader` and only
+ * copied once they match. With `set_use_index()` and a time index (see 
+ * `SDLogger::enable_index()`) only the indexed blocks overlapping the time range, widened
+ * by the slack, are read. An index marked out of order is not trusted and the file is
+ * scanned whole. Indexes are only written by the reader if asked to build them.
+ *
+ * Without an index, files may be declared time ordered with `set_time_ordered()`. The
+ * start of the range is then found by binary search and the scan stops at the first line
+ * past `terminus`, both widened by the configured slack.
+ *
+ * Files logged with topic encoding (see `SDLogger::enable_topic_dictionary()`) have their
+ * dictionary matched against the filter once, lines are then matched by ID and published
+ * with the topic written out. Files whose dictionary holds no wanted topic are skipped.
  *
- * @param[in] f File object to read from.
+ * Files written in binary format (see `SDLogger::set_format()`) are detected by their
+ * first block header and decoded block by block, matching records are published as
+ * `TIME;TOPIC;MESSAGE;` lines like those of text files.
+ *
+ * Compressed day files (see `SDLogger::enable_compression()`) are decompressed frame by
+ * frame, frames outside the time range are skipped using the time range in their header.
+ *
+ * Files preallocated by SDLogger (see `SDLogger::enable_preallocation()`) are read up to
+ * the end of their data, the zeros reserved after it are never scanned.
+ *
+ * With `set_projection()` only the named fields of each matching entry's message are
+ * published, as `epoch,topic,field=value` rows, see `SDProjector`.
+ *
+ * With `set_pipelined()` pages are published by a sender task, so the card is read into
+ * one page while the previous page is on the network.
+ *
+ * @param[in] f Unused, the file opened with `open_file()` is read.
  * @param[in] epoch The beginning of the time range to collect entries from.
  * @param[in] terminus The end of the time range to collect entries from.
- * @param[in] topic_filter A vector list of topic strings, which if matching, should be collected.
- * @param[in] page_length The maximum number of results to include in this page.
+ * @param[in] topic_filter A vector list of topic patterns, which if matching, should be collected. See `SDTopicFilter` for the pattern syntax.
+ * @param[in] page_length The maximum number of results to include in this page, `0` for no limit besides the page size.
  */
 void SDReader::read_entry_range(
         File f, 
@@ -228,50 +500,584 @@ void SDReader::read_entry_range(
         vector<string> topic_filter,
         int page_length)
 {
+    (void)f;
+    SDTopicFilter filter(topic_filter);
 
-    // clear log buffer
-    vector<string> data = {};
-    MQTTMailer mqtt_inst = MQTTMailer::getInstance();
+    uint32_t query = SDQueryCursor::query_id(epoch.get_epoch(), terminus.get_epoch(), topic_filter, this->filename, "");
 
-    while(this->fp.available() ){
-        //Serial.println("\tmemory usage at top of loop");
-        //print_heap_debug();
+    this->begin_export(query, false, SDREADER_RANGE_TOPIC);
+    this->scan_range(epoch.get_epoch(), terminus.get_epoch(), filter, page_length);
+    this->flush_page();
+    this->end_export(true);
+}
 
-        if(data.size() < page_length){
-            string line = this->read_line();
-            if(line.find(":") == string::npos) continue;
-
-            // get line timestamp
-            int first_sc = line.find(this->separator);  // first semicolon in line
-            int second_sc = line.find(this->separator, first_sc + 1); // second semicolon in line
-            string l_ts = line.substr(0, first_sc);     // line timestamp
-            string l_topic = line.substr(first_sc + 1, second_sc - first_sc); // line topic
-                                                                              //
-            // convert to TimeStamp and check if in range
-            TimeStamp ts(l_ts);
-
-            if(ts >= epoch && ts <= terminus){
-                // in legal time range
-                if(this->topic_filter_match(topic_filter, l_topic)){
-                    // add line to vector (matches topic filter)
-                    data.push_back(line);
-                }
+/**
+ * Scans the open file for entries in `[q_epoch, q_terminus]` whose topic matches `filter`
+ * and publishes them in pages, see `read_entry_range()`.
+ *
+ * @param[in] q_epoch The beginning of the time range.
+ * @param[in] q_terminus The end of the time range.
+ * @param[in] filter The compiled topic filter.
+ * @param[in] page_length The maximum number of results to include in a page.
+ */
+void SDReader::scan_range(int64_t q_epoch, int64_t q_terminus, const SDTopicFilter& filter, int page_length){
+
+    std::string_view line;
+    this->begin_page();
+
+    int64_t slack = this->time_ordered ? this->order_slack : 0;
+
+    uint32_t start = 0;
+    uint32_t stop = UINT32_MAX;
+
+    // resolve the filter against the file's topic dictionary once, if no topic in the
+    // dictionary is wanted only the lines written before encoding started can match
+    int wanted = this->resolve_topics(filter);
+
+    if(this->compressed_file()){
+        this->scan_frames(q_epoch, q_terminus, filter, page_length);
+        return;
+    }
+
+    if(this->binary_file()){
+        if(wanted > 0) this->scan_blocks(q_epoch, q_terminus, page_length);
+        return;
+    }
+
+    // lines between the start and end of encoding hold only dictionary topics
+    bool skip_encoded = (wanted == 0);
+    uint32_t encoded_end = 0;
+    if(skip_encoded){
+        if(this->dictionary.end_offset() == UINT32_MAX) stop = this->dictionary.start_offset();
+        else encoded_end = this->dictionary.end_offset();
+    }
+
+    // seek to the last indexed line a slack before epoch, stop at the first indexed line a slack after terminus
+    if(skip_encoded){
+        // only the lines with topics written as is are left to scan
+
+    }else if(this->use_index && this->prepare_index()){
+        int64_t widen = this->index_slack();
+
+        for(const SDIndexEntry& e : this->index){
+            if((int64_t)e.epoch < q_epoch - widen){
+                start = e.offset;
+
+            }else if((int64_t)e.epoch > q_terminus + widen){
+                stop = e.offset;
+                break;
             }
+        }
 
-        }else{
-            // publish page
-            // send contents of vector to receiver... then proceed
-            TimeStamp epoch(data[0].substr(0, data[0].find(this->separator)));
-            TimeStamp terminus(data.back().substr(0, data.back().find(this->separator)));
-            string json_page = this->build_json_page(this->filename, epoch.get_epoch(), terminus.get_epoch(), data);
-
-            mqtt_inst.mailMessage(&mqtt_client, string("datagator/data/time_range/") + WiFi.macAddress().c_str(), json_page, false);
-
-            // clear log buffer
-            //this->calculate_page_size(data);
-            data.clear();           // remove objects from vector (size to 0)
-            data.shrink_to_fit();   // shrink memory allocation(capacity) to size of vector
+    }else if(this->time_ordered){
+        start = this->seek_epoch(q_epoch - slack);
+    }
+    if(this->resume_offset > start) start = this->resume_offset;
+    this->lines.seek(start);
+
+    while(this->lines.next(line)){
+        if(this->lines.line_offset() >= stop) break;
+
+        if(this->lines.line_offset() >= this->dictionary.start_offset() && this->lines.line_offset() < encoded_end){
+            this->lines.seek(encoded_end);
+            continue;
+        }
+
+        this->unit_offset = this->lines.line_offset();
+        this->unit_matches = 0;
+        if(!this->collect_line(line, q_epoch, q_terminus, filter, page_length)) break;
+    }
+}
+
+/**
+ * Checks one text line against the query, adding it to the page if its time stamp is in
+ * range and its topic matches, and publishes the page once it is full. Lines which are
+ * not terminated or fail their checksum (see SDRecovery.hpp) are skipped.
+ *
+ * @param[in] line The line, without its newline.
+ * @param[in] q_epoch The beginning of the time range.
+ * @param[in] q_terminus The end of the time range.
+ * @param[in] filter The compiled topic filter.
+ * @param[in] page_length The maximum number of results to include in a page.
+ *
+ * @returns `false` if the file is time ordered and the line is past the end of the range.
+ */
+bool SDReader::collect_line(std::string_view line, int64_t q_epoch, int64_t q_terminus, 
+        const SDTopicFilter& filter, int page_length){
+
+    SD_METRIC_ADD(SD_LINES_SCANNED, 1);
+
+    // skip lines torn by a power loss, strips the checksum of whole ones
+    if(!sd_check_line(line, this->separator)){
+        SD_METRIC_ADD(SD_LINES_REJECTED, 1);
+        return true;
+    }
+
+    // get line timestamp, first and second semicolons in line
+    size_t first_sc, second_sc;
+    if(!sd_scan_separators(line, this->separator[0], first_sc, second_sc)) return true;
+
+    std::string_view l_topic = line.substr(first_sc + 1, second_sc - first_sc - 1); // line topic
+
+    // parse the time stamp (skips the header) and check if in range
+    int64_t ts;
+    if(!this->time_parser.parse(line.substr(0, first_sc), ts)) return true;
+
+    // time ordered files cannot contain more matches once past terminus
+    if(this->time_ordered && ts > q_terminus + this->order_slack) return false;
+
+    if(ts >= q_epoch && ts <= q_terminus){
+        // in legal time range
+        uint16_t id;
+        if(SDTopicDictionary::parse_ref(l_topic, id)){
+            if(id < this->wanted_ids.size() && this->wanted_ids[id]){
+                // add line to the page with the topic expanded
+                string& entry = this->entry_buffer;
+                entry.assign(line.data(), first_sc + 1);
+                entry += this->dictionary.topic(id);
+                entry.append(line.substr(second_sc));
+                this->add_entry(entry, ts, page_length);
+            }
+
+        }else if(SDTopicDictionary::escaped(l_topic)){
+            if(filter.match(l_topic.substr(1))){
+                // add line to the page with the doubled `@` of the topic dropped
+                string& entry = this->entry_buffer;
+                entry.assign(line.data(), first_sc + 1);
+                entry.append(line.substr(first_sc + 2));
+                this->add_entry(entry, ts, page_length);
+            }
+
+        }else if(filter.match(l_topic)){
+            // add line to the page (matches topic filter)
+            this->add_entry(line, ts, page_length);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @returns `true` if the open file starts with a compressed frame header.
+ */
+bool SDReader::compressed_file(){
+    uint8_t head[SDLOGGER_FRAME_HEADER];
+    SDFrameHeader header;
+
+    this->fp.seek(0);
+    size_t n = this->fp.read(head, SDLOGGER_FRAME_HEADER);
+
+    return sd_parse_frame_header(head, n, header);
+}
+
+/**
+ * Scans a compressed log file (see `SDLogger::compress_file()`) one frame at a time. 
+ * Frames whose time range does not overlap the query are skipped without being read, in
+ * time ordered mode the scan stops at the first frame starting past `q_terminus`. The
+ * lines of the remaining frames are matched like those of text files. At most one 
+ * stored and one decompressed frame are held in memory. A frame which fails to 
+ * decompress or fails its CRC is reported and skipped by searching for the next frame
+ * header.
+ *
+ * @param[in] q_epoch The beginning of the time range.
+ * @param[in] q_terminus The end of the time range.
+ * @param[in] filter The compiled topic filter.
+ * @param[in] page_length The maximum number of results to include in a page.
+ */
+void SDReader::scan_frames(int64_t q_epoch, int64_t q_terminus, const SDTopicFilter& filter, int page_length){
+    int64_t slack = this->time_ordered ? this->order_slack : 0;
+    uint32_t size = this->fp.size();
+    uint32_t pos = this->resume_offset;
+
+    uint8_t head[SDLOGGER_FRAME_HEADER];
+    SDFrameHeader header;
+
+    while(pos < size){
+        this->fp.seek(pos);
+        size_t n = this->fp.read(head, SDLOGGER_FRAME_HEADER);
+
+        if(!sd_parse_frame_header(head, n, header)){
+            if(n < SDLOGGER_FRAME_HEADER) break;
+            pos++;      // resynchronize on the next frame header
+            continue;
+        }
+
+        // time ordered files cannot contain more matches once past terminus
+        if(this->time_ordered && (int64_t)header.min_epoch > q_terminus + slack) break;
+
+        // skip frames entirely outside the range, frames without time stamps have min > max
+        if((int64_t)header.max_epoch < q_epoch || (int64_t)header.min_epoch > q_terminus){
+            pos += SDLOGGER_FRAME_HEADER + header.stored_len;
+            continue;
+        }
+
+        this->block_buffer.resize(header.stored_len);
+        bool ok = this->fp.read(this->block_buffer.data(), header.stored_len) == header.stored_len;
+
+        const uint8_t* raw = this->block_buffer.data();
+        if(ok && header.stored_len < header.raw_len){
+            this->frame_buffer.resize(header.raw_len);
+            ok = SDLzCodec::decompress(this->block_buffer.data(), header.stored_len, 
+                    this->frame_buffer.data(), header.raw_len) == header.raw_len;
+            raw = this->frame_buffer.data();
+        }
+
+        if(!ok || sd_crc32(raw, header.raw_len) != header.crc){
+            Serial.println("[ERROR] corrupt frame in compressed log, skipping");
+            pos++;
+            continue;
+        }
+        this->unit_offset = pos;
+        this->unit_matches = 0;
+        pos += SDLOGGER_FRAME_HEADER + header.stored_len;
+
+        std::string_view text((const char*)raw, header.raw_len);
+        size_t line_start = 0;
+        while(line_start < text.size()){
+            size_t line_end = text.find('\n', line_start);
+            if(line_end == std::string_view::npos) line_end = text.size();
+
+            std::string_view line = text.substr(line_start, line_end - line_start);
+            line_start = line_end + 1;
+
+            if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if(!this->collect_line(line, q_epoch, q_terminus, filter, page_length)) return;
+        }
+    }
+}
+
+/**
+ * Loads the open file's topic dictionary and marks the IDs whose topic matches `filter`
+ * in `wanted_ids`.
+ *
+ * @param[in] filter The compiled topic filter.
+ *
+ * @returns The number of wanted IDs, or `-1` if the file has no dictionary.
+ */
+int SDReader::resolve_topics(const SDTopicFilter& filter){
+    this->wanted_ids.clear();
+    if(!this->dictionary.load(*this->sd, sd_uncompressed_name(this->filename))) return -1;
+
+    int wanted = 0;
+    this->wanted_ids.resize(this->dictionary.size());
+
+    for(size_t id = 0; id < this->dictionary.size(); id++){
+        this->wanted_ids[id] = filter.match(this->dictionary.topic(id));
+        if(this->wanted_ids[id]) wanted++;
+    }
+
+    return wanted;
+}
+
+/**
+ * @returns `true` if the open file starts with a binary block header.
+ */
+bool SDReader::binary_file(){
+    uint8_t head[SDLOGGER_BLOCK_HEADER];
+    SDBlockHeader header;
+
+    this->fp.seek(0);
+    size_t n = this->fp.read(head, SDLOGGER_BLOCK_HEADER);
+
+    return SDBlockDecoder::parse_header(head, n, header);
+}
+
+/**
+ * Scans a binary log file for records in `[q_epoch, q_terminus]` with a wanted topic ID 
+ * and publishes them in pages. Only one block is held in memory at a time. The file's
+ * index, if any, is used to skip blocks outside the time range, in time ordered mode the
+ * scan stops at the first block starting past `q_terminus`. A block failing its CRC is
+ * reported and skipped by searching for the next block header, which stops where the
+ * preallocated zeros of the file begin.
+ *
+ * @param[in] q_epoch The beginning of the time range.
+ * @param[in] q_terminus The end of the time range.
+ * @param[in] page_length The maximum number of results to include in a page.
+ */
+void SDReader::scan_blocks(int64_t q_epoch, int64_t q_terminus, int page_length){
+    int64_t slack = this->time_ordered ? this->order_slack : 0;
+    uint32_t size = this->data_size;    // every block header starts before the preallocated zeros
+    uint32_t pos = 0;
+    uint32_t stop = size;
+
+    // binary indexes are written by SDLogger only, never rebuilt here
+    if(this->use_index && this->load_index(size) && sd_index_ordered(this->index, this->index_slack())){
+        int64_t widen = this->index_slack();
+
+        for(const SDIndexEntry& e : this->index){
+            if((int64_t)e.epoch < q_epoch - widen){
+                pos = e.offset;
+
+            }else if((int64_t)e.epoch > q_terminus + widen){
+                stop = e.offset;
+                break;
+            }
+        }
+    }
+    if(this->resume_offset > pos) pos = this->resume_offset;
+
+    uint8_t head[SDLOGGER_BLOCK_HEADER];
+    char ts[SD_TIME_CHARS];
+    SDBlockHeader header;
+    SDBlockDecoder decoder;
+
+    while(pos < stop){
+        this->fp.seek(pos);
+        size_t n = this->fp.read(head, SDLOGGER_BLOCK_HEADER);
+
+        if(!SDBlockDecoder::parse_header(head, n, header)){
+            if(n < SDLOGGER_BLOCK_HEADER) break;
+            pos++;      // resynchronize on the next block header
+            continue;
+        }
+
+        // time ordered files cannot contain more matches once past terminus
+        if(this->time_ordered && (int64_t)header.base_epoch > q_terminus + slack) break;
+
+        this->block_buffer.resize(header.payload_len);
+        n = this->fp.read(this->block_buffer.data(), header.payload_len);
+
+        if(n != header.payload_len || !decoder.begin(header, this->block_buffer.data())){
+            Serial.println("[ERROR] corrupt block in binary log, skipping");
+            pos++;
+            continue;
+        }
+        this->unit_offset = pos;
+        this->unit_matches = 0;
+        pos += SDLOGGER_BLOCK_HEADER + header.payload_len;
+
+        int64_t epoch;
+        uint16_t id;
+        std::string_view message;
+        while(decoder.next(epoch, id, message)){
+            SD_METRIC_ADD(SD_LINES_SCANNED, 1);
+            if(epoch < q_epoch || epoch > q_terminus) continue;
+            if(id >= this->wanted_ids.size() || !this->wanted_ids[id]) continue;
+
+            // write the record out as a line
+            string& entry = this->entry_buffer;
+            entry.assign(ts, sd_format_time(epoch, ts));
+            entry += this->separator;
+            entry += this->dictionary.topic(id);
+            entry += this->separator;
+            entry.append(message);
+            entry += this->separator;
+            this->add_entry(entry, epoch, page_length);
+        }
+    }
+}
+
+/**
+ * Prepares to publish pages. A resumable export loads the saved cursor and continues its
+ * page numbering if the cursor belongs to the same query, any other export starts from
+ * the beginning. When pipelined (see `set_pipelined()`) a sender task is started and the
+ * reader fills the pipeline's buffers, if the task cannot be created the export falls
+ * back to publishing from the calling task.
+ *
+ * @param[in] query The query's ID, see `SDQueryCursor::query_id()`.
+ * @param[in] resumable `true` to load and save the cursor file.
+ * @param[in] topic Topic prefix of the pages, the device's MAC address is appended.
+ */
+void SDReader::begin_export(uint32_t query, bool resumable, const char* topic){
+    if(this->device_mac.empty()) this->device_mac = WiFi.macAddress().c_str();
+    this->page_topic = topic + this->device_mac;
+
+    this->resumable = resumable;
+    this->cursor_stuck = false;
+    this->unsaved_pages = 0;
+    this->resume_offset = 0;
+    this->resume_skip = 0;
+    this->resume_epoch = 0;
+    this->resume_epoch_skip = 0;
+
+    if(!resumable || !this->cursor.load(*this->sd, this->cursor_path) || this->cursor.query != query){
+        this->cursor.reset(query);
+
+    }else if(USB_DEBUG){
+        Serial.print("[DEBUG] resuming export at page ");
+        Serial.println(this->cursor.seq);
+    }
+
+    this->page_mark = this->cursor;
+    this->next_seq = this->cursor.seq;
+
+    this->page = &this->own_page;
+
+    // the sender task may only use mqtt_client under the application's lock
+    bool shared_client = (this->sink == &this->mqtt_sink && !this->mqtt_sink.has_lock());
+    if(this->pipelined && shared_client)
+        Serial.println("[WARNING] pipelined export to MQTT needs set_mqtt_lock(), publishing serially");
+
+    if(this->pipelined && !shared_client && this->pipeline.start(this->sink, this->page_topic))
+        this->page = this->pipeline.acquire();
+}
+
+/**
+ * Waits for the sender to publish every submitted page and settles the cursor. The
+ * cursor file of a complete export is deleted, so the next export of the query starts
+ * over. An export with a failed page keeps its cursor before that page.
+ *
+ * @param[in] complete `true` if every matching entry was handed to a page.
+ */
+void SDReader::end_export(bool complete){
+    if(this->pipeline.is_running()){
+        this->pipeline.stop();
+
+        bool failed = false;
+        if(this->pipeline.drain(this->delivered_mark, failed)) this->commit_page(this->delivered_mark);
+        if(failed) this->cursor_stuck = true;
+
+        if(USB_DEBUG){
+            Serial.print("[DEBUG] pipelined export sent ");
+            Serial.print(this->pipeline.pages_sent());
+            Serial.print(" pages, reader waited ");
+            Serial.print(this->pipeline.reader_wait_micros());
+            Serial.println(" us");
         }
     }
+
+    this->page = &this->own_page;
+
+    if(this->resumable){
+        if(complete && !this->cursor_stuck) SDQueryCursor::remove(*this->sd, this->cursor_path);
+        else if(this->unsaved_pages > 0) this->cursor.save(*this->sd, this->cursor_path);
+        this->resumable = false;
+    }
 }
 
+/**
+ * Starts the next empty page for the open file. The page budget is the MQTT buffer size
+ * less the publish packet's fixed header and topic, so a full page always fits the buffer.
+ */
+void SDReader::begin_page(){
+    size_t overhead = SDREADER_MQTT_OVERHEAD + this->page_topic.size();
+    this->page->set_budget(this->mqtt_buffer > overhead ? this->mqtt_buffer - overhead : 0);
+    this->page->begin(this->filename, this->next_seq);
+    this->page_mark.file = this->filename;
+}
+
+/**
+ * Hands a matching entry to the page, see `page_entry()`, or to the aggregation of an
+ * aggregating query. With a projection set (`set_projection()`) only the entry's row is
+ * published, entries holding none of the fields are dropped. Entries a resumed export
+ * published before it was interrupted are skipped, by their position in the file or, if
+ * the file was replaced, by their time stamp.
+ *
+ * @param[in] entry The log line to publish.
+ * @param[in] epoch The entry's time stamp.
+ * @param[in] page_length The maximum number of entries in a page, `0` or less for no limit.
+ */
+void SDReader::add_entry(std::string_view entry, int64_t epoch, int page_length){
+    SD_METRIC_ADD(SD_LINES_MATCHED, 1);
+
+    this->unit_matches++;
+    if(this->unit_offset == this->resume_offset && this->unit_matches <= this->resume_skip) return;
+    if(this->resume_epoch_skip > 0 && epoch == this->resume_epoch){
+        this->resume_epoch_skip--;
+        return;
+    }
+
+    if(this->aggregator != NULL){
+        this->aggregator->add_line(entry, epoch);
+        return;
+    }
+
+    if(this->projector.active()){
+        if(this->projector.project_line(entry, epoch, this->row_buffer))
+            this->page_entry(this->row_buffer, epoch, page_length);
+        return;
+    }
+
+    this->page_entry(entry, epoch, page_length);
+}
+
+/**
+ * Adds an entry to the page. The page is published first if the entry would take it over
+ * its byte budget, and afterwards if it holds `page_length` entries. An entry too large
+ * for an empty page is dropped.
+ *
+ * @param[in] entry The text to publish.
+ * @param[in] epoch The entry's time stamp.
+ * @param[in] page_length The maximum number of entries in a page, `0` or less for no limit.
+ */
+void SDReader::page_entry(std::string_view entry, int64_t epoch, int page_length){
+    if(!this->page->add(entry, epoch)){
+        if(!this->page->empty()) this->publish_page();
+
+        if(!this->page->add(entry, epoch)){
+            Serial.println("[WARNING] entry larger than the MQTT buffer was not published");
+            return;
+        }
+    }
+
+    this->page_mark.offset = this->unit_offset;
+    this->page_mark.skip = this->unit_matches;
+    this->page_mark.at_epoch = (epoch == this->page_mark.last_epoch) ? this->page_mark.at_epoch + 1 : 1;
+    this->page_mark.last_epoch = epoch;
+
+    if(page_length > 0 && this->page->count() >= (size_t)page_length){
+        this->publish_page();
+    }
+}
+
+/**
+ * Publishes the page to the page sink, the MQTT broker unless `set_page_sink()` was
+ * called, and starts the next, empty page. The page's epoch and terminus are the time
+ * stamps of its first and last entries. A pipelined export hands the page to the sender
+ * task and continues in the other buffer, waiting only if the sender is still publishing
+ * it. The cursor advances once the page is delivered.
+ */
+void SDReader::publish_page(){
+    if(USB_DEBUG){
+        Serial.print("[DEBUG] publishing page of ");
+        Serial.print(this->page->count());
+        Serial.println(" entries");
+    }
+
+    this->next_seq = this->page->sequence() + 1;
+    this->page_mark.seq = this->next_seq;
+
+    if(this->pipeline.is_running()){
+        bool failed = false;
+
+        this->delivered_mark.file.clear();
+        this->pipeline.submit(this->page, this->page_mark);
+        this->page = this->pipeline.acquire(&this->delivered_mark, &failed);
+
+        if(failed) this->cursor_stuck = true;
+        else if(!this->delivered_mark.file.empty()) this->commit_page(this->delivered_mark);
+
+    }else if(sd_publish_page(*this->sink, this->page_topic, this->page->finish())){
+        this->commit_page(this->page_mark);
+
+    }else{
+        this->cursor_stuck = true;
+    }
+
+    this->begin_page();
+}
+
+/**
+ * Publishes the page if it holds any entries, called at the end of each file.
+ */
+void SDReader::flush_page(){
+    if(!this->page->empty()) this->publish_page();
+}
+
+/**
+ * Moves the cursor past a delivered page and saves it every `cursor_every` pages. Once a
+ * page has failed the cursor stays put, a resumed export repeats the pages after it.
+ *
+ * @param[in] mark The cursor after the page's last entry.
+ */
+void SDReader::commit_page(const SDQueryCursor& mark){
+    if(this->cursor_stuck) return;
+
+    this->cursor = mark;
+    if(!this->resumable) return;
+
+    if(++this->unsaved_pages >= this->cursor_every){
+        this->cursor.save(*this->sd, this->cursor_path);
+        this->unsaved_pages = 0;
+    }
+}
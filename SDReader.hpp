@@ -8,10 +8,25 @@
 #include <vector>
 #include <string>
 
-#include "../../include/SDCard.hpp"
 #include "SDLogger.hpp"
 #include "TimeStamp.hpp"
 #include "MQTTMailer.hpp"
+#include "SDLineReader.hpp"
+#include "SDLogIndex.hpp"
+#include "SDFileCatalog.hpp"
+#include "SDTime.hpp"
+#include "SDTopicFilter.hpp"
+#include "SDTopicDictionary.hpp"
+#include "SDBinaryFormat.hpp"
+#include "SDCompress.hpp"
+#include "SDPageBuilder.hpp"
+#include "SDPageSink.hpp"
+#include "SDPagePipeline.hpp"
+#include "SDQueryCursor.hpp"
+#include "SDAggregator.hpp"
+#include "SDProjector.hpp"
+#include "SDMetrics.hpp"
+#include "SDRecovery.hpp"
 
 #ifndef SDREADER_HPP
 #define SDREADER_HPP
@@ -24,6 +39,12 @@ using namespace std;
 extern PubSubClient mqtt_client;
 extern const bool USB_DEBUG;
 
+#define SDREADER_INDEX_EXTEND_BYTES 32768   // unindexed tail size which triggers extending an index
+#define SDREADER_DEFAULT_SLACK 600          // seconds lines may be out of order in time ordered mode
+#define SDREADER_RANGE_TOPIC "datagator/data/time_range/"    // pages of matching lines, the MAC address is appended
+#define SDREADER_AGGREGATE_TOPIC "datagator/data/aggregate/" // pages of aggregation rows
+#define SDREADER_METRICS_TOPIC "datagator/metrics/"          // metrics snapshots, see SDMetrics.hpp
+
 /**
  * @brief SDReader provides an interface for opening and
  *  reading data from files created using the SDLogger library.
@@ -35,22 +56,97 @@ class SDReader {
         std::string filename = "";
         std::string separator = ";";
 
-        SDCard sd; // default sd interface passed to constructor
+        SDStorage* sd = &sd_default_storage();   // where the log files are read from
 
         bool initialize_sd_card();
 
         bool file_open = false;
         File fp;
+        uint32_t data_size = 0; // where the data of `fp` ends, before any preallocated zeros
+        SDLineReader lines;     // block reader attached to `fp`, or to `mapping`
+#if !defined(ESP_PLATFORM)
+        bool mapped = false;    // read text files through a memory map
+        SDMapping mapping;      // map of `fp`'s file while it is open
+#endif
+        void attach_lines(const string& path);
+
+        SDPageBuilder own_page;         // page buffer of synchronous exports
+        SDPageBuilder* page = &own_page;    // JSON page being filled, see SDPageBuilder.hpp
+        string page_topic;              // MQTT topic pages are published to
+        string device_mac;              // appended to the page topics
+        size_t mqtt_buffer = SDREADER_MQTT_BUFFER;
+        string entry_buffer;            // reused to rebuild entries with expanded topics
+
+        SDMqttSink mqtt_sink;
+        SDPageSink* sink = &mqtt_sink;  // where pages are published
+        bool pipelined = false;         // publish from a sender task while reading
+        SDPagePipeline pipeline;
+
+        SDQueryCursor cursor;           // export position after the last delivered page
+        SDQueryCursor page_mark;        // export position after the last entry in the page
+        SDQueryCursor delivered_mark;   // cursor of a page the sender delivered, reused so its file name keeps its capacity
+        string cursor_path;             // where the cursor is saved, empty to not save it
+        uint32_t cursor_every = 1;      // delivered pages between cursor saves
+        uint32_t unsaved_pages = 0;
+        bool resumable = false;         // the running export saves its cursor
+        bool cursor_stuck = false;      // a page failed, the cursor stays before it
+        uint32_t next_seq = 0;          // sequence number of the next page begun
+
+        uint32_t unit_offset = 0;       // line, block or frame being scanned
+        uint32_t unit_matches = 0;      // matching entries seen in it so far
+        uint32_t resume_offset = 0;     // unit of the open file to resume at
+        uint32_t resume_skip = 0;       // matching entries there already published
+        int64_t resume_epoch = 0;       // time stamp to resume at when the cursor's file is gone
+        uint32_t resume_epoch_skip = 0; // entries with that time stamp already published
+
+        void begin_export(uint32_t query, bool resumable, const char* topic);
+        void end_export(bool complete);
+        void begin_page();
+        void add_entry(std::string_view entry, int64_t epoch, int page_length);
+        void page_entry(std::string_view entry, int64_t epoch, int page_length);
+        void publish_page();
+        void flush_page();
+        void commit_page(const SDQueryCursor& mark);
+
+        SDAggregator* aggregator = NULL;    // set while an aggregating query runs
+        SDProjector projector;          // fields published instead of whole lines, if set
+        string row_buffer;              // reused for projected rows
+        void emit_buckets(int64_t before, int page_length);
+
+        void scan_files(int64_t q_epoch, int64_t q_terminus, const SDTopicFilter& filter, int page_length,
+                const string& prefix, const string& filetype);
+        void scan_range(int64_t q_epoch, int64_t q_terminus, const SDTopicFilter& filter, int page_length);
+        bool collect_line(std::string_view line, int64_t q_epoch, int64_t q_terminus, 
+                const SDTopicFilter& filter, int page_length);
+
+        bool use_index = false;         // seek with `.idx` sidecars when available
+        bool build_index = false;       // write missing or stale `.idx` sidecars
+        vector<SDIndexEntry> index;     // index of the file being queried
 
-        bool topic_filter_match(vector<string> filter, string target);
+        SDTimeParser time_parser;       // parses line time stamps, caches the file's date
+        bool line_epoch(std::string_view line, int64_t& epoch);
+        bool load_index(uint32_t file_size);
+        void index_lines(uint32_t from, bool append);
+        bool prepare_index();
+        uint32_t index_slack();
 
-        string build_json_page(
-                string filename,
-                long int epoch,
-                long int terminus,
-                vector<string> &data);
+        SDTopicDictionary dictionary;   // topic IDs of the file being queried
+        vector<bool> wanted_ids;        // topic IDs which match the query's filter
+        int resolve_topics(const SDTopicFilter& filter);
 
-        int calculate_page_size(vector<string> &page);
+        vector<uint8_t> block_buffer;   // payload of the binary block being decoded
+        bool binary_file();
+        void scan_blocks(int64_t q_epoch, int64_t q_terminus, int page_length);
+
+        vector<uint8_t> frame_buffer;   // decompressed frame of a compressed file
+        bool compressed_file();
+        void scan_frames(int64_t q_epoch, int64_t q_terminus, const SDTopicFilter& filter, int page_length);
+
+        SDFileCatalog catalog;          // daily files found by the last directory listing
+
+        bool time_ordered = false;      // files are append only and sorted by time stamp
+        uint32_t order_slack = SDREADER_DEFAULT_SLACK;
+        uint32_t seek_epoch(int64_t target);
 
     public:
 
@@ -92,6 +188,16 @@ class SDReader {
             initialize_sd_card();
         }
 
+        /**
+         * @brief Read from `storage` instead of the SD card and initialize it.
+         */
+        bool set_storage(SDStorage& storage);
+
+        /**
+         * @brief Storage the log files are read from.
+         */
+        SDStorage& get_storage(){return *this->sd;}
+
         /**
          * @brief Manually set the filename to access.
          *
@@ -105,6 +211,96 @@ class SDReader {
          */
         std::string read_line();
 
+        /**
+         * @brief Use time indexes to seek within files during range queries, and with
+         *  `build` write the indexes of files which have none or an outdated one.
+         */
+        void set_use_index(bool use, bool build = false){
+            this->use_index = use;
+            this->build_index = use && build;
+        }
+
+#if !defined(ESP_PLATFORM)
+        /**
+         * @brief Scan text files through a memory map of each file when the storage can map
+         *  them, ex `SDPosixStorage`, instead of reading them in blocks.
+         */
+        void set_mapped(bool mapped){this->mapped = mapped;}
+#endif
+
+        /**
+         * @brief Treat files as sorted by time, allowing lines to be out of order by up to
+         *  `slack_seconds`, so range queries binary search for their start and stop early.
+         */
+        void set_time_ordered(bool ordered, uint32_t slack_seconds = SDREADER_DEFAULT_SLACK){
+            this->time_ordered = ordered;
+            this->order_slack = slack_seconds;
+        }
+
+        /**
+         * @brief Size of the MQTT client's buffer, pages are kept small enough to fit it.
+         */
+        void set_mqtt_buffer_size(size_t bytes){this->mqtt_buffer = bytes;}
+
+        /**
+         * @brief Publish only `fields` of each matching line's message, as
+         *  `epoch,topic,field=value` rows, an empty list publishes whole lines again.
+         */
+        void set_projection(vector<string> fields){this->projector.set_fields(fields);}
+
+        /**
+         * @brief Publish a snapshot of the metrics to the page sink, zeroing them if `reset`.
+         */
+        bool publish_metrics(bool reset = true);
+
+        /**
+         * @brief Publish pages to `sink` instead of the MQTT broker, `NULL` restores MQTT.
+         */
+        void set_page_sink(SDPageSink* sink){this->sink = (sink != NULL) ? sink : &this->mqtt_sink;}
+
+        /**
+         * @brief Publish each page from a sender task while the next page is read, see 
+         *  `SDPagePipeline`. Exports to the MQTT broker stay serial unless `set_mqtt_lock()`
+         *  was called, as the sender task would share `mqtt_client` with the application.
+         */
+        void set_pipelined(bool pipelined){this->pipelined = pipelined;}
+
+        /**
+         * @brief Lock held while pages are published to `mqtt_client`, which the application
+         *  must hold too whenever it uses the client, ex around `mqtt_client.loop()`.
+         */
+        void set_mqtt_lock(SDMutex* lock){this->mqtt_sink.set_lock(lock);}
+
+        /**
+         * @brief Save the position of `read_entry_range_from_files()` exports to `path` every
+         *  `save_every` pages, so an interrupted export of the same query resumes after the
+         *  last published page.
+         */
+        void enable_cursor(string path = SDREADER_CURSOR_FILE, uint32_t save_every = 1){
+            this->cursor_path = path;
+            this->cursor_every = (save_every > 0) ? save_every : 1;
+        }
+
+        /**
+         * @brief Stop saving export positions, exports always start from the beginning.
+         */
+        void disable_cursor(){this->cursor_path.clear();}
+
+        /**
+         * @brief Position of the current or last export after its last delivered page.
+         */
+        const SDQueryCursor& get_cursor() const {return this->cursor;}
+
+        /**
+         * @brief Page counts and reader/sender timings of the last pipelined export.
+         */
+        const SDPagePipeline& get_pipeline() const {return this->pipeline;}
+
+        /**
+         * @brief Bytes read from the open file so far, for measuring scan throughput.
+         */
+        uint64_t bytes_read(){return this->lines.bytes_read();}
+
         /**
          * @brief Retrieve all data within the specified time range, potentially accessing multiple files.
          */
@@ -115,6 +311,18 @@ class SDReader {
                 string prefix="log", 
                 string filetype="csv");
 
+        /**
+         * @brief Publish per bucket, per topic count/min/max/mean of numeric message fields
+         *  instead of the matching lines.
+         */
+        void aggregate_entry_range_from_files(TimeStamp epoch, 
+                TimeStamp terminus, 
+                vector<string> topic_filter, 
+                uint32_t bucket_seconds, 
+                vector<string> fields, 
+                string prefix="log", 
+                string filetype="csv");
+
         /**
          * @brief Access a single file to retrieve data in time range and publish via MQTT.
          */
@@ -129,8 +337,10 @@ class SDReader {
          */
         File* open_file(){
             if(filename == "") return NULL;
-            this->fp = (sd.open(this->filename.c_str(), "r"));
+            this->fp = (this->sd->open(this->filename.c_str(), "r"));
             this->file_open = true;
+            SD_METRIC_ADD(SD_FILE_OPENS, 1);
+            this->attach_lines(this->filename);
             return &(this->fp);
         }
 
@@ -138,8 +348,10 @@ class SDReader {
          * @brief Open the specified file from path provided.
          */
         File* open_file(string filename){
-            this->fp = sd.open(filename.c_str(), "r");
+            this->fp = this->sd->open(filename.c_str(), "r");
             this->file_open = true;
+            SD_METRIC_ADD(SD_FILE_OPENS, 1);
+            this->attach_lines(filename);
             return &(this->fp);
         }
 
@@ -148,7 +360,12 @@ class SDReader {
          */
         void close_file(){
             this->file_open = false;
+            this->lines.detach();
+#if !defined(ESP_PLATFORM)
+            this->mapping.reset();
+#endif
             this->fp.close();
+            SD_METRIC_ADD(SD_FILE_CLOSES, 1);
         }
 
 };
@@ -0,0 +1,140 @@
+/**
+ * @file SDRecordQueue.hpp
+ * @brief Bounded lock-free multi-producer/multi-consumer queue used to hand log records
+ *  to the background writer.
+ */
+#ifndef SDRECORDQUEUE_HPP
+#define SDRECORDQUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief Fixed capacity queue based on per-slot sequence numbers.
+ *
+ * Producers and consumers claim slots with a single compare-and-swap and never wait on
+ * each other, a full queue fails the push and an empty queue fails the pop. Elements
+ * are filled and consumed in place through callbacks so that records are not copied
+ * through the queue. The capacity is rounded up to a power of two.
+ */
+template<typename T>
+class SDRecordQueue {
+
+    private:
+
+        struct Slot {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        std::unique_ptr<Slot[]> slots;
+        size_t mask;
+
+        alignas(32) std::atomic<size_t> enqueue_pos;
+        alignas(32) std::atomic<size_t> dequeue_pos;
+
+    public:
+
+        /**
+         * @brief Allocate the queue, `capacity` is rounded up to a power of two.
+         */
+        explicit SDRecordQueue(size_t capacity){
+            size_t n = 2;
+            while(n < capacity) n <<= 1;
+
+            this->slots.reset(new Slot[n]);
+            this->mask = n - 1;
+
+            for(size_t i = 0; i < n; i++)
+                this->slots[i].sequence.store(i, std::memory_order_relaxed);
+
+            this->enqueue_pos.store(0, std::memory_order_relaxed);
+            this->dequeue_pos.store(0, std::memory_order_relaxed);
+        }
+
+        SDRecordQueue(const SDRecordQueue&) = delete;
+        SDRecordQueue& operator=(const SDRecordQueue&) = delete;
+
+        /**
+         * @brief Claim a free slot and fill it in place with `fill(T&)`.
+         *
+         * @returns `false` without calling `fill` if the queue is full.
+         */
+        template<typename Fill>
+        bool try_push(Fill fill){
+            Slot* slot;
+            size_t pos = this->enqueue_pos.load(std::memory_order_relaxed);
+
+            for(;;){
+                slot = &this->slots[pos & this->mask];
+                size_t seq = slot->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+                if(diff == 0){
+                    if(this->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+
+                }else if(diff < 0){
+                    return false;   // full
+
+                }else{
+                    pos = this->enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            fill(slot->data);
+            slot->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Take the oldest element and hand it to `consume(T&)` before releasing the slot.
+         *
+         * @returns `false` if the queue is empty.
+         */
+        template<typename Consume>
+        bool try_pop(Consume consume){
+            Slot* slot;
+            size_t pos = this->dequeue_pos.load(std::memory_order_relaxed);
+
+            for(;;){
+                slot = &this->slots[pos & this->mask];
+                size_t seq = slot->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+                if(diff == 0){
+                    if(this->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+
+                }else if(diff < 0){
+                    return false;   // empty
+
+                }else{
+                    pos = this->dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            consume(slot->data);
+            slot->sequence.store(pos + this->mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Approximate number of queued elements, exact when no push or pop is in progress.
+         */
+        size_t size() const {
+            size_t head = this->dequeue_pos.load(std::memory_order_relaxed);
+            size_t tail = this->enqueue_pos.load(std::memory_order_relaxed);
+            return (tail > head) ? tail - head : 0;
+        }
+
+        /**
+         * @brief Number of slots in the queue.
+         */
+        size_t capacity() const {return this->mask + 1;}
+
+};
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * @file SDRecovery.cpp
+ */
+#include "SDRecovery.hpp"
+#include "SDBinaryFormat.hpp"
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+/**
+ * Folds the CRC-32 of `line` to 16 bits. One in 65536 corrupted lines passes, enough to
+ * tell a torn line from a whole one.
+ *
+ * @param[in] line The line, ending with its last separator.
+ *
+ * @returns The checksum.
+ */
+uint16_t sd_line_checksum(std::string_view line){
+    uint32_t crc = sd_crc32((const uint8_t*)line.data(), line.size());
+    return (uint16_t)(crc ^ (crc >> 16));
+}
+
+/**
+ * @param[in,out] line A formatted line, the checksum is appended after its last separator.
+ */
+void sd_append_checksum(std::string& line){
+    uint16_t sum = sd_line_checksum(line);
+
+    line.push_back(SDLOGGER_CHECKSUM_MARK);
+    for(int shift = 12; shift >= 0; shift -= 4) line.push_back(HEX_DIGITS[(sum >> shift) & 0xF]);
+}
+
+/**
+ * Checks that a line read from a log file was written whole. A line ending with a
+ * separator, `*` and four hex digits must match the checksum, other lines must end with the
+ * separator.
+ *
+ * @param[in,out] line The line, without its newline. On success the checksum is removed.
+ * @param[in] separator The separator between fields.
+ *
+ * @returns `false` if the line is torn or corrupt.
+ */
+bool sd_check_line(std::string_view& line, std::string_view separator){
+    size_t n = line.size();
+
+    if(n >= SDLOGGER_CHECKSUM_CHARS + separator.size() && line[n - SDLOGGER_CHECKSUM_CHARS] == SDLOGGER_CHECKSUM_MARK){
+        std::string_view body = line.substr(0, n - SDLOGGER_CHECKSUM_CHARS);
+
+        if(body.substr(body.size() - separator.size()) == separator){
+            uint16_t sum = 0;
+            for(size_t i = n - SDLOGGER_CHECKSUM_CHARS + 1; i < n; i++){
+                char c = line[i];
+                int digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+                if(digit < 0) return false;
+                sum = (sum << 4) | digit;
+            }
+
+            if(sum != sd_line_checksum(body)) return false;
+            line = body;
+            return true;
+        }
+    }
+
+    return n >= separator.size() && line.substr(n - separator.size()) == separator;
+}
+
+/**
+ * Finds where the data of a file ends and its preallocated zeros begin. A file whose last
+ * byte is not zero costs one read. Otherwise the zeros are found by binary search over
+ * chunks of `SDLOGGER_RECOVERY_CHUNK` bytes for the first chunk of only zeros, then the
+ * chunk before it is searched backwards, so a reservation of megabytes takes about a 
+ * dozen reads. Data is assumed not to contain a whole chunk of zeros. The position of 
+ * `f` is left undefined.
+ *
+ * @param[in] f The open file.
+ *
+ * @returns Offset one past the last non-zero byte, `0` if the file holds only zeros.
+ */
+uint32_t sd_data_end(File& f){
+    uint8_t buf[SDLOGGER_RECOVERY_CHUNK];
+    uint32_t size = f.size();
+    if(size == 0) return 0;
+
+    // reads chunk `c` into `buf`, returning its length
+    auto read_chunk = [&](uint32_t c){
+        uint32_t at = c * SDLOGGER_RECOVERY_CHUNK;
+        uint32_t len = (size - at < SDLOGGER_RECOVERY_CHUNK) ? size - at : SDLOGGER_RECOVERY_CHUNK;
+        return (f.seek(at) && f.read(buf, len) == len) ? len : 0;
+    };
+
+    auto zero_chunk = [&](uint32_t c){
+        uint32_t len = read_chunk(c);
+        for(uint32_t i = 0; i < len; i++){
+            if(buf[i] != 0) return false;
+        }
+        return len > 0;
+    };
+
+    if(f.seek(size - 1) && f.read(buf, 1) == 1 && buf[0] != 0) return size;
+
+    uint32_t lo = 0;
+    uint32_t hi = (size + SDLOGGER_RECOVERY_CHUNK - 1) / SDLOGGER_RECOVERY_CHUNK;
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        if(zero_chunk(mid)) hi = mid;
+        else lo = mid + 1;
+    }
+
+    // the data ends in the chunk before the first zero chunk
+    if(lo == 0) return 0;
+
+    uint32_t len = read_chunk(lo - 1);
+    while(len > 0 && buf[len - 1] == 0) len--;
+    return (lo - 1) * SDLOGGER_RECOVERY_CHUNK + len;
+}
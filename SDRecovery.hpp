@@ -0,0 +1,76 @@
+/**
+ * @file SDRecovery.hpp
+ * @brief Per line checksums and the report of the startup scan which removes a torn last
+ *  record from a log file, see `SDLogger::recover_file()`.
+ *
+ * A power loss while a record is written can leave part of it at the end of the file.
+ * Text lines are terminated by the separator, `TIME;TOPIC;MESSAGE;`, and with checksums
+ * enabled (`SDLogger::enable_line_checksums()`) carry a `*` and four hex digits after it
+ *
+ * ```
+ * 5-24-2023T18:00:09;kkm_k6p/bc:57:29:00:f6:d3;{"HUMIDITY":40.16};*3F0A
+ * ```
+ *
+ * The digits are the CRC-32 of the line up to and including its last separator, folded
+ * to 16 bits. SDReader skips lines which are not terminated or fail their checksum, and
+ * removes the checksum from the lines it returns. Binary blocks carry their own CRC
+ * (SDBinaryFormat.hpp).
+ *
+ * Files preallocated by SDLogger (`SDLogger::enable_preallocation()`) end in zeros past
+ * their data until they are closed cleanly. Text lines never end in a zero byte, so the 
+ * data ends at the last non-zero byte, which `sd_data_end()` finds without reading the
+ * zeros. A binary block may end in zeros, its end is taken from its header.
+ */
+#ifndef SDRECOVERY_HPP
+#define SDRECOVERY_HPP
+
+#include <SD.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#define SDLOGGER_CHECKSUM_MARK '*'      // starts the checksum after the last separator
+#define SDLOGGER_CHECKSUM_CHARS 5       // the mark and four hex digits
+#define SDLOGGER_TORN_EXT ".torn"       // torn records moved out of a log file, appended to its name
+#define SDLOGGER_RECOVERY_CHUNK 512     // bytes read at a time by the recovery scan
+#define SDLOGGER_RECOVERY_MAX_LINE 4096 // longer last lines are only checked for their terminator
+
+/**
+ * @brief Outcome of recovering one log file.
+ */
+struct SDRecoveryReport {
+    uint32_t file_size = 0;     // size of the file before recovery
+    uint32_t valid_size = 0;    // where the last whole record ends, the size after unless preallocated zeros are kept
+    bool torn = false;          // a torn record was found and moved to the `.torn` file
+    uint32_t reserved = 0;      // preallocated zeros found after the data
+};
+
+/**
+ * @brief Checksum of a line up to and including its last separator.
+ */
+uint16_t sd_line_checksum(std::string_view line);
+
+/**
+ * @brief Append `*` and the checksum of `line` to `line`.
+ */
+void sd_append_checksum(std::string& line);
+
+/**
+ * @brief `true` if `line` is terminated by `separator` and passes its checksum if it has
+ *  one, which is then removed from `line`.
+ */
+bool sd_check_line(std::string_view& line, std::string_view separator);
+
+/**
+ * @brief Offset one past the last non-zero byte of `f`, where the data of a preallocated file ends.
+ */
+uint32_t sd_data_end(File& f);
+
+/**
+ * @brief Name of the file torn records of log file `fn` are moved to.
+ */
+inline std::string sd_torn_filename(const std::string& fn){
+    return fn + SDLOGGER_TORN_EXT;
+}
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * @file SDScan.hpp
+ * @brief Vectorized split of log lines into their time stamp, topic and message, SSE2 on
+ *  x86 hosts and a plain loop everywhere else.
+ *
+ * Newlines are left to `memchr()`, which the host's libc already vectorizes. The fields
+ * of a line are found by comparing 16 bytes at a time against the separator, which finds
+ * both field ends in one pass instead of two searches. Vector loads never cross the end of
+ * the line, so a line may end at the end of a memory mapped file.
+ */
+#ifndef SDSCAN_HPP
+#define SDSCAN_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SDSCAN_ISA "sse2"
+#else
+#define SDSCAN_ISA "scalar"
+#endif
+
+/**
+ * @brief Find the first two `separator`s of `line`, the ends of its time stamp and topic,
+ *  in one pass. `false` if the line has fewer than two.
+ */
+inline bool sd_scan_separators(std::string_view line, char separator, size_t& first, size_t& second){
+    const char* s = line.data();
+    size_t n = line.size();
+    size_t found[2];
+    size_t count = 0;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i sep = _mm_set1_epi8(separator);
+    for(; i + 16 <= n; i += 16){
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s + i)), sep));
+        while(mask != 0){
+            found[count++] = i + __builtin_ctz(mask);
+            if(count == 2){
+                first = found[0];
+                second = found[1];
+                return true;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for(; i < n; i++){
+        if(s[i] != separator) continue;
+
+        found[count++] = i;
+        if(count == 2){
+            first = found[0];
+            second = found[1];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#endif
@@ -0,0 +1,615 @@
+/**
+ * @file SDStorage.cpp
+ */
+#include "SDStorage.hpp"
+
+#if !defined(ESP_PLATFORM)
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace stdfs = std::filesystem;
+#else
+#include <unistd.h>
+#endif
+
+SDStorage& sd_default_storage(){
+#if defined(ESP_PLATFORM)
+    static SDCardStorage storage;
+#else
+    static SDMemoryStorage storage;
+#endif
+    return storage;
+}
+
+/**
+ * Shortens a file for backends without a native truncate, by copying its first `size`
+ * bytes to `<path>.tmp` and renaming the copy over the file. Takes time and space in
+ * proportion to `size`.
+ *
+ * @param[in] path Absolute path of the file.
+ * @param[in] size New size in bytes, files are never extended.
+ *
+ * @returns `true` if the file now has `size` bytes.
+ */
+bool SDStorage::truncate(const char* path, uint32_t size){
+    File in = this->open(path, FILE_READ);
+    if(!in) return false;
+
+    uint32_t old_size = in.size();
+    if(old_size <= size){
+        in.close();
+        return old_size == size;
+    }
+
+    std::string tmp = std::string(path) + SDSTORAGE_TMP_EXT;
+    File out = this->open(tmp.c_str(), FILE_WRITE);
+    if(!out){
+        in.close();
+        return false;
+    }
+
+    uint8_t buf[512];
+    uint32_t left = size;
+    bool ok = true;
+
+    while(ok && left > 0){
+        size_t want = (left < sizeof(buf)) ? left : sizeof(buf);
+        size_t n = in.read(buf, want);
+        ok = (n == want) && out.write(buf, n) == n;
+        left -= n;
+    }
+
+    in.close();
+    out.close();
+
+    if(!ok){
+        this->remove(tmp.c_str());
+        return false;
+    }
+
+    return this->remove(path) && this->rename(tmp.c_str(), path);
+}
+
+/**
+ * Grows a file by appending zeros, for backends which cannot allocate space without
+ * writing it. On FAT the clusters are taken in one run while nothing else is written, so
+ * the file is contiguous and later writes inside it do not touch the FAT. Files are
+ * never shortened.
+ *
+ * @param[in] path Absolute path of the file, created if missing.
+ * @param[in] size Size in bytes the file should have at least.
+ *
+ * @returns `true` if the file now has at least `size` bytes.
+ */
+bool SDStorage::preallocate(const char* path, uint32_t size){
+    File f = this->open(path, FILE_APPEND);
+    if(!f) return false;
+
+    uint8_t zeros[512] = {0};
+
+    uint32_t have = f.size();
+    bool ok = true;
+
+    while(ok && have < size){
+        size_t want = (size - have < sizeof(zeros)) ? size - have : sizeof(zeros);
+        ok = f.write(zeros, want) == want;
+        have += want;
+    }
+
+    f.close();
+    return ok;
+}
+
+#if defined(ESP_PLATFORM)
+
+/**
+ * Truncates through the VFS the card is mounted on, falling back to the copy of
+ * `SDStorage::truncate()` if the FAT driver does not support it.
+ */
+bool SDCardStorage::truncate(const char* path, uint32_t size){
+    std::string vfs_path = std::string(SDSTORAGE_MOUNT_POINT) + path;
+    if(::truncate(vfs_path.c_str(), size) == 0) return true;
+
+    return SDStorage::truncate(path, size);
+}
+
+#else
+
+/**
+ * Last component of `path`.
+ */
+static const char* base_name(const std::string& path){
+    size_t slash = path.rfind('/');
+    return path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+/**
+ * Joins directory `dir`, as seen by the library, and entry `name`.
+ */
+static std::string child_path(const std::string& dir, const std::string& name){
+    return (dir.empty() || dir.back() != '/') ? dir + "/" + name : dir + name;
+}
+
+/**
+ * A directory listing taken when the directory is opened, entries are opened through the
+ * storage as `openNextFile()` reaches them.
+ */
+class SDListImpl : public fs::FileImpl {
+
+    private:
+
+        SDStorage* storage;
+        std::string dir;
+        std::vector<std::string> names;
+        size_t next = 0;
+        bool open = true;
+
+    public:
+
+        SDListImpl(SDStorage* storage, const std::string& dir, std::vector<std::string> names)
+            : storage(storage), dir(dir), names(names) {}
+
+        size_t write(const uint8_t*, size_t) override {return 0;}
+        size_t read(uint8_t*, size_t) override {return 0;}
+        void flush() override {}
+        bool seek(uint32_t, fs::SeekMode) override {return false;}
+        size_t position() const override {return 0;}
+        size_t size() const override {return 0;}
+        void close() override {this->open = false;}
+        const char* path() const override {return this->dir.c_str();}
+        const char* name() const override {return base_name(this->dir);}
+        bool isDirectory() override {return true;}
+        operator bool() override {return this->open;}
+
+        fs::FileImplPtr openNextFile(const char* mode) override {
+            while(this->open && this->next < this->names.size()){
+                File f = this->storage->open(child_path(this->dir, this->names[this->next++]).c_str(), mode);
+                if(f) return f.impl();
+            }
+            return fs::FileImplPtr();
+        }
+
+};
+
+/**
+ * A host file read and written through stdio.
+ */
+class SDPosixFileImpl : public fs::FileImpl {
+
+    private:
+
+        FILE* fp;
+        std::string name_path;
+
+    public:
+
+        SDPosixFileImpl(FILE* fp, const std::string& path) : fp(fp), name_path(path) {}
+        ~SDPosixFileImpl(){this->close();}
+
+        size_t write(const uint8_t* buf, size_t size) override {return this->fp ? fwrite(buf, 1, size, this->fp) : 0;}
+        size_t read(uint8_t* buf, size_t size) override {return this->fp ? fread(buf, 1, size, this->fp) : 0;}
+        void flush() override {if(this->fp) fflush(this->fp);}
+
+        bool seek(uint32_t pos, fs::SeekMode mode) override {
+            int whence = (mode == fs::SeekCur) ? SEEK_CUR : (mode == fs::SeekEnd) ? SEEK_END : SEEK_SET;
+            return this->fp && fseek(this->fp, pos, whence) == 0;
+        }
+
+        size_t position() const override {
+            long pos = this->fp ? ftell(this->fp) : -1;
+            return pos < 0 ? 0 : (size_t)pos;
+        }
+
+        size_t size() const override {
+            struct stat st;
+            if(!this->fp) return 0;
+            fflush(this->fp);
+            return fstat(fileno(this->fp), &st) == 0 ? (size_t)st.st_size : 0;
+        }
+
+        void close() override {
+            if(this->fp) fclose(this->fp);
+            this->fp = NULL;
+        }
+
+        const char* path() const override {return this->name_path.c_str();}
+        const char* name() const override {return base_name(this->name_path);}
+        bool isDirectory() override {return false;}
+        fs::FileImplPtr openNextFile(const char*) override {return fs::FileImplPtr();}
+        operator bool() override {return this->fp != NULL;}
+
+};
+
+/**
+ * Number of FAT32 table sectors which change when a file grows from `old_size` to
+ * `new_size` bytes, with clusters allocated in one run.
+ */
+static uint64_t fat_sectors(uint64_t old_size, uint64_t new_size){
+    uint64_t old_clusters = (old_size + SDSTORAGE_CLUSTER_SIZE - 1) / SDSTORAGE_CLUSTER_SIZE;
+    uint64_t new_clusters = (new_size + SDSTORAGE_CLUSTER_SIZE - 1) / SDSTORAGE_CLUSTER_SIZE;
+    if(new_clusters <= old_clusters) return 0;
+
+    // the entry of the old last cluster is rewritten to link the chain
+    uint64_t first = (old_clusters > 0) ? old_clusters - 1 : 0;
+    return (new_clusters - 1) / SDSTORAGE_FAT_SECTOR_ENTRIES - first / SDSTORAGE_FAT_SECTOR_ENTRIES + 1;
+}
+
+/**
+ * A file of an SDMemoryStorage, every call stalls for its simulated latency. A flush of
+ * a file which grew into new clusters also pays `alloc_us` per FAT sector they touch.
+ */
+class SDMemoryFileImpl : public fs::FileImpl {
+
+    private:
+
+        SDMemoryStorage* storage;
+        std::shared_ptr<std::vector<uint8_t>> data;
+        std::string name_path;
+        size_t pos = 0;
+        bool append;
+        bool dirty = false;     // written since the last flush
+        size_t synced_size;     // size as of the last flush, its clusters are in the FAT
+
+    public:
+
+        SDMemoryFileImpl(SDMemoryStorage* storage, std::shared_ptr<std::vector<uint8_t>> data,
+                const std::string& path, bool append)
+            : storage(storage), data(data), name_path(path), append(append), synced_size(data->size()) {
+            if(append) this->pos = data->size();
+        }
+
+        size_t write(const uint8_t* buf, size_t size) override {
+            if(!this->data) return 0;
+            size = this->storage->grant_write(size);
+            if(this->append) this->pos = this->data->size();
+            if(this->pos + size > this->data->size()) this->data->resize(this->pos + size);
+            memcpy(this->data->data() + this->pos, buf, size);
+            this->pos += size;
+            this->dirty = true;
+
+            SDStorageStats& stats = this->storage->stats();
+            stats.writes++;
+            stats.bytes_written += size;
+            this->storage->stall(this->storage->get_latency().write_us, size);
+            return size;
+        }
+
+        size_t read(uint8_t* buf, size_t size) override {
+            if(!this->data) return 0;
+            size_t n = (this->pos < this->data->size()) ? std::min(size, this->data->size() - this->pos) : 0;
+            memcpy(buf, this->data->data() + this->pos, n);
+            this->pos += n;
+
+            SDStorageStats& stats = this->storage->stats();
+            stats.reads++;
+            stats.bytes_read += n;
+            this->storage->stall(this->storage->get_latency().read_us, n);
+            return n;
+        }
+
+        void flush() override {
+            if(!this->data) return;
+            this->dirty = false;
+
+            uint64_t sectors = fat_sectors(this->synced_size, this->data->size());
+            this->synced_size = this->data->size();
+
+            SDStorageStats& stats = this->storage->stats();
+            stats.flushes++;
+            stats.fat_writes += sectors;
+            this->storage->stall(this->storage->get_latency().flush_us + this->storage->get_latency().alloc_us * sectors, 0);
+        }
+
+        bool seek(uint32_t pos, fs::SeekMode mode) override {
+            if(!this->data) return false;
+
+            size_t base = (mode == fs::SeekCur) ? this->pos : (mode == fs::SeekEnd) ? this->data->size() : 0;
+            if(base + pos > this->data->size()) return false;
+            this->pos = base + pos;
+            return true;
+        }
+
+        size_t position() const override {return this->pos;}
+        size_t size() const override {return this->data ? this->data->size() : 0;}
+
+        void close() override {
+            if(this->dirty) this->flush();
+            this->data.reset();
+        }
+
+        const char* path() const override {return this->name_path.c_str();}
+        const char* name() const override {return base_name(this->name_path);}
+        bool isDirectory() override {return false;}
+        fs::FileImplPtr openNextFile(const char*) override {return fs::FileImplPtr();}
+        operator bool() override {return this->data != nullptr;}
+
+};
+
+/**
+ * @param[in] path Path as seen by the library, ex `/log_5-24-2023.csv`.
+ *
+ * @returns The path of the file in the host directory.
+ */
+std::string SDPosixStorage::host_path(const char* path) const {
+    while(*path == '/') path++;
+    return child_path(this->root, path);
+}
+
+/**
+ * Creates the root directory if it does not exist.
+ *
+ * @returns `true` if the root is a directory.
+ */
+bool SDPosixStorage::begin(){
+    std::error_code err;
+    stdfs::create_directories(this->root, err);
+    return stdfs::is_directory(this->root, err);
+}
+
+/**
+ * Opens a file with stdio in binary mode, `FILE_APPEND` positions the file at its end, or
+ * lists a directory.
+ *
+ * @param[in] path Absolute path of the file.
+ * @param[in] mode `FILE_READ`, `FILE_WRITE`, `FILE_APPEND` or `SDSTORAGE_MODE_UPDATE`.
+ *
+ * @returns The file, which tests `false` if it could not be opened.
+ */
+File SDPosixStorage::open(const char* path, const char* mode){
+    std::string fn = this->host_path(path);
+    std::error_code err;
+
+    if(stdfs::is_directory(fn, err)){
+        std::vector<std::string> names;
+        for(const stdfs::directory_entry& entry : stdfs::directory_iterator(fn, err))
+            names.push_back(entry.path().filename().string());
+        return File(std::make_shared<SDListImpl>(this, path, names));
+    }
+
+    const char* host_mode = (mode[0] == 'w') ? "wb" : (mode[0] == 'a') ? "ab" : (mode[1] == '+') ? "r+b" : "rb";
+    FILE* fp = fopen(fn.c_str(), host_mode);
+    if(fp == NULL) return File();
+
+    if(mode[0] == 'a') fseek(fp, 0, SEEK_END);
+    return File(std::make_shared<SDPosixFileImpl>(fp, path));
+}
+
+bool SDPosixStorage::exists(const char* path){
+    std::error_code err;
+    return stdfs::exists(this->host_path(path), err);
+}
+
+bool SDPosixStorage::remove(const char* path){
+    return ::remove(this->host_path(path).c_str()) == 0;
+}
+
+bool SDPosixStorage::rename(const char* from, const char* to){
+    return ::rename(this->host_path(from).c_str(), this->host_path(to).c_str()) == 0;
+}
+
+bool SDPosixStorage::mkdir(const char* path){
+    std::error_code err;
+    stdfs::create_directories(this->host_path(path), err);
+    return !err;
+}
+
+bool SDPosixStorage::truncate(const char* path, uint32_t size){
+    std::error_code err;
+    std::string fn = this->host_path(path);
+
+    if(stdfs::file_size(fn, err) < size || err) return false;
+    stdfs::resize_file(fn, size, err);
+    return !err;
+}
+
+/**
+ * Allocates with `posix_fallocate()`, so the file system reserves the blocks without
+ * writing them, falling back to `ftruncate()` on file systems which do not support it.
+ */
+bool SDPosixStorage::preallocate(const char* path, uint32_t size){
+    int fd = ::open(this->host_path(path).c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd < 0) return false;
+
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if(ok && st.st_size < (off_t)size){
+        ok = posix_fallocate(fd, 0, size) == 0 || ftruncate(fd, size) == 0;
+    }
+
+    ::close(fd);
+    return ok;
+}
+
+/**
+ * Maps the file read only with `mmap()` and advises the kernel it will be read in order,
+ * so pages are read ahead as with buffered reads. Writes to the file after it is mapped
+ * may or may not be seen through the map, and its size is fixed when it is mapped.
+ *
+ * @param[in] path Absolute path of the file.
+ * @param[out] mapping Receives the map, reset if the file cannot be mapped.
+ *
+ * @returns `true` if the file was mapped, `false` if it is missing or empty.
+ */
+bool SDPosixStorage::map(const char* path, SDMapping& mapping){
+    mapping.reset();
+
+    int fd = ::open(this->host_path(path).c_str(), O_RDONLY);
+    if(fd < 0) return false;
+
+    struct stat st;
+    void* addr = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+        addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+
+    if(addr == MAP_FAILED) return false;
+
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    mapping.assign((const char*)addr, st.st_size);
+    return true;
+}
+
+void SDMapping::assign(const char* addr, size_t length){
+    this->reset();
+    this->addr = addr;
+    this->length = length;
+}
+
+void SDMapping::reset(){
+    if(this->addr != NULL) munmap((void*)this->addr, this->length);
+    this->addr = NULL;
+    this->length = 0;
+}
+
+/**
+ * Normalizes `path` to a single leading slash and no trailing slash.
+ */
+std::string SDMemoryStorage::key(const char* path){
+    while(*path == '/') path++;
+    std::string k = std::string("/") + path;
+    while(k.size() > 1 && k.back() == '/') k.pop_back();
+    return k;
+}
+
+/**
+ * Spins until the operation's latency passed and adds it to the total in the stats.
+ *
+ * @param[in] us Fixed cost of the operation.
+ * @param[in] bytes Bytes transferred, costing `us_per_kb` per KB.
+ */
+void SDMemoryStorage::stall(uint32_t us, size_t bytes){
+    uint64_t total = us + (uint64_t)this->latency.us_per_kb * bytes / 1024;
+    if(total == 0) return;
+
+    this->counters.latency_us += total;
+
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(total);
+    while(std::chrono::steady_clock::now() < until){}
+}
+
+/**
+ * Opens a file with the semantics of the SD library: `FILE_READ` of a missing file fails,
+ * `FILE_WRITE` truncates and `FILE_APPEND` creates the file and writes at its end. 
+ * `SDSTORAGE_MODE_UPDATE` opens an existing file at its start for reading and writing.
+ * The root and directories made by `mkdir()` open as listings.
+ *
+ * @param[in] path Absolute path of the file.
+ * @param[in] mode `FILE_READ`, `FILE_WRITE`, `FILE_APPEND` or `SDSTORAGE_MODE_UPDATE`.
+ *
+ * @returns The file, which tests `false` if it could not be opened.
+ */
+File SDMemoryStorage::open(const char* path, const char* mode){
+    std::string k = key(path);
+
+    this->counters.opens++;
+    this->stall(this->latency.open_us, 0);
+
+    if(k == "/" || this->dirs.count(k)){
+        std::string prefix = (k == "/") ? k : k + "/";
+        std::set<std::string> names;
+
+        for(const auto& f : this->files){
+            if(f.first.compare(0, prefix.size(), prefix) != 0) continue;
+            names.insert(f.first.substr(prefix.size(), f.first.find('/', prefix.size()) - prefix.size()));
+        }
+        for(const std::string& d : this->dirs){
+            if(d.size() > prefix.size() && d.compare(0, prefix.size(), prefix) == 0)
+                names.insert(d.substr(prefix.size(), d.find('/', prefix.size()) - prefix.size()));
+        }
+
+        return File(std::make_shared<SDListImpl>(this, k, std::vector<std::string>(names.begin(), names.end())));
+    }
+
+    auto it = this->files.find(k);
+    if(mode[0] == 'r'){
+        if(it == this->files.end()) return File();
+    }else if(it == this->files.end()){
+        it = this->files.emplace(k, std::make_shared<std::vector<uint8_t>>()).first;
+    }else if(mode[0] == 'w'){
+        // a fresh buffer, so handles still open on the old contents keep them
+        it->second = std::make_shared<std::vector<uint8_t>>();
+    }
+
+    return File(std::make_shared<SDMemoryFileImpl>(this, it->second, k, mode[0] == 'a'));
+}
+
+bool SDMemoryStorage::exists(const char* path){
+    std::string k = key(path);
+    this->stall(this->latency.open_us, 0);
+    return k == "/" || this->files.count(k) > 0 || this->dirs.count(k) > 0;
+}
+
+bool SDMemoryStorage::remove(const char* path){
+    this->stall(this->latency.open_us, 0);
+    return this->files.erase(key(path)) > 0;
+}
+
+bool SDMemoryStorage::rename(const char* from, const char* to){
+    this->stall(this->latency.open_us, 0);
+
+    auto it = this->files.find(key(from));
+    if(it == this->files.end()) return false;
+
+    this->files[key(to)] = it->second;
+    this->files.erase(it);
+    return true;
+}
+
+bool SDMemoryStorage::mkdir(const char* path){
+    this->stall(this->latency.open_us, 0);
+    this->dirs.insert(key(path));
+    return true;
+}
+
+/**
+ * Shortens the file in place, handles open on it see the new size.
+ */
+bool SDMemoryStorage::truncate(const char* path, uint32_t size){
+    this->stall(this->latency.open_us, 0);
+
+    auto it = this->files.find(key(path));
+    if(it == this->files.end() || it->second->size() < size) return false;
+
+    it->second->resize(size);
+    return true;
+}
+
+/**
+ * Grows the file with zeros at the cost the SD card pays for `SDStorage::preallocate()`,
+ * a write per 512 bytes and one pass over the FAT for the run of clusters.
+ */
+bool SDMemoryStorage::preallocate(const char* path, uint32_t size){
+    this->counters.opens++;
+    this->stall(this->latency.open_us, 0);
+
+    std::string k = key(path);
+    auto it = this->files.find(k);
+    if(it == this->files.end()) it = this->files.emplace(k, std::make_shared<std::vector<uint8_t>>()).first;
+
+    std::vector<uint8_t>& data = *it->second;
+    if(data.size() >= size) return true;
+
+    size_t added = size - data.size();
+    uint64_t writes = (added + 511) / 512;
+    uint64_t sectors = fat_sectors(data.size(), size);
+    data.resize(size, 0);
+
+    this->counters.writes += writes;
+    this->counters.bytes_written += added;
+    this->counters.flushes++;
+    this->counters.fat_writes += sectors;
+    this->stall(this->latency.write_us * writes + this->latency.flush_us + this->latency.alloc_us * sectors, added);
+    return true;
+}
+
+#endif
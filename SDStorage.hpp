@@ -0,0 +1,298 @@
+/**
+ * @file SDStorage.hpp
+ * @brief Storage backends behind SDLogger and SDReader: the SD card on target, a directory
+ *  or simulated card in memory on host.
+ */
+#ifndef SDSTORAGE_HPP
+#define SDSTORAGE_HPP
+
+#include <SD.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#if defined(ESP_PLATFORM)
+#include "../../include/SDCard.hpp"
+#endif
+
+#define TT_CLK 18
+#define TT_MISO 19
+#define TT_MOSI 23
+#define TT_SS 13
+
+#define SDSTORAGE_HOST_ROOT "sdcard"    // default directory of an SDPosixStorage
+#define SDSTORAGE_MOUNT_POINT "/sd"     // VFS mount point of the SD card on target
+#define SDSTORAGE_TMP_EXT ".tmp"        // copy made by the generic `truncate()`
+#define SDSTORAGE_MODE_UPDATE "r+"      // open an existing file to read and write anywhere in it
+#define SDSTORAGE_CLUSTER_SIZE 32768    // FAT32 cluster of a typical SD card, simulated by SDMemoryStorage
+#define SDSTORAGE_FAT_SECTOR_ENTRIES 128    // clusters described by one 512 byte sector of a FAT32 table
+
+#if !defined(ESP_PLATFORM)
+/**
+ * @brief A read only memory map of a whole file, filled by `SDStorage::map()` and
+ *  unmapped when reset or destroyed.
+ */
+class SDMapping {
+
+    private:
+
+        const char* addr = NULL;
+        size_t length = 0;
+
+    public:
+
+        SDMapping(){}
+        ~SDMapping(){this->reset();}
+        SDMapping(const SDMapping&) = delete;
+        SDMapping& operator=(const SDMapping&) = delete;
+
+        /**
+         * @brief Take ownership of `length` bytes mapped at `addr`, unmapping any earlier map.
+         */
+        void assign(const char* addr, size_t length);
+
+        /**
+         * @brief Unmap the file.
+         */
+        void reset();
+
+        const char* data() const {return this->addr;}
+        size_t size() const {return this->length;}
+        explicit operator bool() const {return this->addr != NULL;}
+
+};
+#endif
+
+/**
+ * @brief A filesystem files are logged to and read from, with the interface of `SDCard`.
+ *
+ * Paths are absolute, ex `/log_5-24-2023.csv`, and opening the path of a directory lists
+ * it through `File::openNextFile()`.
+ */
+class SDStorage {
+
+    public:
+
+        virtual ~SDStorage(){}
+
+        /**
+         * @brief Prepare the storage for use, `false` if it is not available.
+         */
+        virtual bool begin() = 0;
+
+        /**
+         * @brief Release the storage, `begin()` must be called before using it again.
+         */
+        virtual void end(){}
+
+        /**
+         * @brief Open `path` in `mode`, `FILE_READ`, `FILE_WRITE`, `FILE_APPEND` or `SDSTORAGE_MODE_UPDATE`.
+         */
+        virtual File open(const char* path, const char* mode = FILE_READ) = 0;
+
+        virtual bool exists(const char* path) = 0;
+        virtual bool remove(const char* path) = 0;
+        virtual bool rename(const char* from, const char* to) = 0;
+        virtual bool mkdir(const char* path) = 0;
+
+        /**
+         * @brief Shorten file `path` to `size` bytes.
+         */
+        virtual bool truncate(const char* path, uint32_t size);
+
+        /**
+         * @brief Grow file `path` to at least `size` bytes, the added bytes read as zeros.
+         */
+        virtual bool preallocate(const char* path, uint32_t size);
+
+        /**
+         * @brief `preallocate()` writes the zeros it adds, which takes seconds for a day of
+         *  logging on the SD card, so loggers only preallocate such storage ahead of time.
+         */
+        virtual bool preallocation_writes() const {return true;}
+
+#if !defined(ESP_PLATFORM)
+        /**
+         * @brief Map the whole of file `path` into memory, `false` if the storage cannot.
+         */
+        virtual bool map(const char*, SDMapping&){return false;}
+#endif
+
+};
+
+/**
+ * @brief The storage used by loggers and readers unless given another, the SD card on
+ *  target and an empty `SDMemoryStorage` without latency on host.
+ */
+SDStorage& sd_default_storage();
+
+#if defined(ESP_PLATFORM)
+/**
+ * @brief The SD card on the TT_* SPI pins.
+ */
+class SDCardStorage : public SDStorage {
+
+    private:
+
+        SDCard card;
+
+    public:
+
+        bool begin() override {return this->card.begin(TT_CLK, TT_MISO, TT_MOSI, TT_SS, &SPI);}
+        void end() override {this->card.end();}
+        File open(const char* path, const char* mode = FILE_READ) override {return this->card.open(path, mode);}
+        bool exists(const char* path) override {return this->card.exists(path);}
+        bool remove(const char* path) override {return this->card.remove(path);}
+        bool rename(const char* from, const char* to) override {return this->card.rename(from, to);}
+        bool mkdir(const char* path) override {return this->card.mkdir(path);}
+        bool truncate(const char* path, uint32_t size) override;
+
+};
+#else
+/**
+ * @brief Files in a host directory, paths are taken relative to `root`.
+ */
+class SDPosixStorage : public SDStorage {
+
+    private:
+
+        std::string root;
+
+        std::string host_path(const char* path) const;
+
+    public:
+
+        /**
+         * @brief Storage in directory `root`, created by `begin()` if missing.
+         */
+        SDPosixStorage(const std::string& root = SDSTORAGE_HOST_ROOT) : root(root) {}
+
+        bool begin() override;
+        File open(const char* path, const char* mode = FILE_READ) override;
+        bool exists(const char* path) override;
+        bool remove(const char* path) override;
+        bool rename(const char* from, const char* to) override;
+        bool mkdir(const char* path) override;
+        bool truncate(const char* path, uint32_t size) override;
+        bool preallocate(const char* path, uint32_t size) override;
+        bool preallocation_writes() const override {return false;}
+        bool map(const char* path, SDMapping& mapping) override;
+
+};
+
+/**
+ * @brief Simulated cost of SD card operations, in microseconds.
+ */
+struct SDLatency {
+    uint32_t open_us = 0;       // each open, exists, remove, rename and mkdir
+    uint32_t read_us = 0;       // each read call
+    uint32_t write_us = 0;      // each write call
+    uint32_t flush_us = 0;      // each flush, and closing a file with unflushed writes
+    uint32_t us_per_kb = 0;     // added per KB read or written
+    uint32_t alloc_us = 0;      // each FAT sector a flush writes for clusters added to a file
+};
+
+/**
+ * @brief Operations served by an `SDMemoryStorage`.
+ */
+struct SDStorageStats {
+    uint64_t opens = 0;
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t flushes = 0;
+    uint64_t fat_writes = 0;    // FAT sectors written for clusters added to files
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+    uint64_t latency_us = 0;    // total simulated latency
+};
+
+/**
+ * @brief Files held in memory, with each operation stalling the caller for the time set
+ *  by an `SDLatency` so benchmarks see the card's cost without a card.
+ *
+ * Stalls spin on the steady clock rather than sleep, sleeping is too coarse for the tens
+ * of microseconds a single SD operation takes. Not thread safe.
+ */
+class SDMemoryStorage : public SDStorage {
+
+    private:
+
+        std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files;
+        std::set<std::string> dirs;
+        SDLatency latency;
+        SDStorageStats counters;
+        uint64_t write_budget = UINT64_MAX;     // bytes which may still be written
+
+        static std::string key(const char* path);
+
+    public:
+
+        /**
+         * @brief An empty storage with per operation `latency`.
+         */
+        SDMemoryStorage(const SDLatency& latency = SDLatency()) : latency(latency) {}
+
+        bool begin() override {return true;}
+        File open(const char* path, const char* mode = FILE_READ) override;
+        bool exists(const char* path) override;
+        bool remove(const char* path) override;
+        bool rename(const char* from, const char* to) override;
+        bool mkdir(const char* path) override;
+        bool truncate(const char* path, uint32_t size) override;
+        bool preallocate(const char* path, uint32_t size) override;
+
+        /**
+         * @brief Like the SD card, preallocation writes its zeros when card latency is simulated.
+         */
+        bool preallocation_writes() const override {return this->latency.write_us > 0 || this->latency.us_per_kb > 0;}
+
+        /**
+         * @brief Set the simulated latency of later operations.
+         */
+        void set_latency(const SDLatency& latency){this->latency = latency;}
+
+        /**
+         * @brief Simulated latency of each operation.
+         */
+        const SDLatency& get_latency() const {return this->latency;}
+
+        /**
+         * @brief Stall for an operation costing `us` plus `bytes` at the per KB rate.
+         */
+        void stall(uint32_t us, size_t bytes);
+
+        /**
+         * @brief Let only `bytes` more bytes be written, later writes are cut short as on
+         *  a full card. `UINT64_MAX` removes the limit.
+         */
+        void set_write_limit(uint64_t bytes){this->write_budget = bytes;}
+
+        /**
+         * @brief Bytes of a write of `size` which fit the write limit, they are used up.
+         */
+        size_t grant_write(size_t size){
+            if(size > this->write_budget) size = this->write_budget;
+            if(this->write_budget != UINT64_MAX) this->write_budget -= size;
+            return size;
+        }
+
+        /**
+         * @brief Operations served so far.
+         */
+        SDStorageStats& stats(){return this->counters;}
+
+        /**
+         * @brief Delete all files.
+         */
+        void clear(){
+            this->files.clear();
+            this->dirs.clear();
+        }
+
+};
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * @file SDTask.hpp
+ * @brief Portable helpers for the library's background tasks, FreeRTOS tasks on target and
+ *  `std::thread` on host.
+ */
+#ifndef SDTASK_HPP
+#define SDTASK_HPP
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#else
+#include <chrono>
+#include <mutex>
+#include <thread>
+#endif
+
+/**
+ * @brief Sleep the calling task/thread for `ms` milliseconds, a value of 0 only yields.
+ */
+inline void sd_task_sleep(unsigned long ms){
+#if defined(ESP_PLATFORM)
+    vTaskDelay(ms > 0 ? pdMS_TO_TICKS(ms) : 1);
+#else
+    if(ms == 0) std::this_thread::yield();
+    else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+#endif
+}
+
+/**
+ * @brief A mutex shared by tasks, a FreeRTOS mutex on target and a `std::mutex` on host.
+ */
+class SDMutex {
+
+    private:
+
+#if defined(ESP_PLATFORM)
+        SemaphoreHandle_t handle = xSemaphoreCreateMutex();
+#else
+        std::mutex handle;
+#endif
+
+    public:
+
+        SDMutex(){}
+        SDMutex(const SDMutex&) = delete;
+        SDMutex& operator=(const SDMutex&) = delete;
+
+#if defined(ESP_PLATFORM)
+        ~SDMutex(){vSemaphoreDelete(this->handle);}
+
+        void lock(){xSemaphoreTake(this->handle, portMAX_DELAY);}
+        void unlock(){xSemaphoreGive(this->handle);}
+#else
+        void lock(){this->handle.lock();}
+        void unlock(){this->handle.unlock();}
+#endif
+
+};
+
+#endif
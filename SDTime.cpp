@@ -0,0 +1,96 @@
+/**
+ * @file SDTime.cpp
+ */
+#include "SDTime.hpp"
+
+#include <cstdio>
+
+/**
+ * Reads a run of up to `max` digits from `s` starting at `i`.
+ *
+ * @returns `false` if there is no digit at `i`.
+ */
+static inline bool read_digits(std::string_view s, size_t& i, size_t max, unsigned& value){
+    size_t start = i;
+    value = 0;
+
+    while(i < s.size() && i - start < max && (unsigned)(s[i] - '0') < 10){
+        value = value * 10 + (s[i] - '0');
+        i++;
+    }
+
+    return i > start;
+}
+
+/**
+ * Parses a time stamp field of the form `M-D-YYYYTHH:MM:SS`, optionally followed by a
+ * relative `+offset` in minutes which is added to the result. The date is only converted
+ * when it differs from the date of the previous call.
+ *
+ * @param[in] ts The time stamp field, without the separator.
+ * @param[out] epoch Seconds since 1970-01-01 (UTC).
+ *
+ * @returns `true` if `ts` was a valid time stamp.
+ */
+bool SDTimeParser::parse(std::string_view ts, int64_t& epoch){
+    size_t t = ts.find('T');
+    if(t == std::string_view::npos || t == 0 || t > sizeof(this->date)) return false;
+
+    if(t != this->date_len || memcmp(ts.data(), this->date, t) != 0){
+        size_t i = 0;
+        unsigned month, day, year;
+
+        if(!read_digits(ts, i, 2, month) || i >= t || ts[i++] != '-') return false;
+        if(!read_digits(ts, i, 2, day) || i >= t || ts[i++] != '-') return false;
+        if(!read_digits(ts, i, 4, year) || i != t) return false;
+        if(month < 1 || month > 12 || day < 1 || day > 31) return false;
+
+        memcpy(this->date, ts.data(), t);
+        this->date_len = t;
+        this->midnight = sd_days_from_civil(year, month, day) * SD_SECS_PER_DAY;
+    }
+
+    size_t i = t + 1;
+    unsigned hour, minute, second;
+
+    if(!read_digits(ts, i, 2, hour) || i >= ts.size() || ts[i++] != ':') return false;
+    if(!read_digits(ts, i, 2, minute) || i >= ts.size() || ts[i++] != ':') return false;
+    if(!read_digits(ts, i, 2, second)) return false;
+
+    int64_t offset = 0;
+    if(i < ts.size() && ts[i] == '+'){
+        i++;
+        bool negative = (i < ts.size() && ts[i] == '-');
+        if(negative) i++;
+
+        unsigned off;
+        if(!read_digits(ts, i, 9, off)) return false;
+        offset = negative ? -(int64_t)off : (int64_t)off;
+    }
+
+    if(i != ts.size()) return false;
+
+    epoch = this->midnight + hour * 3600 + minute * 60 + second + offset * SD_OFFSET_UNIT;
+    return true;
+}
+
+/**
+ * Formats an epoch the way SDLogger writes time stamps, used to turn binary records back
+ * into lines.
+ *
+ * @param[in] epoch Seconds since 1970-01-01 (UTC).
+ * @param[out] buf Destination, must hold at least `SD_TIME_CHARS` characters.
+ *
+ * @returns The number of characters written, no terminator is added.
+ */
+size_t sd_format_time(int64_t epoch, char* buf){
+    int64_t midnight = sd_day_start(epoch);
+    int64_t secs = epoch - midnight;
+
+    int64_t year;
+    unsigned month, day;
+    sd_civil_from_days(midnight / SD_SECS_PER_DAY, year, month, day);
+
+    return snprintf(buf, SD_TIME_CHARS, "%u-%u-%ldT%02u:%02u:%02u", month, day, (long)year,
+            (unsigned)(secs / 3600), (unsigned)(secs / 60 % 60), (unsigned)(secs % 60));
+}
@@ -0,0 +1,91 @@
+/**
+ * @file SDTime.hpp
+ * @brief Calendar helpers shared by SDLogger and SDReader for converting between dates
+ *  and epochs without going through TimeStamp.
+ *
+ * Dates are treated as UTC civil dates in the proleptic Gregorian calendar.
+ */
+#ifndef SDTIME_HPP
+#define SDTIME_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#define SD_SECS_PER_DAY 86400
+#define SD_OFFSET_UNIT 60       // seconds per unit of the `+offset` suffix (minutes)
+#define SD_TIME_CHARS 24        // characters needed by `sd_format_time()`
+
+/**
+ * @brief Number of days from 1970-01-01 to the date `year`-`month`-`day`.
+ */
+inline int64_t sd_days_from_civil(int64_t year, unsigned month, unsigned day){
+    year -= (month <= 2);
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = (unsigned)(year - era * 400);
+    const unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+/**
+ * @brief Date of the day `days` after 1970-01-01.
+ */
+inline void sd_civil_from_days(int64_t days, int64_t& year, unsigned& month, unsigned& day){
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = (unsigned)(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = (int64_t)yoe + era * 400 + (month <= 2);
+}
+
+/**
+ * @brief Epoch of midnight at the start of the day containing `epoch`.
+ */
+inline int64_t sd_day_start(int64_t epoch){
+    int64_t days = epoch / SD_SECS_PER_DAY;
+    if(epoch % SD_SECS_PER_DAY < 0) days--;
+    return days * SD_SECS_PER_DAY;
+}
+
+/**
+ * @brief Write `epoch` as a `M-D-YYYYTHH:MM:SS` time stamp, returns the length.
+ */
+size_t sd_format_time(int64_t epoch, char* buf);
+
+/**
+ * @brief Parses the `M-D-YYYYTHH:MM:SS[+offset]` time stamps written by SDLogger straight
+ *  into an epoch.
+ *
+ * Every line of a daily file shares the same date, so the epoch of midnight for the last
+ * date parsed is cached and reused while the date characters match. No memory is 
+ * allocated.
+ */
+class SDTimeParser {
+
+    private:
+
+        char date[16];          // date characters of the cached day
+        size_t date_len = 0;
+        int64_t midnight = 0;   // epoch of the cached day
+
+    public:
+
+        /**
+         * @brief Parse `ts` into `epoch`, `false` if `ts` is not a time stamp.
+         */
+        bool parse(std::string_view ts, int64_t& epoch);
+
+        /**
+         * @brief Forget the cached day.
+         */
+        void reset(){this->date_len = 0;}
+
+};
+
+#endif
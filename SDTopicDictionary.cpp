@@ -0,0 +1,247 @@
+/**
+ * @file SDTopicDictionary.cpp
+ */
+#include "SDTopicDictionary.hpp"
+#include "SDLineReader.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+/**
+ * @param[in] field A topic field from a log line.
+ * @param[out] id The topic ID if `field` is encoded.
+ *
+ * @returns `true` if `field` has the form `@<id>`, an escaped topic `@@...` is not an ID.
+ */
+bool SDTopicDictionary::parse_ref(std::string_view field, uint16_t& id){
+    if(field.size() < 2 || field.size() > 6 || field[0] != '@') return false;
+
+    uint32_t value = 0;
+    for(size_t i = 1; i < field.size(); i++){
+        if(field[i] < '0' || field[i] > '9') return false;
+        value = value * 10 + (field[i] - '0');
+    }
+
+    if(value > SDLOGGER_DICT_MAX_TOPICS) return false;
+    id = value;
+    return true;
+}
+
+/**
+ * Finishes a rewrite by `set_start()` which a power loss cut off after the old sidecar
+ * was removed, by renaming `<sidecar>.tmp` to the sidecar.
+ *
+ * @param[in] sd The card holding the file.
+ * @param[in] fn The log file name.
+ *
+ * @returns `true` unless a left behind copy could not be renamed.
+ */
+bool SDTopicDictionary::recover(SDStorage& sd, const std::string& fn){
+    std::string dict_fn = filename(fn);
+    std::string tmp = dict_fn + SDSTORAGE_TMP_EXT;
+    if(!sd.exists(tmp.c_str())) return true;
+
+    if(sd.exists(dict_fn.c_str())) return sd.remove(tmp.c_str());
+    return sd.rename(tmp.c_str(), dict_fn.c_str());
+}
+
+void SDTopicDictionary::clear(){
+    this->by_topic.clear();
+    this->by_id.clear();
+    this->start = 0;
+    this->end = UINT32_MAX;
+    this->present = false;
+}
+
+/**
+ * Reads the `.tdx` sidecar of log file `fn`. Lines which are not the start or end offset
+ * or `<id>;<topic>` with the next expected ID are ignored.
+ *
+ * @param[in] sd The card holding the file.
+ * @param[in] fn The log file name.
+ *
+ * @returns `true` if the dictionary exists.
+ */
+bool SDTopicDictionary::load(SDStorage& sd, const std::string& fn){
+    this->clear();
+
+    std::string dict_fn = filename(fn);
+    if(!sd.exists(dict_fn.c_str())) return false;
+
+    File f = sd.open(dict_fn.c_str(), "r");
+    if(!f) return false;
+
+    SDLineReader lines(512);
+    lines.attach(&f);
+
+    std::string_view line;
+    while(lines.next(line)){
+        if(!line.empty() && line[0] == '#'){
+            this->start = strtoul(std::string(line.substr(1)).c_str(), NULL, 10);
+            continue;
+        }
+
+        if(!line.empty() && line[0] == '!'){
+            uint32_t offset = strtoul(std::string(line.substr(1)).c_str(), NULL, 10);
+            if(offset < this->end) this->end = offset;
+            continue;
+        }
+
+        size_t sep = line.find(';');
+        if(sep == std::string_view::npos) continue;
+
+        uint32_t id = strtoul(std::string(line.substr(0, sep)).c_str(), NULL, 10);
+        if(id != this->by_id.size()) continue;
+
+        std::string_view topic = line.substr(sep + 1);
+        this->by_id.emplace_back(topic);
+
+        auto it = std::lower_bound(this->by_topic.begin(), this->by_topic.end(), topic,
+                [](const std::pair<std::string, uint16_t>& e, std::string_view t){return std::string_view(e.first) < t;});
+        this->by_topic.insert(it, std::make_pair(std::string(topic), (uint16_t)id));
+    }
+
+    f.close();
+    this->present = true;
+    return true;
+}
+
+/**
+ * Writes a new sidecar for `fn` holding only the start offset.
+ *
+ * @param[in] sd The card holding the file.
+ * @param[in] fn The log file name.
+ * @param[in] offset Offset of the first log line which will use topic IDs.
+ *
+ * @returns `true` if the sidecar was written.
+ */
+bool SDTopicDictionary::create(SDStorage& sd, const std::string& fn, uint32_t offset){
+    this->clear();
+
+    File f = sd.open(filename(fn).c_str(), FILE_WRITE);
+    if(!f){
+        Serial.println("[ERROR] failed to create topic dictionary");
+        return false;
+    }
+
+    std::string header = "#" + std::to_string(offset) + "\n";
+    f.write((const uint8_t*)header.data(), header.size());
+    f.close();
+
+    this->start = offset;
+    this->present = true;
+    return true;
+}
+
+/**
+ * Writes the sidecar of `fn` anew with start offset `offset` and the loaded topics, 
+ * dropping the end offset. The
+ * new sidecar is written to `<sidecar>.tmp` and renamed over the old one, `recover()`
+ * puts back a copy left behind by a power loss between the two steps.
+ *
+ * @param[in] sd The card holding the file.
+ * @param[in] fn The log file name.
+ * @param[in] offset Offset of the first log line using topic IDs.
+ *
+ * @returns `true` if the sidecar was rewritten.
+ */
+bool SDTopicDictionary::set_start(SDStorage& sd, const std::string& fn, uint32_t offset){
+    std::string dict_fn = filename(fn);
+    std::string tmp = dict_fn + SDSTORAGE_TMP_EXT;
+
+    File f = sd.open(tmp.c_str(), FILE_WRITE);
+    if(!f){
+        Serial.println("[ERROR] failed to rewrite topic dictionary");
+        return false;
+    }
+
+    std::string text = "#" + std::to_string(offset) + "\n";
+    for(size_t id = 0; id < this->by_id.size(); id++)
+        text += std::to_string(id) + ";" + this->by_id[id] + "\n";
+
+    bool ok = f.write((const uint8_t*)text.data(), text.size()) == text.size();
+    f.close();
+
+    if(!ok || !sd.remove(dict_fn.c_str()) || !sd.rename(tmp.c_str(), dict_fn.c_str())){
+        Serial.println("[ERROR] failed to rewrite topic dictionary");
+        sd.remove(tmp.c_str());
+        return false;
+    }
+
+    this->start = offset;
+    this->end = UINT32_MAX;
+    return true;
+}
+
+/**
+ * Appends `!<offset>` to the sidecar of `fn`, called by the logger before it writes the
+ * first topic as is after encoding started, ex after `disable_topic_dictionary()`. 
+ * Readers looking for topics which are not in the dictionary then scan the file from 
+ * there as well as before the start offset. Only the first end offset is kept.
+ *
+ * @param[in] sd The card holding the file.
+ * @param[in] fn The log file name.
+ * @param[in] offset Offset of the line with the topic written as is.
+ *
+ * @returns `true` if the end offset was recorded.
+ */
+bool SDTopicDictionary::set_end(SDStorage& sd, const std::string& fn, uint32_t offset){
+    if(offset >= this->end) return true;
+
+    File f = sd.open(filename(fn).c_str(), FILE_APPEND);
+    if(!f){
+        Serial.println("[ERROR] failed to append to topic dictionary");
+        return false;
+    }
+
+    std::string entry = "!" + std::to_string(offset) + "\n";
+    bool ok = f.write((const uint8_t*)entry.data(), entry.size()) == entry.size();
+    f.close();
+
+    if(ok) this->end = offset;
+    return ok;
+}
+
+/**
+ * Looks up a topic without allocating.
+ *
+ * @returns The topic's ID, or `-1`.
+ */
+int SDTopicDictionary::find(std::string_view topic) const {
+    auto it = std::lower_bound(this->by_topic.begin(), this->by_topic.end(), topic,
+            [](const std::pair<std::string, uint16_t>& e, std::string_view t){return std::string_view(e.first) < t;});
+
+    return (it != this->by_topic.end() && it->first == topic) ? it->second : -1;
+}
+
+/**
+ * Assigns the next ID to `topic` and appends `<id>;<topic>` to the sidecar before the
+ * ID is used in the log file, so a reader never sees an ID it cannot resolve.
+ *
+ * @param[in] sd The card holding the file.
+ * @param[in] fn The log file name.
+ * @param[in] topic The new topic, must not contain a newline.
+ *
+ * @returns The new ID, or `-1` if the dictionary is full or could not be written.
+ */
+int SDTopicDictionary::add(SDStorage& sd, const std::string& fn, std::string_view topic){
+    if(this->by_id.size() >= SDLOGGER_DICT_MAX_TOPICS) return -1;
+
+    File f = sd.open(filename(fn).c_str(), FILE_APPEND);
+    if(!f){
+        Serial.println("[ERROR] failed to append to topic dictionary");
+        return -1;
+    }
+
+    uint16_t id = this->by_id.size();
+    std::string entry = std::to_string(id) + ";" + std::string(topic) + "\n";
+    f.write((const uint8_t*)entry.data(), entry.size());
+    f.close();
+
+    this->by_id.emplace_back(topic);
+    auto it = std::lower_bound(this->by_topic.begin(), this->by_topic.end(), topic,
+            [](const std::pair<std::string, uint16_t>& e, std::string_view t){return std::string_view(e.first) < t;});
+    this->by_topic.insert(it, std::make_pair(std::string(topic), id));
+
+    return id;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file SDTopicDictionary.hpp
+ * @brief Per-file dictionary mapping MQTT topics to short numeric IDs.
+ *
+ * The dictionary is a sidecar file named `<log file>.tdx`. Its first line, `#<offset>`,
+ * gives the byte offset from which the log file writes topic IDs, every following line is
+ * `<id>;<topic>`, or `!<offset>` once the log file writes a topic as is again after that
+ * offset. In the log file an encoded topic field is written as `@<id>`. A topic which 
+ * itself begins with `@` is written with the `@` doubled, in every text log file, so it
+ * is never taken for an ID.
+ */
+#ifndef SDTOPICDICTIONARY_HPP
+#define SDTOPICDICTIONARY_HPP
+
+#include <SD.h>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "SDStorage.hpp"
+
+#define SDLOGGER_DICT_EXT ".tdx"        // appended to the log file name
+#define SDLOGGER_DICT_MAX_TOPICS 65535  // IDs are 16 bit
+
+/**
+ * @brief Topics used in one log file and their IDs, loaded from and appended to the
+ *  file's `.tdx` sidecar.
+ */
+class SDTopicDictionary {
+
+    private:
+
+        std::vector<std::pair<std::string, uint16_t>> by_topic;    // sorted by topic
+        std::vector<std::string> by_id;
+        uint32_t start = 0;     // offset in the log file where encoded topics begin
+        uint32_t end = UINT32_MAX;  // offset of the first topic written as is after `start`
+        bool present = false;   // a sidecar exists for the file
+
+    public:
+
+        /**
+         * @brief Name of the dictionary belonging to log file `fn`.
+         */
+        static std::string filename(const std::string& fn){return fn + SDLOGGER_DICT_EXT;}
+
+        /**
+         * @brief Parse an encoded topic field `@<id>`.
+         */
+        static bool parse_ref(std::string_view field, uint16_t& id);
+
+        /**
+         * @brief A topic field holding a topic beginning with `@`, written as `@@...`.
+         */
+        static bool escaped(std::string_view field){return field.size() >= 2 && field[0] == '@' && field[1] == '@';}
+
+        /**
+         * @brief `true` if `topic` is written with its leading `@` doubled.
+         */
+        static bool needs_escape(std::string_view topic){return !topic.empty() && topic[0] == '@';}
+
+        /**
+         * @brief Finish a sidecar rewrite of log file `fn` cut off by a power loss.
+         */
+        static bool recover(SDStorage& sd, const std::string& fn);
+
+        /**
+         * @brief Forget all topics.
+         */
+        void clear();
+
+        /**
+         * @brief Load the dictionary of log file `fn`, `false` if it has none.
+         */
+        bool load(SDStorage& sd, const std::string& fn);
+
+        /**
+         * @brief Create an empty dictionary for `fn` whose encoded topics start at `offset`.
+         */
+        bool create(SDStorage& sd, const std::string& fn, uint32_t offset);
+
+        /**
+         * @brief Rewrite the sidecar of `fn` with encoded topics starting at `offset`.
+         */
+        bool set_start(SDStorage& sd, const std::string& fn, uint32_t offset);
+
+        /**
+         * @brief Record in the sidecar of `fn` that topics are written as is again from `offset`.
+         */
+        bool set_end(SDStorage& sd, const std::string& fn, uint32_t offset);
+
+        /**
+         * @brief ID of `topic`, or `-1` if it has none.
+         */
+        int find(std::string_view topic) const;
+
+        /**
+         * @brief Give `topic` the next ID and append it to the sidecar of `fn`.
+         */
+        int add(SDStorage& sd, const std::string& fn, std::string_view topic);
+
+        /**
+         * @brief Topic with ID `id`.
+         */
+        const std::string& topic(uint16_t id) const {return this->by_id[id];}
+
+        /**
+         * @brief Number of topics, IDs are `0` to `size() - 1`.
+         */
+        size_t size() const {return this->by_id.size();}
+
+        /**
+         * @brief Offset in the log file from which topics are encoded.
+         */
+        uint32_t start_offset() const {return this->start;}
+
+        /**
+         * @brief Offset from which topics may be written as is again, `UINT32_MAX` if none.
+         */
+        uint32_t end_offset() const {return this->end;}
+
+        /**
+         * @brief A dictionary was loaded or created.
+         */
+        bool exists() const {return this->present;}
+
+};
+
+#endif
@@ -0,0 +1,245 @@
+/**
+ * @file SDTopicFilter.cpp
+ */
+#include "SDTopicFilter.hpp"
+
+#include <algorithm>
+
+/**
+ * @returns `true` if one of the `/` separated levels of `pattern` is `+` or `#`.
+ */
+static bool is_wildcard(std::string_view pattern){
+    size_t pos = 0;
+    for(;;){
+        size_t slash = pattern.find('/', pos);
+        std::string_view level = pattern.substr(pos, (slash == std::string_view::npos) ? std::string_view::npos : slash - pos);
+
+        if(level == "+" || level == "#") return true;
+        if(slash == std::string_view::npos) return false;
+        pos = slash + 1;
+    }
+}
+
+/**
+ * Removes all patterns, leaving only the root of each trie.
+ */
+void SDTopicFilter::clear(){
+    this->match_all = false;
+    this->substrings.assign(1, CharNode());
+    this->prefixes.assign(1, CharNode());
+    this->levels.assign(1, LevelNode());
+    this->single.clear();
+    this->has_substrings = false;
+    this->has_prefixes = false;
+    this->has_levels = false;
+}
+
+/**
+ * Compiles the pattern list, see the class description for the pattern syntax.
+ *
+ * @param[in] patterns The topic filter list, as passed to SDReader's range queries.
+ */
+void SDTopicFilter::compile(const std::vector<std::string>& patterns){
+    this->clear();
+
+    if(patterns.size() == 1 && patterns[0] == ""){
+        this->match_all = true;
+        return;
+    }
+
+    size_t substring_count = 0;
+    for(const std::string& p : patterns){
+        if(p.empty()) continue;
+
+        if(p[0] == '^'){
+            this->prefixes[add_chars(this->prefixes, std::string_view(p).substr(1))].out = true;
+            this->has_prefixes = true;
+
+        }else if(is_wildcard(p)){
+            this->add_levels(p);
+            this->has_levels = true;
+
+        }else{
+            this->substrings[add_chars(this->substrings, p)].out = true;
+            this->has_substrings = true;
+            if(substring_count++ == 0) this->single = p;
+        }
+    }
+
+    if(substring_count > 1) this->single.clear();
+    this->link_substrings();
+}
+
+/**
+ * @returns The child of `node` for character `c`, or `-1`.
+ */
+int SDTopicFilter::child(const std::vector<CharNode>& nodes, int node, char c){
+    const std::vector<std::pair<char, int>>& next = nodes[node].next;
+
+    auto it = std::lower_bound(next.begin(), next.end(), c,
+            [](const std::pair<char, int>& e, char c){return e.first < c;});
+
+    return (it != next.end() && it->first == c) ? it->second : -1;
+}
+
+/**
+ * Inserts `pattern` into a character trie.
+ *
+ * @returns The node at the end of the pattern.
+ */
+int SDTopicFilter::add_chars(std::vector<CharNode>& nodes, std::string_view pattern){
+    int node = 0;
+
+    for(char c : pattern){
+        int next = child(nodes, node, c);
+
+        if(next < 0){
+            next = nodes.size();
+            nodes.emplace_back();
+
+            std::vector<std::pair<char, int>>& edges = nodes[node].next;
+            auto it = std::lower_bound(edges.begin(), edges.end(), c,
+                    [](const std::pair<char, int>& e, char c){return e.first < c;});
+            edges.insert(it, std::make_pair(c, next));
+        }
+
+        node = next;
+    }
+
+    return node;
+}
+
+/**
+ * Inserts a wildcard pattern into the level trie. Levels after a `#` are ignored.
+ */
+void SDTopicFilter::add_levels(std::string_view pattern){
+    int node = 0;
+    size_t pos = 0;
+
+    for(;;){
+        size_t slash = pattern.find('/', pos);
+        std::string_view level = pattern.substr(pos, (slash == std::string_view::npos) ? std::string_view::npos : slash - pos);
+
+        if(level == "#"){
+            this->levels[node].hash = true;
+            return;
+
+        }else if(level == "+"){
+            if(this->levels[node].plus < 0){
+                this->levels[node].plus = this->levels.size();
+                this->levels.emplace_back();
+            }
+            node = this->levels[node].plus;
+
+        }else{
+            std::vector<std::pair<std::string, int>>& next = this->levels[node].next;
+            auto it = std::lower_bound(next.begin(), next.end(), level,
+                    [](const std::pair<std::string, int>& e, std::string_view l){return std::string_view(e.first) < l;});
+
+            if(it != next.end() && it->first == level){
+                node = it->second;
+            }else{
+                int created = this->levels.size();
+                next.insert(it, std::make_pair(std::string(level), created));
+                this->levels.emplace_back();
+                node = created;
+            }
+        }
+
+        if(slash == std::string_view::npos) break;
+        pos = slash + 1;
+    }
+
+    this->levels[node].out = true;
+}
+
+/**
+ * Computes the Aho-Corasick failure links of the substring automaton breadth first, and
+ * marks every node whose fail chain reaches the end of a pattern.
+ */
+void SDTopicFilter::link_substrings(){
+    std::vector<int> queue;
+    queue.reserve(this->substrings.size());
+
+    for(const std::pair<char, int>& e : this->substrings[0].next){
+        this->substrings[e.second].fail = 0;
+        queue.push_back(e.second);
+    }
+
+    for(size_t head = 0; head < queue.size(); head++){
+        int u = queue[head];
+
+        for(const std::pair<char, int>& e : this->substrings[u].next){
+            int f = this->substrings[u].fail;
+            while(f != 0 && child(this->substrings, f, e.first) < 0)
+                f = this->substrings[f].fail;
+
+            int g = child(this->substrings, f, e.first);
+            CharNode& v = this->substrings[e.second];
+            v.fail = (g >= 0 && g != e.second) ? g : 0;
+            v.out = v.out || this->substrings[v.fail].out;
+
+            queue.push_back(e.second);
+        }
+    }
+}
+
+/**
+ * Walks the level trie for the levels of `topic` starting at `pos`, `pos` is `npos` once
+ * every level has been consumed.
+ */
+bool SDTopicFilter::match_levels(int node, std::string_view topic, size_t pos) const {
+    const LevelNode& n = this->levels[node];
+
+    if(n.hash) return true;     // `#` also matches the parent level
+    if(pos == std::string_view::npos) return n.out;
+
+    size_t slash = topic.find('/', pos);
+    std::string_view level = topic.substr(pos, (slash == std::string_view::npos) ? std::string_view::npos : slash - pos);
+    size_t next = (slash == std::string_view::npos) ? std::string_view::npos : slash + 1;
+
+    if(n.plus >= 0 && this->match_levels(n.plus, topic, next)) return true;
+
+    auto it = std::lower_bound(n.next.begin(), n.next.end(), level,
+            [](const std::pair<std::string, int>& e, std::string_view l){return std::string_view(e.first) < l;});
+
+    return it != n.next.end() && it->first == level && this->match_levels(it->second, topic, next);
+}
+
+/**
+ * @param[in] topic The topic field of a logged line.
+ *
+ * @returns `true` if any pattern matches `topic`.
+ */
+bool SDTopicFilter::match(std::string_view topic) const {
+    if(this->match_all) return true;
+
+    if(this->has_prefixes){
+        int node = 0;
+        for(char c : topic){
+            if(this->prefixes[node].out) return true;
+            node = child(this->prefixes, node, c);
+            if(node < 0) break;
+        }
+        if(node >= 0 && this->prefixes[node].out) return true;
+    }
+
+    if(this->has_substrings && !this->single.empty()){
+        if(topic.find(this->single) != std::string_view::npos) return true;
+
+    }else if(this->has_substrings){
+        int state = 0;
+        for(char c : topic){
+            int next;
+            while((next = child(this->substrings, state, c)) < 0 && state != 0)
+                state = this->substrings[state].fail;
+
+            state = (next >= 0) ? next : 0;
+            if(this->substrings[state].out) return true;
+        }
+    }
+
+    if(this->has_levels && this->match_levels(0, topic, 0)) return true;
+
+    return false;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file SDTopicFilter.hpp
+ * @brief Topic filter compiled once per query and matched against the topic of every line.
+ */
+#ifndef SDTOPICFILTER_HPP
+#define SDTOPICFILTER_HPP
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Matches MQTT topics against a list of patterns, a topic matches if any pattern
+ *  matches it.
+ *
+ * Patterns are written as:
+ *  - `^prefix` matches topics starting with `prefix`.
+ *  - patterns with a `+` or `#` level, ex `meter_teros10/+/08:3A:F2:31:9B:D0` or `kkm_k6p/#`,
+ *    use MQTT wildcard rules.
+ *  - anything else matches topics containing the pattern, as the original filter did.
+ *  - a list holding only `""` matches every topic, an empty list matches nothing.
+ *
+ * Substring patterns are compiled into an Aho-Corasick automaton, prefixes into a trie of
+ * characters and wildcard patterns into a trie of topic levels, so the cost of `match()`
+ * depends on the topic length rather than the number of patterns. A lone substring
+ * pattern, the usual query, skips the automaton for `std::string_view::find()`, whose
+ * `memchr()` for the first character skips most of the topic a vector at a time.
+ */
+class SDTopicFilter {
+
+    private:
+
+        struct CharNode {
+            std::vector<std::pair<char, int>> next;   // sorted by character
+            int fail = 0;
+            bool out = false;       // a pattern ends here or on the fail chain
+        };
+
+        struct LevelNode {
+            std::vector<std::pair<std::string, int>> next;   // sorted by level
+            int plus = -1;          // child for a `+` level
+            bool hash = false;      // a `#` level follows
+            bool out = false;       // a pattern ends here
+        };
+
+        bool match_all = false;
+
+        std::vector<CharNode> substrings;   // Aho-Corasick automaton, node 0 is the root
+        std::vector<CharNode> prefixes;     // character trie, node 0 is the root
+        std::vector<LevelNode> levels;      // topic level trie, node 0 is the root
+        std::string single;     // the only substring pattern, searched for directly
+        bool has_substrings = false;
+        bool has_prefixes = false;
+        bool has_levels = false;
+
+        static int child(const std::vector<CharNode>& nodes, int node, char c);
+        static int add_chars(std::vector<CharNode>& nodes, std::string_view pattern);
+        void add_levels(std::string_view pattern);
+        void link_substrings();
+        bool match_levels(int node, std::string_view topic, size_t pos) const;
+
+    public:
+
+        /**
+         * @brief An empty filter which matches nothing.
+         */
+        SDTopicFilter(){this->clear();}
+
+        /**
+         * @brief Compile the filter from a list of patterns.
+         */
+        SDTopicFilter(const std::vector<std::string>& patterns){this->compile(patterns);}
+
+        /**
+         * @brief Replace the filter with one compiled from `patterns`.
+         */
+        void compile(const std::vector<std::string>& patterns);
+
+        /**
+         * @brief Remove all patterns.
+         */
+        void clear();
+
+        /**
+         * @brief `topic` matches one of the patterns.
+         */
+        bool match(std::string_view topic) const;
+
+        /**
+         * @brief The filter matches every topic.
+         */
+        bool matches_all() const {return this->match_all;}
+
+};
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * @file SDWorkPool.cpp
+ */
+#include "SDWorkPool.hpp"
+
+#if !defined(ESP_PLATFORM)
+
+/**
+ * Deals the tasks into the workers' deques and starts the workers. A pool still running
+ * tasks from an earlier `start()` is waited for first.
+ *
+ * @param[in] count Number of tasks, numbered from `0`.
+ * @param[in] threads Worker threads, `0` for `default_threads()`.
+ * @param[in] work Called with the number of each task, from the workers concurrently.
+ * @param[in] limit If set, a task is only taken once its number is below `*limit`.
+ */
+void SDWorkPool::start(size_t count, size_t threads, std::function<void(size_t)> work, const std::atomic<size_t>* limit){
+    this->wait();
+
+    if(threads == 0) threads = default_threads();
+    if(threads > count) threads = (count > 0) ? count : 1;
+
+    this->work = std::move(work);
+    this->limit = limit;
+    this->remaining = count;
+    this->steals = 0;
+
+    this->workers.clear();
+    for(size_t i = 0; i < threads; i++) this->workers.push_back(std::make_unique<Worker>());
+    for(size_t t = 0; t < count; t++) this->workers[t % threads]->tasks.push_back(t);
+
+    for(size_t i = 0; i < threads; i++)
+        this->workers[i]->thread = std::thread(&SDWorkPool::worker_loop, this, i);
+}
+
+/**
+ * Joins the workers, which exit once every task has been taken and run.
+ */
+void SDWorkPool::wait(){
+    for(std::unique_ptr<Worker>& w : this->workers){
+        if(w->thread.joinable()) w->thread.join();
+    }
+}
+
+/**
+ * Takes the next task for worker `self`: the front of its own deque, or else a task
+ * stolen from another worker. Tasks not below the limit are left in place.
+ *
+ * @param[in] self The worker taking a task.
+ * @param[out] task The task taken.
+ *
+ * @returns `true` if a task was taken.
+ */
+bool SDWorkPool::take(size_t self, size_t& task){
+    size_t below = (this->limit != NULL) ? this->limit->load() : SIZE_MAX;
+
+    {
+        Worker& own = *this->workers[self];
+        std::lock_guard<std::mutex> hold(own.lock);
+
+        if(!own.tasks.empty() && own.tasks.front() < below){
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    for(size_t i = 1; i < this->workers.size(); i++){
+        Worker& victim = *this->workers[(self + i) % this->workers.size()];
+        std::lock_guard<std::mutex> hold(victim.lock);
+
+        if(victim.tasks.empty()) continue;
+
+        if(victim.tasks.back() < below){
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+        }else if(victim.tasks.front() < below){
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+        }else{
+            continue;
+        }
+
+        this->steals++;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Runs tasks until none are left to take, sleeping while the only tasks left are held
+ * back by the limit or still being run by other workers.
+ *
+ * @param[in] self The worker's index.
+ */
+void SDWorkPool::worker_loop(size_t self){
+    size_t task;
+
+    while(this->remaining.load() > 0){
+        if(!this->take(self, task)){
+            sd_task_sleep(SDWORKPOOL_POLL_MS);
+            continue;
+        }
+
+        this->remaining--;
+        this->work(task);
+    }
+}
+
+/**
+ * @returns The number of hardware threads, at least `1`.
+ */
+size_t SDWorkPool::default_threads(){
+    unsigned n = std::thread::hardware_concurrency();
+    return (n > 0) ? n : 1;
+}
+#endif
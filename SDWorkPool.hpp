@@ -0,0 +1,88 @@
+/**
+ * @file SDWorkPool.hpp
+ * @brief Host thread pool running a fixed set of numbered tasks with work stealing.
+ */
+#ifndef SDWORKPOOL_HPP
+#define SDWORKPOOL_HPP
+
+#if !defined(ESP_PLATFORM)
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "SDTask.hpp"
+
+#define SDWORKPOOL_POLL_MS 1        // sleep of a worker with no task it may take yet
+
+/**
+ * @brief Runs tasks `0` to `count - 1` on a set of worker threads.
+ *
+ * Tasks are dealt round robin into one deque per worker. A worker takes its own tasks
+ * from the front, so the pool as a whole works through the tasks roughly in order. A
+ * worker whose deque is empty steals from the back of another worker's deque, or from
+ * its front when the back is past the limit. An optional limit holds back tasks whose
+ * number is not below it, so a consumer of the results can bound how far the workers
+ * run ahead of it. Each deque has its own lock, held only to take a task.
+ */
+class SDWorkPool {
+
+    private:
+
+        struct Worker {
+            std::mutex lock;
+            std::deque<size_t> tasks;
+            std::thread thread;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::function<void(size_t)> work;
+        const std::atomic<size_t>* limit = NULL;
+        std::atomic<size_t> remaining{0};   // tasks not taken by a worker yet
+        std::atomic<uint32_t> steals{0};
+
+        bool take(size_t self, size_t& task);
+        void worker_loop(size_t self);
+
+    public:
+
+        SDWorkPool(){}
+
+        /**
+         * @brief Waits for the running tasks.
+         */
+        ~SDWorkPool(){this->wait();}
+
+        SDWorkPool(const SDWorkPool&) = delete;
+        SDWorkPool& operator=(const SDWorkPool&) = delete;
+
+        /**
+         * @brief Start `threads` workers calling `work` for each of `count` tasks, holding back
+         *  tasks not below `*limit` if `limit` is set.
+         */
+        void start(size_t count, size_t threads, std::function<void(size_t)> work, const std::atomic<size_t>* limit = NULL);
+
+        /**
+         * @brief Wait until every task has run and stop the workers.
+         */
+        void wait();
+
+        /**
+         * @brief Tasks taken from another worker's deque since the last `start()`.
+         */
+        uint32_t stolen() const {return this->steals.load();}
+
+        /**
+         * @brief Worker threads to use by default, one per hardware thread.
+         */
+        static size_t default_threads();
+
+};
+#endif
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * @file Arduino.h
+ * @brief Host stand ins for the parts of the Arduino core used by the library: `Serial`,
+ *  `ESP.getFreeHeap()` and the timing functions. Definitions are in SDHost.cpp.
+ */
+#ifndef SDHOST_ARDUINO_H
+#define SDHOST_ARDUINO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+typedef uint8_t byte;
+
+/**
+ * @brief Writes console output to `stderr`, or drops it when muted, so tools can keep
+ *  `stdout` for their results.
+ */
+class SDHostSerial {
+
+    private:
+
+        bool muted = false;
+
+        void put(const char* s){if(!this->muted) fputs(s, stderr);}
+
+    public:
+
+        void begin(unsigned long){}
+
+        /**
+         * @brief Drop all output if `mute`.
+         */
+        void set_muted(bool mute){this->muted = mute;}
+
+        void print(const char* s){this->put(s);}
+        void print(const std::string& s){this->put(s.c_str());}
+        void print(char c){char s[2] = {c, 0}; this->put(s);}
+        void print(int v){this->printf("%d", v);}
+        void print(unsigned int v){this->printf("%u", v);}
+        void print(long v){this->printf("%ld", v);}
+        void print(unsigned long v){this->printf("%lu", v);}
+        void print(long long v){this->printf("%lld", v);}
+        void print(unsigned long long v){this->printf("%llu", v);}
+        void print(double v){this->printf("%.2f", v);}
+
+        template<typename T>
+        void println(const T& v){
+            this->print(v);
+            this->put("\n");
+        }
+        void println(){this->put("\n");}
+
+        template<typename... Args>
+        void printf(const char* format, Args... args){
+            if(!this->muted) fprintf(stderr, format, args...);
+        }
+
+};
+
+/**
+ * @brief Stand in for the ESP32 system object.
+ */
+class SDHostEsp {
+
+    public:
+
+        /**
+         * @brief `0`, the host heap is not bounded.
+         */
+        uint32_t getFreeHeap(){return 0;}
+
+        /**
+         * @brief `0`, the low water mark is not tracked on host.
+         */
+        uint32_t getMinFreeHeap(){return 0;}
+
+};
+
+extern SDHostSerial Serial;
+extern SDHostEsp ESP;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * @file FS.h
+ * @brief Host stand in for the ESP32 Arduino `fs::File`, a handle around a `fs::FileImpl`
+ *  which SDStorage's host backends implement.
+ */
+#ifndef SDHOST_FS_H
+#define SDHOST_FS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+class FileImpl;
+typedef std::shared_ptr<FileImpl> FileImplPtr;
+
+/**
+ * @brief An open file or directory of a storage backend, the subset of the ESP32
+ *  `fs::FileImpl` interface the library uses.
+ */
+class FileImpl {
+
+    public:
+
+        virtual ~FileImpl(){}
+
+        virtual size_t write(const uint8_t* buf, size_t size) = 0;
+        virtual size_t read(uint8_t* buf, size_t size) = 0;
+        virtual void flush() = 0;
+        virtual bool seek(uint32_t pos, SeekMode mode) = 0;
+        virtual size_t position() const = 0;
+        virtual size_t size() const = 0;
+        virtual void close() = 0;
+        virtual const char* path() const = 0;
+        virtual const char* name() const = 0;
+        virtual bool isDirectory() = 0;
+        virtual FileImplPtr openNextFile(const char* mode) = 0;
+        virtual operator bool() = 0;
+
+};
+
+/**
+ * @brief Copyable handle to an open file, closed by `close()`.
+ */
+class File {
+
+    private:
+
+        FileImplPtr p;
+
+    public:
+
+        File(FileImplPtr p = FileImplPtr()) : p(p) {}
+
+        size_t write(uint8_t c){return this->write(&c, 1);}
+        size_t write(const uint8_t* buf, size_t size){return this->p ? this->p->write(buf, size) : 0;}
+
+        int available(){return this->p ? (int)(this->p->size() - this->p->position()) : 0;}
+
+        int read(){
+            uint8_t c;
+            return this->read(&c, 1) == 1 ? c : -1;
+        }
+        size_t read(uint8_t* buf, size_t size){return this->p ? this->p->read(buf, size) : 0;}
+
+        void flush(){if(this->p) this->p->flush();}
+        bool seek(uint32_t pos, SeekMode mode = SeekSet){return this->p ? this->p->seek(pos, mode) : false;}
+        size_t position() const {return this->p ? this->p->position() : 0;}
+        size_t size() const {return this->p ? this->p->size() : 0;}
+
+        void close(){
+            if(this->p) this->p->close();
+            this->p.reset();
+        }
+
+        const char* path() const {return this->p ? this->p->path() : NULL;}
+        const char* name() const {return this->p ? this->p->name() : NULL;}
+        bool isDirectory(){return this->p ? this->p->isDirectory() : false;}
+
+        File openNextFile(const char* mode = FILE_READ){
+            return this->p ? File(this->p->openNextFile(mode)) : File();
+        }
+
+        operator bool() const {return this->p && *this->p;}
+
+        /**
+         * @brief The implementation behind the handle, host only.
+         */
+        FileImplPtr impl() const {return this->p;}
+
+};
+
+}
+
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * @file MQTTMailer.hpp
+ * @brief Host stand ins for the application's MQTT mailer, client and WiFi interface.
+ *  Mailed and published messages are dropped, publish pages to an `SDLocalSink` to
+ *  observe them.
+ */
+#ifndef SDHOST_MQTTMAILER_HPP
+#define SDHOST_MQTTMAILER_HPP
+
+#include <cstdint>
+#include <string>
+
+class PubSubClient {
+
+    private:
+
+        bool online = true;
+
+    public:
+
+        bool connected(){return this->online;}
+
+        bool publish(const char*, const uint8_t*, unsigned int, bool){
+            return this->online;
+        }
+
+        /**
+         * @brief Simulate losing or regaining the broker connection.
+         */
+        void set_connected(bool connected){this->online = connected;}
+
+};
+
+class MQTTMailer {
+
+    public:
+
+        static MQTTMailer& getInstance(){
+            static MQTTMailer mailer;
+            return mailer;
+        }
+
+        void mailMessage(PubSubClient*, std::string, std::string, bool){}
+
+};
+
+class SDHostWiFi {
+
+    public:
+
+        std::string macAddress(){return "00:00:00:00:00:00";}
+
+};
+
+extern SDHostWiFi WiFi;
+
+#endif
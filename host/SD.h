@@ -0,0 +1,12 @@
+/**
+ * @file SD.h
+ * @brief Host stand in for the Arduino SD library, only the `File` type is provided, files
+ *  are opened through an SDStorage backend.
+ */
+#ifndef SDHOST_SD_H
+#define SDHOST_SD_H
+
+#include "Arduino.h"
+#include "FS.h"
+
+#endif
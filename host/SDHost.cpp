@@ -0,0 +1,34 @@
+/**
+ * @file SDHost.cpp
+ * @brief Definitions behind the host stand ins in this directory. Applications still
+ *  define `mqtt_client` and `USB_DEBUG`, as they do on target.
+ */
+#include "Arduino.h"
+#include "MQTTMailer.hpp"
+
+#include <chrono>
+#include <thread>
+
+SDHostSerial Serial;
+SDHostEsp ESP;
+SDHostWiFi WiFi;
+
+static const std::chrono::steady_clock::time_point host_start = std::chrono::steady_clock::now();
+
+unsigned long millis(){
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - host_start).count();
+}
+
+unsigned long micros(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - host_start).count();
+}
+
+void delay(unsigned long ms){
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield(){
+    std::this_thread::yield();
+}
@@ -0,0 +1,22 @@
+/**
+ * @file TimeStamp.hpp
+ * @brief Host stand in for the application's TimeStamp, a fixed epoch in seconds.
+ */
+#ifndef SDHOST_TIMESTAMP_HPP
+#define SDHOST_TIMESTAMP_HPP
+
+class TimeStamp {
+
+    private:
+
+        long int epoch;
+
+    public:
+
+        TimeStamp(long int epoch = 0) : epoch(epoch) {}
+
+        long int get_epoch(){return this->epoch;}
+
+};
+
+#endif
@@ -0,0 +1,254 @@
+/**
+ * @file sdlog_archive.cpp
+ * @brief Host benchmark of SDArchiveReader scaling from one worker thread to many.
+ *
+ * ```
+ * sdlog_archive [megabytes] [max threads] [dir]
+ * ```
+ *
+ * Fills `dir` (default `sdlog_archive_card`) with about `megabytes` (default 512) of daily
+ * text logs with time indexes, one line per second in the README format, unless it
+ * already holds `log_M-D-YYYY.csv` files, in which case those are queried as they are.
+ * Every query is run once by SDReader, then by SDArchiveReader with 1, 2, 4, ... threads
+ * up to `max threads` (default one per hardware thread), after a warm up run so the files
+ * are in the page cache. The queries are
+ *
+ * - `all`, every line of every file, where the single threaded merge and page building
+ *   take a large share of the time,
+ * - `topic`, the lines of one topic over every file, bound by the scan,
+ * - `week`, a week of one topic from the middle of the archive.
+ *
+ * Each run reports its time, MB/s and lines/s scanned, the speedup over one thread, the
+ * tasks stolen between workers, how long the merge waited for them and how long it spent
+ * merging and publishing. The merge is the part of a query which does not scale, so from
+ * its share of the one thread run each run also reports the speedup Amdahl's law allows
+ * with its thread count on as many cores, for comparing with the measured one. It checks that
+ * the published pages are identical to those of one thread, and whether they are also
+ * identical to SDReader's, as they are for files logged in time order. Results are
+ * printed as one JSON object on stdout. Build on the host with
+ *
+ * ```
+ * cd .. && g++ -std=c++17 -O2 -Ihost -I. tools/sdlog_archive.cpp host/SDHost.cpp SDStorage.cpp \
+ *     SDLogger.cpp SDReader.cpp SDArchiveReader.cpp SDWorkPool.cpp SDTime.cpp SDBinaryFormat.cpp \
+ *     SDCompress.cpp SDPageBuilder.cpp SDPageSink.cpp SDPagePipeline.cpp SDQueryCursor.cpp \
+ *     SDJson.cpp SDAggregator.cpp SDProjector.cpp SDFileCatalog.cpp SDTopicFilter.cpp \
+ *     SDTopicDictionary.cpp SDLineReader.cpp SDMetrics.cpp SDRecovery.cpp -o sdlog_archive -lpthread
+ * ```
+ */
+#include "SDLogger.hpp"
+#include "SDReader.hpp"
+#include "SDArchiveReader.hpp"
+#include "SDStorage.hpp"
+#include "SDPageSink.hpp"
+#include "SDTime.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define BENCH_START_EPOCH 1684886400    // 5-24-2023T00:00:00
+#define BENCH_ARCHIVE_DIR "sdlog_archive_card"
+#define BENCH_BYTES_PER_DAY 11500000    // about 86400 lines of the generated data
+
+PubSubClient mqtt_client;
+extern const bool USB_DEBUG = false;
+
+static const char* TOPICS[] = {
+    "meter_teros10/0_shallow/08:3A:F2:31:9B:D0",
+    "meter_teros10/1_middle/08:3A:F2:31:9B:D0",
+    "meter_teros10/2_deep/08:3A:F2:31:9B:D0",
+    "kkm_k6p/bc:57:29:00:f6:d3",
+};
+
+/**
+ * Counts the pages and hashes their contents, so runs can be compared without keeping
+ * the pages. Eight bytes are mixed in at a time, a hash of every byte would cost the
+ * publishing thread more than merging the pages.
+ */
+class HashSink : public SDPageSink {
+
+    public:
+
+        uint32_t pages = 0;
+        uint64_t bytes = 0;
+        uint64_t hash = 1469598103934665603ULL;
+
+        bool publish(const std::string&, const std::string& page) override {
+            size_t i = 0;
+            uint64_t word;
+            for(; i + sizeof(word) <= page.size(); i += sizeof(word)){
+                memcpy(&word, page.data() + i, sizeof(word));
+                this->mix(word);
+            }
+            word = page.size();
+            memcpy(&word, page.data() + i, page.size() - i);
+            this->mix(word);
+
+            this->pages++;
+            this->bytes += page.size();
+            return true;
+        }
+
+    private:
+
+        void mix(uint64_t word){
+            this->hash = (this->hash ^ word) * 0x9E3779B97F4A7C15ULL;
+            this->hash ^= this->hash >> 29;
+        }
+
+};
+
+/**
+ * A query of the benchmark, over `[epoch, terminus]`.
+ */
+struct BenchQuery {
+    const char* name;
+    int64_t epoch;
+    int64_t terminus;
+    std::vector<std::string> filter;
+};
+
+static double seconds(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b){
+    return std::chrono::duration<double>(b - a).count();
+}
+
+/**
+ * Logs `days` days of one line per second through a rotating logger, cycling through the
+ * README's sensors.
+ */
+static void generate(SDStorage& storage, uint32_t days){
+    SDLogger logger;
+    logger.set_storage(storage);
+    logger.enable_buffered_writes();
+    logger.enable_index();
+    logger.enable_rotation("/log", ".csv", {"TIME", "MQTT TOPIC", "MQTT MESSAGE"}, 1);
+
+    char time[SD_TIME_CHARS];
+    char message[160];
+    for(int64_t i = 0; i < (int64_t)days * SD_SECS_PER_DAY; i++){
+        time[sd_format_time(BENCH_START_EPOCH + i, time)] = 0;
+
+        if(i % 4 == 3){
+            snprintf(message, sizeof(message),
+                    "{\"MAC\": \"bc:57:29:00:f6:d3\", \"HUMIDITY\": %.6f, \"TEMP\": %.6f, \"GATOR_MAC\": \"08:3A:F2:31:9B:D0\"}",
+                    40.0 + (i % 97) * 0.01, 21.0 + (i % 89) * 0.01);
+        }else{
+            snprintf(message, sizeof(message),
+                    "{\"MAC\": \"08:3A:F2:31:9B:D0\", \"DEPTH\": \"%s\", \"VWC_RAW\":%.6f, \"VWC\":%.6f}",
+                    (i % 4 == 0) ? "shallow" : (i % 4 == 1) ? "middle" : "deep", 0.003 + (i % 13) * 0.001, -2.14 + (i % 31) * 0.01);
+        }
+        logger.log_absolute_mqtt(time, TOPICS[i % 4], message);
+    }
+    logger.close_card();
+}
+
+int main(int argc, char** argv){
+    uint32_t megabytes = (argc > 1) ? strtoul(argv[1], NULL, 10) : 512;
+    size_t max_threads = (argc > 2) ? strtoul(argv[2], NULL, 10) : SDWorkPool::default_threads();
+    std::string dir = (argc > 3) ? argv[3] : BENCH_ARCHIVE_DIR;
+    if(megabytes == 0 || max_threads == 0) return 1;
+
+    Serial.set_muted(true);
+
+    SDPosixStorage storage(dir);
+    if(!storage.begin()){
+        fprintf(stderr, "cannot use %s\n", dir.c_str());
+        return 1;
+    }
+
+    // list the archive, generating one if it is empty
+    SDFileCatalog catalog;
+    catalog.refresh(storage, "/", "log", "csv");
+    if(catalog.files().empty()){
+        uint32_t days = std::max<uint64_t>(1, (uint64_t)megabytes * 1000000 / BENCH_BYTES_PER_DAY);
+        fprintf(stderr, "generating %u days in %s\n", days, dir.c_str());
+        generate(storage, days);
+        catalog.refresh(storage, "/", "log", "csv");
+    }
+
+    uint64_t archive_bytes = 0;
+    for(const SDCatalogEntry& file : catalog.files()){
+        File f = storage.open(file.path.c_str(), "r");
+        archive_bytes += f ? f.size() : 0;
+        f.close();
+    }
+    int64_t first = catalog.files().front().day_start;
+    int64_t last = catalog.files().back().day_start + SD_SECS_PER_DAY - 1;
+    int64_t middle = first + (last - first) / 2;
+
+    BenchQuery queries[] = {
+        {"all", first, last, {""}},
+        {"topic", first, last, {"kkm_k6p/#"}},
+        {"week", middle, middle + 7 * SD_SECS_PER_DAY - 1, {"kkm_k6p/#"}},
+    };
+
+    std::vector<size_t> thread_counts;
+    for(size_t t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(max_threads);
+
+    printf("{\"dir\": \"%s\", \"files\": %zu, \"mb\": %.1f, \"hardware_threads\": %zu,\n \"queries\": [",
+            dir.c_str(), catalog.files().size(), archive_bytes / 1e6, SDWorkPool::default_threads());
+
+    for(size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++){
+        const BenchQuery& query = queries[q];
+
+        // the serial reader, indexes already exist so it does not write
+        HashSink serial;
+        SDReader reader;
+        reader.set_storage(storage);
+        reader.set_page_sink(&serial);
+        auto a = std::chrono::steady_clock::now();
+        reader.read_entry_range_from_files(TimeStamp(query.epoch), TimeStamp(query.terminus), query.filter, 0);
+        auto b = std::chrono::steady_clock::now();
+
+        printf("%s\n  {\"query\": \"%s\", \"sdreader_s\": %.3f, \"sdreader_pages\": %u, \"runs\": [",
+                q ? "," : "", query.name, seconds(a, b), serial.pages);
+
+        // same page topic, so the page budgets and pages of the readers match
+        SDArchiveReader archive(storage);
+        archive.set_device(WiFi.macAddress().c_str());
+        uint64_t reference = 0;
+        double one_thread = 0;
+        double serial_share = 0;
+
+        // warm up, so every run finds the files in the page cache
+        HashSink warm;
+        archive.set_page_sink(&warm);
+        archive.set_threads(max_threads);
+        archive.read_entry_range_from_files(TimeStamp(query.epoch), TimeStamp(query.terminus), query.filter, 0);
+
+        for(size_t r = 0; r < thread_counts.size(); r++){
+            HashSink sink;
+            archive.set_page_sink(&sink);
+            archive.set_threads(thread_counts[r]);
+
+            a = std::chrono::steady_clock::now();
+            archive.read_entry_range_from_files(TimeStamp(query.epoch), TimeStamp(query.terminus), query.filter, 0);
+            b = std::chrono::steady_clock::now();
+
+            const SDArchiveStats& stats = archive.get_stats();
+            double s = seconds(a, b);
+            if(r == 0){
+                reference = sink.hash;
+                one_thread = s;
+                serial_share = std::min(1.0, stats.merge_us / 1e6 / s);
+            }
+            double amdahl = 1.0 / (serial_share + (1.0 - serial_share) / thread_counts[r]);
+
+            printf("%s\n   {\"threads\": %zu, \"seconds\": %.3f, \"mb_per_s\": %.1f, \"lines_per_s\": %.0f, \"speedup\": %.2f, "
+                    "\"amdahl_speedup\": %.2f, \"tasks\": %u, \"steals\": %u, \"merge_wait_ms\": %.1f, \"merge_ms\": %.1f, "
+                    "\"entries\": %llu, \"pages\": %u, \"same_output\": %s}",
+                    r ? "," : "", thread_counts[r], s, stats.bytes_read / s / 1e6, stats.lines_scanned / s, one_thread / s,
+                    amdahl, stats.tasks, stats.steals, stats.merge_wait_us / 1e3, stats.merge_us / 1e3,
+                    (unsigned long long)stats.lines_matched, sink.pages, sink.hash == reference ? "true" : "false");
+        }
+        printf("],\n  \"matches_sdreader\": %s}", reference == serial.hash ? "true" : "false");
+    }
+    printf("]}\n");
+
+    return 0;
+}
@@ -0,0 +1,974 @@
+/**
+ * @file sdlog_bench.cpp
+ * @brief Host benchmark of the SDLogger and SDReader hot paths on an SDStorage backend.
+ *
+ * ```
+ * sdlog_bench [lines] [days] [memory|sd|posix]
+ * ```
+ *
+ * Generates `lines` log lines (default 200000) in the README format, spread evenly over
+ * `days` daily files (default 3), and measures
+ *
+ * - append throughput and per call latency, opening the file per line against the same
+ *   lines through the buffered writer which keeps the file open, and with buffered writes
+ *   while indexing the data queried below,
+ * - append throughput and commits per durability mode of the buffered writer,
+ * - per call latency of logging bursts of records committed one by one, in the caller and
+ *   queued to SDAsyncLogger, whose writer commits a batch at a time,
+ * - append throughput and file opens of a rotating logger with every 10th record a day
+ *   late, keeping one daily file open and the default number,
+ * - append throughput and FAT sector writes committing every record, with files growing
+ *   as they are appended to and with files preallocated for a day of records ahead of
+ *   the log calls, and the time taken to preallocate them,
+ * - lines scanned per second by a range query over every file without an index,
+ * - the speed of splitting one file in memory into lines and fields, against `memchr()`
+ *   over every byte, and of full scans matching no line and every line, reading files in
+ *   blocks and, on `posix`, through memory maps,
+ * - the speed of reading the lines of one file a byte per call into a growing string, as
+ *   SDReader did before, against the block reader,
+ * - the size of the files with topics encoded by the topic dictionary and the time of full
+ *   scans matching every line, one topic and no topic, against the plain files,
+ * - the cost of matching topics against 1, 10 and 100 patterns with SDTopicFilter, against
+ *   the linear search per pattern the reader used to run for every line,
+ * - bytes read and time of range queries within the first day without an index, scanning
+ *   the whole file against binary searching a time ordered file for the window,
+ * - range query latency for windows from a minute to a day, with the time index,
+ * - the cost of building JSON pages,
+ * - heap allocations per exported page and the peak heap of a day export, reading in the
+ *   caller and with the pipelined sender,
+ * - heap allocations of log calls once the logger is warm, with absolute and relative time
+ *   stamps and with topics encoded, which should be none,
+ *
+ * followed by the SDMetrics snapshot of the whole run. The `memory` backend (default) keeps
+ * files in memory without latency, `sd` adds the latency of a typical SPI SD card to every
+ * operation and `posix` writes the files to `sdlog_bench_card` in the working directory.
+ * Results are printed as one JSON object on stdout for tracking regressions. Build on the
+ * host with
+ *
+ * ```
+ * cd .. && g++ -std=c++17 -O2 -Ihost -I. tools/sdlog_bench.cpp host/SDHost.cpp SDStorage.cpp \
+ *     SDLogger.cpp SDReader.cpp SDTime.cpp SDBinaryFormat.cpp SDCompress.cpp SDPageBuilder.cpp \
+ *     SDPageSink.cpp SDPagePipeline.cpp SDQueryCursor.cpp SDJson.cpp SDAggregator.cpp \
+ *     SDProjector.cpp SDFileCatalog.cpp SDTopicFilter.cpp SDTopicDictionary.cpp SDLineReader.cpp \
+ *     SDMetrics.cpp SDRecovery.cpp SDAsyncLogger.cpp -o sdlog_bench -lpthread
+ * ```
+ */
+#include "SDLogger.hpp"
+#include "SDReader.hpp"
+#include "SDStorage.hpp"
+#include "SDPageBuilder.hpp"
+#include "SDPageSink.hpp"
+#include "SDTime.hpp"
+#include "SDMetrics.hpp"
+#include "SDScan.hpp"
+#include "SDFileCatalog.hpp"
+#include "SDTopicDictionary.hpp"
+#include "SDTopicFilter.hpp"
+#include "SDLineReader.hpp"
+#include "SDAsyncLogger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BENCH_START_EPOCH 1684886400    // 5-24-2023T00:00:00
+#define BENCH_POSIX_DIR "sdlog_bench_card"
+#define BENCH_PER_LINE_MAX 5000         // lines appended with an open and close each
+#define BENCH_PER_LINE_SD 500           // the same with simulated card latency
+#define BENCH_RANGE_REPEATS 5           // queries per window size
+#define BENCH_LATE_EVERY 10             // every Nth record of the rotation run belongs to the day before
+#define BENCH_PASS_BYTES 200000000      // bytes searched by each delimiter pass, repeating the file
+#define BENCH_SCAN_REPEATS 3            // full scans per read mode and filter, the fastest is reported
+#define BENCH_HEAP_LINES 4000           // log calls whose allocations are counted, all fit the write buffer
+#define BENCH_BURST_LINES 16            // records logged back to back by the async comparison
+#define BENCH_BURST_GAP_MS 5            // pause between bursts
+#define BENCH_FILTER_TOPICS 400000      // topics matched per filter size
+#define BENCH_BYTEWISE_BYTES 4000000    // bytes of whole lines read a byte per call
+#define BENCH_BYTEWISE_SD 16384         // the same with simulated card latency on every call
+
+PubSubClient mqtt_client;
+extern const bool USB_DEBUG = false;
+
+static const char* TOPICS[] = {
+    "meter_teros10/0_shallow/08:3A:F2:31:9B:D0",
+    "meter_teros10/1_middle/08:3A:F2:31:9B:D0",
+    "meter_teros10/2_deep/08:3A:F2:31:9B:D0",
+    "kkm_k6p/bc:57:29:00:f6:d3",
+};
+
+static const uint32_t WINDOWS[] = {60, 600, 3600, 21600, 86400};
+
+/**
+ * Heap use of the process, counted by the replaced global `operator new` while
+ * `heap_tracking` is set. Each block carries its size in a header so `delete` can
+ * subtract it.
+ */
+static std::atomic<bool> heap_tracking(false);
+static std::atomic<uint64_t> heap_allocations(0);
+static std::atomic<int64_t> heap_live(0);
+static std::atomic<int64_t> heap_peak(0);
+
+#define BENCH_HEAP_HEADER alignof(std::max_align_t)
+
+void* operator new(size_t size){
+    char* block = (char*)malloc(size + BENCH_HEAP_HEADER);
+    if(block == NULL) throw std::bad_alloc();
+    *(size_t*)block = size;
+
+    if(heap_tracking){
+        heap_allocations++;
+        int64_t live = heap_live += size;
+        int64_t peak = heap_peak;
+        while(live > peak && !heap_peak.compare_exchange_weak(peak, live));
+    }
+    return block + BENCH_HEAP_HEADER;
+}
+
+void operator delete(void* p) noexcept {
+    if(p == NULL) return;
+    char* block = (char*)p - BENCH_HEAP_HEADER;
+    if(heap_tracking) heap_live -= *(size_t*)block;
+    free(block);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+/**
+ * Counts the pages of an export and the allocations made while building each of them.
+ */
+class HeapSink : public SDPageSink {
+
+    public:
+
+        uint32_t pages = 0;
+        uint64_t first_page_allocations = 0;    // includes the setup of the query
+        uint64_t last = 0;
+
+        bool publish(const std::string&, const std::string&) override {
+            uint64_t now = heap_allocations;
+            if(this->pages++ == 0) this->first_page_allocations = now - this->last;
+            this->last = now;
+            return true;
+        }
+
+};
+
+/**
+ * Durability modes compared, with their interval in ms or bytes per commit.
+ */
+static const struct {
+    const char* name;
+    SDDurability mode;
+    uint32_t every;
+} DURABILITY[] = {
+    {"record", SD_DURABLE_RECORD, 0},
+    {"bytes_4k", SD_DURABLE_BYTES, 4096},
+    {"bytes_16k", SD_DURABLE_BYTES, 16384},
+    {"interval_1s", SD_DURABLE_INTERVAL, 1000},
+};
+
+/**
+ * SD card over SPI: a FAT lookup per open, a sector transfer per call at about 2 MB/s, a
+ * few ms to commit a write and both FAT copies written when a commit allocated clusters.
+ */
+static SDLatency sd_card_latency(){
+    SDLatency latency;
+    latency.open_us = 1500;
+    latency.read_us = 150;
+    latency.write_us = 150;
+    latency.flush_us = 3000;
+    latency.us_per_kb = 500;
+    latency.alloc_us = 800;
+    return latency;
+}
+
+/**
+ * Line `i` of the generated data: its time stamp, topic and message.
+ */
+struct BenchLine {
+    int64_t epoch;
+    char time[SD_TIME_CHARS];
+    const char* topic;
+    char message[160];
+};
+
+static void make_line(size_t i, uint32_t interval, BenchLine& line){
+    line.epoch = BENCH_START_EPOCH + (int64_t)i * interval;
+    line.time[sd_format_time(line.epoch, line.time)] = 0;
+    line.topic = TOPICS[i % 4];
+
+    if(i % 4 == 3){
+        snprintf(line.message, sizeof(line.message),
+                "{\"MAC\": \"bc:57:29:00:f6:d3\", \"HUMIDITY\": %.6f, \"TEMP\": %.6f, \"GATOR_MAC\": \"08:3A:F2:31:9B:D0\"}",
+                40.0 + (i % 97) * 0.01, 21.0 + (i % 89) * 0.01);
+    }else{
+        snprintf(line.message, sizeof(line.message),
+                "{\"MAC\": \"08:3A:F2:31:9B:D0\", \"DEPTH\": \"%s\", \"VWC_RAW\":%.6f, \"VWC\":%.6f}",
+                (i % 4 == 0) ? "shallow" : (i % 4 == 1) ? "middle" : "deep", 0.003 + (i % 13) * 0.001, -2.14 + (i % 31) * 0.01);
+    }
+}
+
+/**
+ * Points the logger at the daily file of `epoch`.
+ */
+static void set_day(SDLogger& logger, const char* prefix, int64_t epoch){
+    int64_t year;
+    unsigned month, day;
+    sd_civil_from_days(sd_day_start(epoch) / SD_SECS_PER_DAY, year, month, day);
+    logger.set_filename(prefix, month, day, (int)year, ".csv");
+}
+
+static double seconds(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b){
+    return std::chrono::duration<double>(b - a).count();
+}
+
+/**
+ * Appends `count` lines with `logger`, starting a new file at each midnight.
+ *
+ * @param[out] latency_us If not `NULL`, receives the microseconds each log call took.
+ *
+ * @returns The bytes of the lines appended.
+ */
+static uint64_t append_lines(SDLogger& logger, const char* prefix, size_t count, uint32_t interval,
+        std::vector<uint32_t>* latency_us = NULL){
+    BenchLine line;
+    int64_t day = -1;
+    uint64_t bytes = 0;
+
+    if(latency_us != NULL) latency_us->reserve(count);
+    for(size_t i = 0; i < count; i++){
+        make_line(i, interval, line);
+        if(sd_day_start(line.epoch) != day){
+            day = sd_day_start(line.epoch);
+            set_day(logger, prefix, line.epoch);
+        }
+
+        auto a = std::chrono::steady_clock::now();
+        logger.log_absolute_mqtt(line.time, line.topic, line.message);
+        if(latency_us != NULL){
+            auto b = std::chrono::steady_clock::now();
+            latency_us->push_back(std::chrono::duration_cast<std::chrono::microseconds>(b - a).count());
+        }
+        bytes += strlen(line.time) + strlen(line.topic) + strlen(line.message) + 4;
+    }
+    logger.flush();
+    return bytes;
+}
+
+/**
+ * Adds up the sizes of the daily files of `prefix` and of their topic dictionaries.
+ */
+static void catalog_bytes(SDStorage& storage, const char* prefix, uint64_t& data, uint64_t& dictionaries){
+    SDFileCatalog catalog;
+    catalog.refresh(storage, "/", prefix, "csv");
+
+    data = 0;
+    dictionaries = 0;
+    for(const SDCatalogEntry& e : catalog.files()){
+        File f = storage.open(e.path.c_str(), "r");
+        if(f) data += sd_data_end(f);
+        f.close();
+
+        std::string dict_fn = SDTopicDictionary::filename(e.path);
+        if(!storage.exists(dict_fn.c_str())) continue;
+        File d = storage.open(dict_fn.c_str(), "r");
+        if(d) dictionaries += d.size();
+        d.close();
+    }
+}
+
+/**
+ * Runs a full scan of the files of `prefix` `BENCH_SCAN_REPEATS` times.
+ *
+ * @returns The fastest run in seconds.
+ */
+static double best_scan(SDStorage& storage, SDLocalSink& sink, const char* prefix, 
+        int64_t first, int64_t last, const std::vector<std::string>& filter){
+    SDReader scanner;
+    scanner.set_storage(storage);
+    scanner.set_page_sink(&sink);
+    scanner.set_use_index(false);
+
+    double best = 0;
+    for(int r = 0; r < BENCH_SCAN_REPEATS; r++){
+        sink.clear();
+        auto a = std::chrono::steady_clock::now();
+        scanner.read_entry_range_from_files(TimeStamp(first), TimeStamp(last), filter, 0, prefix, "csv");
+        auto b = std::chrono::steady_clock::now();
+        if(r == 0 || seconds(a, b) < best) best = seconds(a, b);
+    }
+    return best;
+}
+
+/**
+ * Formats the median, 99th percentile and maximum of per call latencies as a JSON object.
+ */
+static std::string latency_json(std::vector<uint32_t> samples){
+    if(samples.empty()) return "{}";
+    std::sort(samples.begin(), samples.end());
+
+    char json[96];
+    snprintf(json, sizeof(json), "{\"p50\": %u, \"p99\": %u, \"max\": %u}",
+            samples[samples.size() / 2], samples[samples.size() * 99 / 100], samples.back());
+    return json;
+}
+
+/**
+ * The topic filter SDReader ran for every line before SDTopicFilter: the patterns and the
+ * topic copied per call and searched for one pattern after another.
+ */
+static bool linear_match(std::vector<std::string> filter, std::string target){
+    bool check_default = (filter.size() == 1);
+    std::string def = "";
+
+    for(std::string f : filter){
+        if(check_default && f == def){
+            return true;
+
+        }else if(f != def && target.find(f) != std::string::npos){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Runs `pass` over `text` as many times as it takes to search about `BENCH_PASS_BYTES`,
+ * adding its results to `check` so the compiler keeps them.
+ *
+ * @returns The MB/s searched.
+ */
+template<typename Pass>
+static double pass_rate(const std::string& text, Pass pass, uint64_t& check){
+    size_t repeats = std::max<size_t>(1, BENCH_PASS_BYTES / std::max<size_t>(1, text.size()));
+    const char* volatile begin = text.data();   // reloaded by every repeat, so none is hoisted
+    const char* end = text.data() + text.size();
+
+    auto a = std::chrono::steady_clock::now();
+    for(size_t r = 0; r < repeats; r++) check += pass(begin, end);
+    auto b = std::chrono::steady_clock::now();
+    return (double)text.size() * repeats / seconds(a, b) / 1e6;
+}
+
+int main(int argc, char** argv){
+    size_t lines = (argc > 1) ? strtoul(argv[1], NULL, 10) : 200000;
+    uint32_t days = (argc > 2) ? strtoul(argv[2], NULL, 10) : 3;
+    std::string backend = (argc > 3) ? argv[3] : "memory";
+    if(lines == 0 || days == 0) return 1;
+
+    uint32_t interval = std::max<uint64_t>(1, (uint64_t)days * SD_SECS_PER_DAY / lines);
+    lines = std::min<size_t>(lines, (uint64_t)days * SD_SECS_PER_DAY / interval);
+
+    Serial.set_muted(true);
+
+    SDMemoryStorage memory;
+    SDPosixStorage posix(BENCH_POSIX_DIR);
+    SDStorage* storage = &memory;
+
+    if(backend == "posix"){
+        std::filesystem::remove_all(BENCH_POSIX_DIR);
+        storage = &posix;
+    }else if(backend != "memory" && backend != "sd"){
+        fprintf(stderr, "unknown backend %s\n", backend.c_str());
+        return 1;
+    }
+
+    SDLogger logger;
+    if(!logger.set_storage(*storage)){
+        fprintf(stderr, "storage failed to initialize\n");
+        return 1;
+    }
+    if(backend == "sd") memory.set_latency(sd_card_latency());
+
+    // append, opening and closing the file for every line
+    size_t per_line = std::min<size_t>(lines, (backend == "sd") ? BENCH_PER_LINE_SD : BENCH_PER_LINE_MAX);
+    std::vector<uint32_t> per_line_latency;
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t per_line_bytes = append_lines(logger, "/perline", per_line, interval, &per_line_latency);
+    auto t1 = std::chrono::steady_clock::now();
+
+    // the same lines through the buffered writer, without an index, for a like for like comparison
+    std::vector<uint32_t> kept_open_latency;
+    double kept_open_s;
+    {
+        SDLogger kept_open;
+        kept_open.set_storage(*storage);
+        kept_open.enable_buffered_writes();
+
+        auto a = std::chrono::steady_clock::now();
+        append_lines(kept_open, "/keptopen", per_line, interval, &kept_open_latency);
+        auto b = std::chrono::steady_clock::now();
+        kept_open_s = seconds(a, b);
+    }
+
+    // rotate by time stamp with late records, one open file against the default LRU
+    size_t rotation_handles[] = {1, SDLOGGER_ROTATION_HANDLES};
+    double rotation_rate[2];
+    uint32_t rotation_opens[2];
+    for(int r = 0; r < 2; r++){
+        SDMetricsSnapshot before, after;
+        SDLogger rotating;
+        rotating.set_storage(*storage);
+        rotating.enable_rotation(std::string("/rot") + std::to_string(r), ".csv", {"TIME", "MQTT TOPIC", "MQTT MESSAGE"}, rotation_handles[r]);
+
+        BenchLine line;
+        sd_metrics_snapshot(before);
+        auto a = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < per_line; i++){
+            make_line(i, interval, line);
+            if(i % BENCH_LATE_EVERY == BENCH_LATE_EVERY - 1)
+                line.time[sd_format_time(line.epoch - SD_SECS_PER_DAY, line.time)] = 0;
+            rotating.log_absolute_mqtt(line.time, line.topic, line.message);
+        }
+        rotating.close_card();
+        auto b = std::chrono::steady_clock::now();
+        sd_metrics_snapshot(after);
+
+        rotation_rate[r] = per_line / seconds(a, b);
+        rotation_opens[r] = after.counters[SD_FILE_OPENS] - before.counters[SD_FILE_OPENS];
+    }
+
+    // append per durability mode, commits counted by the flush latency histogram
+    std::vector<double> durability_rate;
+    std::vector<uint32_t> durability_commits;
+    for(const auto& d : DURABILITY){
+        SDMetricsSnapshot before, after;
+        SDLogger durable;
+        durable.set_storage(*storage);
+        durable.enable_buffered_writes(SDLOGGER_DEFAULT_BUFFER_SIZE, UINT32_MAX);
+        durable.set_durability(d.mode, d.every);
+
+        sd_metrics_snapshot(before);
+        auto a = std::chrono::steady_clock::now();
+        append_lines(durable, (std::string("/dur_") + d.name).c_str(), per_line, interval);
+        auto b = std::chrono::steady_clock::now();
+        sd_metrics_snapshot(after);
+
+        durability_rate.push_back(per_line / seconds(a, b));
+        durability_commits.push_back(after.histograms[SD_FLUSH_LATENCY].count - before.histograms[SD_FLUSH_LATENCY].count);
+    }
+
+    // bursts of records committed one by one, logged in the caller against queued to the
+    // async writer, which commits each batch once
+    const char* async_modes[] = {"sync", "async"};
+    std::vector<uint32_t> async_latency[2];
+    double async_s[2];
+    uint32_t async_written = 0, async_dropped = 0;
+    for(int m = 0; m < 2; m++){
+        SDLogger durable;
+        durable.set_storage(*storage);
+        durable.set_durability(SD_DURABLE_RECORD);
+        durable.set_filename((std::string("/async") + std::to_string(m)).c_str(), 5, 24, 2023, ".csv");
+
+        SDAsyncLogger async(&durable, SDLOGGER_ASYNC_QUEUE_LENGTH, SD_BLOCK);
+        if(m == 1) async.start();
+
+        BenchLine line;
+        async_latency[m].reserve(per_line);
+        auto a = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < per_line; i++){
+            make_line(i % 1000, 1, line);
+
+            auto c = std::chrono::steady_clock::now();
+            if(m == 1) async.log_absolute_mqtt(line.time, line.topic, line.message);
+            else durable.log_absolute_mqtt(line.time, line.topic, line.message);
+            auto d = std::chrono::steady_clock::now();
+            async_latency[m].push_back(std::chrono::duration_cast<std::chrono::microseconds>(d - c).count());
+
+            if(i % BENCH_BURST_LINES == BENCH_BURST_LINES - 1)
+                std::this_thread::sleep_for(std::chrono::milliseconds(BENCH_BURST_GAP_MS));
+        }
+        if(m == 1){
+            async.stop();
+            async_written = async.written_count();
+            async_dropped = async.dropped_count();
+        }
+        durable.close_card();
+        async_s[m] = seconds(a, std::chrono::steady_clock::now());
+    }
+
+    // commit every record, appending to growing files against preallocated ones
+    uint32_t per_line_days = per_line * interval / SD_SECS_PER_DAY + 1;
+    uint32_t prealloc_bytes[] = {0, (uint32_t)(per_line_bytes * 5 / 4 / per_line_days) + SDLOGGER_SECTOR_SIZE};
+    double prealloc_rate[2], prepare_ms[2];
+    uint64_t prealloc_fat[2];
+    for(int p = 0; p < 2; p++){
+        SDLogger durable;
+        durable.set_storage(*storage);
+        durable.set_durability(SD_DURABLE_RECORD);
+        std::string prefix = std::string("/pre") + std::to_string(p);
+
+        auto a = std::chrono::steady_clock::now();
+        if(prealloc_bytes[p] > 0){
+            durable.enable_preallocation(prealloc_bytes[p]);
+            for(uint32_t d = 0; d < per_line_days; d++){
+                set_day(durable, prefix.c_str(), BENCH_START_EPOCH + (int64_t)d * SD_SECS_PER_DAY);
+                durable.prepare_file(durable.get_filename());
+            }
+        }
+
+        uint64_t fat = memory.stats().fat_writes;
+        auto b = std::chrono::steady_clock::now();
+        append_lines(durable, prefix.c_str(), per_line, interval);
+        durable.close_card();
+        auto c = std::chrono::steady_clock::now();
+
+        prepare_ms[p] = seconds(a, b) * 1e3;
+        prealloc_rate[p] = per_line / seconds(b, c);
+        prealloc_fat[p] = memory.stats().fat_writes - fat;
+    }
+
+    // append through the buffered writer, indexing, this is the data queried below
+    logger.enable_buffered_writes();
+    logger.enable_index();
+    auto t2 = std::chrono::steady_clock::now();
+    uint64_t data_bytes = append_lines(logger, "/log", lines, interval);
+    logger.disable_buffered_writes();
+    auto t3 = std::chrono::steady_clock::now();
+
+    SDLocalSink sink;
+    SDReader reader;
+    reader.set_storage(*storage);
+    reader.set_page_sink(&sink);
+
+    int64_t first = BENCH_START_EPOCH;
+    int64_t last = BENCH_START_EPOCH + (int64_t)(lines - 1) * interval;
+
+    // scan every line without the index, the first query also lists the files
+    reader.set_use_index(false);
+    reader.read_entry_range_from_files(TimeStamp(first), TimeStamp(last), {""}, 0);
+    sink.clear();
+    auto t4 = std::chrono::steady_clock::now();
+    reader.read_entry_range_from_files(TimeStamp(first), TimeStamp(last), {""}, 0);
+    auto t5 = std::chrono::steady_clock::now();
+    uint32_t scan_pages = sink.pages();
+    uint64_t scan_page_bytes = sink.bytes();
+
+    printf("{\"backend\": \"%s\", \"lines\": %zu, \"days\": %u, \"interval_s\": %u, \"bytes_per_line\": %.1f,\n",
+            backend.c_str(), lines, days, interval, (double)data_bytes / lines);
+    printf(" \"append\": {\n");
+    printf("  \"per_line\": {\"lines\": %zu, \"lines_per_s\": %.0f, \"mb_per_s\": %.3f, \"latency_us\": %s},\n",
+            per_line, per_line / seconds(t0, t1), per_line_bytes / seconds(t0, t1) / 1e6, latency_json(per_line_latency).c_str());
+    printf("  \"kept_open\": {\"lines\": %zu, \"lines_per_s\": %.0f, \"mb_per_s\": %.3f, \"latency_us\": %s, \"speedup\": %.1f},\n",
+            per_line, per_line / kept_open_s, per_line_bytes / kept_open_s / 1e6, latency_json(kept_open_latency).c_str(),
+            seconds(t0, t1) / kept_open_s);
+    printf("  \"buffered\": {\"lines\": %zu, \"lines_per_s\": %.0f, \"mb_per_s\": %.3f}},\n",
+            lines, lines / seconds(t2, t3), data_bytes / seconds(t2, t3) / 1e6);
+    printf(" \"rotation\": [");
+    for(int r = 0; r < 2; r++){
+        printf("%s\n  {\"handles\": %zu, \"lines\": %zu, \"lines_per_s\": %.0f, \"opens\": %u}",
+                r ? "," : "", rotation_handles[r], per_line, rotation_rate[r], rotation_opens[r]);
+    }
+    printf("],\n");
+    printf(" \"durability\": [");
+    for(size_t d = 0; d < durability_rate.size(); d++){
+        printf("%s\n  {\"mode\": \"%s\", \"lines\": %zu, \"lines_per_s\": %.0f, \"commits\": %u}",
+                d ? "," : "", DURABILITY[d].name, per_line, durability_rate[d], durability_commits[d]);
+    }
+    printf("],\n");
+    printf(" \"async\": {\"burst\": %u, \"gap_ms\": %u, \"queue\": %u, \"written\": %u, \"dropped\": %u, \"modes\": [",
+            BENCH_BURST_LINES, BENCH_BURST_GAP_MS, SDLOGGER_ASYNC_QUEUE_LENGTH, async_written, async_dropped);
+    for(int m = 0; m < 2; m++){
+        printf("%s\n  {\"mode\": \"%s\", \"lines\": %zu, \"latency_us\": %s, \"seconds\": %.3f}",
+                m ? "," : "", async_modes[m], per_line, latency_json(async_latency[m]).c_str(), async_s[m]);
+    }
+    printf("]},\n");
+    printf(" \"preallocation\": [");
+    for(int p = 0; p < 2; p++){
+        printf("%s\n  {\"reserve_bytes\": %u, \"prepare_ms\": %.1f, \"lines\": %zu, \"lines_per_s\": %.0f, \"fat_writes\": %llu}",
+                p ? "," : "", prealloc_bytes[p], prepare_ms[p], per_line, prealloc_rate[p], (unsigned long long)prealloc_fat[p]);
+    }
+    printf("],\n");
+    printf(" \"scan\": {\"lines_per_s\": %.0f, \"mb_per_s\": %.3f, \"pages\": %u, \"page_bytes\": %llu},\n",
+            lines / seconds(t4, t5), data_bytes / seconds(t4, t5) / 1e6, scan_pages, (unsigned long long)scan_page_bytes);
+
+    // delimiter search alone over the first file, `memchr()` for a byte the file does not
+    // hold reads every byte as fast as libc can and bounds the others, then the lines are
+    // split into fields with two searches and with one vector pass
+    SDFileCatalog catalog;
+    catalog.refresh(*storage, "/", "log", "csv");
+    std::string text;
+    if(!catalog.files().empty()){
+        File f = storage->open(catalog.files().front().path.c_str(), "r");
+        text.resize(f ? sd_data_end(f) : 0);
+        f.seek(0);
+        text.resize(f ? f.read((uint8_t*)&text[0], text.size()) : 0);
+        f.close();
+    }
+
+    auto memchr_absent = [](const char* p, const char* end) -> uint64_t {
+        return memchr(p, 1, end - p) != NULL;
+    };
+    auto memchr_lines = [](const char* p, const char* end) -> uint64_t {
+        uint64_t n = 0;
+        while((p = (const char*)memchr(p, '\n', end - p)) != NULL){
+            p++;
+            n++;
+        }
+        return n;
+    };
+    auto find_fields = [](const char* p, const char* end) -> uint64_t {
+        uint64_t sum = 0;
+        for(const char* nl; p < end; p = nl + 1){
+            nl = (const char*)memchr(p, '\n', end - p);
+            if(nl == NULL) nl = end;
+            std::string_view line(p, nl - p);
+            size_t first_sc = line.find(';');
+            if(first_sc != std::string_view::npos) sum += line.find(';', first_sc + 1);
+        }
+        return sum;
+    };
+    auto scan_fields = [](const char* p, const char* end) -> uint64_t {
+        uint64_t sum = 0;
+        for(const char* nl; p < end; p = nl + 1){
+            nl = (const char*)memchr(p, '\n', end - p);
+            if(nl == NULL) nl = end;
+            size_t first_sc, second_sc;
+            if(sd_scan_separators(std::string_view(p, nl - p), ';', first_sc, second_sc)) sum += second_sc;
+        }
+        return sum;
+    };
+
+    const char* pass_names[] = {"memchr_absent", "memchr_newlines", "find_fields", "scan_fields"};
+    uint64_t pass_check[4] = {0};
+    double pass_mb[4] = {
+        pass_rate(text, memchr_absent, pass_check[0]),
+        pass_rate(text, memchr_lines, pass_check[1]),
+        pass_rate(text, find_fields, pass_check[2]),
+        pass_rate(text, scan_fields, pass_check[3]),
+    };
+
+    printf(" \"scan_modes\": {\"isa\": \"%s\", \"file_bytes\": %zu, \"same_results\": %s, \"passes\": [",
+            SDSCAN_ISA, text.size(), (pass_check[0] == 0 && pass_check[1] > 0 && pass_check[2] == pass_check[3]) ? "true" : "false");
+    for(int p = 0; p < 4; p++){
+        printf("%s\n  {\"pass\": \"%s\", \"mb_per_s\": %.0f}", p ? "," : "", pass_names[p], pass_mb[p]);
+    }
+    printf("],\n  \"queries\": [");
+
+    // full scans without the index, a filter matching nothing is bound by the scan alone
+    const char* read_modes[] = {"blocks", "mapped"};
+    const char* filter_names[] = {"none", "all"};
+    std::vector<std::string> filters[] = {{"no/such/topic"}, {""}};
+    for(int m = 0; m < ((storage == &posix) ? 2 : 1); m++){
+        for(int q = 0; q < 2; q++){
+            SDReader scanner;
+            scanner.set_storage(*storage);
+            scanner.set_page_sink(&sink);
+            scanner.set_use_index(false);
+            scanner.set_mapped(m == 1);
+
+            double best = 0;
+            for(int r = 0; r < BENCH_SCAN_REPEATS; r++){
+                sink.clear();
+                auto a = std::chrono::steady_clock::now();
+                scanner.read_entry_range_from_files(TimeStamp(first), TimeStamp(last), filters[q], 0);
+                auto b = std::chrono::steady_clock::now();
+                if(r == 0 || seconds(a, b) < best) best = seconds(a, b);
+            }
+
+            printf("%s\n   {\"read\": \"%s\", \"filter\": \"%s\", \"lines_per_s\": %.0f, \"mb_per_s\": %.1f, \"pages\": %u}",
+                    (m || q) ? "," : "", read_modes[m], filter_names[q], lines / best, data_bytes / best / 1e6, sink.pages());
+        }
+    }
+    printf("]},\n");
+    sink.clear();
+
+    // the lines of the first file read a byte per call into a growing string, as SDReader
+    // did before the block reader, then the same whole lines through the block reader
+    size_t bytewise_cap = (backend == "sd") ? BENCH_BYTEWISE_SD : BENCH_BYTEWISE_BYTES;
+    uint32_t line_scan_bytes = 0;
+    uint64_t bytewise_lines = 0, block_lines = 0;
+    double bytewise_s = 0, block_s = 0;
+    if(!catalog.files().empty()){
+        File f = storage->open(catalog.files().front().path.c_str(), "r");
+
+        auto a = std::chrono::steady_clock::now();
+        while(f.available() && line_scan_bytes < bytewise_cap){
+            std::string buf = "";
+            while(f.available()){
+                char c = f.read();
+                buf += c;
+
+                if(c == '\n'){
+                    break;
+                }
+            }
+            line_scan_bytes += buf.size();
+            bytewise_lines++;
+        }
+        auto b = std::chrono::steady_clock::now();
+
+        f.seek(0);
+        SDLineReader block;
+        std::string_view view;
+        block.attach(&f, line_scan_bytes);
+        while(block.next(view)) block_lines++;
+        auto c = std::chrono::steady_clock::now();
+        f.close();
+
+        bytewise_s = seconds(a, b);
+        block_s = seconds(b, c);
+    }
+    printf(" \"line_scan\": {\"bytes\": %u, \"lines\": %llu, \"same_lines\": %s, \"bytewise_mb_per_s\": %.3f, \"block_mb_per_s\": %.1f, \"speedup\": %.1f},\n",
+            line_scan_bytes, (unsigned long long)block_lines, bytewise_lines == block_lines ? "true" : "false",
+            line_scan_bytes / std::max(bytewise_s, 1e-9) / 1e6, line_scan_bytes / std::max(block_s, 1e-9) / 1e6,
+            bytewise_s / std::max(block_s, 1e-9));
+
+    // the same lines with topics encoded, sizes of the data files and full scans of both
+    {
+        SDLogger encoded;
+        encoded.set_storage(*storage);
+        encoded.enable_buffered_writes();
+        encoded.enable_topic_dictionary();
+        append_lines(encoded, "/dict", lines, interval);
+    }
+
+    uint64_t plain_bytes, plain_dict, encoded_bytes, encoded_dict;
+    catalog_bytes(*storage, "log", plain_bytes, plain_dict);
+    catalog_bytes(*storage, "dict", encoded_bytes, encoded_dict);
+
+    printf(" \"dictionary\": {\"plain_bytes\": %llu, \"encoded_bytes\": %llu, \"tdx_bytes\": %llu, \"size_ratio\": %.3f, \"scans\": [",
+            (unsigned long long)plain_bytes, (unsigned long long)encoded_bytes, (unsigned long long)encoded_dict,
+            plain_bytes > 0 ? (double)(encoded_bytes + encoded_dict) / plain_bytes : 0.0);
+    const char* dict_filter_names[] = {"all", "one_topic", "none"};
+    std::vector<std::string> dict_filters[] = {{""}, {"kkm_k6p/#"}, {"no/such/topic"}};
+    for(int q = 0; q < 3; q++){
+        double plain_s = best_scan(*storage, sink, "log", first, last, dict_filters[q]);
+        uint32_t plain_pages = sink.pages();
+        double encoded_s = best_scan(*storage, sink, "dict", first, last, dict_filters[q]);
+
+        printf("%s\n  {\"filter\": \"%s\", \"plain_ms\": %.2f, \"encoded_ms\": %.2f, \"speedup\": %.2f, \"plain_pages\": %u, \"encoded_pages\": %u}",
+                q ? "," : "", dict_filter_names[q], plain_s * 1e3, encoded_s * 1e3, plain_s / encoded_s, plain_pages, sink.pages());
+    }
+    printf("]},\n");
+    sink.clear();
+
+    // topic filters of growing size, one pattern matching the last topic behind ones
+    // matching none, compiled once against searched pattern by pattern per topic
+    const size_t filter_sizes[] = {1, 10, 100};
+    printf(" \"topic_filter\": [");
+    for(size_t f = 0; f < sizeof(filter_sizes) / sizeof(filter_sizes[0]); f++){
+        std::vector<std::string> patterns;
+        for(size_t p = 1; p < filter_sizes[f]; p++) patterns.push_back("sensor_" + std::to_string(p) + "/");
+        patterns.push_back("kkm_k6p");
+
+        size_t linear_matches = 0, compiled_matches = 0;
+        auto a = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < BENCH_FILTER_TOPICS; i++) linear_matches += linear_match(patterns, TOPICS[i % 4]);
+        auto b = std::chrono::steady_clock::now();
+        SDTopicFilter filter(patterns);
+        for(size_t i = 0; i < BENCH_FILTER_TOPICS; i++) compiled_matches += filter.match(TOPICS[i % 4]);
+        auto c = std::chrono::steady_clock::now();
+
+        double linear_ns = seconds(a, b) * 1e9 / BENCH_FILTER_TOPICS;
+        double compiled_ns = seconds(b, c) * 1e9 / BENCH_FILTER_TOPICS;
+        printf("%s\n  {\"patterns\": %zu, \"linear_ns_per_topic\": %.1f, \"compiled_ns_per_topic\": %.1f, \"speedup\": %.1f, \"same_matches\": %s}",
+                f ? "," : "", filter_sizes[f], linear_ns, compiled_ns, linear_ns / compiled_ns,
+                linear_matches == compiled_matches ? "true" : "false");
+    }
+    printf("],\n");
+
+    // range queries within the first day without an index, the whole file scanned against
+    // a binary search for the start and a stop after the window in a time ordered file
+    const char* order_modes[] = {"linear", "time_ordered"};
+    printf(" \"time_ordered\": [");
+    for(size_t w = 0; w < sizeof(WINDOWS) / sizeof(WINDOWS[0]); w++){
+        int64_t start = first + std::max<int64_t>(0, std::min<int64_t>(SD_SECS_PER_DAY, last - first) - WINDOWS[w]) / 2;
+        uint64_t order_bytes[2];
+        uint32_t order_lines[2];
+        double order_ms[2];
+
+        for(int m = 0; m < 2; m++){
+            reader.set_time_ordered(m == 1);
+            order_ms[m] = 0;
+            for(int r = 0; r < BENCH_RANGE_REPEATS; r++){
+                SDMetricsSnapshot before, after;
+                sink.clear();
+                sd_metrics_snapshot(before);
+                auto a = std::chrono::steady_clock::now();
+                reader.read_entry_range_from_files(TimeStamp(start), TimeStamp(start + WINDOWS[w] - 1), {""}, 0);
+                auto b = std::chrono::steady_clock::now();
+                sd_metrics_snapshot(after);
+
+                double ms = seconds(a, b) * 1e3;
+                if(r == 0 || ms < order_ms[m]) order_ms[m] = ms;
+                order_bytes[m] = reader.bytes_read();
+                order_lines[m] = after.counters[SD_LINES_MATCHED] - before.counters[SD_LINES_MATCHED];
+            }
+        }
+
+        printf("%s\n  {\"window_s\": %u, \"lines\": %u", w ? "," : "", WINDOWS[w], order_lines[1]);
+        for(int m = 0; m < 2; m++)
+            printf(", \"%s_bytes\": %llu, \"%s_ms\": %.3f", order_modes[m], (unsigned long long)order_bytes[m], order_modes[m], order_ms[m]);
+        printf(", \"same_lines\": %s}", order_lines[0] == order_lines[1] ? "true" : "false");
+    }
+    printf("],\n");
+    reader.set_time_ordered(false);
+    sink.clear();
+
+    // range queries through the index, windows spread over the data
+    reader.set_use_index(true);
+    reader.read_entry_range_from_files(TimeStamp(first), TimeStamp(first), {""}, 0);    // build the indexes
+    printf(" \"range\": [");
+    for(size_t w = 0; w < sizeof(WINDOWS) / sizeof(WINDOWS[0]); w++){
+        std::vector<double> ms;
+        uint64_t pages = 0;
+
+        for(int r = 0; r < BENCH_RANGE_REPEATS; r++){
+            int64_t span = std::max<int64_t>(0, last - first - WINDOWS[w]);
+            int64_t start = first + span * (2 * r + 1) / (2 * BENCH_RANGE_REPEATS);
+
+            sink.clear();
+            auto a = std::chrono::steady_clock::now();
+            reader.read_entry_range_from_files(TimeStamp(start), TimeStamp(start + WINDOWS[w] - 1), {""}, 0);
+            auto b = std::chrono::steady_clock::now();
+            ms.push_back(seconds(a, b) * 1e3);
+            pages += sink.pages();
+        }
+
+        std::sort(ms.begin(), ms.end());
+        printf("%s\n  {\"window_s\": %u, \"lines\": %u, \"median_ms\": %.3f, \"max_ms\": %.3f, \"pages\": %.1f}",
+                w ? "," : "", WINDOWS[w], std::max<uint32_t>(1, WINDOWS[w] / interval), ms[ms.size() / 2], ms.back(),
+                (double)pages / BENCH_RANGE_REPEATS);
+    }
+    printf("],\n");
+
+    // page building alone, lines already in memory
+    std::vector<std::string> entries;
+    BenchLine line;
+    for(size_t i = 0; i < std::min<size_t>(lines, 4096); i++){
+        make_line(i, interval, line);
+        entries.push_back(std::string(line.time) + ";" + line.topic + ";" + line.message + ";");
+    }
+
+    // heap of a day export: the peak of a new reader, then the allocations of its second
+    // export once its buffers are warm
+    const char* export_modes[] = {"sync", "pipelined"};
+    uint32_t export_pages[2];
+    uint64_t export_setup[2], export_steady[2];
+    int64_t export_peak[2];
+    for(int m = 0; m < 2; m++){
+        HeapSink heap;
+        heap_live = 0;
+        heap_peak = 0;
+        heap_tracking = true;
+        {
+            SDReader cold;
+            cold.set_storage(*storage);
+            cold.set_page_sink(&heap);
+            cold.set_pipelined(m == 1);
+            cold.read_entry_range_from_files(TimeStamp(first), TimeStamp(first + SD_SECS_PER_DAY - 1), {""}, 0);
+        }
+        heap_tracking = false;
+        export_peak[m] = heap_peak;
+
+        SDReader exporter;
+        exporter.set_storage(*storage);
+        exporter.set_page_sink(&heap);
+        exporter.set_pipelined(m == 1);
+        exporter.read_entry_range_from_files(TimeStamp(first), TimeStamp(first + SD_SECS_PER_DAY - 1), {""}, 0);
+
+        heap = HeapSink();
+        heap_allocations = 0;
+        heap_tracking = true;
+        exporter.read_entry_range_from_files(TimeStamp(first), TimeStamp(first + SD_SECS_PER_DAY - 1), {""}, 0);
+        heap_tracking = false;
+
+        export_pages[m] = heap.pages;
+        export_setup[m] = heap.first_page_allocations;
+        export_steady[m] = heap_allocations - heap.first_page_allocations;
+    }
+
+    // allocations of log calls into a warm logger, the write buffer holds every line so the
+    // storage is not written while counting
+    const char* log_modes[] = {"absolute", "relative", "dictionary"};
+    uint64_t log_allocations[3];
+    for(int m = 0; m < 3; m++){
+        SDLogger warm;
+        warm.set_storage(*storage);
+        warm.enable_buffered_writes(BENCH_HEAP_LINES * 256, UINT32_MAX);
+        if(m == 2) warm.enable_topic_dictionary();
+        warm.set_filename((std::string("/heap") + std::to_string(m)).c_str(), 5, 24, 2023, ".csv");
+
+        BenchLine heap_line;
+        for(size_t i = 0; i < 2 * BENCH_HEAP_LINES; i++){
+            make_line(i % 1000, 1, heap_line);
+            if(i == BENCH_HEAP_LINES){
+                warm.flush();
+                heap_allocations = 0;
+                heap_tracking = true;
+            }
+            if(m == 1) warm.log_relative_mqtt(heap_line.time, (int)(i % 60), heap_line.topic, heap_line.message);
+            else warm.log_absolute_mqtt(heap_line.time, heap_line.topic, heap_line.message);
+        }
+        heap_tracking = false;
+        log_allocations[m] = heap_allocations;
+    }
+
+    SDPageBuilder page;
+    size_t built = 0, page_count = 0;
+    uint64_t page_bytes = 0;
+    size_t rounds = std::max<size_t>(1, 1000000 / entries.size());
+
+    auto t6 = std::chrono::steady_clock::now();
+    page.begin("/log_5-24-2023.csv");
+    for(size_t r = 0; r < rounds; r++){
+        for(size_t i = 0; i < entries.size(); i++){
+            if(!page.add(entries[i], BENCH_START_EPOCH + i)){
+                page_bytes += page.finish().size();
+                page_count++;
+                page.begin("/log_5-24-2023.csv", page_count);
+                page.add(entries[i], BENCH_START_EPOCH + i);
+            }
+            built++;
+        }
+    }
+    page_bytes += page.finish().size();
+    page_count++;
+    auto t7 = std::chrono::steady_clock::now();
+
+    printf(" \"page_build\": {\"entries\": %zu, \"entries_per_s\": %.0f, \"ns_per_entry\": %.1f, \"pages\": %zu, \"mb_per_s\": %.1f}",
+            built, built / seconds(t6, t7), seconds(t6, t7) * 1e9 / built, page_count, page_bytes / seconds(t6, t7) / 1e6);
+
+    printf(",\n \"export_heap\": [");
+    for(int m = 0; m < 2; m++){
+        printf("%s\n  {\"mode\": \"%s\", \"pages\": %u, \"first_page_allocs\": %llu, \"allocs_per_page\": %.2f, \"peak_heap_bytes\": %lld}",
+                m ? "," : "", export_modes[m], export_pages[m], (unsigned long long)export_setup[m],
+                export_pages[m] > 1 ? (double)export_steady[m] / (export_pages[m] - 1) : 0.0, (long long)export_peak[m]);
+    }
+    printf("],\n \"log_heap\": [");
+    for(int m = 0; m < 3; m++){
+        printf("%s\n  {\"mode\": \"%s\", \"calls\": %u, \"allocs\": %llu, \"allocation_free\": %s}",
+                m ? "," : "", log_modes[m], BENCH_HEAP_LINES, (unsigned long long)log_allocations[m],
+                (log_allocations[m] == 0) ? "true" : "false");
+    }
+    printf("]");
+
+    if(storage == &memory){
+        const SDStorageStats& stats = memory.stats();
+        printf(",\n \"storage\": {\"opens\": %llu, \"reads\": %llu, \"writes\": %llu, \"flushes\": %llu, "
+                "\"fat_writes\": %llu, \"bytes_read\": %llu, \"bytes_written\": %llu, \"latency_ms\": %.1f}",
+                (unsigned long long)stats.opens, (unsigned long long)stats.reads, (unsigned long long)stats.writes,
+                (unsigned long long)stats.flushes, (unsigned long long)stats.fat_writes, (unsigned long long)stats.bytes_read,
+                (unsigned long long)stats.bytes_written, stats.latency_us / 1e3);
+    }
+
+    SDMetricsSnapshot snapshot;
+    std::string metrics;
+    sd_metrics_snapshot(snapshot);
+    sd_metrics_json(snapshot, metrics);
+    printf(",\n \"metrics\": %s}\n", metrics.c_str());
+
+    return 0;
+}
@@ -0,0 +1,647 @@
+/**
+ * @file sdlog_check.cpp
+ * @brief Host checks of SDLogger and SDReader behaviour which benchmarks do not cover.
+ *
+ * ```
+ * sdlog_check
+ * ```
+ *
+ * Runs each check against an `SDMemoryStorage` and prints `ok <check>` or
+ * `FAIL <check>: <details>` per check, exiting non-zero if any failed. The checks are
+ *
+ * - `buffered_writes`, a buffered logger going out of scope writes its lines, and a short
+ *   write keeps the unwritten bytes for the next flush instead of losing them.
+ * - `late_index`, a record routed late to its daily file by a rotating logger with a time
+ *   index is found again by range queries seeking with the index, in text and binary format,
+ *   by SDReader and by SDArchiveReader.
+ * - `mqtt_cursor`, an export to the MQTT broker without a connection does not move the
+ *   query cursor past its pages, and does once the client is connected.
+ * - `cursor_replaced`, an export interrupted in the middle of a second and resumed after its
+ *   file was compressed publishes every line exactly once.
+ * - `mqtt_pipelined`, a pipelined export to the MQTT broker publishes from the sender task
+ *   only once the application gave the reader a lock for `mqtt_client`.
+ * - `compress_closed`, a file left by a logger with compression enabled waits for 
+ *   `compress_closed_files()`, and its topic dictionary no longer points into the removed
+ *   plain file once it is compressed.
+ * - `topic_dictionary`, topics beginning with `@` are not taken for dictionary IDs, and
+ *   lines logged after `disable_topic_dictionary()` are found by filters matching no
+ *   dictionary topic, by SDReader and by SDArchiveReader.
+ * - `prepare_day`, a rotating logger on storage whose preallocation writes zeros leaves
+ *   files created by a log call unreserved, and writes in place to a daily file prepared
+ *   ahead with its header once, which reads back whole after its zeros are cut.
+ * - `time_parser`, SDTimeParser agrees with `timegm()` on the last second of every month
+ *   over leap and common years, on year rollovers, on relative `+offset` suffixes in
+ *   minutes crossing midnight and the new year, and on random time stamps. The host 
+ *   TimeStamp only holds an epoch, so `timegm()` is the reference.
+ *
+ * Build on the host with
+ *
+ * ```
+ * cd .. && g++ -std=c++17 -O2 -Ihost -I. tools/sdlog_check.cpp host/SDHost.cpp SDStorage.cpp \
+ *     SDLogger.cpp SDReader.cpp SDArchiveReader.cpp SDWorkPool.cpp SDTime.cpp SDBinaryFormat.cpp \
+ *     SDCompress.cpp SDPageBuilder.cpp SDPageSink.cpp SDPagePipeline.cpp SDQueryCursor.cpp \
+ *     SDJson.cpp SDAggregator.cpp SDProjector.cpp SDFileCatalog.cpp SDTopicFilter.cpp \
+ *     SDTopicDictionary.cpp SDLineReader.cpp SDMetrics.cpp SDRecovery.cpp -o sdlog_check -lpthread
+ * ```
+ */
+#include "SDLogger.hpp"
+#include "SDReader.hpp"
+#include "SDArchiveReader.hpp"
+#include "SDStorage.hpp"
+#include "SDPageSink.hpp"
+#include "SDTime.hpp"
+#include "SDMetrics.hpp"
+#include "SDTopicDictionary.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#define CHECK_DAY_EPOCH 1684886400      // 5-24-2023T00:00:00
+
+PubSubClient mqtt_client;
+extern const bool USB_DEBUG = false;
+
+static int failures = 0;
+
+/**
+ * Reports the outcome of check `name`, `details` are printed if it failed.
+ */
+static void report(const char* name, bool ok, const std::string& details){
+    if(ok){
+        printf("ok %s\n", name);
+        return;
+    }
+
+    printf("FAIL %s: %s\n", name, details.c_str());
+    failures++;
+}
+
+/**
+ * Counts the occurrences of `needle` in the pages published to `sink`.
+ */
+static size_t count_in_pages(const SDLocalSink& sink, const std::string& needle){
+    size_t n = 0;
+    for(const std::string& page : sink.received()){
+        for(size_t pos = page.find(needle); pos != std::string::npos; pos = page.find(needle, pos + 1)) n++;
+    }
+    return n;
+}
+
+/**
+ * Counts the records of the 5-24-2023 file matching `needle`, read back with SDReader.
+ */
+static size_t count_logged(SDStorage& storage, const std::string& needle){
+    SDLocalSink sink(0, 0, true);
+    SDReader reader;
+    reader.set_storage(storage);
+    reader.set_page_sink(&sink);
+    reader.read_entry_range_from_files(TimeStamp(CHECK_DAY_EPOCH), TimeStamp(CHECK_DAY_EPOCH + SD_SECS_PER_DAY - 1),
+            {""}, 0, "log", "csv");
+    return count_in_pages(sink, needle);
+}
+
+/**
+ * Logs lines through the buffered writer and lets the logger go out of scope without a
+ * flush, then logs while the storage cuts a buffer write short and flushes once it accepts
+ * writes again. Every line must be in the file.
+ */
+static void check_buffered_writes(){
+    SDMemoryStorage storage;
+    char time[SD_TIME_CHARS];
+    std::string details;
+
+    {
+        SDLogger logger;
+        logger.set_storage(storage);
+        logger.set_filename("/log", 5, 24, 2023, ".csv");
+        logger.enable_buffered_writes(SDLOGGER_DEFAULT_BUFFER_SIZE, UINT32_MAX);
+        for(int i = 0; i < 50; i++){
+            time[sd_format_time(CHECK_DAY_EPOCH + i, time)] = 0;
+            logger.log_absolute_mqtt(time, "meter/0", "{\"SCOPE\":1}");
+        }
+    }
+    size_t scoped = count_logged(storage, "SCOPE");
+    if(scoped != 50) details += "destructor left " + std::to_string(scoped) + " of 50 lines; ";
+
+    SDMetricsSnapshot before, after;
+    sd_metrics_snapshot(before);
+    {
+        SDLogger logger;
+        logger.set_storage(storage);
+        logger.set_filename("/log", 5, 24, 2023, ".csv");
+        logger.enable_buffered_writes(4096, UINT32_MAX);
+
+        // the first full buffer is written in part, the rest of the lines fit behind its tail
+        storage.set_write_limit(1000);
+        for(int i = 0; i < 110; i++){
+            time[sd_format_time(CHECK_DAY_EPOCH + 100 + i, time)] = 0;
+            logger.log_absolute_mqtt(time, "meter/0", "{\"SHORT\":1}");
+        }
+        storage.set_write_limit(UINT64_MAX);
+        logger.flush();
+    }
+    sd_metrics_snapshot(after);
+
+    size_t kept = count_logged(storage, "SHORT");
+    uint32_t short_writes = after.counters[SD_SHORT_WRITES] - before.counters[SD_SHORT_WRITES];
+    uint32_t dropped = after.counters[SD_BYTES_DROPPED] - before.counters[SD_BYTES_DROPPED];
+    if(kept != 110 || short_writes != 1 || dropped != 0){
+        details += "short write kept " + std::to_string(kept) + " of 110 lines, counted " + 
+                std::to_string(short_writes) + " short writes and " + std::to_string(dropped) + " bytes dropped; ";
+    }
+
+    report("buffered_writes", details.empty(), details);
+}
+
+/**
+ * Logs a morning of records to one day, some to the next day, then one record for
+ * the first day's night which the rotating logger appends to the first day's file after
+ * its morning. Range queries over the night must return the late record with and without
+ * seeking by index.
+ */
+static void check_late_index(SDLogFormat format, const char* filetype, const char* name){
+    SDMemoryStorage storage;
+    char time[SD_TIME_CHARS];
+
+    SDLogger logger;
+    logger.set_storage(storage);
+    logger.set_format(format);
+    logger.enable_index(16);
+    logger.enable_rotation("/log", filetype, {}, 2);
+
+    for(int i = 0; i < 1000; i++){
+        time[sd_format_time(CHECK_DAY_EPOCH + 10 * 3600 + i, time)] = 0;
+        logger.log_absolute_mqtt(time, "meter/0", "{\"VWC\":1}");
+    }
+    for(int i = 0; i < 100; i++){
+        time[sd_format_time(CHECK_DAY_EPOCH + SD_SECS_PER_DAY + i, time)] = 0;
+        logger.log_absolute_mqtt(time, "meter/0", "{\"VWC\":2}");
+    }
+    time[sd_format_time(CHECK_DAY_EPOCH + 1800, time)] = 0;
+    logger.log_absolute_mqtt(time, "meter/0", "{\"LATE\":1}");
+    logger.close_card();
+
+    std::string details;
+    bool ok = true;
+    for(int mode = 0; mode < 3; mode++){
+        SDLocalSink sink(0, 0, true);
+        SDReader reader;
+        reader.set_storage(storage);
+        reader.set_page_sink(&sink);
+        reader.set_use_index(mode > 0, mode == 2);
+        reader.read_entry_range_from_files(TimeStamp(CHECK_DAY_EPOCH), TimeStamp(CHECK_DAY_EPOCH + 3600),
+                {""}, 0, "log", filetype + 1);
+
+        SDLocalSink archive_sink(0, 0, true);
+        SDArchiveReader archive(storage);
+        archive.set_page_sink(&archive_sink);
+        archive.set_use_index(mode > 0);
+        archive.read_entry_range_from_files(TimeStamp(CHECK_DAY_EPOCH), TimeStamp(CHECK_DAY_EPOCH + 3600),
+                {""}, 0, "log", filetype + 1);
+
+        for(const SDLocalSink* found : {&sink, &archive_sink}){
+            size_t late = count_in_pages(*found, "LATE");
+            size_t others = count_in_pages(*found, "VWC");
+            if(late != 1 || others != 0){
+                ok = false;
+                details += std::string((found == &sink) ? "reader" : "archive") + " index mode " + 
+                        std::to_string(mode) + " found " + std::to_string(late) + " late and " + 
+                        std::to_string(others) + " other records; ";
+            }
+        }
+    }
+
+    report(name, ok, details);
+}
+
+/**
+ * Exports a file through the default MQTT sink with the stand in client disconnected and
+ * then connected. Failed pages must leave the cursor before them.
+ */
+static void check_mqtt_cursor(){
+    SDMemoryStorage storage;
+    char time[SD_TIME_CHARS];
+
+    SDLogger logger;
+    logger.set_storage(storage);
+    logger.set_filename("/log", 5, 24, 2023, ".csv");
+    for(int i = 0; i < 100; i++){
+        time[sd_format_time(CHECK_DAY_EPOCH + i, time)] = 0;
+        logger.log_absolute_mqtt(time, "meter/0", "{\"VWC\":1}");
+    }
+    logger.close_card();
+
+    std::string details;
+    bool ok = true;
+    for(bool connected : {false, true}){
+        mqtt_client.set_connected(connected);
+
+        SDReader reader;
+        reader.set_storage(storage);
+        reader.enable_cursor();
+        reader.read_entry_range_from_files(TimeStamp(CHECK_DAY_EPOCH), TimeStamp(CHECK_DAY_EPOCH + 3600),
+                {""}, 10, "log", "csv");
+
+        const SDQueryCursor& cursor = reader.get_cursor();
+        if(cursor.file.empty() == connected){
+            ok = false;
+            details += std::string(connected ? "connected" : "disconnected") + " export left the cursor at page " + 
+                    std::to_string(cursor.seq) + "; ";
+        }
+    }
+    mqtt_client.set_connected(true);
+
+    report("mqtt_cursor", ok, details);
+}
+
+/**
+ * Stand in for a broker which accepts `pages` pages and fails the rest.
+ */
+class CutSink : public SDLocalSink {
+
+    private:
+
+        uint32_t left;
+
+    public:
+
+        CutSink(uint32_t pages) : SDLocalSink(0, 0, true), left(pages) {}
+
+        bool publish(const std::string& topic, const std::string& page) override {
+            if(this->left == 0) return false;
+            this->left--;
+            return SDLocalSink::publish(topic, page);
+        }
+
+};
+
+/**
+ * Interrupts an export of a file logging four lines a second in the middle of a second,
+ * compresses the file and resumes the export. Every line must be published exactly once.
+ */
+static void check_cursor_replaced(){
+    SDMemoryStorage storage;
+    char time[SD_TIME_CHARS];
+
+    SDLogger logger;
+    logger.set_storage(storage);
+    logger.set_filename("/log", 5, 24, 2023, ".csv");
+    for(int i = 0; i < 100; i++){
+        time[sd_format_time(CHECK_DAY_EPOCH + i / 4, time)] = 0;
+        logger.log_absolute_mqtt(time, "meter/0", "{\"n\":" + std::to_string(i) + "}");
+    }
+    logger.close_card();
+
+    CutSink first(3), second(UINT32_MAX);
+    for(CutSink* sink : {&first, &second}){
+        if(sink == &second) logger.compress_file("/log_5-24-2023.csv");
+
+        SDReader reader;
+        reader.set_storage(storage);
+        reader.set_page_sink(sink);
+        reader.enable_cursor();
+        reader.read_entry_range_from_files(TimeStamp(CHECK_DAY_EPOCH), TimeStamp(CHECK_DAY_EPOCH + 3600),
+                {""}, 10, "log", "csv");
+    }
+
+    std::string details;
+    if(!storage.exists("/log_5-24-2023.csv.sdz")) details += "the file was not compressed; ";
+    for(int i = 0; i < 100; i++){
+        std::string needle = "n\\\":" + std::to_string(i) + "}";
+        size_t n = count_in_pages(first, needle) + count_in_pages(second, needle);
+        if(n != 1) details += "line " + std::to_string(i) + " published " + std::to_string(n) + " times; ";
+    }
+
+    report("cursor_replaced", details.empty(), details);
+}
+
+/**
+ * Exports a file through the default MQTT sink in pipelined mode without and with a client
+ * lock. Without one the sender task must not publish.
+ */
+static void check_mqtt_pipelined(){
+    SDMemoryStorage storage;
+    char time[SD_TIME_CHARS];
+
+    SDLogger logger;
+    logger.set_storage(storage);
+    logger.set_filename("/log", 5, 24, 2023, ".csv");
+    for(int i = 0; i < 100; i++){
+        time[sd_format_time(CHECK_DAY_EPOCH + i, time)] = 0;
+        logger.log_absolute_mqtt(time, "meter/0", "{\"VWC\":1}");
+    }
+    logger.close_card();
+
+    SDMutex client_lock;
+    std::string details;
+    bool ok = true;
+    for(bool locked : {false, true}){
+        SDReader reader;
+        reader.set_storage(storage);
+        reader.set_pipelined(true);
+        if(locked) reader.set_mqtt_lock(&client_lock);
+        reader.read_entry_range_from_files(TimeStamp(CHECK_DAY_EPOCH), TimeStamp(CHECK_DAY_EPOCH + 3600),
+                {""}, 10, "log", "csv");
+
+        uint32_t sent = reader.get_pipeline().pages_sent();
+        if((sent > 0) != locked){
+            ok = false;
+            details += std::string(locked ? "locked" : "unlocked") + " export sent " + std::to_string(sent) + 
+                    " pages from the sender task; ";
+        }
+    }
+
+    report("mqtt_pipelined", ok, details);
+}
+
+/**
+ * Logs a day with topics encoded part way through the file and moves the logger to the 
+ * next day. The day must stay plain until `compress_closed_files()`, after which its
+ * dictionary starts at offset 0 and a late line logged to the day is read back.
+ */
+static void check_compress_closed(){
+    SDMemoryStorage storage;
+    char time[SD_TIME_CHARS];
+    std::string details;
+
+    SDLogger logger;
+    logger.set_storage(storage);
+    logger.enable_compression();
+    logger.set_filename("/log", 5, 24, 2023, ".csv");
+    for(int i = 0; i < 200; i++){
+        if(i == 100) logger.enable_topic_dictionary();
+        time[sd_format_time(CHECK_DAY_EPOCH + i, time)] = 0;
+        logger.log_absolute_mqtt(time, "meter/0", "{\"VWC\":1}");
+    }
+
+    logger.set_filename("/log", 5, 25, 2023, ".csv");
+    if(!storage.exists("/log_5-24-2023.csv") || storage.exists("/log_5-24-2023.csv.sdz"))
+        details += "the day was compressed while switching files; ";
+    if(logger.pending_compression() != 1)
+        details += "queued " + std::to_string(logger.pending_compression()) + " files instead of 1; ";
+
+    size_t done = logger.compress_closed_files();
+    if(done != 1 || storage.exists("/log_5-24-2023.csv") || !storage.exists("/log_5-24-2023.csv.sdz"))
+        details += "compress_closed_files() compressed " + std::to_string(done) + " files; ";
+
+    SDTopicDictionary dict;
+    if(!dict.load(storage, "/log_5-24-2023.csv") || dict.start_offset() != 0)
+        details += "dictionary starts at " + std::to_string(dict.start_offset()) + " after compression; ";
+
+    logger.set_filename("/log", 5, 24, 2023, ".csv");
+    time[sd_format_time(CHECK_DAY_EPOCH + 3000, time)] = 0;
+    logger.log_absolute_mqtt(time, "meter/0", "{\"LATE\":1}");
+    logger.close_card();
+
+    size_t found = count_logged(storage, "VWC");
+    size_t late = count_logged(storage, "LATE");
+    if(found != 200 || late != 1)
+        details += "read back " + std::to_string(found) + " of 200 lines and " + std::to_string(late) + " late lines; ";
+
+    report("compress_closed", details.empty(), details);
+}
+
+/**
+ * Size of file `path` in `storage`, `0` if it is missing.
+ */
+static uint32_t file_size(SDStorage& storage, const char* path){
+    File f = storage.open(path, FILE_READ);
+    uint32_t size = f ? f.size() : 0;
+    if(f) f.close();
+    return size;
+}
+
+/**
+ * Logs to a day nobody prepared and to a day prepared ahead with `prepare_day()`, on
+ * storage simulating the card's cost of writing zeros. Only the prepared file may be
+ * reserved, it must keep its size while records are logged into it, hold its header once
+ * and shrink to its data when the logger closes it.
+ */
+static void check_prepare_day(){
+    SDLatency latency;
+    latency.write_us = 1;
+    SDMemoryStorage storage(latency);
+    char time[SD_TIME_CHARS];
+    std::string details;
+
+    SDLogger logger;
+    logger.set_storage(storage);
+    logger.enable_rotation("/log", ".csv", {"TIME", "MQTT TOPIC", "MQTT MESSAGE"});
+    logger.enable_preallocation(65536);
+
+    time[sd_format_time(CHECK_DAY_EPOCH - 60, time)] = 0;
+    logger.log_absolute_mqtt(time, "meter/0", "{\"VWC\":1}");
+    logger.flush();
+    if(file_size(storage, "/log_5-23-2023.csv") >= 65536)
+        details += "a file created by a log call was preallocated; ";
+
+    if(!logger.prepare_day(CHECK_DAY_EPOCH + 3600) || file_size(storage, "/log_5-24-2023.csv") != 65536)
+        details += "prepare_day() left " + std::to_string(file_size(storage, "/log_5-24-2023.csv")) + " bytes; ";
+
+    for(int i = 0; i < 100; i++){
+        time[sd_format_time(CHECK_DAY_EPOCH + i, time)] = 0;
+        logger.log_absolute_mqtt(time, "meter/0", "{\"VWC\":1}");
+    }
+    logger.flush();
+    if(file_size(storage, "/log_5-24-2023.csv") != 65536)
+        details += "the prepared file grew to " + std::to_string(file_size(storage, "/log_5-24-2023.csv")) + " bytes; ";
+    logger.close_card();
+
+    File f = storage.open("/log_5-24-2023.csv", FILE_READ);
+    std::string text(f ? f.size() : 0, '\0');
+    if(f){
+        text.resize(f.read((uint8_t*)&text[0], text.size()));
+        f.close();
+    }
+    size_t headers = 0;
+    for(size_t pos = text.find("MQTT TOPIC"); pos != std::string::npos; pos = text.find("MQTT TOPIC", pos + 1)) headers++;
+    if(headers != 1 || text.size() >= 65536)
+        details += std::to_string(headers) + " headers in " + std::to_string(text.size()) + " bytes after closing; ";
+
+    size_t found = count_logged(storage, "VWC");
+    if(found != 100) details += "read back " + std::to_string(found) + " of 100 lines; ";
+
+    report("prepare_day", details.empty(), details);
+}
+
+/**
+ * Logs a file with a literal `@12` topic before encoding starts, encoded topics and a
+ * formatted line with an escaped `@@5` topic while it is on, then other topics after it
+ * is disabled. Queries for each part must return exactly its lines with their topics as
+ * logged.
+ */
+static void check_topic_dictionary(){
+    SDMemoryStorage storage;
+    char time[SD_TIME_CHARS];
+
+    SDLogger logger;
+    logger.set_storage(storage);
+    logger.set_filename("/log", 5, 24, 2023, ".csv");
+    for(int i = 0; i < 150; i++){
+        if(i == 50) logger.enable_topic_dictionary();
+        if(i == 100) logger.disable_topic_dictionary();
+
+        time[sd_format_time(CHECK_DAY_EPOCH + i, time)] = 0;
+        const char* topic = (i < 50) ? "@12" : (i < 100) ? "meter/0" : "other/1";
+        logger.log_absolute_mqtt(time, topic, "{\"VWC\":1}");
+
+        if(i == 75) logger.log_line(std::string(time) + ";@@5;{\"VWC\":1};");
+    }
+    logger.close_card();
+
+    struct Query { std::vector<std::string> filter; const char* needle; size_t expect; } queries[] = {
+        {{""}, "VWC", 151}, {{"@12"}, ";@12;", 50}, {{"@5"}, ";@5;", 1}, {{"other/#"}, ";other/1;", 50}, {{""}, "@@", 0}
+    };
+
+    std::string details;
+    for(const Query& q : queries){
+        SDLocalSink sink(0, 0, true);
+        SDReader reader;
+        reader.set_storage(storage);
+        reader.set_page_sink(&sink);
+        reader.read_entry_range_from_files(TimeStamp(CHECK_DAY_EPOCH), TimeStamp(CHECK_DAY_EPOCH + 3600),
+                q.filter, 0, "log", "csv");
+
+        SDLocalSink archive_sink(0, 0, true);
+        SDArchiveReader archive(storage);
+        archive.set_page_sink(&archive_sink);
+        archive.read_entry_range_from_files(TimeStamp(CHECK_DAY_EPOCH), TimeStamp(CHECK_DAY_EPOCH + 3600),
+                q.filter, 0, "log", "csv");
+
+        for(const SDLocalSink* found : {&sink, &archive_sink}){
+            size_t n = count_in_pages(*found, q.needle);
+            if(n != q.expect){
+                details += std::string((found == &sink) ? "reader" : "archive") + " filter '" + q.filter[0] + 
+                        "' found " + std::to_string(n) + " '" + q.needle + "' instead of " + std::to_string(q.expect) + "; ";
+            }
+        }
+    }
+
+    report("topic_dictionary", details.empty(), details);
+}
+
+/**
+ * Parses `ts` with `parser` and compares the epoch to `expect`, adding a description of
+ * any difference to `details`.
+ */
+static void expect_time(SDTimeParser& parser, const std::string& ts, int64_t expect, std::string& details){
+    int64_t epoch = 0;
+    if(!parser.parse(ts, epoch)){
+        details += "rejected " + ts + "; ";
+
+    }else if(epoch != expect){
+        details += ts + " parsed to " + std::to_string(epoch) + " instead of " + std::to_string(expect) + "; ";
+    }
+}
+
+/**
+ * Formats `tm` the way SDLogger writes time stamps, with `+offset` appended if `offset`
+ * is not `NULL`, and with the month and day zero padded if `padded`.
+ */
+static std::string time_text(const struct tm& tm, const int* offset, bool padded){
+    char text[48];
+    int n = snprintf(text, sizeof(text), padded ? "%02d-%02d-%04dT%02d:%02d:%02d" : "%d-%d-%04dT%02d:%02d:%02d",
+            tm.tm_mon + 1, tm.tm_mday, tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    if(offset != NULL) snprintf(text + n, sizeof(text) - n, "+%d", *offset);
+    return text;
+}
+
+/**
+ * Compares SDTimeParser against `timegm()` on every month end of common, leap and century
+ * years, on offsets which move a time stamp across midnight and the new year, and on 
+ * random time stamps, parsed with one parser so its cached day is exercised as well.
+ */
+static void check_time_parser(){
+    SDTimeParser parser;
+    std::string details;
+
+    // last second of each month, and the first second after it
+    for(int year : {1970, 1999, 2000, 2023, 2024, 2038, 2100}){
+        for(int month = 0; month < 12; month++){
+            struct tm tm = {};
+            tm.tm_year = year - 1900;
+            tm.tm_mon = month + 1;
+            tm.tm_mday = 1;
+            int64_t next = timegm(&tm);
+
+            time_t last = next - 1;
+            gmtime_r(&last, &tm);
+            expect_time(parser, time_text(tm, NULL, false), next - 1, details);
+            expect_time(parser, time_text(tm, NULL, true), next - 1, details);
+
+            time_t first = next;
+            gmtime_r(&first, &tm);
+            expect_time(parser, time_text(tm, NULL, false), next, details);
+        }
+
+        // February 29th only exists in leap years
+        int64_t epoch;
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        std::string feb29 = "2-29-" + std::to_string(year) + "T12:00:00";
+        if(leap){
+            struct tm tm = {};
+            tm.tm_year = year - 1900;
+            tm.tm_mon = 1;
+            tm.tm_mday = 29;
+            tm.tm_hour = 12;
+            expect_time(parser, feb29, timegm(&tm), details);
+
+        }else if(parser.parse(feb29, epoch)){
+            struct tm tm = {};
+            tm.tm_year = year - 1900;
+            tm.tm_mon = 2;
+            tm.tm_mday = 1;
+            tm.tm_hour = 12;
+            if(epoch != (int64_t)timegm(&tm)) details += feb29 + " is not read as March 1st; ";
+        }
+    }
+
+    // relative offsets are minutes, across midnight, the new year and back
+    for(int offset : {0, 1, 5, 59, 61, 1440, 525600, -1, -61, -1440}){
+        struct tm tm = {};
+        tm.tm_year = 2023 - 1900;
+        tm.tm_mon = 11;
+        tm.tm_mday = 31;
+        tm.tm_hour = 23;
+        tm.tm_min = 58;
+        tm.tm_sec = 30;
+        int64_t base = timegm(&tm);
+        expect_time(parser, time_text(tm, &offset, false), base + (int64_t)offset * 60, details);
+    }
+
+    // random time stamps from 1970 to 2100 with and without offsets
+    srand(1);
+    for(int i = 0; i < 100000; i++){
+        time_t t = (time_t)(((uint64_t)rand() << 16 ^ (uint64_t)rand()) % 4102444800ULL);
+        struct tm tm;
+        gmtime_r(&t, &tm);
+
+        int offset = rand() % 2000 - 1000;
+        bool relative = (i % 3 == 0);
+        expect_time(parser, time_text(tm, relative ? &offset : NULL, i % 2 == 0), 
+                t + (relative ? (int64_t)offset * 60 : 0), details);
+        if(details.size() > 1000) break;
+    }
+
+    report("time_parser", details.empty(), details);
+}
+
+int main(){
+    Serial.set_muted(true);
+
+    check_buffered_writes();
+    check_late_index(SD_FORMAT_TEXT, ".csv", "late_index_text");
+    check_late_index(SD_FORMAT_BINARY, ".sdl", "late_index_binary");
+    check_mqtt_cursor();
+    check_cursor_replaced();
+    check_mqtt_pipelined();
+    check_compress_closed();
+    check_topic_dictionary();
+    check_prepare_day();
+    check_time_parser();
+
+    return (failures > 0) ? 1 : 0;
+}
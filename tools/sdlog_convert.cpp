@@ -0,0 +1,313 @@
+/**
+ * @file sdlog_convert.cpp
+ * @brief Host tool converting SDLogger files between the text and binary formats, and
+ *  comparing the two formats on a sample file.
+ *
+ * ```
+ * sdlog_convert to-binary <log.csv> <log.sdl>
+ * sdlog_convert to-text <log.sdl> <log.csv>
+ * sdlog_convert bench <log.csv>
+ * ```
+ *
+ * Topic dictionaries are read from and written to the `.tdx` sidecar next to each file,
+ * as on the card. Build on the host with
+ *
+ * ```
+ * g++ -std=c++17 -O2 -I.. sdlog_convert.cpp ../SDBinaryFormat.cpp ../SDTime.cpp -o sdlog_convert
+ * ```
+ */
+#include "SDBinaryFormat.hpp"
+#include "SDTime.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define DICT_EXT ".tdx"
+
+struct Record {
+    int64_t epoch;
+    std::string topic;
+    std::string message;
+};
+
+static bool read_file(const std::string& fn, std::string& out){
+    std::ifstream in(fn, std::ios::binary);
+    if(!in) return false;
+
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+/**
+ * Reads the `<id>;<topic>` lines of a `.tdx` sidecar, a missing sidecar gives an empty
+ * dictionary.
+ */
+static std::vector<std::string> read_dictionary(const std::string& fn){
+    std::vector<std::string> topics;
+    std::ifstream in(fn + DICT_EXT);
+    std::string line;
+
+    while(std::getline(in, line)){
+        size_t sep = line.find(';');
+        if(line.empty() || line[0] == '#' || sep == std::string::npos) continue;
+        if(strtoul(line.substr(0, sep).c_str(), NULL, 10) != topics.size()) continue;
+        topics.push_back(line.substr(sep + 1));
+    }
+
+    return topics;
+}
+
+static bool write_dictionary(const std::string& fn, const std::vector<std::string>& topics){
+    std::ofstream out(fn + DICT_EXT, std::ios::binary);
+    out << "#0\n";
+    for(size_t id = 0; id < topics.size(); id++) out << id << ";" << topics[id] << "\n";
+    return (bool)out;
+}
+
+/**
+ * Splits a text log into records. Lines without a time stamp, like the header, are
+ * skipped and `@<id>` topics are resolved through the file's dictionary.
+ */
+static std::vector<Record> parse_text(const std::string& text, const std::vector<std::string>& topics){
+    std::vector<Record> records;
+    SDTimeParser parser;
+    size_t pos = 0;
+
+    while(pos < text.size()){
+        size_t end = text.find('\n', pos);
+        if(end == std::string::npos) end = text.size();
+
+        std::string_view line(text.data() + pos, end - pos);
+        pos = end + 1;
+
+        if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        size_t first_sc = line.find(';');
+        size_t second_sc = (first_sc == std::string_view::npos) ? first_sc : line.find(';', first_sc + 1);
+        if(second_sc == std::string_view::npos) continue;
+
+        Record r;
+        if(!parser.parse(line.substr(0, first_sc), r.epoch)) continue;
+
+        std::string_view topic = line.substr(first_sc + 1, second_sc - first_sc - 1);
+        if(topic.size() > 1 && topic[0] == '@'){
+            size_t id = strtoul(std::string(topic.substr(1)).c_str(), NULL, 10);
+            if(id < topics.size()) topic = topics[id];
+        }
+        r.topic = topic;
+
+        std::string_view message = line.substr(second_sc + 1);
+        if(!message.empty() && message.back() == ';') message.remove_suffix(1);
+        r.message = message;
+
+        records.push_back(std::move(r));
+    }
+
+    return records;
+}
+
+/**
+ * Encodes records into blocks, assigning topic IDs in order of first use.
+ */
+static std::string encode_binary(const std::vector<Record>& records, std::vector<std::string>& topics){
+    std::map<std::string, uint16_t> ids;
+    std::string out;
+    SDBlockEncoder encoder;
+
+    for(const Record& r : records){
+        auto it = ids.find(r.topic);
+        if(it == ids.end()){
+            it = ids.emplace(r.topic, topics.size()).first;
+            topics.push_back(r.topic);
+        }
+
+        if(!encoder.add(r.epoch, it->second, r.message)){
+            out.append(encoder.finish());
+            encoder.reset();
+            encoder.add(r.epoch, it->second, r.message);
+        }
+    }
+
+    out.append(encoder.finish());
+    return out;
+}
+
+/**
+ * Decodes every block of a binary log, calling `emit` for each record. Corrupt blocks
+ * are reported and skipped by searching for the next block header.
+ *
+ * @returns The number of corrupt blocks.
+ */
+template <typename Emit>
+static size_t decode_binary(const std::string& data, Emit emit){
+    const uint8_t* p = (const uint8_t*)data.data();
+    size_t pos = 0;
+    size_t corrupt = 0;
+    SDBlockHeader header;
+    SDBlockDecoder decoder;
+
+    while(pos < data.size()){
+        if(!SDBlockDecoder::parse_header(p + pos, data.size() - pos, header)){
+            pos++;
+            continue;
+        }
+
+        if(pos + SDLOGGER_BLOCK_HEADER + header.payload_len > data.size() ||
+                !decoder.begin(header, p + pos + SDLOGGER_BLOCK_HEADER)){
+            fprintf(stderr, "[ERROR] corrupt block at offset %zu\n", pos);
+            corrupt++;
+            pos++;
+            continue;
+        }
+        pos += SDLOGGER_BLOCK_HEADER + header.payload_len;
+
+        int64_t epoch;
+        uint16_t id;
+        std::string_view message;
+        while(decoder.next(epoch, id, message)) emit(epoch, id, message);
+    }
+
+    return corrupt;
+}
+
+static int to_binary(const std::string& in_fn, const std::string& out_fn){
+    std::string text;
+    if(!read_file(in_fn, text)){
+        fprintf(stderr, "[ERROR] cannot read %s\n", in_fn.c_str());
+        return 1;
+    }
+
+    std::vector<Record> records = parse_text(text, read_dictionary(in_fn));
+    std::vector<std::string> topics;
+    std::string data = encode_binary(records, topics);
+
+    std::ofstream out(out_fn, std::ios::binary);
+    out.write(data.data(), data.size());
+    if(!out || !write_dictionary(out_fn, topics)){
+        fprintf(stderr, "[ERROR] cannot write %s\n", out_fn.c_str());
+        return 1;
+    }
+
+    printf("%zu records, %zu topics, %zu -> %zu bytes\n", records.size(), topics.size(), text.size(), data.size());
+    return 0;
+}
+
+static int to_text(const std::string& in_fn, const std::string& out_fn){
+    std::string data;
+    if(!read_file(in_fn, data)){
+        fprintf(stderr, "[ERROR] cannot read %s\n", in_fn.c_str());
+        return 1;
+    }
+
+    std::vector<std::string> topics = read_dictionary(in_fn);
+    std::ofstream out(out_fn, std::ios::binary);
+    out << "\nTIME;MQTT TOPIC;MQTT MESSAGE;";
+
+    char ts[SD_TIME_CHARS];
+    size_t count = 0;
+    size_t corrupt = decode_binary(data, [&](int64_t epoch, uint16_t id, std::string_view message){
+        out << '\n';
+        out.write(ts, sd_format_time(epoch, ts));
+        out << ';';
+        if(id < topics.size()) out << topics[id];
+        else out << '@' << id;
+        out << ';' << message << ';';
+        count++;
+    });
+
+    if(!out){
+        fprintf(stderr, "[ERROR] cannot write %s\n", out_fn.c_str());
+        return 1;
+    }
+
+    printf("%zu records, %zu corrupt blocks\n", count, corrupt);
+    return corrupt > 0;
+}
+
+/**
+ * Compares bytes per record, encode throughput and scan throughput of the two formats on
+ * the records of a text log, printed as JSON. The text scan splits lines and parses time
+ * stamps, the binary scan checks CRCs and decodes records, which is the work SDReader
+ * does per record before matching topics.
+ */
+static int bench(const std::string& in_fn){
+    std::string text;
+    if(!read_file(in_fn, text)){
+        fprintf(stderr, "[ERROR] cannot read %s\n", in_fn.c_str());
+        return 1;
+    }
+
+    std::vector<Record> records = parse_text(text, read_dictionary(in_fn));
+    if(records.empty()){
+        fprintf(stderr, "[ERROR] no records in %s\n", in_fn.c_str());
+        return 1;
+    }
+
+    const int rounds = 20;
+    using clock = std::chrono::steady_clock;
+    auto seconds = [](clock::time_point a, clock::time_point b){return std::chrono::duration<double>(b - a).count();};
+
+    // encode, text lines are formatted the way SDLogger formats them
+    std::string csv, bin;
+    char ts[SD_TIME_CHARS];
+    auto t0 = clock::now();
+    for(int i = 0; i < rounds; i++){
+        csv.clear();
+        for(const Record& r : records){
+            csv += '\n';
+            csv.append(ts, sd_format_time(r.epoch, ts));
+            csv += ';';
+            csv += r.topic;
+            csv += ';';
+            csv += r.message;
+            csv += ';';
+        }
+    }
+    auto t1 = clock::now();
+    for(int i = 0; i < rounds; i++){
+        std::vector<std::string> topics;
+        bin = encode_binary(records, topics);
+    }
+    auto t2 = clock::now();
+
+    // scan
+    size_t sink = 0;
+    for(int i = 0; i < rounds; i++) sink += parse_text(csv, {}).size();
+    auto t3 = clock::now();
+    for(int i = 0; i < rounds; i++)
+        decode_binary(bin, [&](int64_t epoch, uint16_t id, std::string_view message){sink += id + message.size() + (size_t)epoch;});
+    auto t4 = clock::now();
+
+    volatile size_t keep = sink;   // keep the scans from being optimized out
+    (void)keep;
+
+    double n = (double)records.size() * rounds;
+    printf("{\"records\": %zu,\n", records.size());
+    printf(" \"text\": {\"bytes_per_record\": %.1f, \"write_records_per_s\": %.0f, \"scan_records_per_s\": %.0f, \"scan_mb_per_s\": %.1f},\n",
+            (double)csv.size() / records.size(), n / seconds(t0, t1), n / seconds(t2, t3), csv.size() * rounds / seconds(t2, t3) / 1e6);
+    printf(" \"binary\": {\"bytes_per_record\": %.1f, \"write_records_per_s\": %.0f, \"scan_records_per_s\": %.0f, \"scan_mb_per_s\": %.1f}}\n",
+            (double)bin.size() / records.size(), n / seconds(t1, t2), n / seconds(t3, t4), bin.size() * rounds / seconds(t3, t4) / 1e6);
+    return 0;
+}
+
+int main(int argc, char** argv){
+    std::string mode = (argc > 1) ? argv[1] : "";
+
+    if(mode == "to-binary" && argc == 4) return to_binary(argv[2], argv[3]);
+    if(mode == "to-text" && argc == 4) return to_text(argv[2], argv[3]);
+    if(mode == "bench" && argc == 3) return bench(argv[2]);
+
+    fprintf(stderr, "usage: %s to-binary <log.csv> <log.sdl>\n"
+                    "       %s to-text <log.sdl> <log.csv>\n"
+                    "       %s bench <log.csv>\n", argv[0], argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file sdlog_project.cpp
+ * @brief Host benchmark of JSON field projection on the README sample lines.
+ *
+ * ```
+ * sdlog_project [lines] [field ...]
+ * ```
+ *
+ * Projects `lines` log lines (default 1000000), cycling through the README sample, onto
+ * the fields (default `HUMIDITY VWC`) as text rows and as binary tuples, and compares
+ * with a naive `find("\"<field>\":")` lookup per field. Prints throughput and bytes per
+ * line as JSON, followed by the rows of a few malformed and tricky messages. Build on the
+ * host with
+ *
+ * ```
+ * g++ -std=c++17 -O2 -I.. sdlog_project.cpp ../SDProjector.cpp ../SDJson.cpp -o sdlog_project
+ * ```
+ */
+#include "SDProjector.hpp"
+#include "SDJson.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static const char* SAMPLE[] = {
+    "5-24-2023T17:10:57+0;meter_teros10/0_shallow/08:3A:F2:31:9B:D0;{\"MAC\": \"08:3A:F2:31:9B:D0\", \"DEPTH\": \"shallow\", \"VWC_RAW\":0.003000, \"VWC\":-2.142326};",
+    "5-24-2023T17:10:57+0;meter_teros10/1_middle/08:3A:F2:31:9B:D0;{\"MAC\": \"08:3A:F2:31:9B:D0\", \"DEPTH\": \"middle\", \"VWC_RAW\":0.003000, \"VWC\":-2.142326};",
+    "5-24-2023T17:10:57+0;meter_teros10/2_deep/08:3A:F2:31:9B:D0;{\"MAC\": \"08:3A:F2:31:9B:D0\", \"DEPTH\": \"deep\", \"VWC_RAW\":0.003000, \"VWC\":-2.142326};",
+    "5-24-2023T17:10:57+0;kkm_k6p/bc:57:29:00:f6:d3;{\"MAC\": \"bc:57:29:00:f6:d3\", \"HUMIDITY\": 40.167999, \"TEMP\": 21.136999, \"GATOR_MAC\": \"08:3A:F2:31:9B:D0\"};",
+};
+
+static const char* TRICKY[] = {
+    "{\"VWC\":1.5}",
+    "{\"NOTE\": \"\\\"VWC\\\": 99, }\", \"VWC\": 2.5}",
+    "{\"CAL\": {\"VWC\": 99, \"HUMIDITY\": [1, {\"x\": \"}\"}]}, \"VWC\": 3.5}",
+    "{\"HUMIDITY\": \"n/a\", \"VWC\" : 4.5 }",
+    "{\"VWC_RAW\": 0.1, \"TEMP\": 20}",
+    "{\"VWC\": 5.5, \"HUMIDITY\": 41",
+    "{\"VWC\": \"unterminated",
+    "not json",
+};
+
+/**
+ * The obvious lookup: find `"<field>":` anywhere in the message and parse what follows.
+ * Matches keys inside strings and nested objects, kept only as a speed baseline.
+ */
+static size_t naive_row(std::string_view message, const std::vector<std::string>& needles, std::string& out){
+    size_t found = 0;
+    out.clear();
+    for(const std::string& needle : needles){
+        size_t pos = message.find(needle);
+        if(pos == std::string_view::npos) continue;
+
+        const char* start = message.data() + pos + needle.size();
+        char* end;
+        double v = strtod(start, &end);
+        if(end == start) continue;
+
+        out += needle;
+        out += std::to_string(v);
+        found++;
+    }
+    return found;
+}
+
+int main(int argc, char** argv){
+    size_t lines = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    std::vector<std::string> fields;
+    for(int i = 2; i < argc; i++) fields.push_back(argv[i]);
+    if(fields.empty()) fields = {"HUMIDITY", "VWC"};
+
+    SDProjector projector;
+    projector.set_fields(fields);
+
+    std::vector<std::string> needles;
+    for(const std::string& f : fields) needles.push_back("\"" + f + "\":");
+
+    const size_t n_sample = sizeof(SAMPLE) / sizeof(SAMPLE[0]);
+    std::vector<std::string_view> topics, messages;
+    size_t line_bytes = 0;
+    for(const char* line : SAMPLE){
+        std::string_view l(line);
+        size_t a = l.find(';'), b = l.find(';', a + 1);
+        topics.push_back(l.substr(a + 1, b - a - 1));
+        messages.push_back(l.substr(b + 1));
+        line_bytes += l.size() + 1;
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto seconds = [](clock::time_point a, clock::time_point b){return std::chrono::duration<double>(b - a).count();};
+
+    std::string row;
+    uint8_t tuple[SDREADER_TUPLE_MAX];
+    size_t row_bytes = 0, tuple_bytes = 0, rows = 0, sink = 0;
+
+    auto t0 = clock::now();
+    for(size_t i = 0; i < lines; i++){
+        size_t k = i % n_sample;
+        if(projector.project(topics[k], messages[k], 1684948257 + i, row)){
+            row_bytes += row.size() + 1;
+            rows++;
+        }
+    }
+    auto t1 = clock::now();
+    for(size_t i = 0; i < lines; i++){
+        size_t k = i % n_sample;
+        tuple_bytes += projector.project_binary(k, messages[k], 1684948257 + i, tuple);
+    }
+    auto t2 = clock::now();
+    for(size_t i = 0; i < lines; i++){
+        size_t k = i % n_sample;
+        sink += naive_row(messages[k], needles, row);
+    }
+    auto t3 = clock::now();
+
+    volatile size_t keep = sink;    // keep the baseline from being optimized out
+    (void)keep;
+
+    double raw_per_line = (double)line_bytes / n_sample;
+    printf("{\"lines\": %zu, \"fields\": %zu, \"rows\": %zu,\n", lines, fields.size(), rows);
+    printf(" \"line_bytes_per_line\": %.1f,\n", raw_per_line);
+    printf(" \"text\": {\"lines_per_s\": %.0f, \"bytes_per_line\": %.1f},\n", lines / seconds(t0, t1), (double)row_bytes / lines);
+    printf(" \"binary\": {\"lines_per_s\": %.0f, \"bytes_per_line\": %.1f},\n", lines / seconds(t1, t2), (double)tuple_bytes / lines);
+    printf(" \"naive_find\": {\"lines_per_s\": %.0f},\n", lines / seconds(t2, t3));
+
+    printf(" \"tricky\": [");
+    const size_t n_tricky = sizeof(TRICKY) / sizeof(TRICKY[0]);
+    for(size_t i = 0; i < n_tricky; i++){
+        bool ok = projector.project("t", TRICKY[i], 0, row);
+        printf("%s\n  {\"case\": %zu, \"row\": \"", i ? "," : "", i);
+        if(ok){
+            for(char c : row){
+                if(c == '"' || c == '\\') putchar('\\');
+                putchar(c);
+            }
+        }
+        printf("\"}");
+    }
+    printf("]}\n");
+
+    return 0;
+}